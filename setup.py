@@ -24,13 +24,27 @@ This module contains the required libraries and softwares allowing to execute th
 and setup elements to configure and identify the software.
 """
 
+import sys
 
 from pybind11.setup_helpers import Pybind11Extension, build_ext
 from setuptools import setup
 
+# OpenMP is used to aggregate the scanlines of a direction in parallel
+if sys.platform == "win32":
+    COMPILE_ARGS = ["/O2", "/openmp"]
+    LINK_ARGS = []
+else:
+    COMPILE_ARGS = ["-O3", "-fopenmp"]
+    LINK_ARGS = ["-fopenmp"]
+
 try:
     ext_modules = [
-        Pybind11Extension("c_libsgm", ["src/libsgm_c/sgm_wrapper.cpp"], extra_compile_args=["-O3"]),
+        Pybind11Extension(
+            "c_libsgm",
+            ["src/libsgm_c/sgm_wrapper.cpp", "src/libsgm_c/sgm_simd.cpp"],
+            extra_compile_args=COMPILE_ARGS,
+            extra_link_args=LINK_ARGS,
+        ),
     ]
 
     setup(
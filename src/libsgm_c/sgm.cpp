@@ -19,44 +19,322 @@
  */
 
 #include <cstdlib>
+#include <cmath>
 #include <iostream>
 #include <limits>
 #include <algorithm>
 #include <array>
 #include <functional>
+#include <vector>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
 #include <omp.h>
 #include "sgm.hpp"
+#include "sgm_simd.hpp"
 
 template <typename T, typename Tout>
 CostVolumes<Tout> sgm(T *cv_in, T *p1_in, T *p2_in, int *directions_in, unsigned long int nb_rows, unsigned long int nb_cols,
-                      unsigned int nb_disps, T invalid_value, float *segmentation, bool cost_paths, bool overcounting, bool edge_classification)
+                      unsigned int nb_disps, T invalid_value, float *segmentation, bool cost_paths, bool overcounting, bool edge_classification,
+                      int num_threads, Concurrency concurrency, unsigned int nb_partial_volumes, Tout *cost_volume_out,
+                      int *cost_volume_min_out, bool accumulate)
 
+{
+  return sgm<T, Tout>(contiguousInputs<T>(cv_in, p1_in, p2_in, segmentation, nb_cols, nb_disps), directions_in, nb_rows,
+                      nb_cols, nb_disps, invalid_value, cost_paths, overcounting, edge_classification, num_threads,
+                      concurrency, nb_partial_volumes, cost_volume_out, cost_volume_min_out, accumulate);
+}
+
+template <typename T, typename Tout>
+CostVolumes<Tout> sgm(const SgmInputs<T> &inputs, int *directions_in, unsigned long int nb_rows,
+                      unsigned long int nb_cols, unsigned int nb_disps, T invalid_value, bool cost_paths,
+                      bool overcounting, bool edge_classification, int num_threads, Concurrency concurrency,
+                      unsigned int nb_partial_volumes, Tout *cost_volume_out, int *cost_volume_min_out, bool accumulate,
+                      DisparityMode disparity_mode, bool keep_cost_volume, float *disparity_out,
+                      ConfidenceOptions confidence)
+{
+  typedef typename Accumulator<T>::narrow Tnarrow;
+  typedef typename Accumulator<T>::wide Twide;
+  // Narrow lanes hold twice as many disparities in a vector, if aggregated costs can not saturate them
+  if (std::is_same<Tnarrow, Twide>::value ||
+      aggregatedCostBound(inputs, nb_rows, nb_cols, nb_disps, invalid_value, getNumThreads(num_threads)) <=
+          static_cast<double>(std::numeric_limits<Tnarrow>::max()))
+  {
+    return sgmWithAccumulator<T, Tnarrow, Tout>(inputs, directions_in, nb_rows, nb_cols, nb_disps, invalid_value,
+                                                cost_paths, overcounting, edge_classification, num_threads,
+                                                concurrency, nb_partial_volumes, cost_volume_out, cost_volume_min_out,
+                                                accumulate, disparity_mode, keep_cost_volume, disparity_out,
+                                                confidence);
+  }
+  return sgmWithAccumulator<T, Twide, Tout>(inputs, directions_in, nb_rows, nb_cols, nb_disps, invalid_value,
+                                            cost_paths, overcounting, edge_classification, num_threads, concurrency,
+                                            nb_partial_volumes, cost_volume_out, cost_volume_min_out, accumulate,
+                                            disparity_mode, keep_cost_volume, disparity_out, confidence);
+}
+
+template <typename Tin, typename Tacc, typename Tout>
+CostVolumes<Tout> sgmWithAccumulator(const SgmInputs<Tin> &inputs, int *directions_in, unsigned long int nb_rows,
+                                     unsigned long int nb_cols, unsigned int nb_disps, Tin invalid_value,
+                                     bool cost_paths, bool overcounting, bool edge_classification, int num_threads,
+                                     Concurrency concurrency, unsigned int nb_partial_volumes, Tout *cost_volume_out,
+                                     int *cost_volume_min_out, bool accumulate, DisparityMode disparity_mode,
+                                     bool keep_cost_volume, float *disparity_out, ConfidenceOptions confidence)
 {
   int nb_dir = 8;
-  // Allocate final cost volume
+  // Direction (x,y) indicating previous pixel for each path
+  Direction direction[8] = {};
+  assignDirections(directions_in, direction);
+  // Directions are checked before any allocation
+  checkDirections(direction);
+  if (concurrency != CONCURRENCY_DIRECTIONS)
+  {
+    // Passes are only defined for directions following their scan order
+    checkPassDirections(direction);
+  }
+  if (accumulate && cost_volume_out == nullptr)
+  {
+    throw std::invalid_argument("accumulate requires an output cost volume.");
+  }
+  if (!keep_cost_volume &&
+      ((disparity_mode == DISPARITY_NONE && !hasConfidenceMaps(confidence)) || cost_volume_out != nullptr))
+  {
+    throw std::invalid_argument("the cost volume is kept if it is given, or without disparity nor confidence map.");
+  }
+  if ((confidence.ambiguity || confidence.risk) && !(confidence.eta_step > 0.f && confidence.eta_max >= 0.f))
+  {
+    throw std::invalid_argument("ambiguity and risk require a positive eta_step and a non-negative eta_max.");
+  }
+  if (confidence.path_agreement && !cost_paths)
+  {
+    throw std::invalid_argument("path agreement requires cost_paths.");
+  }
+  num_threads = getNumThreads(num_threads);
+  checkInputs(inputs, nb_rows, nb_cols, nb_disps, num_threads);
+  // The output volume is reset before the costs are read
+  if (static_cast<const void *>(inputs.cv_in.data) == static_cast<const void *>(cost_volume_out))
+  {
+    throw std::invalid_argument("the output cost volume must not be the cost volume.");
+  }
+  if (inputs.offsets != nullptr && concurrency != CONCURRENCY_NONE)
+  {
+    throw std::invalid_argument("ragged cost volumes are aggregated without concurrency.");
+  }
+
+  // Allocate final cost volume, or reset the one of the caller. Every aggregation adds its costs to the final
+  // cost volume, which is kept as is to accumulate them.
   CostVolumes<Tout> cvs;
   // To avoid an overflow due to big multiplications, nb_rows and nb_cols are defined as long int
-  cvs.cost_volume = new Tout[nb_rows * nb_cols * nb_disps]();
+  // A ragged output volume has the offsets of the input one
+  const unsigned long int nb_costs = (inputs.offsets != nullptr)
+                                         ? static_cast<unsigned long int>(inputs.offsets[nb_rows * nb_cols])
+                                         : nb_rows * nb_cols * nb_disps;
+  cvs.cost_volume = accumulate ? cost_volume_out : outputBuffer(cost_volume_out, nb_costs);
   // Allocate costs
   unsigned long int nb_values = 1;
   if (cost_paths)
   {
     nb_values = nb_rows * nb_cols * nb_dir;
   }
-  cvs.cost_volume_min = new int[nb_values]();
+  cvs.cost_volume_min = outputBuffer(cost_volume_min_out, nb_values);
+  cvs.disparity_map = (disparity_mode != DISPARITY_NONE) ? outputBuffer(disparity_out, nb_rows * nb_cols) : nullptr;
+  float *no_map = nullptr;
+  cvs.confidence = {confidence.ambiguity ? outputBuffer(no_map, nb_rows * nb_cols) : nullptr,
+                    confidence.risk ? outputBuffer(no_map, nb_rows * nb_cols) : nullptr,
+                    confidence.risk ? outputBuffer(no_map, nb_rows * nb_cols) : nullptr,
+                    confidence.ratio ? outputBuffer(no_map, nb_rows * nb_cols) : nullptr,
+                    confidence.path_agreement ? outputBuffer<uint8_t>(nullptr, nb_rows * nb_cols) : nullptr};
 
-  // Direction (x,y) indicating previous pixel for each path
+  // Options are dispatched once to an instantiation where they are constants
+  const ResetMode reset = (inputs.reset_masks != nullptr)
+                              ? resetMode(inputs.reset_masks, nb_rows * nb_cols, num_threads)
+                              : resetMode(inputs.segmentation, nb_rows, nb_cols, edge_classification, num_threads);
+  aggregationEngine<Tin, Tacc, Tout>(cost_paths, overcounting, reset)(inputs, direction, nb_rows, nb_cols, nb_disps,
+                                                                      invalid_value, cvs, num_threads, concurrency,
+                                                                      nb_partial_volumes, disparity_mode, confidence);
+  if (!keep_cost_volume)
+  {
+    // Only the disparity map is returned
+    delete[] cvs.cost_volume;
+    cvs.cost_volume = nullptr;
+  }
+  return cvs;
+}
+
+template <typename T, typename Tout>
+DisparityMap<Tout> esgm(const SgmInputs<T> &inputs, int *directions_in, unsigned long int nb_rows,
+                        unsigned long int nb_cols, unsigned int nb_disps, T invalid_value, bool overcounting,
+                        bool edge_classification, int num_threads, int *disparity_out, Tout *costs_out)
+{
+  typedef typename Accumulator<T>::narrow Tnarrow;
+  typedef typename Accumulator<T>::wide Twide;
+  // Same accumulator as sgm: the costs of the passes are bounded as in the aggregated cost volume
+  if (std::is_same<Tnarrow, Twide>::value ||
+      aggregatedCostBound(inputs, nb_rows, nb_cols, nb_disps, invalid_value, getNumThreads(num_threads)) <=
+          static_cast<double>(std::numeric_limits<Tnarrow>::max()))
+  {
+    return esgmWithAccumulator<T, Tnarrow, Tout>(inputs, directions_in, nb_rows, nb_cols, nb_disps, invalid_value,
+                                                 overcounting, edge_classification, num_threads, disparity_out,
+                                                 costs_out);
+  }
+  return esgmWithAccumulator<T, Twide, Tout>(inputs, directions_in, nb_rows, nb_cols, nb_disps, invalid_value,
+                                             overcounting, edge_classification, num_threads, disparity_out,
+                                             costs_out);
+}
+
+template <typename Tin, typename Tacc, typename Tout>
+DisparityMap<Tout> esgmWithAccumulator(const SgmInputs<Tin> &inputs, int *directions_in, unsigned long int nb_rows,
+                                       unsigned long int nb_cols, unsigned int nb_disps, Tin invalid_value,
+                                       bool overcounting, bool edge_classification, int num_threads,
+                                       int *disparity_out, Tout *costs_out)
+{
   Direction direction[8] = {};
   assignDirections(directions_in, direction);
+  // Directions are checked before any allocation, the passes follow their scan order
+  checkDirections(direction);
+  checkPassDirections(direction);
+  num_threads = getNumThreads(num_threads);
+  checkInputs(inputs, nb_rows, nb_cols, nb_disps, num_threads);
 
-  // Penalties (Fix: Initialize P1 and P2 to avoid warnings)
-  T P1 = static_cast<T>(0);
-  T P2 = static_cast<T>(0);
-  Penalty<T> penalty[8] = {{P1, P2}, {P1, P2}, {P1, P2}, {P1, P2}, {P1, P2}, {P1, P2}, {P1, P2}, {P1, P2}};
+  DisparityMap<Tout> map;
+  map.disparity = outputBuffer(disparity_out, nb_rows * nb_cols);
+  map.costs = outputBuffer(costs_out, 3 * nb_rows * nb_cols);
 
-  // Census Cost at pixel
-  T pixelCost;
+  const ResetMode reset = (inputs.reset_masks != nullptr)
+                              ? resetMode(inputs.reset_masks, nb_rows * nb_cols, num_threads)
+                              : resetMode(inputs.segmentation, nb_rows, nb_cols, edge_classification, num_threads);
+  esgmEngine<Tin, Tacc, Tout>(overcounting, reset)(inputs, direction, nb_rows, nb_cols, nb_disps, invalid_value, map,
+                                                   num_threads);
+  return map;
+}
+
+template <typename T>
+void checkInputs(const SgmInputs<T> &inputs, unsigned long int nb_rows, unsigned long int nb_cols,
+                 unsigned int nb_disps, int num_threads)
+{
+  if ((inputs.disp_min.data == nullptr) != (inputs.disp_max.data == nullptr))
+  {
+    throw std::invalid_argument("disp_min and disp_max must be given together.");
+  }
+  if (inputs.penalty_tables.p1 != nullptr)
+  {
+    checkPenaltyClasses(inputs.segmentation, nb_rows, nb_cols, inputs.penalty_tables.nb_classes, num_threads);
+  }
+  if (inputs.offsets != nullptr)
+  {
+    checkRaggedVolume(inputs, nb_rows, nb_cols, nb_disps, num_threads);
+  }
+}
+
+bool hasConfidenceMaps(const ConfidenceOptions &confidence)
+{
+  return confidence.ambiguity || confidence.risk || confidence.ratio || confidence.path_agreement;
+}
+
+Strides contiguousStrides(unsigned long int nb_cols, unsigned int depth)
+{
+  return {static_cast<long long>(nb_cols * depth), static_cast<long long>(depth), 1};
+}
+
+template <typename T>
+SgmInputs<T> contiguousInputs(const T *cv_in, const T *p1_in, const T *p2_in, const float *segmentation,
+                              unsigned long int nb_cols, unsigned int nb_disps)
+{
+  const int nb_dir = 8;
+  return {{cv_in, contiguousStrides(nb_cols, nb_disps)},
+          {p1_in, contiguousStrides(nb_cols, nb_dir)},
+          {p2_in, contiguousStrides(nb_cols, nb_dir)},
+          {segmentation, contiguousStrides(nb_cols, 1)},
+          {nullptr, nullptr, 0},
+          {nullptr, contiguousStrides(nb_cols, 1)},
+          nullptr,
+          nullptr,
+          {nullptr, contiguousStrides(nb_cols, 1)},
+          {nullptr, contiguousStrides(nb_cols, 1)},
+          nullptr};
+}
+
+template <typename T>
+const T *pointValues(const StridedArray<T> &array, long long row, long long col)
+{
+  return array.data + row * array.strides.row + col * array.strides.col;
+}
+
+template <typename T>
+const T *pointCosts(const StridedArray<T> &cv_in, long long row, long long col, unsigned int nb_disps, T *buffer)
+{
+  const T *costs = pointValues(cv_in, row, col);
+  if (cv_in.strides.depth == 1)
+  {
+    return costs;
+  }
+  // Disparities are not contiguous: the kernels read the costs of the point from the buffer
+  for (unsigned int disp = 0; disp < nb_disps; disp++)
+  {
+    buffer[disp] = costs[disp * cv_in.strides.depth];
+  }
+  return buffer;
+}
+
+template <typename T>
+T *outputBuffer(T *buffer, unsigned long int nb_values)
+{
+  if (buffer == nullptr)
+  {
+    return new T[nb_values]();
+  }
+  std::fill(buffer, buffer + nb_values, T(0));
+  return buffer;
+}
 
+template <typename Tin, typename Options>
+SgmInputs<Tin> passInputs(const SgmInputs<Tin> &inputs, const Direction *direction, unsigned long int nb_rows,
+                          unsigned long int nb_cols, unsigned int nb_disps, Tin invalid_value, int num_threads,
+                          std::vector<uint8_t> &reset_masks, std::vector<uint8_t> &validity)
+{
+  SgmInputs<Tin> pass_inputs = inputs;
+  if (Options::reset != RESET_NONE && inputs.reset_masks == nullptr)
+  {
+    // The direction kernels read the history resets as bits, packed once from the segmentation map
+    reset_masks.resize(nb_rows * nb_cols);
+    resetMasks(inputs.segmentation, direction, nb_rows, nb_cols, Options::reset == RESET_EDGES, reset_masks.data(),
+               num_threads);
+    pass_inputs.reset_masks = reset_masks.data();
+  }
+  if (inputs.validity == nullptr && std::isnan(static_cast<double>(invalid_value)))
+  {
+    // A NaN invalid value can not be compared to the costs of the previous point: the points with only invalid costs
+    // in their interval are found once, and the paths restart after them
+    validity.resize(nb_rows * nb_cols);
+    pixelValidity(inputs, nb_rows, nb_cols, nb_disps, invalid_value, validity.data(), num_threads);
+    pass_inputs.validity = validity.data();
+  }
+  return pass_inputs;
+}
+
+template <typename Tin, typename Tacc, typename Tout, typename Options>
+void aggregate(const SgmInputs<Tin> &inputs, Direction *direction, unsigned long int nb_rows,
+               unsigned long int nb_cols, unsigned int nb_disps, Tin invalid_value, CostVolumes<Tout> &cvs,
+               int num_threads, Concurrency concurrency, unsigned int nb_partial_volumes, DisparityMode disparity_mode,
+               const ConfidenceOptions &confidence)
+{
+  const ConfidenceOptions *pass_confidence = hasConfidenceMaps(confidence) ? &confidence : nullptr;
+  // History resets and validity are computed once for all passes
+  std::vector<uint8_t> reset_masks, validity;
+  const SgmInputs<Tin> pass_inputs = passInputs<Tin, Options>(inputs, direction, nb_rows, nb_cols, nb_disps,
+                                                              invalid_value, num_threads, reset_masks, validity);
+  if (concurrency != CONCURRENCY_NONE)
+  {
+    // Passes or directions aggregated at the same time in private partial volumes
+    aggregateConcurrently<Tin, Tacc, Tout, Options>(pass_inputs, direction, nb_rows, nb_cols, nb_disps, invalid_value,
+                                                    cvs, num_threads, concurrency, nb_partial_volumes);
+    if (disparity_mode != DISPARITY_NONE || pass_confidence != nullptr)
+    {
+      // The final costs are only known once the partial volumes are reduced
+      disparityMap(pass_inputs, nb_rows, nb_cols, nb_disps, invalid_value, disparity_mode, confidence, cvs,
+                   num_threads);
+    }
+    return;
+  }
   /*
   Two passes: the 1st from top left , the 2nd from bottom right
   Each one aggregate 4 paths
@@ -71,682 +349,1443 @@ CostVolumes<Tout> sgm(T *cv_in, T *p1_in, T *p2_in, int *directions_in, unsigned
       6 : diagonal from lower left
       7 : diagonal from lower right
   */
+  // The over-counting is corrected once, by the second pass, which also computes the disparity and confidence maps
+  aggregatePass<Tin, Tacc, Tout, typename Options::without_overcounting>(
+      0, pass_inputs, direction, nb_rows, nb_cols, nb_disps, invalid_value, cvs.cost_volume, cvs.cost_volume_min,
+      num_threads);
+  aggregatePass<Tin, Tacc, Tout, Options>(1, pass_inputs, direction, nb_rows, nb_cols, nb_disps, invalid_value,
+                                          cvs.cost_volume, cvs.cost_volume_min, num_threads, disparity_mode,
+                                          cvs.disparity_map, pass_confidence, &cvs.confidence);
+}
+
+template <typename Tin, typename Tacc, typename Tout>
+AggregationEngine<Tin, Tacc, Tout> aggregationEngine(bool cost_paths, bool overcounting, ResetMode reset)
+{
+  switch (4 * reset + 2 * cost_paths + overcounting)
+  {
+  case 0:
+    return &aggregate<Tin, Tacc, Tout, AggregationOptions<false, false, RESET_NONE>>;
+  case 1:
+    return &aggregate<Tin, Tacc, Tout, AggregationOptions<false, true, RESET_NONE>>;
+  case 2:
+    return &aggregate<Tin, Tacc, Tout, AggregationOptions<true, false, RESET_NONE>>;
+  case 3:
+    return &aggregate<Tin, Tacc, Tout, AggregationOptions<true, true, RESET_NONE>>;
+  case 4:
+    return &aggregate<Tin, Tacc, Tout, AggregationOptions<false, false, RESET_CLASSES>>;
+  case 5:
+    return &aggregate<Tin, Tacc, Tout, AggregationOptions<false, true, RESET_CLASSES>>;
+  case 6:
+    return &aggregate<Tin, Tacc, Tout, AggregationOptions<true, false, RESET_CLASSES>>;
+  case 7:
+    return &aggregate<Tin, Tacc, Tout, AggregationOptions<true, true, RESET_CLASSES>>;
+  case 8:
+    return &aggregate<Tin, Tacc, Tout, AggregationOptions<false, false, RESET_EDGES>>;
+  case 9:
+    return &aggregate<Tin, Tacc, Tout, AggregationOptions<false, true, RESET_EDGES>>;
+  case 10:
+    return &aggregate<Tin, Tacc, Tout, AggregationOptions<true, false, RESET_EDGES>>;
+  case 11:
+    return &aggregate<Tin, Tacc, Tout, AggregationOptions<true, true, RESET_EDGES>>;
+  default:
+    throw std::invalid_argument("unknown reset mode " + std::to_string(reset));
+  }
+}
+
+template <typename Tin, typename Tacc, typename Tout, typename Options>
+void esgmAggregate(const SgmInputs<Tin> &inputs, Direction *direction, unsigned long int nb_rows,
+                   unsigned long int nb_cols, unsigned int nb_disps, Tin invalid_value, DisparityMap<Tout> &map,
+                   int num_threads)
+{
+  const int nb_pass_dir = 4;
+  const Tout invalid_cost = static_cast<Tout>(invalid_value);
+  std::vector<uint8_t> reset_masks, validity;
+  const SgmInputs<Tin> pass_inputs = passInputs<Tin, Options>(inputs, direction, nb_rows, nb_cols, nb_disps,
+                                                              invalid_value, num_threads, reset_masks, validity);
+  // Best disparity of the second pass and its costs, the ones of the first pass are kept in the map
+  std::vector<int> second_disparity(nb_rows * nb_cols);
+  std::vector<Tout> second_costs(3 * nb_rows * nb_cols);
+
+  // Sum of the 4 directions of the pass at a disparity
+  auto passCost = [&](Tacc *const *lr, int disp)
+  {
+    Tout cost = 0;
+    for (int k = 0; k < nb_pass_dir; k++)
+    {
+      const float s = lr[k][disp];
+      cost += s;
+    }
+    return cost;
+  };
+  // First disparity of lowest cost of the pass among the valid costs of the interval of the point, -1 if there is none
+  auto passMinimum = [&](const Tin *pixel_costs, Tacc *const *lr, const std::pair<int, int> &range)
+  {
+    int best_disp = -1;
+    Tout best_cost = 0;
+    for (int disp = range.first; disp <= range.second; disp++)
+    {
+      if (isInvalidCost(pixel_costs[disp], invalid_value))
+      {
+        continue;
+      }
+      const Tout cost = passCost(lr, disp);
+      if (best_disp < 0 || cost < best_cost)
+      {
+        best_disp = disp;
+        best_cost = cost;
+      }
+    }
+    return best_disp;
+  };
+  // Costs of the pass at the disparity and its two neighbours, invalid out of the interval of the point
+  auto neighbourCosts = [&](Tacc *const *lr, int disp, const std::pair<int, int> &range, Tout *costs)
+  {
+    for (int k = 0; k < 3; k++)
+    {
+      const int neighbour = disp - 1 + k;
+      costs[k] = (disp >= 0 && neighbour >= range.first && neighbour <= range.second) ? passCost(lr, neighbour)
+                                                                                      : invalid_cost;
+    }
+  };
+  // Completion of the costs of the other pass, with the over-counting correction
+  auto addCosts = [&](const Tin *pixel_costs, Tacc *const *lr, int disp, const std::pair<int, int> &range,
+                      Tout *costs)
+  {
+    for (int k = 0; k < 3; k++)
+    {
+      const int neighbour = disp - 1 + k;
+      if (disp < 0 || neighbour < range.first || neighbour > range.second)
+      {
+        continue;
+      }
+      costs[k] += passCost(lr, neighbour);
+      if (Options::overcounting)
+      {
+        costs[k] -= Options::overcounting_factor * pixel_costs[neighbour];
+      }
+    }
+  };
+
+  auto firstPass = [&](long long row, long long col, const Tin *pixel_costs, Tacc *const *lr, const Tacc *,
+                       const SimdKernels<Tin, Tacc> &)
+  {
+    const unsigned long int pixel = col + row * nb_cols;
+    const std::pair<int, int> range = disparityRange(pass_inputs, row, col, nb_disps);
+    map.disparity[pixel] = passMinimum(pixel_costs, lr, range);
+    neighbourCosts(lr, map.disparity[pixel], range, &map.costs[3 * pixel]);
+  };
+  scanPass<Tin, Tacc, Options>(0, pass_inputs, direction, nb_rows, nb_cols, nb_disps, invalid_value, num_threads,
+                               firstPass);
+
+  auto secondPass = [&](long long row, long long col, const Tin *pixel_costs, Tacc *const *lr, const Tacc *,
+                        const SimdKernels<Tin, Tacc> &)
+  {
+    const unsigned long int pixel = col + row * nb_cols;
+    const std::pair<int, int> range = disparityRange(pass_inputs, row, col, nb_disps);
+    second_disparity[pixel] = passMinimum(pixel_costs, lr, range);
+    neighbourCosts(lr, second_disparity[pixel], range, &second_costs[3 * pixel]);
+    addCosts(pixel_costs, lr, map.disparity[pixel], range, &map.costs[3 * pixel]);
+  };
+  scanPass<Tin, Tacc, Options>(1, pass_inputs, direction, nb_rows, nb_cols, nb_disps, invalid_value, num_threads,
+                               secondPass);
+
+  // The first pass is aggregated again to complete the costs of the best disparities of the second pass
+  auto thirdPass = [&](long long row, long long col, const Tin *pixel_costs, Tacc *const *lr, const Tacc *,
+                       const SimdKernels<Tin, Tacc> &)
+  {
+    const unsigned long int pixel = col + row * nb_cols;
+    const int disp = second_disparity[pixel];
+    if (disp == map.disparity[pixel])
+    {
+      return;
+    }
+    Tout *costs = &second_costs[3 * pixel];
+    addCosts(pixel_costs, lr, disp, disparityRange(pass_inputs, row, col, nb_disps), costs);
+    // Lowest aggregated cost of the two candidates, the lowest disparity for a tie
+    Tout *best_costs = &map.costs[3 * pixel];
+    if (costs[1] < best_costs[1] || (costs[1] == best_costs[1] && disp < map.disparity[pixel]))
+    {
+      map.disparity[pixel] = disp;
+      std::copy(costs, costs + 3, best_costs);
+    }
+  };
+  scanPass<Tin, Tacc, Options>(0, pass_inputs, direction, nb_rows, nb_cols, nb_disps, invalid_value, num_threads,
+                               thirdPass);
+}
+
+template <typename Tin, typename Tacc, typename Tout>
+EsgmEngine<Tin, Tacc, Tout> esgmEngine(bool overcounting, ResetMode reset)
+{
+  switch (2 * reset + overcounting)
+  {
+  case 0:
+    return &esgmAggregate<Tin, Tacc, Tout, AggregationOptions<false, false, RESET_NONE>>;
+  case 1:
+    return &esgmAggregate<Tin, Tacc, Tout, AggregationOptions<false, true, RESET_NONE>>;
+  case 2:
+    return &esgmAggregate<Tin, Tacc, Tout, AggregationOptions<false, false, RESET_CLASSES>>;
+  case 3:
+    return &esgmAggregate<Tin, Tacc, Tout, AggregationOptions<false, true, RESET_CLASSES>>;
+  case 4:
+    return &esgmAggregate<Tin, Tacc, Tout, AggregationOptions<false, false, RESET_EDGES>>;
+  case 5:
+    return &esgmAggregate<Tin, Tacc, Tout, AggregationOptions<false, true, RESET_EDGES>>;
+  default:
+    throw std::invalid_argument("unknown reset mode " + std::to_string(reset));
+  }
+}
 
-  /* ---------------*/
-  /* --First pass-- */
-  /* ---------------*/
-
-  // temporary buffers and variables for storing aggregated cost
-  T *buff0 = new T[nb_disps]();
-  T *buff1 = new T[nb_cols * nb_disps]();
-  T *buff2 = new T[nb_cols * nb_disps]();
-  T *buff3 = new T[nb_cols * nb_disps]();
-  T pixel_0, pixel_1, pixel_2;
-  T *buff_disp_2 = new T[nb_disps]();
-  T min_disp0, min_disp1, min_disp2, min_disp3;
-  Tout costAggr;
-  // temporary variables for storing outputs
-  float s0, s1, s2, s3;
-  // temporary variables for storing current position of minimums
-  int pos0, pos1, pos2, pos3;
-  // temporary variables for storing current minimums
-  float min0, min1, min2, min3;
-  // temporary buffers for storing current classification
-  float current_class;
-  // buff_class0 stores the class from the left of current pixel (previous seen pixel)
-  float buff_class0;
-  // tmp_buff_class1_2_3 stores the previous classes of pixels seen in the line
-  float *tmp_buff_class1_2_3 = new float[nb_cols]();
-  // buff_class1_2_3 stores the previous line of classes
-  float *buff_class1_2_3 = new float[nb_cols]();
-  // reset variables store 0 if we want to reset history, 1 if not
-  float reset0;
-  float reset1;
-  float reset2;
-  float reset3;
-
-  for (size_t row = 0; row < nb_rows; row++)
-  {
-    for (size_t col = 0; col < nb_cols; col++)
-    {
-      // left-> right
-      apply_penalty(&penalty[0], p1_in[0 + col * nb_dir + row * nb_dir * nb_cols], p2_in[0 + col * nb_dir + row * nb_dir * nb_cols]);
-      // up -> down
-      apply_penalty(&penalty[1], p1_in[1 + col * nb_dir + row * nb_dir * nb_cols], p2_in[1 + col * nb_dir + row * nb_dir * nb_cols]);
-      // diagonal from top left
-      apply_penalty(&penalty[2], p1_in[2 + col * nb_dir + row * nb_dir * nb_cols], p2_in[2 + col * nb_dir + row * nb_dir * nb_cols]);
-      // diagonal from top right
-      apply_penalty(&penalty[3], p1_in[3 + col * nb_dir + row * nb_dir * nb_cols], p2_in[3 + col * nb_dir + row * nb_dir * nb_cols]);
-
-      // initialize minimums
-      min0 = std::numeric_limits<float>::max(), min1 = std::numeric_limits<float>::max(), min2 = std::numeric_limits<float>::max(), min3 = std::numeric_limits<float>::max();
-      pos0 = 0, pos1 = 0, pos2 = 0, pos3 = 0;
-      // Get current class of pixel
-      current_class = segmentation[col + row * nb_cols];
-      for (size_t disp = 0; disp < nb_disps; disp++)
+ResetMode resetMode(const StridedArray<float> &segmentation, unsigned long int nb_rows, unsigned long int nb_cols,
+                    bool edge_classification, int num_threads)
+{
+  if (segmentation.data == nullptr)
+  {
+    return RESET_NONE;
+  }
+  const long long rows = static_cast<long long>(nb_rows);
+  const long long cols = static_cast<long long>(nb_cols);
+  const float first_class = segmentation.data[0];
+  // Number of points resetting the history: edges, or classes different from the first one
+  long long nb_resets = 0;
+#pragma omp parallel for num_threads(num_threads) schedule(static) reduction(+ : nb_resets)
+  for (long long row = 0; row < rows; row++)
+  {
+    for (long long col = 0; col < cols; col++)
+    {
+      const float point_class = pointValues(segmentation, row, col)[0];
+      nb_resets += edge_classification ? (point_class > 0.f) : !(point_class == first_class);
+    }
+  }
+  if (nb_resets == 0)
+  {
+    // History is never reset, as with a uniform segmentation
+    return RESET_NONE;
+  }
+  return edge_classification ? RESET_EDGES : RESET_CLASSES;
+}
+
+ResetMode resetMode(const uint8_t *reset_masks, unsigned long int nb_pixels, int num_threads)
+{
+  const long long nb = static_cast<long long>(nb_pixels);
+  long long nb_resets = 0;
+#pragma omp parallel for num_threads(num_threads) schedule(static) reduction(+ : nb_resets)
+  for (long long i = 0; i < nb; i++)
+  {
+    nb_resets += (reset_masks[i] != 0);
+  }
+  return (nb_resets == 0) ? RESET_NONE : RESET_CLASSES;
+}
+
+template <typename Tseg>
+void resetMasks(const StridedArray<Tseg> &segmentation, const Direction *direction, unsigned long int nb_rows,
+                unsigned long int nb_cols, bool edge_classification, uint8_t *reset_masks, int num_threads)
+{
+  const int nb_dir = 8;
+  const long long rows = static_cast<long long>(nb_rows);
+  const long long cols = static_cast<long long>(nb_cols);
+#pragma omp parallel for num_threads(num_threads) schedule(static)
+  for (long long row = 0; row < rows; row++)
+  {
+    uint8_t *row_masks = &reset_masks[row * cols];
+    std::fill(row_masks, row_masks + cols, uint8_t(0));
+    const Tseg *labels = pointValues(segmentation, row, 0);
+    for (int dir = 0; dir < nb_dir; dir++)
+    {
+      const long long previous_row = row - direction[dir].drow;
+      if (previous_row < 0 || previous_row >= rows)
+      {
+        continue;
+      }
+      // Points of the row having a previous point along the direction
+      const long long dcol = direction[dir].dcol;
+      const long long first_col = std::max(0LL, dcol);
+      const long long last_col = std::min(cols, cols + dcol);
+      const Tseg *previous_labels = pointValues(segmentation, previous_row, 0);
+      const long long col_stride = segmentation.strides.col;
+      // omp simd is OpenMP 4.0, MSVC /openmp only implements OpenMP 2.0
+#if _OPENMP >= 201307
+#pragma omp simd
+#endif
+      for (long long col = first_col; col < last_col; col++)
       {
-        costAggr = 0;
-        s0 = 0, s1 = 0, s2 = 0, s3 = 0;
-        pixelCost = cv_in[disp + col * nb_disps + row * nb_disps * nb_cols];
-        // left-> right
-        s0 = aggregatedCostFromTopLeft0(pixelCost, row, col, disp, invalid_value, nb_rows,
-                                        nb_cols, nb_disps, penalty[0].P1, penalty[0].P2, direction[0], buff0, &min_disp0,
-                                        &pixel_0, current_class, buff_class0, reset0, edge_classification);
-        costAggr += s0;
-        // up -> down
-        s1 = aggregatedCostFromTopLeft1(pixelCost, row, col, disp, invalid_value, nb_rows,
-                                        nb_cols, nb_disps, penalty[1].P1, penalty[1].P2, direction[1], buff1, &min_disp1,
-                                        &pixel_1, current_class, buff_class1_2_3, reset1, edge_classification);
-        costAggr += s1;
-        // diagonal from top left
-        s2 = aggregatedCostFromTopLeft2(pixelCost, row, col, disp, invalid_value, nb_rows,
-                                        nb_cols, nb_disps, penalty[2].P1, penalty[2].P2, direction[2], buff2, buff_disp_2,
-                                        &min_disp2, &pixel_2, current_class, buff_class1_2_3, reset2, edge_classification);
-        costAggr += s2;
-        // diagonal from top right
-        s3 = aggregatedCostFromTopLeft3(pixelCost, row, col, disp, invalid_value, nb_rows,
-                                        nb_cols, nb_disps, penalty[3].P1, penalty[3].P2, direction[3], buff3, &min_disp3,
-                                        current_class, buff_class1_2_3, reset3, edge_classification);
-        costAggr += s3;
-
-        cvs.cost_volume[disp + col * nb_disps + row * nb_disps * nb_cols] += costAggr;
-
-        if (cost_paths)
+        const bool reset = computeReset(labels[col * col_stride], previous_labels[(col - dcol) * col_stride],
+                                        edge_classification) == 0.f;
+        row_masks[col] |= static_cast<uint8_t>(reset << dir);
+      }
+    }
+  }
+}
+
+template <typename T>
+void pixelValidity(const SgmInputs<T> &inputs, unsigned long int nb_rows, unsigned long int nb_cols,
+                   unsigned int nb_disps, T invalid_value, uint8_t *validity, int num_threads)
+{
+  const long long rows = static_cast<long long>(nb_rows);
+  const long long cols = static_cast<long long>(nb_cols);
+#pragma omp parallel for num_threads(num_threads) schedule(static)
+  for (long long row = 0; row < rows; row++)
+  {
+    for (long long col = 0; col < cols; col++)
+    {
+      // Only the costs of the interval of the point are aggregated, a ragged volume packs them from its offset
+      const std::pair<int, int> range = disparityRange(inputs, row, col, nb_disps);
+      const long long pixel = col + row * cols;
+      const T *costs = (inputs.offsets != nullptr) ? &inputs.cv_in.data[inputs.offsets[pixel]]
+                                                   : pointValues(inputs.cv_in, row, col) +
+                                                         range.first * inputs.cv_in.strides.depth;
+      const int nb_costs = std::max(range.second - range.first + 1, 0);
+      int nb_invalid = 0;
+      for (int disp = 0; disp < nb_costs; disp++)
+      {
+        nb_invalid += isInvalidCost(costs[disp * inputs.cv_in.strides.depth], invalid_value);
+      }
+      validity[pixel] = static_cast<uint8_t>(
+          (nb_invalid == nb_costs) ? PIXEL_INVALID : ((nb_invalid == 0) ? PIXEL_VALID : PIXEL_PARTIAL));
+    }
+  }
+}
+
+template <typename T>
+PenaltyMode penaltyMode(const SgmInputs<T> &inputs)
+{
+  if (inputs.penalty_tables.p1 != nullptr)
+  {
+    return PENALTIES_CLASSES;
+  }
+  if (inputs.p1_in.strides.row == 0 && inputs.p1_in.strides.col == 0 && inputs.p2_in.strides.row == 0 &&
+      inputs.p2_in.strides.col == 0)
+  {
+    return PENALTIES_CONSTANT;
+  }
+  return PENALTIES_MAP;
+}
+
+// Maximum of a penalty, from the table of the classes if there is one
+template <typename T>
+double maxPenalty(const StridedArray<T> &penalties, const T *table, unsigned int nb_classes, long long nb_rows,
+                  long long nb_cols, int num_threads)
+{
+  const int nb_dir = 8;
+  if (table != nullptr)
+  {
+    return static_cast<double>(*std::max_element(table, table + nb_classes * nb_dir));
+  }
+  double max_penalty = 0;
+  // Broadcast penalties are only read once
+  const long long rows = (penalties.strides.row == 0) ? 1 : nb_rows;
+  const long long cols = (penalties.strides.col == 0) ? 1 : nb_cols;
+  // Maximum of each thread, merged at the end: reduction(max) is OpenMP 3.1, MSVC only implements OpenMP 2.0
+#pragma omp parallel num_threads(num_threads)
+  {
+    double thread_max = 0;
+#pragma omp for schedule(static)
+    for (long long row = 0; row < rows; row++)
+    {
+      for (long long col = 0; col < cols; col++)
+      {
+        const T *values = pointValues(penalties, row, col);
+        for (int dir = 0; dir < nb_dir; dir++)
+        {
+          thread_max = std::max(thread_max, static_cast<double>(values[dir * penalties.strides.depth]));
+        }
+      }
+    }
+#pragma omp critical
+    max_penalty = std::max(max_penalty, thread_max);
+  }
+  return max_penalty;
+}
+
+template <typename T>
+double aggregatedCostBound(const SgmInputs<T> &inputs, unsigned long int nb_rows, unsigned long int nb_cols,
+                           unsigned int nb_disps, T invalid_value, int num_threads)
+{
+  // Invalid costs are kept as they are, other aggregated costs are at most cost + P2
+  double max_cost = 0;
+  const long long rows = static_cast<long long>(nb_rows);
+  const long long cols = static_cast<long long>(nb_cols);
+  if (inputs.offsets != nullptr)
+  {
+    // Costs of a ragged volume are packed one after the other
+    const long long nb_costs = inputs.offsets[rows * cols];
+#pragma omp parallel num_threads(num_threads)
+    {
+      double thread_max = 0;
+#pragma omp for schedule(static)
+      for (long long i = inputs.offsets[0]; i < nb_costs; i++)
+      {
+        if (inputs.cv_in.data[i] != invalid_value)
         {
-          std::tie(min0, pos0) = update_minimum(min0, s0, pos0, disp);
-          std::tie(min1, pos1) = update_minimum(min1, s1, pos1, disp);
-          std::tie(min2, pos2) = update_minimum(min2, s2, pos2, disp);
-          std::tie(min3, pos3) = update_minimum(min3, s3, pos3, disp);
+          thread_max = std::max(thread_max, static_cast<double>(inputs.cv_in.data[i]));
         }
       }
-      if (cost_paths)
+#pragma omp critical
+      max_cost = std::max(max_cost, thread_max);
+    }
+  }
+  else
+  {
+#pragma omp parallel num_threads(num_threads)
+    {
+      double thread_max = 0;
+#pragma omp for schedule(static)
+      for (long long row = 0; row < rows; row++)
       {
-        cvs.cost_volume_min[0 + col * nb_dir + row * nb_dir * nb_cols] = pos0;
-        cvs.cost_volume_min[1 + col * nb_dir + row * nb_dir * nb_cols] = pos1;
-        cvs.cost_volume_min[2 + col * nb_dir + row * nb_dir * nb_cols] = pos2;
-        cvs.cost_volume_min[3 + col * nb_dir + row * nb_dir * nb_cols] = pos3;
+        for (long long col = 0; col < cols; col++)
+        {
+          const T *costs = pointValues(inputs.cv_in, row, col);
+          for (unsigned int disp = 0; disp < nb_disps; disp++)
+          {
+            const T cost = costs[disp * inputs.cv_in.strides.depth];
+            if (cost != invalid_value)
+            {
+              thread_max = std::max(thread_max, static_cast<double>(cost));
+            }
+          }
+        }
       }
-      // Update buffer
-      buff_class0 = current_class;
-      tmp_buff_class1_2_3[col] = current_class;
-    }
-    // Update buffer
-    std::copy(tmp_buff_class1_2_3, tmp_buff_class1_2_3 + nb_cols, buff_class1_2_3);
-  }
-  // delete buffers
-  delete[] buff0;
-  delete[] buff1;
-  delete[] buff2;
-  delete[] buff3;
-  delete[] buff_disp_2;
-  delete[] buff_class1_2_3;
-  delete[] tmp_buff_class1_2_3;
-
-  /* ------------------*/
-  /* -- Second pass -- */
-  /* ------------------*/
-
-  // temporary buffers and variables for storing aggregated cost
-  T *buff4 = new T[nb_disps]();
-  T *buff5 = new T[nb_cols * nb_disps]();
-  T *buff6 = new T[nb_cols * nb_disps]();
-  T *buff7 = new T[nb_cols * nb_disps]();
-  T pixel_4, pixel_5, pixel_6;
-  T *buff_disp_6 = new T[nb_disps]();
-  T min_disp4, min_disp5, min_disp6, min_disp7;
-  // temporary variables for storing outputs
-  float s4, s5, s6, s7;
-  // temporary variables for storing current position of minimums
-  int pos4, pos5, pos6, pos7;
-  // temporary variables for storing current minimums
-  float min4, min5, min6, min7;
-
-  // temporary buffers for storing current classification
-  // buff_class4 stores the class from the right of current pixel (previous seen pixel)
-  float buff_class4;
-  // buff_class5_6_7 stores the previous line of classes
-  float *buff_class5_6_7 = new float[nb_cols]();
-  // tmp_buff_class5_6_7 stores the previous classes of pixels seen in the line
-  float *tmp_buff_class5_6_7 = new float[nb_cols]();
-  // reset variables store 0 if we want to reset history, 1 if not
-  float reset4;
-  float reset5;
-  float reset6;
-  float reset7;
-
-  int overcounting_factor;
-
-  if (overcounting)
-  {
-    // Factor to correct the overcounting: number of directions [8] - 1
-    overcounting_factor = 7;
+#pragma omp critical
+      max_cost = std::max(max_cost, thread_max);
+    }
+  }
+  double max_p2 = maxPenalty(inputs.p2_in, inputs.penalty_tables.p2, inputs.penalty_tables.nb_classes, rows, cols,
+                             num_threads);
+  if (inputs.guide.data != nullptr)
+  {
+    // Adaptive P2 is at most P2, or P1 when P1 is higher
+    max_p2 = std::max(max_p2, maxPenalty(inputs.p1_in, inputs.penalty_tables.p1, inputs.penalty_tables.nb_classes,
+                                         rows, cols, num_threads));
+  }
+  if (inputs.disp_min.data != nullptr || inputs.offsets != nullptr)
+  {
+    // Out of the interval of the previous point, its minimum + P2 is the only candidate: the minimum is at most
+    // cost + P2, the sum must not saturate either
+    return max_cost + 2 * max_p2;
+  }
+  return max_cost + max_p2;
+}
+
+template <typename Tin, typename Tacc, typename Options, typename PointSink>
+void scanPass(int pass, const SgmInputs<Tin> &inputs, Direction *direction, unsigned long int nb_rows,
+              unsigned long int nb_cols, unsigned int nb_disps, Tin invalid_value, int num_threads, PointSink &sink)
+{
+  const int nb_pass_dir = 4;
+  const long long rows = static_cast<long long>(nb_rows);
+  const long long cols = static_cast<long long>(nb_cols);
+
+  /*
+  Pass coordinates (i, j) follow the scan order of the pass: i = row, j = col for the first pass,
+  i = nb_rows - 1 - row, j = nb_cols - 1 - col for the second one.
+  The previous point of each path is then (i, j-1), or on the previous line (i-1, j-1..j+1).
+  */
+  DirectionKernel<Tin, Tacc> kernels[4];
+  for (int k = 0; k < nb_pass_dir; k++)
+  {
+    kernels[k] = directionKernel<Tin, Tacc>(direction[k + nb_pass_dir * pass], Options::reset, penaltyMode(inputs),
+                                            inputs.guide.data != nullptr);
+  }
+  // SIMD kernels are selected once for the number of disparities
+  const SimdKernels<Tin, Tacc> simd = aggregationKernels<Tin, Tacc>(nb_disps, invalid_value);
+
+  // Line buffers: for each direction, the aggregated costs of a row are stored in line (row % 2),
+  // the previous row is still complete in the other one when the row is aggregated
+  const unsigned long int line_size = nb_cols * nb_disps;
+  Tacc *lines = new Tacc[nb_pass_dir * 2 * line_size]();
+  Tacc *line_mins = new Tacc[nb_pass_dir * 2 * nb_cols]();
+  // Costs of the points gathered by column when their disparities are not contiguous:
+  // the points aggregated at the same time are in different columns
+  Tin *cost_lines = (inputs.cv_in.strides.depth != 1 || inputs.offsets != nullptr) ? new Tin[line_size] : nullptr;
+
+  // Aggregate the point (i, j) along the 4 directions of the pass
+  auto aggregatePoint = [&](long long i, long long j)
+  {
+    const long long row = (pass == 0) ? i : rows - 1 - i;
+    const long long col = (pass == 0) ? j : cols - 1 - j;
+    const Tin *pixel_costs =
+        (inputs.offsets != nullptr)
+            ? raggedCosts(inputs, row, col, nb_cols, nb_disps, invalid_value, &cost_lines[col * nb_disps])
+            : pointCosts(inputs.cv_in, row, col, nb_disps, (cost_lines != nullptr) ? &cost_lines[col * nb_disps] : nullptr);
+
+    Tacc *lr[4];
+    Tacc min_lr[4];
+    for (int k = 0; k < nb_pass_dir; k++)
+    {
+      const LineBuffers<Tacc> direction_lines = {&lines[2 * k * line_size], &line_mins[2 * k * nb_cols]};
+      lr[k] = kernels[k](pixel_costs, inputs, row, col, rows, cols, nb_disps, invalid_value, k + nb_pass_dir * pass,
+                         simd, direction_lines, min_lr[k]);
+    }
+    sink(row, col, pixel_costs, lr, min_lr, simd);
+  };
+
+  if (num_threads > 1)
+  {
+    // The point (i, j) only depends on points of lower wavefronts t = 2*i + j:
+    // all points of a wavefront are aggregated in parallel
+    const long long nb_wavefronts = 2 * (rows - 1) + cols;
+#pragma omp parallel num_threads(num_threads)
+    {
+      for (long long t = 0; t < nb_wavefronts; t++)
+      {
+        // points of the wavefront: j = t - 2 * i in [0, nb_cols)
+        const long long i_first = (t - cols + 1 <= 0) ? 0 : (t - cols + 2) / 2;
+        const long long i_last = std::min(rows - 1, t / 2);
+#pragma omp for schedule(static)
+        for (long long i = i_first; i <= i_last; i++)
+        {
+          aggregatePoint(i, t - 2 * i);
+        }
+        // implicit barrier of the loop: wavefront t is complete before wavefront t + 1
+      }
+    }
   }
   else
   {
-    // Factor to not correct the over-counting
-    overcounting_factor = 0;
+    for (long long i = 0; i < rows; i++)
+    {
+      for (long long j = 0; j < cols; j++)
+      {
+        aggregatePoint(i, j);
+      }
+    }
+  }
+
+  delete[] lines;
+  delete[] line_mins;
+  delete[] cost_lines;
+}
+
+template <typename Tin, typename Tacc, typename Tout, typename Options>
+void aggregatePass(int pass, const SgmInputs<Tin> &inputs, Direction *direction, unsigned long int nb_rows,
+                   unsigned long int nb_cols, unsigned int nb_disps, Tin invalid_value, Tout *cost_volume,
+                   int *cost_volume_min, int num_threads, DisparityMode disparity_mode, float *disparity_map, const ConfidenceOptions *confidence,
+                   ConfidenceMaps *confidence_maps)
+{
+  const int nb_dir = 8;
+  const int nb_pass_dir = 4;
+
+  // Sum of the 4 directions of the pass, added to the volume at each point
+  auto writePoint = [&](long long row, long long col, const Tin *pixel_costs, Tacc *const *lr, const Tacc *min_lr,
+                        const SimdKernels<Tin, Tacc> &simd)
+  {
+    const unsigned long int pixel = col + row * nb_cols;
+    // A ragged volume only stores the disparities of the interval of the point
+    int first_disp = 0;
+    int last_disp = static_cast<int>(nb_disps) - 1;
+    unsigned long int offset = pixel * nb_disps;
+    if (inputs.offsets != nullptr)
+    {
+      const std::pair<int, int> range = disparityRange(inputs, row, col, nb_disps);
+      first_disp = range.first;
+      last_disp = range.second;
+      offset = static_cast<unsigned long int>(inputs.offsets[pixel]);
+    }
+    Tout *pixel_cost_volume = &cost_volume[offset];
+    for (int disp = first_disp; disp <= last_disp; disp++)
+    {
+      Tout costAggr = 0;
+      for (int k = 0; k < nb_pass_dir; k++)
+      {
+        const float s = lr[k][disp];
+        costAggr += s;
+      }
+      pixel_cost_volume[disp - first_disp] += costAggr;
+      if (Options::overcounting)
+      {
+        // Correction of the over-counting by removing (overcounting_factor * pixel cost volume)
+        pixel_cost_volume[disp - first_disp] -= Options::overcounting_factor * pixel_costs[disp];
+      }
+    }
+    if (Options::cost_paths)
+    {
+      // Minimum of each direction is known from the aggregation, only its position is searched
+      for (int k = 0; k < nb_pass_dir; k++)
+      {
+        cost_volume_min[k + nb_pass_dir * pass + pixel * nb_dir] = lastMinimumPosition(lr[k], nb_disps, min_lr[k], simd.last_index);
+      }
+    }
+    if (disparity_mode != DISPARITY_NONE || confidence != nullptr)
+    {
+      // The final costs of the point are still in cache, and the minimum of each direction is known
+      const std::pair<int, int> range = disparityRange(inputs, row, col, nb_disps);
+      const Tout *interval_costs = &pixel_cost_volume[range.first - first_disp];
+      if (disparity_mode != DISPARITY_NONE)
+      {
+        disparity_map[pixel] = pointDisparity(interval_costs, pixel_costs, range.first, range.second, invalid_value,
+                                              disparity_mode);
+      }
+      if (confidence != nullptr)
+      {
+        pointConfidence(interval_costs, pixel_costs, range.first, range.second, invalid_value, *confidence,
+                        Options::cost_paths ? &cost_volume_min[pixel * nb_dir] : nullptr, *confidence_maps, pixel);
+      }
+    }
+  };
+  scanPass<Tin, Tacc, Options>(pass, inputs, direction, nb_rows, nb_cols, nb_disps, invalid_value, num_threads,
+                               writePoint);
+}
+
+template <typename Tin, typename Tacc, typename Tout, typename Options>
+void aggregateConcurrently(const SgmInputs<Tin> &inputs, Direction *direction, unsigned long int nb_rows,
+                           unsigned long int nb_cols, unsigned int nb_disps, Tin invalid_value, CostVolumes<Tout> &cvs,
+                           int num_threads, Concurrency concurrency, unsigned int nb_partial_volumes)
+{
+  const unsigned long int nb_values = nb_rows * nb_cols * nb_disps;
+  // A task is a pass (4 directions) or a single direction
+  const int nb_tasks = (concurrency == CONCURRENCY_PASSES) ? 2 : 8;
+  // The first running task writes in the final cost volume, each other one in its private partial volume
+  const int nb_concurrent = std::max(1, std::min({nb_tasks, static_cast<int>(std::min(nb_partial_volumes, 7u)) + 1, num_threads}));
+  // Threads left for the wavefronts or scanlines of each task
+  const int task_threads = std::max(1, num_threads / nb_concurrent);
+
+  std::vector<Tout *> partial_volumes(nb_concurrent);
+  partial_volumes[0] = cvs.cost_volume;
+  for (int slot = 1; slot < nb_concurrent; slot++)
+  {
+    partial_volumes[slot] = new Tout[nb_values]();
+  }
+
+  // Tasks and scanlines are two nested levels of parallelism. MSVC only implements OpenMP 2.0, without active levels.
+#if defined(_OPENMP) && _OPENMP >= 200805
+  const int max_active_levels = omp_get_max_active_levels();
+  omp_set_max_active_levels(2);
+#elif defined(_OPENMP)
+  const int nested = omp_get_nested();
+  omp_set_nested(1);
+#endif
+
+  int correction = Options::overcounting_factor;
+  for (int first_task = 0; first_task < nb_tasks; first_task += nb_concurrent)
+  {
+    const int nb_running = std::min(nb_concurrent, nb_tasks - first_task);
+#pragma omp parallel for num_threads(nb_running) schedule(static, 1)
+    for (int slot = 0; slot < nb_running; slot++)
+    {
+      const int task = first_task + slot;
+      CostVolumes<Tout> task_cvs = {partial_volumes[slot], cvs.cost_volume_min, nullptr, {}};
+      if (concurrency == CONCURRENCY_PASSES)
+      {
+        aggregatePass<Tin, Tacc, Tout, typename Options::without_overcounting>(
+            task, inputs, direction, nb_rows, nb_cols, nb_disps, invalid_value, task_cvs.cost_volume,
+            task_cvs.cost_volume_min, task_threads);
+      }
+      else
+      {
+        aggregateDirection<Tin, Tacc, Tout, Options>(inputs, nb_rows, nb_cols, nb_disps, invalid_value, task,
+                                                     direction[task], task_cvs, task_threads);
+      }
+    }
+    // Sum the partial volumes in the final one, the over-counting correction is applied once
+    if (nb_running > 1 || correction != 0)
+    {
+      reducePartialVolumes(inputs.cv_in, partial_volumes.data(), nb_running, nb_rows, nb_cols, nb_disps, correction,
+                           num_threads);
+      correction = 0;
+    }
+  }
+
+#if defined(_OPENMP) && _OPENMP >= 200805
+  omp_set_max_active_levels(max_active_levels);
+#elif defined(_OPENMP)
+  omp_set_nested(nested);
+#endif
+
+  for (int slot = 1; slot < nb_concurrent; slot++)
+  {
+    delete[] partial_volumes[slot];
   }
+}
 
-  for (int row = nb_rows - 1; row >= 0; row--)
+template <typename T, typename Tout>
+void reducePartialVolumes(const StridedArray<T> &cv_in, Tout **partial_volumes, int nb_partial_volumes,
+                          unsigned long int nb_rows, unsigned long int nb_cols, unsigned int nb_disps,
+                          int overcounting_factor, int num_threads)
+{
+  Tout *cost_volume = partial_volumes[0];
+  const long long nb_pixels = static_cast<long long>(nb_rows * nb_cols);
+  const long long cols = static_cast<long long>(nb_cols);
+#pragma omp parallel for num_threads(num_threads) schedule(static)
+  for (long long pixel = 0; pixel < nb_pixels; pixel++)
+  {
+    const T *costs = pointValues(cv_in, pixel / cols, pixel % cols);
+    for (unsigned int disp = 0; disp < nb_disps; disp++)
+    {
+      const unsigned long int i = pixel * nb_disps + disp;
+      Tout costAggr = cost_volume[i];
+      for (int slot = 1; slot < nb_partial_volumes; slot++)
+      {
+        costAggr += partial_volumes[slot][i];
+        // the partial volume is ready for the next tasks
+        partial_volumes[slot][i] = 0;
+      }
+      cost_volume[i] = costAggr - overcounting_factor * costs[disp * cv_in.strides.depth];
+    }
+  }
+}
+
+template <typename Tin, typename Tacc, typename Tout, typename Options>
+void aggregateDirection(const SgmInputs<Tin> &inputs, unsigned long int nb_rows, unsigned long int nb_cols,
+                        unsigned int nb_disps, Tin invalid_value, int dir, Direction direction, CostVolumes<Tout> &cvs,
+                        int num_threads)
+{
+  const int nb_dir = 8;
+  const long long rows = static_cast<long long>(nb_rows);
+  const long long cols = static_cast<long long>(nb_cols);
+
+  const DirectionKernel<Tin, Tacc> kernel =
+      directionKernel<Tin, Tacc>(direction, Options::reset, penaltyMode(inputs), inputs.guide.data != nullptr);
+  const SimdKernels<Tin, Tacc> simd = aggregationKernels<Tin, Tacc>(nb_disps, invalid_value);
+
+  // Aggregate the point (row, col) and add its aggregated costs to the final cost volume
+  // Costs of the points are gathered in cost_lines when their disparities are not contiguous
+  const bool gather = (inputs.cv_in.strides.depth != 1);
+  auto step = [&](long long row, long long col, const LineBuffers<Tacc> &lines, Tin *cost_lines)
+  {
+    const unsigned long int pixel = col + row * nb_cols;
+    const Tin *pixel_costs =
+        pointCosts(inputs.cv_in, row, col, nb_disps, gather ? &cost_lines[col * nb_disps] : nullptr);
+    Tacc min_lr;
+    const Tacc *lr = kernel(pixel_costs, inputs, row, col, rows, cols, nb_disps, invalid_value, dir, simd, lines,
+                            min_lr);
+
+    Tout *pixel_cost_volume = &cvs.cost_volume[pixel * nb_disps];
+    for (unsigned int disp = 0; disp < nb_disps; disp++)
+    {
+      pixel_cost_volume[disp] += lr[disp];
+    }
+    if (Options::cost_paths)
+    {
+      cvs.cost_volume_min[dir + pixel * nb_dir] = lastMinimumPosition(lr, nb_disps, min_lr, simd.last_index);
+    }
+  };
+
+  if (direction.drow == 0)
+  {
+    // Horizontal paths: each row is an independent scanline, aggregated in the private lines of a thread
+#pragma omp parallel num_threads(num_threads)
+    {
+      const LineBuffers<Tacc> lines = {new Tacc[2 * nb_cols * nb_disps](), new Tacc[2 * nb_cols]()};
+      Tin *cost_lines = gather ? new Tin[nb_cols * nb_disps] : nullptr;
+#pragma omp for schedule(static)
+      for (long long row = 0; row < rows; row++)
+      {
+        for (long long i = 0; i < cols; i++)
+        {
+          step(row, (direction.dcol > 0) ? i : cols - 1 - i, lines, cost_lines);
+        }
+      }
+      delete[] lines.lr;
+      delete[] lines.min_lr;
+      delete[] cost_lines;
+    }
+  }
+  else
   {
-    for (int col = nb_cols - 1; col >= 0; col--)
+    // Vertical and diagonal paths: each point only depends on the previous row,
+    // so the columns of a row are shared by the threads, one row after the other
+    const LineBuffers<Tacc> lines = {new Tacc[2 * nb_cols * nb_disps](), new Tacc[2 * nb_cols]()};
+    Tin *cost_lines = gather ? new Tin[nb_cols * nb_disps] : nullptr;
+#pragma omp parallel num_threads(num_threads)
     {
-      // right->left
-      apply_penalty(&penalty[4], p1_in[4 + col * nb_dir + row * nb_dir * nb_cols], p2_in[4 + col * nb_dir + row * nb_dir * nb_cols]);
-      // up -> down
-      apply_penalty(&penalty[5], p1_in[5 + col * nb_dir + row * nb_dir * nb_cols], p2_in[5 + col * nb_dir + row * nb_dir * nb_cols]);
-      // diagonal from lower left
-      apply_penalty(&penalty[6], p1_in[6 + col * nb_dir + row * nb_dir * nb_cols], p2_in[6 + col * nb_dir + row * nb_dir * nb_cols]);
-      // diagonal from lower right
-      apply_penalty(&penalty[7], p1_in[7 + col * nb_dir + row * nb_dir * nb_cols], p2_in[7 + col * nb_dir + row * nb_dir * nb_cols]);
-
-      // initialize minimums
-      min4 = std::numeric_limits<float>::max(), min5 = std::numeric_limits<float>::max(), min6 = std::numeric_limits<float>::max(), min7 = std::numeric_limits<float>::max();
-      pos4 = 0, pos5 = 0, pos6 = 0, pos7 = 0;
-      // Get current class of pixel
-      current_class = segmentation[col + row * nb_cols];
-
-      for (size_t disp = 0; disp < nb_disps; disp++)
+      for (long long i = 0; i < rows; i++)
       {
-        costAggr = 0;
-        s4 = 0, s5 = 0, s6 = 0, s7 = 0;
-
-        pixelCost = cv_in[disp + col * nb_disps + row * nb_disps * nb_cols];
-        // right->left
-        s4 = aggregatedCostFromBottomRight4(pixelCost, row, col, disp, invalid_value, nb_rows,
-                                            nb_cols, nb_disps, penalty[4].P1, penalty[4].P2, direction[4], buff4, &min_disp4, &pixel_4,
-                                            current_class, buff_class4, reset4, edge_classification);
-        costAggr += s4;
-        // up -> down
-        s5 = aggregatedCostFromBottomRight5(pixelCost, row, col, disp, invalid_value, nb_rows,
-                                            nb_cols, nb_disps, penalty[5].P1, penalty[5].P2, direction[5], buff5, &min_disp5, &pixel_5,
-                                            current_class, buff_class5_6_7, reset5, edge_classification);
-        costAggr += s5;
-        // diagonal from lower left
-        s6 = aggregatedCostFromBottomRight6(pixelCost, row, col, disp, invalid_value, nb_rows,
-                                            nb_cols, nb_disps, penalty[6].P1, penalty[6].P2, direction[6], buff6, buff_disp_6, &min_disp6,
-                                            &pixel_6, current_class, buff_class5_6_7, reset6, edge_classification);
-        costAggr += s6;
-        // diagonal from lower right
-        s7 = aggregatedCostFromBottomRight7(pixelCost, row, col, disp, invalid_value, nb_rows,
-                                            nb_cols, nb_disps, penalty[7].P1, penalty[7].P2, direction[7], buff7, &min_disp7, current_class,
-                                            buff_class5_6_7, reset7, edge_classification);
-        costAggr += s7;
-
-        cvs.cost_volume[disp + col * nb_disps + row * nb_disps * nb_cols] += costAggr;
-        // Correction of the over-counting by removing (overcounting_factor * pixel cost volume) to the aggregated cost volume
-        cvs.cost_volume[disp + col * nb_disps + row * nb_disps * nb_cols] -= overcounting_factor * pixelCost;
-
-        if (cost_paths)
+        const long long row = (direction.drow > 0) ? i : rows - 1 - i;
+#pragma omp for schedule(static)
+        for (long long col = 0; col < cols; col++)
         {
-          std::tie(min4, pos4) = update_minimum(min4, s4, pos4, disp);
-          std::tie(min5, pos5) = update_minimum(min5, s5, pos5, disp);
-          std::tie(min6, pos6) = update_minimum(min6, s6, pos6, disp);
-          std::tie(min7, pos7) = update_minimum(min7, s7, pos7, disp);
+          step(row, col, lines, cost_lines);
         }
+        // implicit barrier of the loop: the whole row is aggregated before being used as previous row
       }
-      if (cost_paths)
-      {
-        cvs.cost_volume_min[4 + col * nb_dir + row * nb_dir * nb_cols] = pos4;
-        cvs.cost_volume_min[5 + col * nb_dir + row * nb_dir * nb_cols] = pos5;
-        cvs.cost_volume_min[6 + col * nb_dir + row * nb_dir * nb_cols] = pos6;
-        cvs.cost_volume_min[7 + col * nb_dir + row * nb_dir * nb_cols] = pos7;
-      }
-
-      // Update buffer
-      buff_class4 = current_class;
-      tmp_buff_class5_6_7[col] = current_class;
     }
-    // Update buffer
-    std::copy(tmp_buff_class5_6_7, tmp_buff_class5_6_7 + nb_cols, buff_class5_6_7);
+    delete[] lines.lr;
+    delete[] lines.min_lr;
+    delete[] cost_lines;
   }
+}
 
-  delete[] buff4;
-  delete[] buff5;
-  delete[] buff6;
-  delete[] buff7;
-  delete[] buff_disp_6;
-  delete[] buff_class5_6_7;
-  delete[] tmp_buff_class5_6_7;
-
-  return cvs;
+// Initial value of a running minimum
+template <typename T>
+T maxCost()
+{
+  return std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
 }
 
-std::pair<float, int> update_minimum(float current_min, float value, int current_disp, int disp)
+// Sum of two costs, saturating for integer types as the SIMD lanes
+template <typename T>
+T saturatedAdd(T a, T b)
 {
-  if (current_min < value)
-  {
-    return std::make_pair(current_min, current_disp);
-  }
-  else
+  if (std::numeric_limits<T>::is_integer)
   {
-    return std::make_pair(value, disp);
+    return static_cast<T>(std::min<long long>(static_cast<long long>(a) + static_cast<long long>(b),
+                                              std::numeric_limits<T>::max()));
   }
+  return a + b;
 }
 
-template <typename T>
-T aggregatedCostFromTopLeft0(T pixelCost, int row, int col, int disp, T invalid_value,
-                             int nb_rows, int nb_cols, int nb_disps, T P1, T P2, Direction direction,
-                             T *buff0, T *min_disp0, T *pixel_0, float current_class, float buff_class0, float &reset0, bool edge_classification)
+template <typename Tin, typename Tacc>
+Tacc aggregatePixel(const Tin *pixel_costs, const Tacc *previous_lr, Tacc *lr, unsigned int nb_disps, Tacc P1,
+                    Tacc P2, Tin invalid_value, float reset, Tacc previous_min,
+                    AggregatePixelKernel<Tin, Tacc> simd_kernel)
 {
+  // Vectorised kernel along the disparity axis, the history is only reset by the scalar path
+  if (reset == 1.f && simd_kernel != nullptr)
+  {
+    return simd_kernel(pixel_costs, previous_lr, lr, nb_disps, P1, P2, invalid_value, previous_min);
+  }
+  // Minimum cost at previous point
+  const Tacc min_disp = previous_min;
 
-  // Pixel cost at the point (row,col,disp)
-  /* ------------------*/
-  /* -- Left->right -- */
-  /* ------------------*/
-
-  T costAggr0 = pixelCost;
-
-  if (!(row - direction.drow < 0 || row - direction.drow > (nb_rows - 1) || col - direction.dcol < 0 || col - direction.dcol > (nb_cols - 1)))
-  { /*Minimum cost at previous point for each disparity
-    Compute value just at the first disparity for a given point (row,col)
-    */
-
-    if (disp == 0)
-    {
-      *min_disp0 = *std::min_element(&buff0[disp], &buff0[nb_disps]);
-      if (edge_classification) {
-        // if pixel is an edge, reset history
-        reset0 = static_cast<float>(!(buff_class0 > 0.f));
-      } else {
-        // if classes are different, reset history (reset == 0)
-        reset0 = static_cast<float>(current_class == buff_class0);
-      }
-    }
-    /*If pixelCost is equal to invalid value, aggregated cost must be equal to invalid value.
-    So, it's useless to compute the minimum on tmp1,tmp2,tmp3,tmp4
-    */
-    if (pixelCost != invalid_value)
+  Tacc min_lr = maxCost<Tacc>();
+  for (unsigned int disp = 0; disp < nb_disps; disp++)
+  {
+    Tacc costAggr = pixel_costs[disp];
+    // If pixelCost is equal to invalid value, aggregated cost must be equal to invalid value
+    if (!isInvalidCost(pixel_costs[disp], invalid_value))
     {
       // Previous cost
-      const T tmp1 = buff0[disp];
+      const Tacc tmp1 = previous_lr[disp];
       // Previous cost at disparity-1
-      const T tmp2 = (disp > 0) ? *pixel_0 + P1 : std::numeric_limits<T>::max();
+      const Tacc tmp2 = (disp > 0) ? saturatedAdd(previous_lr[disp - 1], P1) : std::numeric_limits<Tacc>::max();
       // Previous cost at disparity+1
-      const T tmp3 = (disp < nb_disps - 1) ? buff0[disp + 1] + P1 : std::numeric_limits<T>::max();
+      const Tacc tmp3 = (disp < nb_disps - 1) ? saturatedAdd(previous_lr[disp + 1], P1)
+                                              : std::numeric_limits<Tacc>::max();
+      // Minimum cost at previous point
+      const Tacc tmp4 = saturatedAdd(min_disp, P2);
+      // Minimum path cost, from the minimum of the previous point first: NaN invalid costs are never selected
+      costAggr = saturatedAdd(costAggr, static_cast<Tacc>(reset * (std::min({tmp4, tmp1, tmp2, tmp3}) - min_disp)));
+    }
+    lr[disp] = costAggr;
+    min_lr = std::min(min_lr, costAggr);
+  }
+  return min_lr;
+}
 
-      const T tmp4 = (*min_disp0) + P2;
+template <typename Tin, typename Tacc>
+Tacc aggregatePixelRange(const Tin *pixel_costs, const Tacc *previous_lr, Tacc *lr, unsigned int nb_disps,
+                         std::pair<int, int> range, std::pair<int, int> previous_range, Tacc P1, Tacc P2,
+                         Tin invalid_value, float reset, Tacc previous_min)
+{
+  const Tacc invalid_lr = static_cast<Tacc>(invalid_value);
+  if (range.first > range.second)
+  {
+    std::fill(lr, lr + nb_disps, invalid_lr);
+    return std::min(maxCost<Tacc>(), invalid_lr);
+  }
+  // Out of the interval, aggregated costs are invalid and the recurrence is not computed
+  std::fill(lr, lr + range.first, invalid_lr);
+  std::fill(lr + range.second + 1, lr + nb_disps, invalid_lr);
+  // Minimum cost at previous point, over its interval
+  const Tacc min_disp = previous_min;
 
-      // Minimum path cost
-      costAggr0 += reset0 * (std::min({tmp1, tmp2, tmp3, tmp4}) - (*min_disp0));
+  Tacc min_lr = maxCost<Tacc>();
+  for (int disp = range.first; disp <= range.second; disp++)
+  {
+    Tacc costAggr = pixel_costs[disp];
+    if (!isInvalidCost(pixel_costs[disp], invalid_value))
+    {
+      // Previous costs out of the previous interval are only reached through its minimum and P2
+      const Tacc tmp1 = (disp >= previous_range.first && disp <= previous_range.second)
+                            ? previous_lr[disp]
+                            : std::numeric_limits<Tacc>::max();
+      const Tacc tmp2 = (disp > previous_range.first && disp - 1 <= previous_range.second)
+                            ? saturatedAdd(previous_lr[disp - 1], P1)
+                            : std::numeric_limits<Tacc>::max();
+      const Tacc tmp3 = (disp + 1 >= previous_range.first && disp < previous_range.second)
+                            ? saturatedAdd(previous_lr[disp + 1], P1)
+                            : std::numeric_limits<Tacc>::max();
+      const Tacc tmp4 = saturatedAdd(min_disp, P2);
+      costAggr = saturatedAdd(costAggr, static_cast<Tacc>(reset * (std::min({tmp4, tmp1, tmp2, tmp3}) - min_disp)));
     }
+    lr[disp] = costAggr;
+    min_lr = std::min(min_lr, costAggr);
   }
-  // sava buffer data before writing new value in buffer
-  *pixel_0 = buff0[disp];
-  // Save data in buffer
-  buff0[disp] = costAggr0;
+  return min_lr;
+}
 
-  return costAggr0;
+// Interval of a point from two grids, clamped to the disparity axis
+std::pair<int, int> gridRange(const StridedArray<int32_t> &disp_min, const StridedArray<int32_t> &disp_max,
+                              long long row, long long col, unsigned int nb_disps)
+{
+  return std::make_pair(std::max(static_cast<int>(pointValues(disp_min, row, col)[0]), 0),
+                        std::min(static_cast<int>(pointValues(disp_max, row, col)[0]), static_cast<int>(nb_disps) - 1));
 }
 
 template <typename T>
-T aggregatedCostFromTopLeft1(T pixelCost, int row, int col, int disp, T invalid_value,
-                             int nb_rows, int nb_cols, int nb_disps, T P1, T P2, Direction direction,
-                             T *buff1, T *min_disp1, T *pixel_1, float current_class, float *buff_class1, float &reset1, bool edge_classification)
-{
-  /* ------------------*/
-  /* --  Up->Down   -- */
-  /* ------------------*/
-  T costAggr1 = pixelCost;
-  // Border check
-  if (!(row - direction.drow < 0 || row - direction.drow > (nb_rows - 1) || col - direction.dcol < 0 || col - direction.dcol > (nb_cols - 1)))
-  {
-    /*Minimum cost at previous point for each disparity
-    Compute value just at the first disparity for a given point (row,col)
-    */
-    if (disp == 0)
-    {
-      *min_disp1 = *std::min_element(&buff1[disp + col * nb_disps], &buff1[nb_disps + col * nb_disps]);
-
-      if (edge_classification) {
-        // if pixel is an edge, reset history
-        reset1 = static_cast<float>(!(buff_class1[col - direction.dcol] > 0.f));
-      } else {
-        // if classes are different, reset history (reset == 0)
-        reset1 = static_cast<float>(current_class == buff_class1[col - direction.dcol]);
-      }
-    }
-    /*If pixelCost is equal to invalid value, aggregated cost must be equal to invalid value.
-    So, it's useless to compute the minimum on tmp1,tmp2,tmp3,tmp4
-    */
-    if (pixelCost != invalid_value)
+std::pair<int, int> disparityRange(const SgmInputs<T> &inputs, long long row, long long col, unsigned int nb_disps)
+{
+  if (inputs.disp_min.data == nullptr)
+  {
+    return std::make_pair(0, static_cast<int>(nb_disps) - 1);
+  }
+  return gridRange(inputs.disp_min, inputs.disp_max, row, col, nb_disps);
+}
+
+int64_t raggedOffsets(const StridedArray<int32_t> &disp_min, const StridedArray<int32_t> &disp_max,
+                      unsigned long int nb_rows, unsigned long int nb_cols, unsigned int nb_disps, int64_t *offsets)
+{
+  const long long rows = static_cast<long long>(nb_rows);
+  const long long cols = static_cast<long long>(nb_cols);
+  offsets[0] = 0;
+  for (long long row = 0; row < rows; row++)
+  {
+    for (long long col = 0; col < cols; col++)
     {
-      // Previous cost
-      const T tmp1 = buff1[disp + col * nb_disps];
-      // Previous cost at disparity-1
-      const T tmp2 = (disp > 0) ? *pixel_1 + P1 : std::numeric_limits<T>::max();
-      // Previous cost at disparity+1
-      const T tmp3 = (disp < nb_disps - 1) ? buff1[disp + 1 + col * nb_disps] + P1 : std::numeric_limits<T>::max();
-      // Minimum cost at previous point
-      const T tmp4 = (*min_disp1) + P2;
-      // Minimum path cost
-      costAggr1 += reset1 * (std::min({tmp1, tmp2, tmp3, tmp4}) - (*min_disp1));
+      const std::pair<int, int> range = gridRange(disp_min, disp_max, row, col, nb_disps);
+      const long long pixel = col + row * cols;
+      offsets[pixel + 1] = offsets[pixel] + std::max(range.second - range.first + 1, 0);
     }
   }
-  // sava buffer data before writing new value in buffer
-  *pixel_1 = buff1[disp + col * nb_disps];
-  // Save data in buffer
-  buff1[disp + col * nb_disps] = costAggr1;
-
-  return costAggr1;
+  return offsets[rows * cols];
 }
 
 template <typename T>
-T aggregatedCostFromTopLeft2(T pixelCost, int row, int col, int disp, T invalid_value,
-                             int nb_rows, int nb_cols, int nb_disps, T P1, T P2, Direction direction,
-                             T *buff2, T *buff_disp_2, T *min_disp2, T *pixel_2, float current_class, float *buff_class2, float &reset2, bool edge_classification)
-{
-
-  /* -----------------------------*/
-  /* --Diagonal from upper left-- */
-  /* -----------------------------*/
-  T costAggr2 = pixelCost;
-  // Border check
-  if (!(row - direction.drow < 0 || row - direction.drow > (nb_rows - 1) || col - direction.dcol < 0 || col - direction.dcol > (nb_cols - 1)))
-  {
-    /*Minimum cost at previous point for each disparity
-    Compute value just at the first disparity for a given point (row,col)
-    */
-    if (disp == 0)
-    {
-      *min_disp2 = *std::min_element(&buff_disp_2[disp], &buff_disp_2[nb_disps]);
-      
-      if (edge_classification) {
-        // if pixel is an edge, reset history
-        reset2 = static_cast<float>(!(buff_class2[col - direction.dcol] > 0.f));
-      } else {
-        // if classes are different, reset history (reset == 0)
-        reset2 = static_cast<float>(current_class == buff_class2[col - direction.dcol]);
-      }
-    }
-    /*If pixelCost is equal to invalid value, aggregated cost must be equal to invalid value.
-    So, it's useless to compute the minimum on tmp1,tmp2,tmp3,tmp4
-    */
-    if (pixelCost != invalid_value)
+void toRagged(const StridedArray<T> &cv_in, const StridedArray<int32_t> &disp_min,
+              const StridedArray<int32_t> &disp_max, const int64_t *offsets, unsigned long int nb_rows,
+              unsigned long int nb_cols, unsigned int nb_disps, T *costs, int num_threads)
+{
+  const long long rows = static_cast<long long>(nb_rows);
+  const long long cols = static_cast<long long>(nb_cols);
+#pragma omp parallel for num_threads(num_threads) schedule(static)
+  for (long long row = 0; row < rows; row++)
+  {
+    for (long long col = 0; col < cols; col++)
     {
-      // Previous cost
-      const T tmp1 = buff_disp_2[disp];
-      // Previous cost at disparity-1
-      const T tmp2 = (disp > 0) ? *pixel_2 + P1 : std::numeric_limits<T>::max();
-      // Previous cost at disparity+1
-      const T tmp3 = (disp < nb_disps - 1) ? buff_disp_2[disp + 1] + P1 : std::numeric_limits<T>::max();
-      // Minimum cost at previous point
-      const T tmp4 = (*min_disp2) + P2;
-      // Minimum path cost
-      costAggr2 += reset2 * (std::min({tmp1, tmp2, tmp3, tmp4}) - (*min_disp2));
+      const std::pair<int, int> range = gridRange(disp_min, disp_max, row, col, nb_disps);
+      const T *point_costs = pointValues(cv_in, row, col);
+      T *packed = &costs[offsets[col + row * cols]];
+      for (int disp = range.first; disp <= range.second; disp++)
+      {
+        packed[disp - range.first] = point_costs[disp * cv_in.strides.depth];
+      }
     }
   }
-  // sava buffer data before writing new value in buffer_disp
-  *pixel_2 = buff_disp_2[disp];
-  // sava buffer data before writing new value in buffer_disp
-  buff_disp_2[disp] = buff2[disp + col * nb_disps];
-  // Save data in buffer
-  buff2[disp + col * nb_disps] = costAggr2;
-
-  return costAggr2;
 }
 
 template <typename T>
-T aggregatedCostFromTopLeft3(T pixelCost, int row, int col, int disp, T invalid_value,
-                             int nb_rows, int nb_cols, int nb_disps, T P1, T P2, Direction direction,
-                             T *buff3, T *min_disp3, float current_class, float *buff_class3, float &reset3, bool edge_classification)
-{
-  /* -----------------------------*/
-  /* --Diagonal from upper right-- */
-  /* -----------------------------*/
-  T costAggr3 = pixelCost;
-  // Border check
-  if (!(row - direction.drow < 0 || row - direction.drow > (nb_rows - 1) || col - direction.dcol < 0 || col - direction.dcol > (nb_cols - 1)))
-  {
-    /*Minimum cost at previous point for each disparity
-    Compute value just at the first disparity for a given point (row,col)
-    */
-    if (disp == 0)
-    {
-      *min_disp3 = *std::min_element(&buff3[disp + (col - direction.dcol) * nb_disps], &buff3[nb_disps + (col - direction.dcol) * nb_disps]);
-      // if classes are different, reset history
-      if (edge_classification) {
-        // if pixel is an edge, reset history
-        reset3 = static_cast<float>(!(buff_class3[col - direction.dcol] > 0.f));
-      } else {
-        // if classes are different, reset history (reset == 0)
-        reset3 = static_cast<float>(current_class == buff_class3[col - direction.dcol]);
+void toDense(const T *costs, const StridedArray<int32_t> &disp_min, const StridedArray<int32_t> &disp_max,
+             const int64_t *offsets, unsigned long int nb_rows, unsigned long int nb_cols, unsigned int nb_disps,
+             T invalid_value, T *cv_out, int num_threads)
+{
+  const long long rows = static_cast<long long>(nb_rows);
+  const long long cols = static_cast<long long>(nb_cols);
+#pragma omp parallel for num_threads(num_threads) schedule(static)
+  for (long long row = 0; row < rows; row++)
+  {
+    for (long long col = 0; col < cols; col++)
+    {
+      const std::pair<int, int> range = gridRange(disp_min, disp_max, row, col, nb_disps);
+      const T *packed = &costs[offsets[col + row * cols]];
+      T *point_costs = &cv_out[(col + row * cols) * nb_disps];
+      for (int disp = 0; disp < static_cast<int>(nb_disps); disp++)
+      {
+        point_costs[disp] = (disp >= range.first && disp <= range.second) ? packed[disp - range.first] : invalid_value;
       }
     }
-    /*If pixelCost is equal to invalid value, aggregated cost must be equal to invalid value.
-    So, it's useless to compute the minimum on tmp1,tmp2,tmp3,tmp4
-    */
-    if (pixelCost != invalid_value)
+  }
+}
+
+template <typename T>
+void checkRaggedVolume(const SgmInputs<T> &inputs, unsigned long int nb_rows, unsigned long int nb_cols,
+                       unsigned int nb_disps, int num_threads)
+{
+  if (inputs.disp_min.data == nullptr)
+  {
+    throw std::invalid_argument("a ragged cost volume requires disp_min and disp_max.");
+  }
+  const long long rows = static_cast<long long>(nb_rows);
+  const long long cols = static_cast<long long>(nb_cols);
+  long long nb_errors = 0;
+#pragma omp parallel for num_threads(num_threads) schedule(static) reduction(+ : nb_errors)
+  for (long long row = 0; row < rows; row++)
+  {
+    for (long long col = 0; col < cols; col++)
     {
-      // Previous cost
-      const T tmp1 = buff3[disp + (col - direction.dcol) * nb_disps];
-      // Previous cost at disparity-1
-      const T tmp2 = (disp > 0) ? buff3[disp - 1 + (col - direction.dcol) * nb_disps] + P1 : std::numeric_limits<T>::max();
-      // Previous cost at disparity+1
-      const T tmp3 = (disp < nb_disps - 1) ? buff3[disp + 1 + (col - direction.dcol) * nb_disps] + P1 : std::numeric_limits<T>::max();
-      // Minimum cost at previous point
-      const T tmp4 = (*min_disp3) + P2;
-      // Minimum path cost
-      costAggr3 += reset3 * (std::min({tmp1, tmp2, tmp3, tmp4}) - (*min_disp3));
+      const std::pair<int, int> range = disparityRange(inputs, row, col, nb_disps);
+      const long long pixel = col + row * cols;
+      nb_errors += (inputs.offsets[pixel + 1] - inputs.offsets[pixel] != std::max(range.second - range.first + 1, 0));
     }
   }
-  // Save data in buffer
-  buff3[disp + col * nb_disps] = costAggr3;
+  if (nb_errors != 0)
+  {
+    throw std::invalid_argument("offsets of the ragged cost volume must follow the lengths of the disparity "
+                                "intervals.");
+  }
+}
 
-  return costAggr3;
+template <typename T>
+const T *raggedCosts(const SgmInputs<T> &inputs, long long row, long long col, unsigned long int nb_cols,
+                     unsigned int nb_disps, T invalid_value, T *buffer)
+{
+  const std::pair<int, int> range = disparityRange(inputs, row, col, nb_disps);
+  const T *packed = &inputs.cv_in.data[inputs.offsets[col + row * static_cast<long long>(nb_cols)]];
+  for (int disp = 0; disp < static_cast<int>(nb_disps); disp++)
+  {
+    buffer[disp] = (disp >= range.first && disp <= range.second) ? packed[disp - range.first] : invalid_value;
+  }
+  return buffer;
 }
 
 template <typename T>
-T aggregatedCostFromBottomRight4(T pixelCost, int row, int col, int disp, T invalid_value,
-                                 int nb_rows, int nb_cols, int nb_disps, T P1, T P2, Direction direction,
-                                 T *buff4, T *min_disp4, T *pixel_4, float current_class, float buff_class4, float &reset4, bool edge_classification)
-{
-
-  /* ------------------*/
-  /* -- right->left -- */
-  /* ------------------*/
-  T costAggr4 = pixelCost;
-  // Border check
-  if (!(row - direction.drow < 0 || row - direction.drow > (nb_rows - 1) || col - direction.dcol < 0 || col - direction.dcol > (nb_cols - 1)))
-  {
-    /*Minimum cost at previous point for each disparity
-    Compute value just at the first disparity for a given point (row,col)
-    */
-    if (disp == 0)
-    {
-      *min_disp4 = *std::min_element(&buff4[disp], &buff4[nb_disps]);
-      // if classes are different, reset history
-      if (edge_classification) {
-        // if pixel is an edge, reset history
-        reset4 = static_cast<float>(!(buff_class4 > 0.f));
-      } else {
-        // if classes are different, reset history (reset == 0)
-        reset4 = static_cast<float>(current_class == buff_class4);
-      }
-    }
-    /*If pixelCost is equal to invalid value, aggregated cost must be equal to invalid value.
-    So, it's useless to compute the minimum on tmp1,tmp2,tmp3,tmp4
-    */
-    if (pixelCost != invalid_value)
+bool isInvalidCost(T cost, T invalid_value)
+{
+  return cost == invalid_value ||
+         (std::isnan(static_cast<double>(invalid_value)) && std::isnan(static_cast<double>(cost)));
+}
+
+template <typename Tin, typename Tacc>
+SimdKernels<Tin, Tacc> aggregationKernels(unsigned int nb_disps, Tin invalid_value)
+{
+  if (std::isnan(static_cast<double>(invalid_value)))
+  {
+    return {nullptr, simdKernels<Tin, Tacc>(nb_disps).last_index};
+  }
+  return simdKernels<Tin, Tacc>(nb_disps);
+}
+
+template <typename T>
+int lastMinimumPosition(const T *lr, unsigned int nb_disps, T min_lr, LastIndexKernel<T> last_index)
+{
+  // As update_minimum from a float maximum: no position is found above it
+  if (!(static_cast<float>(min_lr) <= std::numeric_limits<float>::max()))
+  {
+    return 0;
+  }
+  if (last_index != nullptr)
+  {
+    return last_index(lr, nb_disps, min_lr);
+  }
+  int position;
+  // Ties take the last disparity
+  for (position = static_cast<int>(nb_disps) - 1; position > 0 && lr[position] != min_lr; position--)
+  {
+  }
+  return position;
+}
+
+template <typename Tin, typename Tout>
+int bestDisparity(const Tout *costs, const Tin *pixel_costs, int first_disp, int last_disp, Tin invalid_value)
+{
+  int best_disp = -1;
+  for (int disp = first_disp; disp <= last_disp; disp++)
+  {
+    if (!isInvalidCost(pixel_costs[disp], invalid_value) &&
+        (best_disp < 0 || costs[disp - first_disp] < costs[best_disp - first_disp]))
     {
-      // Previous cost
-      const T tmp1 = buff4[disp];
-      // Previous cost at disparity-1
-      const T tmp2 = (disp > 0) ? *pixel_4 + P1 : std::numeric_limits<T>::max();
-      // Previous cost at disparity+1
-      const T tmp3 = (disp < nb_disps - 1) ? buff4[disp + 1] + P1 : std::numeric_limits<T>::max();
-      // Minimum cost at previous point
-      const T tmp4 = (*min_disp4) + P2;
-      // Minimum path cost
-      costAggr4 += reset4 * (std::min({tmp1, tmp2, tmp3, tmp4}) - (*min_disp4));
+      best_disp = disp;
     }
   }
-  // sava buffer data before writing new value in buffer
-  *pixel_4 = buff4[disp];
-  // Save data in buffer
-  buff4[disp] = costAggr4;
+  return best_disp;
+}
 
-  return costAggr4;
+template <typename Tin, typename Tout>
+float pointDisparity(const Tout *costs, const Tin *pixel_costs, int first_disp, int last_disp, Tin invalid_value,
+                     DisparityMode mode)
+{
+  const int best_disp = bestDisparity(costs, pixel_costs, first_disp, last_disp, invalid_value);
+  if (best_disp < 0)
+  {
+    return std::numeric_limits<float>::quiet_NaN();
+  }
+  if (mode == DISPARITY_WTA || best_disp == first_disp || best_disp == last_disp ||
+      isInvalidCost(pixel_costs[best_disp - 1], invalid_value) ||
+      isInvalidCost(pixel_costs[best_disp + 1], invalid_value))
+  {
+    return static_cast<float>(best_disp);
+  }
+  const float previous = costs[best_disp - 1 - first_disp];
+  const float cost = costs[best_disp - first_disp];
+  const float next = costs[best_disp + 1 - first_disp];
+  float offset = 0.f;
+  if (mode == DISPARITY_PARABOLA)
+  {
+    const float curvature = previous - 2.f * cost + next;
+    if (curvature > 0.f)
+    {
+      offset = (previous - next) / (2.f * curvature);
+    }
+  }
+  else
+  {
+    // The V has the slope of its steepest side
+    const float slope = std::max(previous - cost, next - cost);
+    if (slope > 0.f)
+    {
+      offset = (previous - next) / (2.f * slope);
+    }
+  }
+  return static_cast<float>(best_disp) + offset;
 }
 
-template <typename T>
-T aggregatedCostFromBottomRight5(T pixelCost, int row, int col, int disp, T invalid_value,
-                                 int nb_rows, int nb_cols, int nb_disps, T P1, T P2, Direction direction,
-                                 T *buff5, T *min_disp5, T *pixel_5, float current_class, float *buff_class5, float &reset5, bool edge_classification)
-{
-
-  /* ------------------*/
-  /* --  Down->up   -- */
-  /* ------------------*/
-  T costAggr5 = pixelCost;
-  // Border check
-  if (!(row - direction.drow < 0 || row - direction.drow > (nb_rows - 1) || col - direction.dcol < 0 || col - direction.dcol > (nb_cols - 1)))
-  {
-    /*Minimum cost at previous point for each disparity
-    Compute value just at the first disparity for a given point (row,col)
-    */
-    if (disp == 0)
-    {
-      *min_disp5 = *std::min_element(&buff5[disp + col * nb_disps], &buff5[nb_disps + col * nb_disps]);
-      // if classes are different, reset history
-      if (edge_classification) {
-        // if pixel is an edge, reset history
-        reset5 = static_cast<float>(!(buff_class5[col - direction.dcol] > 0.f));
-      } else {
-        // if classes are different, reset history (reset == 0)
-        reset5 = static_cast<float>(current_class == buff_class5[col - direction.dcol]);
+template <typename Tin, typename Tout>
+void pointConfidence(const Tout *costs, const Tin *pixel_costs, int first_disp, int last_disp, Tin invalid_value,
+                     const ConfidenceOptions &options, const int *path_minimums, ConfidenceMaps &maps,
+                     unsigned long int pixel)
+{
+  const int nb_dir = 8;
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  const int best_disp = bestDisparity(costs, pixel_costs, first_disp, last_disp, invalid_value);
+  auto isValid = [&](int disp) { return !isInvalidCost(pixel_costs[disp], invalid_value); };
+  if (options.path_agreement)
+  {
+    uint8_t agreement = 0;
+    for (int dir = 0; dir < nb_dir; dir++)
+    {
+      if (best_disp >= 0 && std::abs(path_minimums[dir] - best_disp) <= 1)
+      {
+        agreement++;
       }
     }
-    /*If pixelCost is equal to invalid value, aggregated cost must be equal to invalid value.
-    So, it's useless to compute the minimum on tmp1,tmp2,tmp3,tmp4
-    */
-    if (pixelCost != invalid_value)
+    maps.path_agreement[pixel] = agreement;
+  }
+  const float min_cost = (best_disp >= 0) ? static_cast<float>(costs[best_disp - first_disp]) : nan;
+  if (options.ratio)
+  {
+    // Second lowest cost among the other valid disparities
+    int second_disp = -1;
+    for (int disp = first_disp; disp <= last_disp; disp++)
     {
-      // Previous cost
-      const T tmp1 = buff5[disp + col * nb_disps];
-      // Previous cost at disparity-1
-      const T tmp2 = (disp > 0) ? *pixel_5 + P1 : std::numeric_limits<T>::max();
-      // Previous cost at disparity+1
-      const T tmp3 = (disp < nb_disps - 1) ? buff5[disp + 1 + col * nb_disps] + P1 : std::numeric_limits<T>::max();
-      // Minimum cost at previous point
-      const T tmp4 = (*min_disp5) + P2;
-      // Minimum path cost
-      costAggr5 += reset5 * (std::min({tmp1, tmp2, tmp3, tmp4}) - (*min_disp5));
+      if (disp != best_disp && isValid(disp) &&
+          (second_disp < 0 || costs[disp - first_disp] < costs[second_disp - first_disp]))
+      {
+        second_disp = disp;
+      }
     }
+    const float second_cost = (second_disp >= 0) ? static_cast<float>(costs[second_disp - first_disp]) : nan;
+    maps.ratio[pixel] = (second_cost > 0.f) ? min_cost / second_cost : (second_cost == 0.f) ? 1.f : nan;
+  }
+  if (!options.ambiguity && !options.risk)
+  {
+    return;
+  }
+  float ambiguity = nan;
+  float risk_min = nan;
+  float risk_max = nan;
+  if (best_disp >= 0)
+  {
+    const int nb_eta = static_cast<int>(options.eta_max / options.eta_step) + 1;
+    ambiguity = risk_min = risk_max = 0.f;
+    for (int k = 0; k < nb_eta; k++)
+    {
+      const float threshold = min_cost + k * options.eta_step;
+      auto isLow = [&](int disp) { return isValid(disp) && static_cast<float>(costs[disp - first_disp]) <= threshold; };
+      int nb_low = 0;
+      int lowest = best_disp;
+      int highest = best_disp;
+      for (int disp = first_disp; disp <= last_disp; disp++)
+      {
+        if (isLow(disp))
+        {
+          nb_low++;
+          lowest = std::min(lowest, disp);
+          highest = std::max(highest, disp);
+        }
+      }
+      // Disparities below the threshold connected to the lowest cost
+      int connected_lowest = best_disp;
+      int connected_highest = best_disp;
+      while (connected_lowest > first_disp && isLow(connected_lowest - 1))
+      {
+        connected_lowest--;
+      }
+      while (connected_highest < last_disp && isLow(connected_highest + 1))
+      {
+        connected_highest++;
+      }
+      ambiguity += nb_low;
+      risk_max += highest - lowest;
+      risk_min += connected_highest - connected_lowest;
+    }
+    ambiguity /= nb_eta;
+    risk_min /= nb_eta;
+    risk_max /= nb_eta;
+  }
+  if (options.ambiguity)
+  {
+    maps.ambiguity[pixel] = ambiguity;
+  }
+  if (options.risk)
+  {
+    maps.risk_min[pixel] = risk_min;
+    maps.risk_max[pixel] = risk_max;
   }
-  // sava buffer data before writing new value in buffer
-  *pixel_5 = buff5[disp + col * nb_disps];
-  // Save data in buffer
-  buff5[disp + col * nb_disps] = costAggr5;
-
-  return costAggr5;
 }
 
-template <typename T>
-T aggregatedCostFromBottomRight6(T pixelCost, int row, int col, int disp, T invalid_value,
-                                 int nb_rows, int nb_cols, int nb_disps, T P1, T P2, Direction direction,
-                                 T *buff6, T *buff_disp_6, T *min_disp6, T *pixel_6, float current_class, float *buff_class6, float &reset6, bool edge_classification)
-{
-
-  /* -----------------------------*/
-  /* --diagonal from lower left-- */
-  /* -----------------------------*/
-
-  T costAggr6 = pixelCost;
-  // Border check
-  if (!(row - direction.drow < 0 || row - direction.drow > (nb_rows - 1) || col - direction.dcol < 0 || col - direction.dcol > (nb_cols - 1)))
-  {
-    /*Minimum cost at previous point for each disparity
-    Compute value just at the first disparity for a given point (row,col)
-    */
-    if (disp == 0)
-    {
-      *min_disp6 = *std::min_element(&buff_disp_6[disp], &buff_disp_6[nb_disps]);
-      // if classes are different, reset history
-      if (edge_classification) {
-        // if pixel is an edge, reset history
-        reset6 = static_cast<float>(!(buff_class6[col - direction.dcol] > 0.f));
-      } else {
-        // if classes are different, reset history (reset == 0)
-        reset6 = static_cast<float>(current_class == buff_class6[col - direction.dcol]);
+template <typename Tin, typename Tout>
+void disparityMap(const SgmInputs<Tin> &inputs, unsigned long int nb_rows, unsigned long int nb_cols,
+                  unsigned int nb_disps, Tin invalid_value, DisparityMode mode, const ConfidenceOptions &confidence,
+                  CostVolumes<Tout> &cvs, int num_threads)
+{
+  const int nb_dir = 8;
+  const bool confidence_maps = hasConfidenceMaps(confidence);
+  const long long nb_pixels = static_cast<long long>(nb_rows * nb_cols);
+  const long long cols = static_cast<long long>(nb_cols);
+#pragma omp parallel num_threads(num_threads)
+  {
+    std::vector<Tin> buffer(nb_disps);
+#pragma omp for schedule(static)
+    for (long long pixel = 0; pixel < nb_pixels; pixel++)
+    {
+      const Tin *pixel_costs = pointCosts(inputs.cv_in, pixel / cols, pixel % cols, nb_disps, buffer.data());
+      const std::pair<int, int> range = disparityRange(inputs, pixel / cols, pixel % cols, nb_disps);
+      const Tout *interval_costs = &cvs.cost_volume[pixel * nb_disps + range.first];
+      if (mode != DISPARITY_NONE)
+      {
+        cvs.disparity_map[pixel] = pointDisparity(interval_costs, pixel_costs, range.first, range.second,
+                                                  invalid_value, mode);
+      }
+      if (confidence_maps)
+      {
+        pointConfidence(interval_costs, pixel_costs, range.first, range.second, invalid_value, confidence,
+                        confidence.path_agreement ? &cvs.cost_volume_min[pixel * nb_dir] : nullptr,
+                        cvs.confidence, pixel);
       }
     }
-    /*If pixelCost is equal to invalid value, aggregated cost must be equal to invalid value.
-    So, it's useless to compute the minimum on tmp1,tmp2,tmp3,tmp4
-    */
-    if (pixelCost != invalid_value)
+  }
+}
+
+template <typename Tseg>
+float computeReset(Tseg current_class, Tseg previous_class, bool edge_classification)
+{
+  if (edge_classification)
+  {
+    // if previous pixel is an edge, reset history
+    return static_cast<float>(!(previous_class > 0));
+  }
+  // if classes are different, reset history (reset == 0)
+  return static_cast<float>(current_class == previous_class);
+}
+
+void checkPassDirections(const Direction *direction)
+{
+  for (int dir = 0; dir < 8; dir++)
+  {
+    // Previous point in the scan order of the pass: forward for the first pass, backward for the second one
+    const int sign = (dir < 4) ? 1 : -1;
+    const int drow = sign * direction[dir].drow;
+    const int dcol = sign * direction[dir].dcol;
+    if (std::abs(drow) > 1 || std::abs(dcol) > 1 || 2 * drow + dcol <= 0)
     {
-      // Previous pixels
-      const T tmp1 = buff_disp_6[disp];
-      // Previous cost at disparity-1
-      const T tmp2 = (disp > 0) ? *pixel_6 + P1 : std::numeric_limits<T>::max();
-      // Previous cost at disparity+1
-      const T tmp3 = (disp < nb_disps - 1) ? buff_disp_6[disp + 1] + P1 : std::numeric_limits<T>::max();
-      // Minimum cost at previous point
-      const T tmp4 = (*min_disp6) + P2;
-      // Minimum path cost
-      costAggr6 += reset6 * (std::min({tmp1, tmp2, tmp3, tmp4}) - (*min_disp6));
+      throw std::invalid_argument("direction " + std::to_string(dir) + " is not compatible with the scan order of its pass");
     }
   }
-  // sava buffer data before writing new value in buffer_disp
-  *pixel_6 = buff_disp_6[disp];
-  // sava buffer data before writing new value in buffer_disp
-  buff_disp_6[disp] = buff6[disp + col * nb_disps];
-  // Save data in buffer
-  buff6[disp + col * nb_disps] = costAggr6;
+}
 
-  return costAggr6;
+int getNumThreads(int num_threads)
+{
+#ifdef _OPENMP
+  if (num_threads <= 0)
+  {
+    return omp_get_max_threads();
+  }
+  return num_threads;
+#else
+  // built without OpenMP: sequential two passes only
+  (void)num_threads;
+  return 1;
+#endif
 }
 
-template <typename T>
-T aggregatedCostFromBottomRight7(T pixelCost, int row, int col, int disp, T invalid_value,
-                                 int nb_rows, int nb_cols, int nb_disps, T P1, T P2, Direction direction,
-                                 T *buff7, T *min_disp7, float current_class, float *buff_class7, float &reset7, bool edge_classification)
-{
-
-  /* ------------------------------*/
-  /* --diagonal from lower right-- */
-  /* ------------------------------*/
-  T costAggr7 = pixelCost;
-  // Border
-  if (!(row - direction.drow < 0 || row - direction.drow > (nb_rows - 1) || col - direction.dcol < 0 || col - direction.dcol > (nb_cols - 1)))
-  {
-    /*Minimum cost at previous point for each disparity
-    Compute value just at the first disparity for a given point (row,col)
-    */
-    if (disp == 0)
-    {
-      *min_disp7 = *std::min_element(&buff7[disp + (col - direction.dcol) * nb_disps], &buff7[nb_disps + (col - direction.dcol) * nb_disps]);
-      // if classes are different, reset history
-      if (edge_classification) {
-        // if pixel is an edge, reset history
-        reset7 = static_cast<float>(!(buff_class7[col - direction.dcol] > 0.f));
-      } else {
-        // if classes are different, reset history (reset == 0)
-        reset7 = static_cast<float>(current_class == buff_class7[col - direction.dcol]);
-      }
+std::pair<float, int> update_minimum(float current_min, float value, int current_disp, int disp)
+{
+  if (current_min < value)
+  {
+    return std::make_pair(current_min, current_disp);
+  }
+  else
+  {
+    return std::make_pair(value, disp);
+  }
+}
+
+// Penalty of the point (row, col) along the direction dir, from its map or from the table of its class
+template <PenaltyMode PENALTIES, typename T>
+T pointPenalty(const StridedArray<T> &penalties, const T *table, const StridedArray<float> &segmentation, long long row,
+               long long col, int dir)
+{
+  const int nb_dir = 8;
+  switch (PENALTIES)
+  {
+  case PENALTIES_CONSTANT:
+    // Constant penalties are read from their 8 values, whatever the position of the point
+    return penalties.data[dir * penalties.strides.depth];
+  case PENALTIES_CLASSES:
+    return table[static_cast<int>(pointValues(segmentation, row, col)[0]) * nb_dir + dir];
+  default:
+    return pointValues(penalties, row, col)[dir * penalties.strides.depth];
+  }
+}
+
+template <int DROW, int DCOL, ResetMode RESET, PenaltyMode PENALTIES, bool ADAPTIVE_P2, typename Tin, typename Tacc>
+Tacc *aggregatedCostFrom(const Tin *pixel_costs, const SgmInputs<Tin> &inputs, long long row, long long col,
+                         long long nb_rows, long long nb_cols, unsigned int nb_disps, Tin invalid_value, int dir,
+                         const SimdKernels<Tin, Tacc> &simd, const LineBuffers<Tacc> &lines, Tacc &min_lr)
+{
+  const unsigned long int point = (row & 1) * nb_cols + col;
+  Tacc *lr = &lines.lr[point * nb_disps];
+
+  // Border test, once for all disparities: tests on a null step are removed at compile time
+  const long long previous_row = row - DROW;
+  const long long previous_col = col - DCOL;
+  const bool no_previous = (DROW > 0 && previous_row < 0) || (DROW < 0 && previous_row >= nb_rows) ||
+                           (DCOL > 0 && previous_col < 0) || (DCOL < 0 && previous_col >= nb_cols);
+  // Intervals of the point and of its previous point, all disparities without disparity grids
+  const bool ranges = inputs.disp_min.data != nullptr;
+  const std::pair<int, int> all_disps = std::make_pair(0, static_cast<int>(nb_disps) - 1);
+  const std::pair<int, int> range = ranges ? disparityRange(inputs, row, col, nb_disps) : all_disps;
+  const std::pair<int, int> previous_range =
+      (ranges && !no_previous) ? disparityRange(inputs, previous_row, previous_col, nb_disps) : all_disps;
+  // A point with only invalid costs keeps them, and the path restarts after it: the history of a point with equal
+  // costs adds nothing to the next one
+  if (no_previous || previous_range.first > previous_range.second ||
+      (inputs.validity != nullptr && (inputs.validity[col + row * nb_cols] == PIXEL_INVALID ||
+                                      inputs.validity[previous_col + previous_row * nb_cols] == PIXEL_INVALID)))
+  {
+    // No previous point, aggregated cost is the pixel cost in the interval of the point
+    min_lr = (range.first > range.second) ? std::min(maxCost<Tacc>(), static_cast<Tacc>(invalid_value))
+                                          : maxCost<Tacc>();
+    for (unsigned int disp = 0; disp < nb_disps; disp++)
+    {
+      const bool in_range = static_cast<int>(disp) >= range.first && static_cast<int>(disp) <= range.second;
+      lr[disp] = in_range ? static_cast<Tacc>(pixel_costs[disp]) : static_cast<Tacc>(invalid_value);
+      min_lr = in_range ? std::min(min_lr, lr[disp]) : min_lr;
     }
-    /*If pixelCost is equal to invalid value, aggregated cost must be equal to invalid value.
-    So, it's useless to compute the minimum on tmp1,tmp2,tmp3,tmp4
-    */
-    if (pixelCost != invalid_value)
+    lines.min_lr[point] = min_lr;
+    return lr;
+  }
+
+  // Without segmentation, the masks are not read, otherwise the reset of the direction is one bit of the point
+  const float reset = (RESET == RESET_NONE || !((inputs.reset_masks[col + row * nb_cols] >> dir) & 1)) ? 1.f : 0.f;
+  const Tacc P1 = static_cast<Tacc>(
+      pointPenalty<PENALTIES>(inputs.p1_in, inputs.penalty_tables.p1, inputs.segmentation, row, col, dir));
+  Tacc P2 = static_cast<Tacc>(
+      pointPenalty<PENALTIES>(inputs.p2_in, inputs.penalty_tables.p2, inputs.segmentation, row, col, dir));
+  if (ADAPTIVE_P2)
+  {
+    // P2 / |I(p) - I(p-r)| from the intensities of the guide image, at least P1
+    const float gradient = std::fabs(pointValues(inputs.guide, row, col)[0] -
+                                     pointValues(inputs.guide, previous_row, previous_col)[0]);
+    P2 = static_cast<Tacc>(std::max(static_cast<float>(P1), static_cast<float>(P2) / std::max(gradient, 1.f)));
+  }
+  const unsigned long int previous_point = (previous_row & 1) * nb_cols + previous_col;
+  if (range != all_disps || previous_range != all_disps)
+  {
+    min_lr = aggregatePixelRange(pixel_costs, &lines.lr[previous_point * nb_disps], lr, nb_disps, range,
+                                 previous_range, P1, P2, invalid_value, reset, lines.min_lr[previous_point]);
+    lines.min_lr[point] = min_lr;
+    return lr;
+  }
+  min_lr = aggregatePixel(pixel_costs, &lines.lr[previous_point * nb_disps], lr, nb_disps, P1, P2, invalid_value, reset,
+                          lines.min_lr[previous_point], simd.aggregate_pixel);
+  lines.min_lr[point] = min_lr;
+  return lr;
+}
+
+// Aggregation of one point along a direction, for a reset mode
+template <ResetMode RESET, PenaltyMode PENALTIES, bool ADAPTIVE_P2, typename Tin, typename Tacc>
+DirectionKernel<Tin, Tacc> resetDirectionKernel(Direction direction)
+{
+  switch (3 * (direction.drow + 1) + (direction.dcol + 1))
+  {
+  case 0:
+    return &aggregatedCostFrom<-1, -1, RESET, PENALTIES, ADAPTIVE_P2, Tin, Tacc>;
+  case 1:
+    return &aggregatedCostFrom<-1, 0, RESET, PENALTIES, ADAPTIVE_P2, Tin, Tacc>;
+  case 2:
+    return &aggregatedCostFrom<-1, 1, RESET, PENALTIES, ADAPTIVE_P2, Tin, Tacc>;
+  case 3:
+    return &aggregatedCostFrom<0, -1, RESET, PENALTIES, ADAPTIVE_P2, Tin, Tacc>;
+  case 5:
+    return &aggregatedCostFrom<0, 1, RESET, PENALTIES, ADAPTIVE_P2, Tin, Tacc>;
+  case 6:
+    return &aggregatedCostFrom<1, -1, RESET, PENALTIES, ADAPTIVE_P2, Tin, Tacc>;
+  case 7:
+    return &aggregatedCostFrom<1, 0, RESET, PENALTIES, ADAPTIVE_P2, Tin, Tacc>;
+  case 8:
+    return &aggregatedCostFrom<1, 1, RESET, PENALTIES, ADAPTIVE_P2, Tin, Tacc>;
+  default:
+    throw std::invalid_argument("direction (" + std::to_string(direction.drow) + ", " + std::to_string(direction.dcol) +
+                                ") is not a step to a neighbouring point");
+  }
+}
+
+template <ResetMode RESET, PenaltyMode PENALTIES, typename Tin, typename Tacc>
+DirectionKernel<Tin, Tacc> adaptiveDirectionKernel(Direction direction, bool adaptive_p2)
+{
+  if (adaptive_p2)
+  {
+    return resetDirectionKernel<RESET, PENALTIES, true, Tin, Tacc>(direction);
+  }
+  return resetDirectionKernel<RESET, PENALTIES, false, Tin, Tacc>(direction);
+}
+
+template <ResetMode RESET, typename Tin, typename Tacc>
+DirectionKernel<Tin, Tacc> penaltyDirectionKernel(Direction direction, PenaltyMode penalties, bool adaptive_p2)
+{
+  switch (penalties)
+  {
+  case PENALTIES_MAP:
+    return adaptiveDirectionKernel<RESET, PENALTIES_MAP, Tin, Tacc>(direction, adaptive_p2);
+  case PENALTIES_CONSTANT:
+    return adaptiveDirectionKernel<RESET, PENALTIES_CONSTANT, Tin, Tacc>(direction, adaptive_p2);
+  case PENALTIES_CLASSES:
+    return adaptiveDirectionKernel<RESET, PENALTIES_CLASSES, Tin, Tacc>(direction, adaptive_p2);
+  default:
+    throw std::invalid_argument("unknown penalty mode " + std::to_string(penalties));
+  }
+}
+
+template <typename Tin, typename Tacc>
+DirectionKernel<Tin, Tacc> directionKernel(Direction direction, ResetMode reset, PenaltyMode penalties, bool adaptive_p2)
+{
+  switch (reset)
+  {
+  case RESET_NONE:
+    return penaltyDirectionKernel<RESET_NONE, Tin, Tacc>(direction, penalties, adaptive_p2);
+  case RESET_CLASSES:
+  case RESET_EDGES:
+    // Both read the resets in the masks, computed for their classification
+    return penaltyDirectionKernel<RESET_CLASSES, Tin, Tacc>(direction, penalties, adaptive_p2);
+  default:
+    throw std::invalid_argument("unknown reset mode " + std::to_string(reset));
+  }
+}
+
+void checkDirections(const Direction *direction)
+{
+  for (int dir = 0; dir < 8; dir++)
+  {
+    if (std::abs(direction[dir].drow) > 1 || std::abs(direction[dir].dcol) > 1 ||
+        (direction[dir].drow == 0 && direction[dir].dcol == 0))
     {
-      // Previous pixels
-      const T tmp1 = buff7[disp + (col - direction.dcol) * nb_disps];
-      // Previous cost at disparity-1
-      const T tmp2 = (disp > 0) ? buff7[disp - 1 + (col - direction.dcol) * nb_disps] + P1 : std::numeric_limits<T>::max();
-      // Previous cost at disparity+1
-      const T tmp3 = (disp < nb_disps - 1) ? buff7[disp + 1 + (col - direction.dcol) * nb_disps] + P1 : std::numeric_limits<T>::max();
-      // Minimum cost at previous point
-      const T tmp4 = (*min_disp7) + P2;
-      // Minimum path cost
-      costAggr7 += reset7 * (std::min({tmp1, tmp2, tmp3, tmp4}) - (*min_disp7));
+      throw std::invalid_argument("direction " + std::to_string(dir) + " is not a step to a neighbouring point");
     }
   }
-  // sava buffer data before writing new value in buffer
-  buff7[disp + col * nb_disps] = costAggr7;
+}
 
-  return costAggr7;
+void checkPenaltyClasses(const StridedArray<float> &segmentation, unsigned long int nb_rows, unsigned long int nb_cols,
+                         unsigned int nb_classes, int num_threads)
+{
+  if (segmentation.data == nullptr)
+  {
+    throw std::invalid_argument("penalty tables require a segmentation map of their classes.");
+  }
+  const long long rows = static_cast<long long>(nb_rows);
+  const long long cols = static_cast<long long>(nb_cols);
+  long long nb_invalid = 0;
+#pragma omp parallel for num_threads(num_threads) schedule(static) reduction(+ : nb_invalid)
+  for (long long row = 0; row < rows; row++)
+  {
+    for (long long col = 0; col < cols; col++)
+    {
+      const float label = pointValues(segmentation, row, col)[0];
+      nb_invalid += !(label >= 0.f && label < static_cast<float>(nb_classes) && label == std::floor(label));
+    }
+  }
+  if (nb_invalid > 0)
+  {
+    throw std::invalid_argument("segmentation labels must be integers in [0, " + std::to_string(nb_classes) +
+                                ") to index the penalty tables.");
+  }
 }
 
 template <typename T>
@@ -768,7 +1807,142 @@ void assignDirections(int *directions_in, Direction *dirs)
 /* Explicitly instantiate all the templates needed to use libSGM as an external lib */
 template CostVolumes<uint16_t> sgm<uint8_t, uint16_t>(uint8_t *cv_in, uint8_t *p1_in, uint8_t *p2_in, int *directions_in, unsigned long int nb_rows,
                                                       unsigned long int nb_cols, unsigned int nb_disps, uint8_t invalid_value, float *segmentation,
-                                                      bool cost_paths, bool overcounting, bool edge_classification);
+                                                      bool cost_paths, bool overcounting, bool edge_classification, int num_threads,
+                                                      Concurrency concurrency, unsigned int nb_partial_volumes,
+                                                      uint16_t *cost_volume_out, int *cost_volume_min_out,
+                                                      bool accumulate);
+template CostVolumes<uint16_t> sgm<uint8_t, uint16_t>(const SgmInputs<uint8_t> &inputs, int *directions_in,
+                                                      unsigned long int nb_rows, unsigned long int nb_cols,
+                                                      unsigned int nb_disps, uint8_t invalid_value, bool cost_paths,
+                                                      bool overcounting, bool edge_classification, int num_threads,
+                                                      Concurrency concurrency, unsigned int nb_partial_volumes,
+                                                      uint16_t *cost_volume_out, int *cost_volume_min_out,
+                                                      bool accumulate, DisparityMode disparity_mode,
+                                                      bool keep_cost_volume, float *disparity_out,
+                                                      ConfidenceOptions confidence);
+template CostVolumes<uint16_t> sgmWithAccumulator<uint8_t, uint8_t, uint16_t>(const SgmInputs<uint8_t> &inputs,
+                                                                              int *directions_in, unsigned long int nb_rows,
+                                                                              unsigned long int nb_cols, unsigned int nb_disps,
+                                                                              uint8_t invalid_value,
+                                                                              bool cost_paths, bool overcounting,
+                                                                              bool edge_classification, int num_threads,
+                                                                              Concurrency concurrency,
+                                                                              unsigned int nb_partial_volumes,
+                                                                              uint16_t *cost_volume_out,
+                                                                              int *cost_volume_min_out,
+                                                                              bool accumulate,
+                                                                              DisparityMode disparity_mode,
+                                                                              bool keep_cost_volume,
+                                                                              float *disparity_out,
+                                                                              ConfidenceOptions confidence);
+template CostVolumes<uint16_t> sgmWithAccumulator<uint8_t, uint16_t, uint16_t>(const SgmInputs<uint8_t> &inputs,
+                                                                               int *directions_in, unsigned long int nb_rows,
+                                                                               unsigned long int nb_cols, unsigned int nb_disps,
+                                                                               uint8_t invalid_value,
+                                                                               bool cost_paths, bool overcounting,
+                                                                               bool edge_classification, int num_threads,
+                                                                               Concurrency concurrency,
+                                                                               unsigned int nb_partial_volumes,
+                                                                               uint16_t *cost_volume_out,
+                                                                               int *cost_volume_min_out,
+                                                                               bool accumulate,
+                                                                               DisparityMode disparity_mode,
+                                                                               bool keep_cost_volume,
+                                                                               float *disparity_out,
+                                                                               ConfidenceOptions confidence);
 template CostVolumes<float> sgm<float, float>(float *cv_in, float *p1_in, float *p2_in, int *directions_in, unsigned long int nb_rows,
                                               unsigned long int nb_cols, unsigned int nb_disps, float invalid_value, float *segmentation,
-                                              bool cost_paths, bool overcounting, bool edge_classification);
\ No newline at end of file
+                                              bool cost_paths, bool overcounting, bool edge_classification, int num_threads,
+                                              Concurrency concurrency, unsigned int nb_partial_volumes,
+                                              float *cost_volume_out, int *cost_volume_min_out,
+                                              bool accumulate);
+template CostVolumes<float> sgm<float, float>(const SgmInputs<float> &inputs, int *directions_in, unsigned long int nb_rows,
+                                              unsigned long int nb_cols, unsigned int nb_disps, float invalid_value,
+                                              bool cost_paths, bool overcounting, bool edge_classification, int num_threads,
+                                              Concurrency concurrency, unsigned int nb_partial_volumes,
+                                              float *cost_volume_out, int *cost_volume_min_out,
+                                              bool accumulate,
+                                              DisparityMode disparity_mode, bool keep_cost_volume,
+                                              float *disparity_out, ConfidenceOptions confidence);
+template DisparityMap<uint16_t> esgm<uint8_t, uint16_t>(const SgmInputs<uint8_t> &inputs, int *directions_in,
+                                                        unsigned long int nb_rows, unsigned long int nb_cols,
+                                                        unsigned int nb_disps, uint8_t invalid_value,
+                                                        bool overcounting, bool edge_classification, int num_threads,
+                                                        int *disparity_out, uint16_t *costs_out);
+template DisparityMap<uint16_t> esgmWithAccumulator<uint8_t, uint8_t, uint16_t>(
+    const SgmInputs<uint8_t> &inputs, int *directions_in, unsigned long int nb_rows, unsigned long int nb_cols,
+    unsigned int nb_disps, uint8_t invalid_value, bool overcounting, bool edge_classification, int num_threads,
+    int *disparity_out, uint16_t *costs_out);
+template DisparityMap<uint16_t> esgmWithAccumulator<uint8_t, uint16_t, uint16_t>(
+    const SgmInputs<uint8_t> &inputs, int *directions_in, unsigned long int nb_rows, unsigned long int nb_cols,
+    unsigned int nb_disps, uint8_t invalid_value, bool overcounting, bool edge_classification, int num_threads,
+    int *disparity_out, uint16_t *costs_out);
+template DisparityMap<float> esgm<float, float>(const SgmInputs<float> &inputs, int *directions_in,
+                                                unsigned long int nb_rows, unsigned long int nb_cols,
+                                                unsigned int nb_disps, float invalid_value, bool overcounting,
+                                                bool edge_classification, int num_threads, int *disparity_out,
+                                                float *costs_out);
+template SgmInputs<uint8_t> contiguousInputs<uint8_t>(const uint8_t *cv_in, const uint8_t *p1_in, const uint8_t *p2_in,
+                                                      const float *segmentation, unsigned long int nb_cols,
+                                                      unsigned int nb_disps);
+template SgmInputs<float> contiguousInputs<float>(const float *cv_in, const float *p1_in, const float *p2_in,
+                                                  const float *segmentation, unsigned long int nb_cols,
+                                                  unsigned int nb_disps);
+
+template void resetMasks<float>(const StridedArray<float> &segmentation, const Direction *direction,
+                                unsigned long int nb_rows, unsigned long int nb_cols, bool edge_classification,
+                                uint8_t *reset_masks, int num_threads);
+template void resetMasks<bool>(const StridedArray<bool> &segmentation, const Direction *direction,
+                               unsigned long int nb_rows, unsigned long int nb_cols, bool edge_classification,
+                               uint8_t *reset_masks, int num_threads);
+template void resetMasks<uint8_t>(const StridedArray<uint8_t> &segmentation, const Direction *direction,
+                                  unsigned long int nb_rows, unsigned long int nb_cols, bool edge_classification,
+                                  uint8_t *reset_masks, int num_threads);
+template void resetMasks<int32_t>(const StridedArray<int32_t> &segmentation, const Direction *direction,
+                                  unsigned long int nb_rows, unsigned long int nb_cols, bool edge_classification,
+                                  uint8_t *reset_masks, int num_threads);
+template void resetMasks<int64_t>(const StridedArray<int64_t> &segmentation, const Direction *direction,
+                                  unsigned long int nb_rows, unsigned long int nb_cols, bool edge_classification,
+                                  uint8_t *reset_masks, int num_threads);
+
+template void pixelValidity<uint8_t>(const SgmInputs<uint8_t> &inputs, unsigned long int nb_rows,
+                                     unsigned long int nb_cols, unsigned int nb_disps, uint8_t invalid_value,
+                                     uint8_t *validity, int num_threads);
+template void pixelValidity<float>(const SgmInputs<float> &inputs, unsigned long int nb_rows,
+                                   unsigned long int nb_cols, unsigned int nb_disps, float invalid_value,
+                                   uint8_t *validity, int num_threads);
+
+template void toRagged<uint8_t>(const StridedArray<uint8_t> &cv_in, const StridedArray<int32_t> &disp_min,
+                                const StridedArray<int32_t> &disp_max, const int64_t *offsets,
+                                unsigned long int nb_rows, unsigned long int nb_cols, unsigned int nb_disps,
+                                uint8_t *costs, int num_threads);
+template void toRagged<float>(const StridedArray<float> &cv_in, const StridedArray<int32_t> &disp_min,
+                              const StridedArray<int32_t> &disp_max, const int64_t *offsets, unsigned long int nb_rows,
+                              unsigned long int nb_cols, unsigned int nb_disps, float *costs, int num_threads);
+template void toDense<uint8_t>(const uint8_t *costs, const StridedArray<int32_t> &disp_min,
+                               const StridedArray<int32_t> &disp_max, const int64_t *offsets,
+                               unsigned long int nb_rows, unsigned long int nb_cols, unsigned int nb_disps,
+                               uint8_t invalid_value, uint8_t *cv_out, int num_threads);
+template void toDense<float>(const float *costs, const StridedArray<int32_t> &disp_min,
+                             const StridedArray<int32_t> &disp_max, const int64_t *offsets, unsigned long int nb_rows,
+                             unsigned long int nb_cols, unsigned int nb_disps, float invalid_value, float *cv_out,
+                             int num_threads);
+
+template float pointDisparity<uint8_t, uint16_t>(const uint16_t *costs, const uint8_t *pixel_costs, int first_disp,
+                                                 int last_disp, uint8_t invalid_value, DisparityMode mode);
+template float pointDisparity<float, float>(const float *costs, const float *pixel_costs, int first_disp,
+                                            int last_disp, float invalid_value, DisparityMode mode);
+template void pointConfidence<uint8_t, uint16_t>(const uint16_t *costs, const uint8_t *pixel_costs, int first_disp,
+                                                 int last_disp, uint8_t invalid_value,
+                                                 const ConfidenceOptions &options, const int *path_minimums,
+                                                 ConfidenceMaps &maps, unsigned long int pixel);
+template void pointConfidence<float, float>(const float *costs, const float *pixel_costs, int first_disp,
+                                            int last_disp, float invalid_value, const ConfidenceOptions &options,
+                                            const int *path_minimums, ConfidenceMaps &maps, unsigned long int pixel);
+
+template DirectionKernel<uint8_t> directionKernel<uint8_t>(Direction direction, ResetMode reset,
+                                                           PenaltyMode penalties, bool adaptive_p2);
+template DirectionKernel<uint8_t, uint16_t> directionKernel<uint8_t, uint16_t>(Direction direction, ResetMode reset,
+                                                                               PenaltyMode penalties, bool adaptive_p2);
+template DirectionKernel<float> directionKernel<float>(Direction direction, ResetMode reset,
+                                                       PenaltyMode penalties, bool adaptive_p2);
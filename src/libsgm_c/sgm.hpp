@@ -19,6 +19,33 @@
  */
 
 #include <stdint.h>
+#include <vector>
+#include "sgm_simd.hpp"
+
+/**
+* Confidence measures computed from the final aggregated costs of each point
+*/
+struct ConfidenceOptions{
+    bool ambiguity; /**< mean number of disparities of cost within eta of the lowest one, for eta in [0, eta_max] */
+    bool risk; /**< mean amplitude of these disparities (risk_max), and of the ones connected to the lowest cost
+                    (risk_min) */
+    bool ratio; /**< lowest cost over the second lowest one, for non-negative costs */
+    bool path_agreement; /**< number of directions whose minimum is within one disparity of the lowest cost,
+                              with cost_paths */
+    float eta_max; /**< highest cost difference to the lowest cost of ambiguity and risk */
+    float eta_step; /**< step of the cost differences of ambiguity and risk, positive */
+};
+
+/**
+* Confidence maps of the points, nullptr for the measures not computed
+*/
+struct ConfidenceMaps{
+    float * ambiguity; /**< ambiguity of each point, NaN without valid cost */
+    float * risk_min; /**< minimum risk of each point, NaN without valid cost */
+    float * risk_max; /**< maximum risk of each point, NaN without valid cost */
+    float * ratio; /**< ratio of each point, NaN with less than two valid costs */
+    uint8_t * path_agreement; /**< path agreement of each point, 0 without valid cost */
+};
 
 /**
 * Structure to represent Aggregated Cost Volume and the positions of minimum costs along each direction
@@ -27,9 +54,21 @@ template<typename T>
 struct CostVolumes{
     T * cost_volume; /**< Aggregated Cost Volume */
     int * cost_volume_min; /**< positions of minimum costs along each direction */
+    float * disparity_map; /**< disparity of the lowest aggregated cost of each point, nullptr if not computed */
+    ConfidenceMaps confidence; /**< confidence maps computed from the aggregated costs */
 };
 
 
+/**
+* Disparity map of the aggregation, without the aggregated cost volume
+*/
+template<typename T>
+struct DisparityMap{
+    int * disparity; /**< best disparity of each point, as an index along the disparity axis, -1 without valid cost */
+    T * costs; /**< aggregated costs S(d - 1), S(d), S(d + 1) of the best disparity d of each point, 3 values per
+                    point, invalid_value out of the disparity axis */
+};
+
 /**
 * Structure to represent coordinates of previous point path
 */
@@ -39,6 +78,146 @@ struct Direction{
     int dcol; /**< col coordinate */
 };
 
+/**
+* Aggregation tasks running at the same time, each one in a private partial cost volume
+*/
+enum Concurrency{
+    CONCURRENCY_NONE = 0, /**< passes or directions aggregated one after the other in the final cost volume */
+    CONCURRENCY_PASSES = 1, /**< the two passes aggregated at the same time */
+    CONCURRENCY_DIRECTIONS = 2 /**< the eight directions aggregated at the same time */
+};
+
+/**
+* History reset along the paths, from the segmentation map
+*/
+enum ResetMode{
+    RESET_NONE = 0, /**< no segmentation, or a uniform one: history is never reset and the resets are not read */
+    RESET_CLASSES = 1, /**< history reset between points of different classes */
+    RESET_EDGES = 2 /**< segmentation is an edge classification: history reset after an edge */
+};
+
+/**
+* Layout of the penalties, from their strides
+*/
+enum PenaltyMode{
+    PENALTIES_MAP = 0, /**< penalties of each point, read at the position of the point */
+    PENALTIES_CONSTANT = 1, /**< same penalties for all points, e.g. shapes (8,), (1, 1, 8) or scalars: only their 8 values are read */
+    PENALTIES_CLASSES = 2 /**< penalties of the class of each point, read in tables indexed by the segmentation labels */
+};
+
+/**
+* Validity of the costs of a point, from the invalid value
+*/
+enum PixelValidity{
+    PIXEL_VALID = 0, /**< no invalid cost */
+    PIXEL_PARTIAL = 1, /**< some invalid costs, tested disparity by disparity */
+    PIXEL_INVALID = 2 /**< only invalid costs: the point gives its costs and the paths restart after it */
+};
+
+/**
+* Disparity map computed from the final aggregated costs of each point
+*/
+enum DisparityMode{
+    DISPARITY_NONE = 0, /**< no disparity map */
+    DISPARITY_WTA = 1, /**< disparity of the lowest valid aggregated cost, the lowest one for a tie */
+    DISPARITY_PARABOLA = 2, /**< WTA disparity refined by the parabola through the costs of its neighbours */
+    DISPARITY_V_SHAPE = 3 /**< WTA disparity refined by the symmetric V through the costs of its neighbours */
+};
+
+/**
+* Options of the aggregation as compile-time constants, for the instantiations of the aggregation
+*/
+template<bool COST_PATHS, bool OVERCOUNTING, ResetMode RESET>
+struct AggregationOptions{
+    static const bool cost_paths = COST_PATHS; /**< positions of minimum costs are stored */
+    static const bool overcounting = OVERCOUNTING; /**< over-counting correction */
+    static const int overcounting_factor = OVERCOUNTING ? 7 : 0; /**< number of directions [8] - 1, if corrected */
+    static const ResetMode reset = RESET; /**< history reset */
+    typedef AggregationOptions<COST_PATHS, false, RESET> without_overcounting; /**< same options, no correction */
+};
+
+/**
+* Structure to represent two lines of aggregated costs along a direction, indexed by row parity
+*/
+template<typename T>
+struct LineBuffers{
+    T * lr; /**< aggregated costs, 2 x nb_cols x nb_disps */
+    T * min_lr; /**< minimum aggregated cost of each point, 2 x nb_cols */
+};
+
+/**
+* Strides of an input array, in number of values: the value k of the point (row, col) is at
+* row * row_stride + col * col_stride + k * depth_stride from the first value. Null strides broadcast the array.
+*/
+struct Strides{
+    long long row; /**< stride between two rows */
+    long long col; /**< stride between two columns */
+    long long depth; /**< stride between two disparities, or two directions */
+};
+
+/**
+* Strided view of an input array of nb_rows x nb_cols points
+*/
+template<typename T>
+struct StridedArray{
+    const T * data; /**< first value, nullptr for a missing optional array */
+    Strides strides; /**< strides of the array */
+};
+
+/**
+* Penalties of each class of the segmentation map, given to all points labelled with the class
+*/
+template<typename T>
+struct PenaltyTables{
+    const T * p1; /**< p1 penalties indexed [class][direction], nb_classes x 8 values, nullptr without tables */
+    const T * p2; /**< p2 penalties indexed [class][direction], nb_classes x 8 values */
+    unsigned int nb_classes; /**< number of classes, labels of the segmentation map are integers in [0, nb_classes) */
+};
+
+/**
+* Input arrays of the aggregation, read in place through their strides
+*/
+template<typename T>
+struct SgmInputs{
+    StridedArray<T> cv_in; /**< cost volume, nb_disps values per point */
+    StridedArray<T> p1_in; /**< p1 penalty, 8 directions per point */
+    StridedArray<T> p2_in; /**< p2 penalty, 8 directions per point */
+    StridedArray<float> segmentation; /**< segmentation map, one value per point, data is nullptr without it */
+    PenaltyTables<T> penalty_tables; /**< penalties of the segmentation classes, used instead of p1_in and p2_in if given */
+    StridedArray<float> guide; /**< guide image, one intensity per point: P2 adapted to the intensity gradient along
+                                    the paths, P2 / |I(p) - I(p-r)|, if given, data is nullptr without it */
+    const uint8_t * reset_masks; /**< history resets of each point, bit k for the direction k, C-contiguous nb_rows x
+                                      nb_cols, e.g. from resetMasks() on an integer map: nullptr to compute them
+                                      from the segmentation map */
+    const uint8_t * validity; /**< PixelValidity of each point over its disparity interval, C-contiguous
+                                   nb_rows x nb_cols, e.g. from pixelValidity(): nullptr to test every cost, the
+                                   validity is then derived once from the costs for a NaN invalid value */
+    StridedArray<int32_t> disp_min; /**< first disparity index of each point along the disparity axis of cv_in,
+                                         data is nullptr to aggregate all disparities of all points */
+    StridedArray<int32_t> disp_max; /**< last disparity index of each point, included: the costs out of
+                                         [disp_min, disp_max] are invalid, and they are not aggregated */
+    const int64_t * offsets; /**< ragged cost volume: the costs of the interval of the point p are packed from
+                                  cv_in.data[offsets[p]], p = col + row * nb_cols, nb_rows x nb_cols + 1 offsets
+                                  from raggedOffsets(); the output volume has the same offsets. nullptr for a
+                                  dense cost volume */
+};
+
+/**
+* Accumulator types of the aggregated costs of an input cost type: the narrow one is used when the aggregated
+* costs are bounded by its maximum, the wide one can not overflow
+*/
+template<typename T>
+struct Accumulator{
+    typedef T narrow; /**< narrowest lanes */
+    typedef T wide; /**< lanes without overflow */
+};
+
+template<>
+struct Accumulator<uint8_t>{
+    typedef uint8_t narrow; /**< 8 bits lanes, if aggregatedCostBound() fits in them */
+    typedef uint16_t wide; /**< 16 bits lanes, max cost + 2 P2 <= 765 */
+};
+
 /**
 * Structure to represent Penalty
 */
@@ -61,267 +240,931 @@ struct Penalty{
  *  \param nb_cols column number of cost volume
  *  \param nb_disps disparity number of cost volume
  *  \param invalid_value value representing invalid cost
- *  \param segmentation segmentation map
+ *  \param segmentation segmentation map, nullptr for no segmentation
  *  \param cost_paths True if Cost Volumes along direction are to be returned
  *  \param overcounting over-counting correction option
- *  \return cost volume aggregated, minimum cost on each direction
+ *  \param edge_classification use segmentation as an edge classification
+ *  \param num_threads number of threads, 1 for sequential passes, 0 uses all available threads
+ *  \param concurrency passes or directions to aggregate at the same time
+ *  \param nb_partial_volumes maximum number of private partial cost volumes allocated for the concurrent tasks
+ *  \param cost_volume_out output cost volume of nb_rows * nb_cols * nb_disps values, allocated by sgm if nullptr.
+ *   It must not be cv_in.
+ *  \param cost_volume_min_out output positions of minimum costs of nb_rows * nb_cols * 8 values if cost_paths,
+ *   allocated by sgm if nullptr
+ *  \param accumulate add the aggregated costs to the values of cost_volume_out instead of resetting it, e.g. to sum
+ *   the volumes of several stereo pairs. cost_volume_min_out is still reset.
+ *  \return cost volume aggregated, minimum cost on each direction. Output buffers given by the caller are returned,
+ *   and stay owned by the caller; other buffers are allocated with new[].
+ *  \throws std::invalid_argument if accumulate is set without cost_volume_out, or if cost_volume_out is cv_in
  */
 
 
 template<typename T , typename Tout>
 CostVolumes<Tout> sgm(T * cv_in, T* p1_in, T* p2_in, int* directions_in, unsigned long int nb_rows, unsigned long int nb_cols,
- unsigned int nb_disps, T invalid_value, float* segmentation, bool cost_paths, bool overcounting, bool edge_classification);
+ unsigned int nb_disps, T invalid_value, float* segmentation, bool cost_paths, bool overcounting, bool edge_classification,
+ int num_threads = 1, Concurrency concurrency = CONCURRENCY_NONE, unsigned int nb_partial_volumes = 7,
+ Tout* cost_volume_out = nullptr, int* cost_volume_min_out = nullptr,
+ bool accumulate = false);
 
 /*!
- *  Update minimum
+ *  \brief  Compute aggregated cost volume from strided inputs
+ *   Same as sgm, the inputs are read in place through their strides: views into larger arrays, transposed
+ *   or broadcast arrays are not copied. Costs whose disparities are not contiguous are gathered point by point.
  *
- *  \param current_min current minimum
- *  \param value potential new minimum
- *  \param current_disp current disparity
- *  \param disp potential disparity
- *  \return new minimum, new disparity
+ *  \param inputs cost volume, penalties and segmentation map with their strides
+ *  \param directions_in directions to use
+ *  \param nb_rows row number of cost volume
+ *  \param nb_cols column number of cost volume
+ *  \param nb_disps disparity number of cost volume
+ *  \param invalid_value value representing invalid cost
+ *  \param cost_paths True if Cost Volumes along direction are to be returned
+ *  \param overcounting over-counting correction option
+ *  \param edge_classification use segmentation as an edge classification
+ *  \param num_threads number of threads, 1 for sequential passes, 0 uses all available threads
+ *  \param concurrency passes or directions to aggregate at the same time
+ *  \param nb_partial_volumes maximum number of private partial cost volumes allocated for the concurrent tasks
+ *  \param cost_volume_out output cost volume of nb_rows * nb_cols * nb_disps values, allocated by sgm if nullptr.
+ *   It must not be the cost volume.
+ *  \param cost_volume_min_out output positions of minimum costs of nb_rows * nb_cols * 8 values if cost_paths,
+ *   allocated by sgm if nullptr
+ *  \param accumulate add the aggregated costs to the values of cost_volume_out instead of resetting it
+ *  \param disparity_mode disparity map computed from the final aggregated costs of each point, while the second
+ *   pass writes them, or once the concurrent tasks are reduced. The disparity is an index along the disparity axis,
+ *   with its sub-pixel offset, NaN for a point without valid cost.
+ *  \param keep_cost_volume return the aggregated cost volume, else it is freed once the disparity and confidence
+ *   maps are computed and cost_volume is nullptr
+ *  \param disparity_out output disparity map of nb_rows * nb_cols values, allocated by sgm if nullptr
+ *  \param confidence confidence maps computed from the final aggregated costs of each point, as the disparity map
+ *  \return cost volume aggregated, minimum cost on each direction, disparity map (nullptr with DISPARITY_NONE) and
+ *   confidence maps (nullptr if not asked). Output buffers given by the caller are returned, and stay owned by the
+ *   caller; other buffers are allocated with new[].
+ *  \throws std::invalid_argument as sgm, if a ragged cost volume is concurrent, if the cost volume is not kept
+ *   while it is given or without disparity nor confidence map, or for invalid confidence options
  */
 
-std::pair<float, int> update_minimum(float current_min, float value, int current_disp, int disp);
+template<typename T , typename Tout>
+CostVolumes<Tout> sgm(const SgmInputs<T> & inputs, int* directions_in, unsigned long int nb_rows,
+ unsigned long int nb_cols, unsigned int nb_disps, T invalid_value, bool cost_paths, bool overcounting,
+ bool edge_classification, int num_threads = 1, Concurrency concurrency = CONCURRENCY_NONE,
+ unsigned int nb_partial_volumes = 7, Tout* cost_volume_out = nullptr, int* cost_volume_min_out = nullptr,
+ bool accumulate = false, DisparityMode disparity_mode = DISPARITY_NONE, bool keep_cost_volume = true,
+ float* disparity_out = nullptr, ConfidenceOptions confidence = ConfidenceOptions());
 
 /*!
- *  \brief  Compute aggregated cost volume
- *   Compute aggregated cost at one point
- *   from left to right direction
+ *  \brief  Compute the disparity map of the 8 directions without the aggregated cost volume (memory efficient SGM)
+ *   As in Hirschmuller, Buder and Ernst (2012), the passes keep the best disparity of each point and the
+ *   aggregated costs around it, never a volume: the first pass keeps its best disparity, the second pass completes
+ *   its costs and keeps its own best disparity, whose costs are completed by the first pass aggregated again.
+ *   The best disparity is the one of lowest aggregated cost of the two, among the disparities of valid cost in the
+ *   interval of the point; the costs of its neighbours out of the interval are invalid. The temporary memory is the line buffers of the passes, O(nb_cols x nb_disps), and a few values per point.
  *
- *  \param pixelCost cost value 
- *  \param row row position
- *  \param col col position
- *  \param disp disp position
- *  \param invalid_value value representing invalid cost
+ *  \param inputs cost volume, penalties and segmentation map with their strides
+ *  \param directions_in directions to use
  *  \param nb_rows row number of cost volume
  *  \param nb_cols column number of cost volume
  *  \param nb_disps disparity number of cost volume
- *  \param P1 penalty P1 from sgm equation
- *  \param P2 penalty P2 from sgm equation
- *  \param direction array of struct containing coordinates of previous point
- *  \param buff0 buffer containing previous aggregated cost (previous point)
- *  \param min_disp0 value of minimum cost at the previous pixel
- *  \param pixel_0 value of previous disp on the buffer
- *  \param current_class current class
- *  \param buff_class0 buffer containing previous class (previous point
- *  \param reset0 value of coefficient to multiply history
- *  \return cost aggregated point
+ *  \param invalid_value value representing invalid cost
+ *  \param overcounting over-counting correction option
+ *  \param edge_classification use segmentation as an edge classification
+ *  \param num_threads number of threads, 1 for sequential passes, 0 uses all available threads
+ *  \param disparity_out output disparity map of nb_rows * nb_cols values, allocated if nullptr
+ *  \param costs_out output costs of nb_rows * nb_cols * 3 values, allocated if nullptr
+ *  \return disparity map and costs of the best disparities, the buffers of the caller or allocated with new[]
+ */
+
+template<typename T , typename Tout>
+DisparityMap<Tout> esgm(const SgmInputs<T> & inputs, int* directions_in, unsigned long int nb_rows,
+ unsigned long int nb_cols, unsigned int nb_disps, T invalid_value, bool overcounting, bool edge_classification,
+ int num_threads = 1, int* disparity_out = nullptr, Tout* costs_out = nullptr);
+
+/*!
+ *  \brief  Strides of a C-contiguous array
+ *
+ *  \param nb_cols column number of the array
+ *  \param depth number of values of each point
+ *  \return strides of the array
+ */
+
+Strides contiguousStrides(unsigned long int nb_cols, unsigned int depth);
+
+/*!
+ *  \brief  Inputs of the aggregation from C-contiguous arrays
+ *
+ *  \param cv_in cost volume
+ *  \param p1_in p1 penalty
+ *  \param p2_in p2 penalty
+ *  \param segmentation segmentation map, nullptr for no segmentation
+ *  \param nb_cols column number of cost volume
+ *  \param nb_disps disparity number of cost volume
+ *  \return inputs with contiguous strides
  */
 
 template<typename T>
-T aggregatedCostFromTopLeft0(T pixelCost, int row, int col, int disp, T invalid_value,
-    int nb_rows, int nb_cols, int nb_disps, T P1, T P2, Direction direction,
-    T * buff0, T * min_disp0, T * pixel_0, float current_class, float buff_class0, float & reset0, bool edge_classification);
+SgmInputs<T> contiguousInputs(const T * cv_in, const T * p1_in, const T * p2_in, const float * segmentation,
+    unsigned long int nb_cols, unsigned int nb_disps);
 
 /*!
- *  \brief  Compute aggregated cost volume
- *   Compute aggregated cost at one point
- *   from up to down direction
+ *  \brief  First value of a point of a strided array
+ *
+ *  \param array strided array
+ *  \param row row position
+ *  \param col col position
+ *  \return first value of the point, the next ones are array.strides.depth values apart
+ */
+
+template<typename T>
+const T * pointValues(const StridedArray<T> & array, long long row, long long col);
+
+/*!
+ *  \brief  Contiguous costs of a point
  *
- *  \param pixelCost cost value 
+ *  \param cv_in cost volume
  *  \param row row position
  *  \param col col position
- *  \param disp disp position
+ *  \param nb_disps disparity number of cost volume
+ *  \param buffer nb_disps values where the costs are gathered if their disparities are not contiguous
+ *  \return costs of the point, in the cost volume or in buffer
+ */
+
+template<typename T>
+const T * pointCosts(const StridedArray<T> & cv_in, long long row, long long col, unsigned int nb_disps, T * buffer);
+
+/*!
+ *  \brief  Compute aggregated cost volume with path costs of type Tacc
+ *   sgm chooses the narrowest accumulator of Accumulator<T> without overflow: an aggregated cost is bounded
+ *   by max cost + P2, invalid costs being kept. Integer accumulators are saturating.
+ *
+ *  \tparam Tin type of the costs and penalties
+ *  \tparam Tacc type of the aggregated costs along each direction
+ *  \tparam Tout type of the aggregated cost volume
+ *  \param inputs cost volume, penalties and segmentation map with their strides
+ *  \param directions_in directions to use
+ *  \param nb_rows row number of cost volume
+ *  \param nb_cols column number of cost volume
+ *  \param nb_disps disparity number of cost volume
  *  \param invalid_value value representing invalid cost
+ *  \param cost_paths True if Cost Volumes along direction are to be returned
+ *  \param overcounting over-counting correction option
+ *  \param edge_classification use segmentation as an edge classification
+ *  \param num_threads number of threads, 1 for sequential passes, 0 uses all available threads
+ *  \param concurrency passes or directions to aggregate at the same time
+ *  \param nb_partial_volumes maximum number of private partial cost volumes allocated for the concurrent tasks
+ *  \param cost_volume_out output cost volume of nb_rows * nb_cols * nb_disps values, allocated by sgm if nullptr.
+ *   It must not be cv_in.
+ *  \param cost_volume_min_out output positions of minimum costs of nb_rows * nb_cols * 8 values if cost_paths,
+ *   allocated by sgm if nullptr
+ *  \param accumulate add the aggregated costs to the values of cost_volume_out instead of resetting it, e.g. to sum
+ *   the volumes of several stereo pairs. cost_volume_min_out is still reset.
+ *  \return cost volume aggregated, minimum cost on each direction. Output buffers given by the caller are returned,
+ *   and stay owned by the caller; other buffers are allocated with new[].
+ *  \throws std::invalid_argument if accumulate is set without cost_volume_out, or if cost_volume_out is cv_in
+ */
+
+template<typename Tin , typename Tacc , typename Tout>
+CostVolumes<Tout> sgmWithAccumulator(const SgmInputs<Tin> & inputs, int* directions_in,
+ unsigned long int nb_rows, unsigned long int nb_cols, unsigned int nb_disps, Tin invalid_value,
+ bool cost_paths, bool overcounting, bool edge_classification, int num_threads = 1,
+ Concurrency concurrency = CONCURRENCY_NONE, unsigned int nb_partial_volumes = 7, Tout* cost_volume_out = nullptr,
+ int* cost_volume_min_out = nullptr, bool accumulate = false, DisparityMode disparity_mode = DISPARITY_NONE,
+ bool keep_cost_volume = true, float* disparity_out = nullptr, ConfidenceOptions confidence = ConfidenceOptions());
+
+/*!
+ *  \brief  Check if confidence maps are asked
+ *
+ *  \param confidence confidence options
+ *  \return true if a measure is asked
+ */
+
+bool hasConfidenceMaps(const ConfidenceOptions & confidence);
+
+/*!
+ *  \brief  Bound of the aggregated costs: maximum valid cost + maximum P2, + 2 maximum P2 with disparity grids
+ *
+ *  \param inputs cost volume and penalties
  *  \param nb_rows row number of cost volume
  *  \param nb_cols column number of cost volume
  *  \param nb_disps disparity number of cost volume
- *  \param P1 penalty P1 from sgm equation
- *  \param P2 penalty P2 from sgm equation
- *  \param direction array of struct containing coordinates of previous point
- *  \param buff1 buffer containing previois aggregated cost (previous line)
- *  \param min_disp1 value of minimum cost at the previous pixel
- *  \param pixel_1 value of previous disp on the buffer
- *  \param current_class current class
- *  \param buff_class1 buffer containing previous class (previous point
- *  \param reset1 value of coefficient to multiply history
- *  \return cost aggregated point
+ *  \param invalid_value value representing invalid cost, not taken into account
+ *  \param num_threads number of threads
+ *  \return maximum aggregated cost
  */
 
-template<typename T> 
-T aggregatedCostFromTopLeft1(T pixelCost, int row, int col, int disp, T invalid_value,
-    int nb_rows, int nb_cols, int nb_disps, T P1, T P2, Direction direction,
-    T * buff1, T * min_disp1, T * pixel_1, float current_class, float * buff_class1, float & reset1, bool edge_classification);
+template<typename T>
+double aggregatedCostBound(const SgmInputs<T> & inputs, unsigned long int nb_rows, unsigned long int nb_cols,
+    unsigned int nb_disps, T invalid_value, int num_threads);
+
 /*!
- *  \brief  Compute aggregated cost volume
- *   Compute aggregated cost at one point
- *   diagonaly from upper left
+ *  \brief  Get an output buffer of zeros
  *
- *  \param pixelCost cost value 
- *  \param row row position
- *  \param col col position
- *  \param disp disp position
+ *  \param buffer buffer given by the caller, or nullptr
+ *  \param nb_values number of values of the buffer
+ *  \return buffer filled with zeros, allocated with new[] if not given
+ */
+
+template<typename T>
+T * outputBuffer(T * buffer, unsigned long int nb_values);
+
+/*!
+ *  \brief  Compute the disparity map of the 8 directions with path costs of type Tacc, see esgm
+ *
+ *  \tparam Tin type of the costs and penalties
+ *  \tparam Tacc type of the aggregated costs along each direction
+ *  \tparam Tout type of the aggregated costs of the disparity map
+ *  \param inputs cost volume, penalties and segmentation map with their strides
+ *  \param directions_in directions to use
+ *  \param nb_rows row number of cost volume
+ *  \param nb_cols column number of cost volume
+ *  \param nb_disps disparity number of cost volume
  *  \param invalid_value value representing invalid cost
+ *  \param overcounting over-counting correction option
+ *  \param edge_classification use segmentation as an edge classification
+ *  \param num_threads number of threads, 1 for sequential passes, 0 uses all available threads
+ *  \param disparity_out output disparity map of nb_rows * nb_cols values, allocated if nullptr
+ *  \param costs_out output costs of nb_rows * nb_cols * 3 values, allocated if nullptr
+ *  \return disparity map and costs of the best disparities
+ */
+
+template<typename Tin , typename Tacc , typename Tout>
+DisparityMap<Tout> esgmWithAccumulator(const SgmInputs<Tin> & inputs, int* directions_in, unsigned long int nb_rows,
+ unsigned long int nb_cols, unsigned int nb_disps, Tin invalid_value, bool overcounting, bool edge_classification,
+ int num_threads = 1, int* disparity_out = nullptr, Tout* costs_out = nullptr);
+
+/*!
+ *  \brief  Check the optional inputs of the aggregation, before any allocation
+ *
+ *  \param inputs inputs of the aggregation
  *  \param nb_rows row number of cost volume
  *  \param nb_cols column number of cost volume
  *  \param nb_disps disparity number of cost volume
- *  \param P1 penalty P1 from sgm equation
- *  \param P2 penalty P2 from sgm equation
- *  \param direction array of struct containing coordinates of previous point
- *  \param buff2 buffer containing previous aggregated cost (previous line)
- *  \param buff_disp_2 buffer containing previous aggregated point
- *  \param min_disp2 value of minimum cost at the previous pixel
- *  \param pixel_2 value of previous disp on the buffer
- *  \param current_class current class
- *  \param buff_class2 buffer containing previous class (previous point
- *  \param reset2 value of coefficient to multiply history
- *  \return cost aggregated point
+ *  \param num_threads number of threads
+ *  \throws std::invalid_argument for a single disparity grid, invalid classes of the penalty tables or offsets of a
+ *   ragged volume not following the disparity intervals
  */
 
-template<typename T> 
-T aggregatedCostFromTopLeft2(T pixelCost, int row, int col, int disp, T invalid_value,
-    int nb_rows, int nb_cols, int nb_disps, T P1, T P2, Direction direction,
-    T * buff2, T * buff_disp_2, T * min_disp2, T * pixel_2, float current_class, float * buff_class2, float & reset2, bool edge_classification);
+template<typename T>
+void checkInputs(const SgmInputs<T> & inputs, unsigned long int nb_rows, unsigned long int nb_cols,
+    unsigned int nb_disps, int num_threads);
 
 /*!
- *  \brief  Compute aggregated cost volume
- *   Compute aggregated cost at one point
- *   diagonaly from upper right
+ *  \brief  Inputs of the passes: history resets and validity computed once, if they are needed and not given
  *
- *  \param pixelCost cost value 
- *  \param row row position
- *  \param col col position
- *  \param disp disp position
- *  \param invalid_value value representing invalid cost
+ *  \tparam Options AggregationOptions of the instantiation
+ *  \param inputs inputs of the aggregation
+ *  \param direction array of struct containing coordinates of previous point, for the 8 directions
  *  \param nb_rows row number of cost volume
  *  \param nb_cols column number of cost volume
  *  \param nb_disps disparity number of cost volume
- *  \param P1 penalty P1 from sgm equation
- *  \param P2 penalty P2 from sgm equation
- *  \param direction array of struct containing coordinates of previous point
- *  \param buff3 buffer containing previous aggregated cost (previous line)
- *  \param min_disp3 value of minimum cost at the previous pixel
- *  \param current_class current class
- *  \param buff_class3 buffer containing previous class (previous point
- *  \param reset3 value of coefficient to multiply history
- *  \return cost aggregated point
+ *  \param invalid_value value representing invalid cost
+ *  \param num_threads number of threads
+ *  \param reset_masks storage of the computed reset masks, kept by the caller during the passes
+ *  \param validity storage of the computed validity, kept by the caller during the passes
+ *  \return inputs with the computed reset masks and validity
  */
 
-template<typename T> 
-T aggregatedCostFromTopLeft3(T pixelCost, int row, int col, int disp, T invalid_value,
-    int nb_rows, int nb_cols, int nb_disps, T P1, T P2, Direction direction,
-    T * buff3, T * min_disp3, float current_class, float * buff_class3, float & reset3, bool edge_classification);
+template<typename Tin , typename Options>
+SgmInputs<Tin> passInputs(const SgmInputs<Tin> & inputs, const Direction * direction, unsigned long int nb_rows,
+    unsigned long int nb_cols, unsigned int nb_disps, Tin invalid_value, int num_threads,
+    std::vector<uint8_t> & reset_masks, std::vector<uint8_t> & validity);
 
 /*!
- *  \brief  Compute aggregated cost volume
- *   Compute aggregated cost at one point
- *   from right to left direction
+ *  \brief  Compute aggregated cost of the 8 directions, in sequential passes or with concurrent tasks
  *
- *  \param pixelCost cost value 
- *  \param row row position
- *  \param col col position
- *  \param disp disp position
+ *  \tparam Options AggregationOptions of the instantiation
+ *  \param inputs cost volume, penalties and segmentation map
+ *  \param direction array of struct containing coordinates of previous point, for the 8 directions
+ *  \param nb_rows row number of cost volume
+ *  \param nb_cols column number of cost volume
+ *  \param nb_disps disparity number of cost volume
  *  \param invalid_value value representing invalid cost
+ *  \param cvs aggregated cost volume and positions of minimum costs to update
+ *  \param num_threads number of threads
+ *  \param concurrency passes or directions to aggregate at the same time
+ *  \param nb_partial_volumes maximum number of private partial cost volumes
+ *  \param disparity_mode disparity map written in cvs.disparity_map
+ *  \param confidence confidence maps written in cvs.confidence
+ */
+
+template<typename Tin , typename Tacc , typename Tout , typename Options>
+void aggregate(const SgmInputs<Tin> & inputs, Direction * direction, unsigned long int nb_rows,
+ unsigned long int nb_cols, unsigned int nb_disps, Tin invalid_value, CostVolumes<Tout> & cvs,
+ int num_threads, Concurrency concurrency, unsigned int nb_partial_volumes, DisparityMode disparity_mode,
+ const ConfidenceOptions & confidence);
+
+/**
+* Signature of the aggregation of the 8 directions
+*/
+template<typename Tin, typename Tacc, typename Tout>
+using AggregationEngine = void (*)(const SgmInputs<Tin> &, Direction *, unsigned long int, unsigned long int,
+    unsigned int, Tin, CostVolumes<Tout> &, int, Concurrency, unsigned int, DisparityMode,
+    const ConfidenceOptions &);
+
+/*!
+ *  \brief  Get the aggregation instantiated for the options
+ *
+ *  \param cost_paths True if positions of minimum costs are to be stored
+ *  \param overcounting over-counting correction option
+ *  \param reset history reset
+ *  \return aggregate instantiated with the options as constants
+ */
+
+template<typename Tin, typename Tacc, typename Tout>
+AggregationEngine<Tin, Tacc, Tout> aggregationEngine(bool cost_paths, bool overcounting, ResetMode reset);
+
+/*!
+ *  \brief  Compute the disparity map of the 8 directions in three passes, see esgm
+ *
+ *  \tparam Options AggregationOptions of the instantiation
+ *  \param inputs cost volume, penalties and segmentation map
+ *  \param direction array of struct containing coordinates of previous point, for the 8 directions
  *  \param nb_rows row number of cost volume
  *  \param nb_cols column number of cost volume
  *  \param nb_disps disparity number of cost volume
- *  \param P1 penalty P1 from sgm equation
- *  \param P2 penalty P2 from sgm equation
- *  \param direction array of struct containing coordinates of previous pointnt
- *  \param buff4 buffer containing previois aggregated cost (previous point)
- *  \param min_disp4 value of minimum cost at the previous pixel
- *  \param pixel_4 value of previous disp on the buffer
- *  \param current_class current class
- *  \param buff_class4 buffer containing previous class (previous point
- *  \param reset4 value of coefficient to multiply history
- *  \return cost aggregated point
+ *  \param invalid_value value representing invalid cost
+ *  \param map output disparity map and costs
+ *  \param num_threads number of threads
  */
 
-template<typename T> 
-T aggregatedCostFromBottomRight4(T pixelCost, int row, int col, int disp, T invalid_value,
-    int nb_rows, int nb_cols, int nb_disps, T P1, T P2, Direction direction,
-    T * buff4, T * min_disp4, T * pixel_4, float current_class, float buff_class4, float & reset4, bool edge_classification);
+template<typename Tin , typename Tacc , typename Tout , typename Options>
+void esgmAggregate(const SgmInputs<Tin> & inputs, Direction * direction, unsigned long int nb_rows,
+ unsigned long int nb_cols, unsigned int nb_disps, Tin invalid_value, DisparityMap<Tout> & map, int num_threads);
+
+/**
+* Signature of the memory efficient aggregation of the 8 directions
+*/
+template<typename Tin, typename Tacc, typename Tout>
+using EsgmEngine = void (*)(const SgmInputs<Tin> &, Direction *, unsigned long int, unsigned long int,
+    unsigned int, Tin, DisparityMap<Tout> &, int);
 
 /*!
- *  \brief  Compute aggregated cost volume
- *   Compute aggregated cost at one point
- *   from down to up direction
+ *  \brief  Get the memory efficient aggregation instantiated for the options
  *
- *  \param pixelCost cost value 
- *  \param row row position
- *  \param col col position
- *  \param disp disp position
+ *  \param overcounting over-counting correction option
+ *  \param reset history reset
+ *  \return esgmAggregate instantiated with the options as constants
+ */
+
+template<typename Tin, typename Tacc, typename Tout>
+EsgmEngine<Tin, Tacc, Tout> esgmEngine(bool overcounting, ResetMode reset);
+
+/*!
+ *  \brief  Find how the segmentation resets the history
+ *   A uniform segmentation, or an edge classification without edge, never resets it.
+ *
+ *  \param segmentation segmentation map, data is nullptr for no segmentation
+ *  \param nb_rows row number of the segmentation map
+ *  \param nb_cols column number of the segmentation map
+ *  \param edge_classification use segmentation as an edge classification
+ *  \param num_threads number of threads
+ *  \return reset mode of the aggregation
+ */
+
+ResetMode resetMode(const StridedArray<float> & segmentation, unsigned long int nb_rows, unsigned long int nb_cols,
+    bool edge_classification, int num_threads);
+
+/*!
+ *  \brief  Find whether packed reset masks reset the history
+ *
+ *  \param reset_masks reset bits of the 8 directions of each point
+ *  \param nb_pixels number of points
+ *  \param num_threads number of threads
+ *  \return RESET_NONE if no bit is set, RESET_CLASSES otherwise
+ */
+
+ResetMode resetMode(const uint8_t * reset_masks, unsigned long int nb_pixels, int num_threads);
+
+/*!
+ *  \brief  Pack the history resets of the 8 directions of each point in one byte
+ *   The bit k of a point is set if the history of the direction k is reset at the point, from its label and
+ *   the label of its previous point along the direction; it is not set if there is no previous point.
+ *   Rows are computed in parallel, and the columns of a row in SIMD lanes.
+ *
+ *  \tparam Tseg label type: float, integer or boolean map
+ *  \param segmentation segmentation map
+ *  \param direction coordinates of the previous point, for the 8 directions
+ *  \param nb_rows row number of the segmentation map
+ *  \param nb_cols column number of the segmentation map
+ *  \param edge_classification use segmentation as an edge classification
+ *  \param reset_masks output masks, C-contiguous nb_rows x nb_cols
+ *  \param num_threads number of threads
+ */
+template<typename Tseg>
+void resetMasks(const StridedArray<Tseg> & segmentation, const Direction * direction, unsigned long int nb_rows,
+    unsigned long int nb_cols, bool edge_classification, uint8_t * reset_masks, int num_threads);
+
+/*!
+ *  \brief  Classify the points from the number of invalid costs in their disparity interval
+ *   A NaN invalid value matches the NaN costs, a point with an empty interval has only invalid costs. Points are
+ *   classified in parallel; the validity of a cost volume can be computed once and given to all its aggregations.
+ *
+ *  \param inputs cost volume, dense or ragged, and its disparity grids
+ *  \param nb_rows row number of the cost volume
+ *  \param nb_cols column number of the cost volume
+ *  \param nb_disps disparity number of the cost volume
+ *  \param invalid_value value of the invalid costs
+ *  \param validity output PixelValidity of each point, C-contiguous nb_rows x nb_cols
+ *  \param num_threads number of threads
+ */
+template<typename T>
+void pixelValidity(const SgmInputs<T> & inputs, unsigned long int nb_rows, unsigned long int nb_cols,
+    unsigned int nb_disps, T invalid_value, uint8_t * validity, int num_threads);
+
+/*!
+ *  \brief  Find how the penalties are read
+ *   Penalties are read in the tables of the classes if there are tables, they are constant if both P1 and P2
+ *   have null row and column strides.
+ *
+ *  \param inputs inputs of the aggregation
+ *  \return penalty mode of the direction kernels
+ */
+template<typename T>
+PenaltyMode penaltyMode(const SgmInputs<T> & inputs);
+
+/*!
+ *  \brief  Aggregate the 4 directions of one pass, and give the aggregated costs of each point to a sink
+ *   The 4 directions of the pass are aggregated at once, point by point.
+ *   In the scan order (i, j) of the pass, a point only depends on points (i, j-1) and (i-1, j-1..j+1):
+ *   with several threads, all points of the wavefront 2*i + j are aggregated at the same time.
+ *   Aggregated costs of each direction are stored in two line buffers, indexed by row parity: the temporary
+ *   memory is O(nb_cols x nb_disps), what the sink keeps of the aggregated costs is up to it.
+ *
+ *  \tparam Options AggregationOptions of the pass, for the history reset
+ *  \tparam PointSink callable as sink(row, col, pixel_costs, lr, min_lr, simd), with the costs of the point, the
+ *   aggregated costs and their minimum along the 4 directions, and the SIMD kernels of the pass. Points of a
+ *   wavefront are given to the sink from several threads.
+ *  \param pass 0 for the first pass (directions 0 to 3), 1 for the second pass (directions 4 to 7)
+ *  \param inputs cost volume, penalties and segmentation map
+ *  \param direction array of struct containing coordinates of previous point, for the 8 directions
+ *  \param nb_rows row number of cost volume
+ *  \param nb_cols column number of cost volume
+ *  \param nb_disps disparity number of cost volume
  *  \param invalid_value value representing invalid cost
+ *  \param num_threads number of threads
+ *  \param sink output of each point
+ */
+
+template<typename Tin , typename Tacc , typename Options , typename PointSink>
+void scanPass(int pass, const SgmInputs<Tin> & inputs, Direction * direction, unsigned long int nb_rows,
+    unsigned long int nb_cols, unsigned int nb_disps, Tin invalid_value, int num_threads, PointSink & sink);
+
+/*!
+ *  \brief  Compute aggregated cost of one pass
+ *   The sum of the 4 directions of the pass is added to the cost volume at each point scanned by scanPass().
+ *
+ *  \tparam Options AggregationOptions of the pass, with the over-counting correction if the pass applies it
+ *  \param pass 0 for the first pass (directions 0 to 3), 1 for the second pass (directions 4 to 7)
+ *  \param inputs cost volume, penalties and segmentation map
+ *  \param direction array of struct containing coordinates of previous point, for the 8 directions
  *  \param nb_rows row number of cost volume
  *  \param nb_cols column number of cost volume
  *  \param nb_disps disparity number of cost volume
- *  \param P1 penalty P1 from sgm equation
- *  \param P2 penalty P2 from sgm equation
- *  \param direction array of struct containing coordinates of previous point
- *  \param buff5 buffer containing previois aggregated cost (previous line)
- *  \param min_disp5 value of minimum cost at the previous pixel
- *  \param pixel_5 value of previous disp on the buffer
- *  \param current_class current class
- *  \param buff_class5 buffer containing previous class (previous point
- *  \param reset5 value of coefficient to multiply history
- *  \return cost aggregated point
+ *  \param invalid_value value representing invalid cost
+ *  \param cost_volume aggregated cost volume to update
+ *  \param cost_volume_min positions of minimum costs along each direction
+ *  \param num_threads number of threads
+ *  \param disparity_mode disparity map computed from the costs written at each point, by the last pass
+ *  \param disparity_map output disparity map, nullptr with DISPARITY_NONE
+ *  \param confidence confidence maps computed from the costs written at each point, by the last pass, nullptr if none
+ *  \param confidence_maps output confidence maps
  */
 
-template<typename T> 
-T aggregatedCostFromBottomRight5(T pixelCost, int row, int col, int disp, T invalid_value,
-    int nb_rows, int nb_cols, int nb_disps, T P1, T P2, Direction direction,
-    T * buff5, T * min_disp5, T * pixel_5, float current_class, float * buff_class5, float & reset5, bool edge_classification);
+template<typename Tin , typename Tacc , typename Tout , typename Options>
+void aggregatePass(int pass, const SgmInputs<Tin> & inputs, Direction * direction, unsigned long int nb_rows,
+ unsigned long int nb_cols, unsigned int nb_disps, Tin invalid_value, Tout * cost_volume,
+ int * cost_volume_min, int num_threads, DisparityMode disparity_mode = DISPARITY_NONE, float * disparity_map = nullptr,
+ const ConfidenceOptions * confidence = nullptr, ConfidenceMaps * confidence_maps = nullptr);
 
 /*!
- *  \brief  Compute aggregated cost volume
- *   Compute aggregated cost at one point
- *   diagonaly from lower left
+ *  \brief  Compute aggregated cost with concurrent tasks
+ *   Passes or directions run at the same time, the first one in the final cost volume and the others
+ *   in private partial volumes. Partial volumes are summed in the final one by a parallel reduction.
+ *   If there are more tasks than partial volumes, tasks run in several rounds.
  *
- *  \param pixelCost cost value 
- *  \param row row position
- *  \param col col position
- *  \param disp disp position
+ *  \tparam Options AggregationOptions of the aggregation
+ *  \param inputs cost volume, penalties and segmentation map
+ *  \param direction array of struct containing coordinates of previous point, for the 8 directions
+ *  \param nb_rows row number of cost volume
+ *  \param nb_cols column number of cost volume
+ *  \param nb_disps disparity number of cost volume
  *  \param invalid_value value representing invalid cost
+ *  \param cvs aggregated cost volume and positions of minimum costs to update
+ *  \param num_threads number of threads
+ *  \param concurrency passes or directions to aggregate at the same time
+ *  \param nb_partial_volumes maximum number of private partial cost volumes
+ */
+
+template<typename Tin , typename Tacc , typename Tout , typename Options>
+void aggregateConcurrently(const SgmInputs<Tin> & inputs, Direction * direction, unsigned long int nb_rows,
+ unsigned long int nb_cols, unsigned int nb_disps, Tin invalid_value, CostVolumes<Tout> & cvs,
+ int num_threads, Concurrency concurrency, unsigned int nb_partial_volumes);
+
+/*!
+ *  \brief  Sum partial cost volumes in the first one and reset them to 0
+ *
+ *  \param cv_in cost volume
+ *  \param partial_volumes partial cost volumes, the first one receives the sum
+ *  \param nb_partial_volumes number of partial cost volumes
  *  \param nb_rows row number of cost volume
  *  \param nb_cols column number of cost volume
  *  \param nb_disps disparity number of cost volume
+ *  \param overcounting_factor number of times the pixel cost is removed from the sum
+ *  \param num_threads number of threads
+ */
+
+template<typename T , typename Tout>
+void reducePartialVolumes(const StridedArray<T> & cv_in, Tout ** partial_volumes, int nb_partial_volumes,
+    unsigned long int nb_rows, unsigned long int nb_cols, unsigned int nb_disps, int overcounting_factor,
+    int num_threads);
+
+/*!
+ *  \brief  Compute aggregated cost along one direction
+ *   Each scanline of the direction is independent: rows for horizontal paths,
+ *   columns (one row after the other) for the other paths. Scanlines are shared
+ *   between the threads of the team and the path costs are added to cvs.
+ *
+ *  \tparam Options AggregationOptions of the aggregation, the over-counting is not corrected here
+ *  \param inputs cost volume, penalties and segmentation map
+ *  \param nb_rows row number of cost volume
+ *  \param nb_cols column number of cost volume
+ *  \param nb_disps disparity number of cost volume
+ *  \param invalid_value value representing invalid cost
+ *  \param dir index of the direction, in [0, 8)
+ *  \param direction coordinates of previous point
+ *  \param cvs aggregated cost volume and positions of minimum costs to update
+ *  \param num_threads number of threads
+ */
+
+template<typename Tin , typename Tacc , typename Tout , typename Options>
+void aggregateDirection(const SgmInputs<Tin> & inputs, unsigned long int nb_rows, unsigned long int nb_cols,
+ unsigned int nb_disps, Tin invalid_value, int dir, Direction direction, CostVolumes<Tout> & cvs, int num_threads);
+
+/*!
+ *  \brief  Compute aggregated cost of one point for all disparities
+ *   The minimum aggregated cost is tracked while the costs are written, so that the next point
+ *   does not search it again. Integer aggregated costs are saturating.
+ *
+ *  \param pixel_costs costs of the point, nb_disps values
+ *  \param previous_lr aggregated costs of the previous point
+ *  \param lr output aggregated costs of the point, nb_disps values
+ *  \param nb_disps disparity number of cost volume
  *  \param P1 penalty P1 from sgm equation
  *  \param P2 penalty P2 from sgm equation
- *  \param direction array of struct containing coordinates of previous point
- *  \param buff6 buffer containing previous aggregated cost (previous line)
- *  \param buff_disp_6 buffer containing previous aggregated point
- *  \param min_disp6 value of minimum cost at the previous pixel
- *  \param pixel_6 value of previous disp on the buffer
- *  \param current_class current class
- *  \param buff_class6 buffer containing previous class (previous point
- *  \param reset6 value of coefficient to multiply history
- *  \return cost aggregated point
+ *  \param invalid_value value representing invalid cost
+ *  \param reset value of coefficient to multiply history
+ *  \param previous_min minimum aggregated cost of the previous point
+ *  \param simd_kernel SIMD kernel selected for nb_disps, used if the history is not reset, or null
+ *  \return minimum aggregated cost of the point
+ */
+
+template<typename Tin , typename Tacc>
+Tacc aggregatePixel(const Tin * pixel_costs, const Tacc * previous_lr, Tacc * lr, unsigned int nb_disps, Tacc P1,
+    Tacc P2, Tin invalid_value, float reset, Tacc previous_min, AggregatePixelKernel<Tin, Tacc> simd_kernel);
+
+/*!
+ *  \brief  Compute aggregated cost of one point over its disparity interval
+ *   The recurrence runs over the interval of the point only, each disparity being compared to the costs of the
+ *   previous point in its own interval: a disparity, or its neighbours for P1, out of the previous interval is
+ *   not reached without the P2 jump. Out of its interval, the aggregated costs of the point are invalid.
+ *
+ *  \param pixel_costs costs of the point, nb_disps values
+ *  \param previous_lr aggregated costs of the previous point
+ *  \param lr output aggregated costs of the point, nb_disps values
+ *  \param nb_disps disparity number of cost volume
+ *  \param range first and last disparities of the point, included
+ *  \param previous_range first and last disparities of the previous point, included
+ *  \param P1 penalty P1 from sgm equation
+ *  \param P2 penalty P2 from sgm equation
+ *  \param invalid_value value representing invalid cost
+ *  \param reset value of coefficient to multiply history
+ *  \param previous_min minimum aggregated cost of the previous point, over its interval
+ *  \return minimum aggregated cost of the point over its interval
+ */
+
+template<typename Tin , typename Tacc>
+Tacc aggregatePixelRange(const Tin * pixel_costs, const Tacc * previous_lr, Tacc * lr, unsigned int nb_disps,
+    std::pair<int, int> range, std::pair<int, int> previous_range, Tacc P1, Tacc P2, Tin invalid_value, float reset,
+    Tacc previous_min);
+
+/*!
+ *  \brief  Interval of disparities of a point, clamped to the disparity axis
+ *
+ *  \param inputs inputs of the aggregation, the interval is the whole axis without disparity grids
+ *  \param row row of the point
+ *  \param col column of the point
+ *  \param nb_disps disparity number of cost volume
+ *  \return first and last disparities of the point, included: the first is above the last for an empty interval
  */
 
 template<typename T>
-T aggregatedCostFromBottomRight6(T pixelCost, int row, int col, int disp, T invalid_value,
-    int nb_rows, int nb_cols, int nb_disps, T P1, T P2, Direction direction,
-    T * buff6, T * buff_disp_6, T * min_disp6, T * pixel_6, float current_class, float * buff_class6, float & reset6, bool edge_classification);
+std::pair<int, int> disparityRange(const SgmInputs<T> & inputs, long long row, long long col, unsigned int nb_disps);
 
 /*!
- *  \brief  Compute aggregated cost volume
- *   Compute aggregated cost at one point
- *   diagonaly from lower right
+ *  \brief  Compute the offsets of a ragged cost volume, from the lengths of the disparity intervals
+ *   The interval of a point is clamped to the disparity axis, as in the aggregation.
  *
- *  \param pixelCost cost value 
+ *  \param disp_min first disparity index of each point
+ *  \param disp_max last disparity index of each point, included
+ *  \param nb_rows row number of the grids
+ *  \param nb_cols column number of the grids
+ *  \param nb_disps disparity number of the dense cost volume
+ *  \param offsets output offsets, nb_rows x nb_cols + 1 values: the costs of the point p are
+ *         [offsets[p], offsets[p + 1])
+ *  \return number of packed costs, offsets[nb_rows x nb_cols]
+ */
+
+int64_t raggedOffsets(const StridedArray<int32_t> & disp_min, const StridedArray<int32_t> & disp_max,
+    unsigned long int nb_rows, unsigned long int nb_cols, unsigned int nb_disps, int64_t * offsets);
+
+/*!
+ *  \brief  Pack the costs of the disparity intervals of a dense cost volume
+ *
+ *  \param cv_in dense cost volume
+ *  \param disp_min first disparity index of each point
+ *  \param disp_max last disparity index of each point, included
+ *  \param offsets offsets of the ragged volume, from raggedOffsets()
+ *  \param nb_rows row number of the cost volume
+ *  \param nb_cols column number of the cost volume
+ *  \param nb_disps disparity number of the cost volume
+ *  \param costs output packed costs, offsets[nb_rows x nb_cols] values
+ *  \param num_threads number of threads
+ */
+template<typename T>
+void toRagged(const StridedArray<T> & cv_in, const StridedArray<int32_t> & disp_min,
+    const StridedArray<int32_t> & disp_max, const int64_t * offsets, unsigned long int nb_rows,
+    unsigned long int nb_cols, unsigned int nb_disps, T * costs, int num_threads);
+
+/*!
+ *  \brief  Unpack a ragged cost volume in a dense one, the costs out of the intervals being invalid
+ *
+ *  \param costs packed costs
+ *  \param disp_min first disparity index of each point
+ *  \param disp_max last disparity index of each point, included
+ *  \param offsets offsets of the ragged volume, from raggedOffsets()
+ *  \param nb_rows row number of the cost volume
+ *  \param nb_cols column number of the cost volume
+ *  \param nb_disps disparity number of the dense cost volume
+ *  \param invalid_value value of the costs out of the intervals
+ *  \param cv_out output C-contiguous dense cost volume, nb_rows x nb_cols x nb_disps values
+ *  \param num_threads number of threads
+ */
+template<typename T>
+void toDense(const T * costs, const StridedArray<int32_t> & disp_min, const StridedArray<int32_t> & disp_max,
+    const int64_t * offsets, unsigned long int nb_rows, unsigned long int nb_cols, unsigned int nb_disps,
+    T invalid_value, T * cv_out, int num_threads);
+
+/*!
+ *  \brief  Check that the offsets of a ragged cost volume follow the lengths of the disparity intervals
+ *
+ *  \param inputs inputs of the aggregation, with the offsets and the disparity grids
+ *  \param nb_rows row number of the cost volume
+ *  \param nb_cols column number of the cost volume
+ *  \param nb_disps disparity number of the dense cost volume
+ *  \param num_threads number of threads
+ */
+template<typename T>
+void checkRaggedVolume(const SgmInputs<T> & inputs, unsigned long int nb_rows, unsigned long int nb_cols,
+    unsigned int nb_disps, int num_threads);
+
+/*!
+ *  \brief  Gather the costs of a point of a ragged cost volume over all disparities
+ *
+ *  \param inputs inputs of the aggregation, with the offsets and the disparity grids
+ *  \param row row of the point
+ *  \param col column of the point
+ *  \param nb_cols column number of the cost volume
+ *  \param nb_disps disparity number of the dense cost volume
+ *  \param invalid_value value of the costs out of the interval
+ *  \param buffer output costs, nb_disps values
+ *  \return buffer
+ */
+template<typename T>
+const T * raggedCosts(const SgmInputs<T> & inputs, long long row, long long col, unsigned long int nb_cols,
+    unsigned int nb_disps, T invalid_value, T * buffer);
+
+/*!
+ *  \brief  Test whether a cost is invalid: equal to the invalid value, or NaN for a NaN invalid value
+ *
+ *  \param cost cost of one point at one disparity
+ *  \param invalid_value value representing invalid cost
+ *  \return true if the cost is invalid
+ */
+template<typename T>
+bool isInvalidCost(T cost, T invalid_value);
+
+/*!
+ *  \brief  Select the kernels of the aggregation of nb_disps disparities
+ *   SIMD kernels compare the costs to the invalid value, which a NaN never equals: a NaN invalid value is only
+ *   tested by the scalar path.
+ *
+ *  \param nb_disps disparity number of cost volume
+ *  \param invalid_value value representing invalid cost
+ *  \return SIMD kernels, null for the scalar path
+ */
+
+template<typename Tin , typename Tacc>
+SimdKernels<Tin, Tacc> aggregationKernels(unsigned int nb_disps, Tin invalid_value);
+
+/*!
+ *  \brief  Position of the minimum aggregated cost of a point, as found by update_minimum
+ *   The last disparity is taken in case of tie.
+ *
+ *  \param lr aggregated costs of the point
+ *  \param nb_disps disparity number of cost volume
+ *  \param min_lr minimum aggregated cost of the point
+ *  \param last_index SIMD search selected for nb_disps, or null
+ *  \return disparity of the minimum
+ */
+
+template<typename T>
+int lastMinimumPosition(const T * lr, unsigned int nb_disps, T min_lr, LastIndexKernel<T> last_index);
+
+/*!
+ *  \brief  Disparity of the lowest valid aggregated cost of a point, the lowest one for a tie
+ *
+ *  \param costs aggregated costs of the interval, costs[0] being the cost of first_disp
+ *  \param pixel_costs costs of the point along the disparity axis, to find the invalid ones
+ *  \param first_disp first disparity of the interval
+ *  \param last_disp last disparity of the interval, included
+ *  \param invalid_value value representing invalid cost
+ *  \return disparity, -1 without valid cost
+ */
+
+template<typename Tin , typename Tout>
+int bestDisparity(const Tout * costs, const Tin * pixel_costs, int first_disp, int last_disp, Tin invalid_value);
+
+/*!
+ *  \brief  Disparity of the lowest aggregated cost of a point, with its sub-pixel offset
+ *   The disparities of invalid costs are not selected. The offset is only computed if both neighbours of the
+ *   minimum are valid costs of the interval.
+ *
+ *  \param costs aggregated costs of the interval, costs[0] being the cost of first_disp
+ *  \param pixel_costs costs of the point along the disparity axis, to find the invalid ones
+ *  \param first_disp first disparity of the interval
+ *  \param last_disp last disparity of the interval, included
+ *  \param invalid_value value representing invalid cost
+ *  \param mode WTA or sub-pixel refinement
+ *  \return disparity, NaN without valid cost
+ */
+
+template<typename Tin , typename Tout>
+float pointDisparity(const Tout * costs, const Tin * pixel_costs, int first_disp, int last_disp, Tin invalid_value,
+    DisparityMode mode);
+
+/*!
+ *  \brief  Confidence measures of the aggregated costs of a point
+ *   Ambiguity and risks are averaged over the cost differences eta = 0, eta_step, ... up to eta_max: the disparities
+ *   of valid cost up to the lowest cost + eta are counted (ambiguity), and their amplitude is measured (risk_max),
+ *   as the one of the disparities connected to the lowest cost (risk_min).
+ *
+ *  \param costs aggregated costs of the interval, costs[0] being the cost of first_disp
+ *  \param pixel_costs costs of the point along the disparity axis, to find the invalid ones
+ *  \param first_disp first disparity of the interval
+ *  \param last_disp last disparity of the interval, included
+ *  \param invalid_value value representing invalid cost
+ *  \param options measures to compute
+ *  \param path_minimums positions of the minimum of the 8 directions, read for the path agreement
+ *  \param maps output confidence maps
+ *  \param pixel index of the point in the maps
+ */
+
+template<typename Tin , typename Tout>
+void pointConfidence(const Tout * costs, const Tin * pixel_costs, int first_disp, int last_disp, Tin invalid_value,
+    const ConfidenceOptions & options, const int * path_minimums, ConfidenceMaps & maps, unsigned long int pixel);
+
+/*!
+ *  \brief  Disparity and confidence maps of an aggregated cost volume, for the concurrent tasks whose last one is
+ *   not known
+ *
+ *  \param inputs cost volume and disparity grids
+ *  \param nb_rows row number of cost volume
+ *  \param nb_cols column number of cost volume
+ *  \param nb_disps disparity number of cost volume
+ *  \param invalid_value value representing invalid cost
+ *  \param mode WTA or sub-pixel refinement, DISPARITY_NONE without disparity map
+ *  \param confidence confidence measures to compute
+ *  \param cvs C-contiguous aggregated cost volume, positions of the minimum of each direction, and output maps
+ *  \param num_threads number of threads
+ */
+
+template<typename Tin , typename Tout>
+void disparityMap(const SgmInputs<Tin> & inputs, unsigned long int nb_rows, unsigned long int nb_cols,
+    unsigned int nb_disps, Tin invalid_value, DisparityMode mode, const ConfidenceOptions & confidence,
+    CostVolumes<Tout> & cvs, int num_threads);
+
+/*!
+ *  \brief  Compute the coefficient to multiply history
+ *
+ *  \param current_class class of the current point
+ *  \param previous_class class of the previous point
+ *  \param edge_classification use segmentation as an edge classification
+ *  \return 0 if history must be reset, 1 if not
+ */
+template<typename Tseg>
+float computeReset(Tseg current_class, Tseg previous_class, bool edge_classification);
+
+/*!
+ *  \brief  Check that directions follow the scan order of their pass
+ *   Throw std::invalid_argument if the previous point of a direction is not aggregated before
+ *   the current point in the scan order of its pass
+ *
+ *  \param direction array of struct containing coordinates of previous point, for the 8 directions
+ */
+
+void checkPassDirections(const Direction * direction);
+
+/*!
+ *  \brief  Get the number of threads to use
+ *
+ *  \param num_threads requested number of threads, 0 or less for all available threads
+ *  \return number of threads, 1 if libSGM is built without OpenMP
+ */
+
+int getNumThreads(int num_threads);
+
+/*!
+ *  Update minimum
+ *
+ *  \param current_min current minimum
+ *  \param value potential new minimum
+ *  \param current_disp current disparity
+ *  \param disp potential disparity
+ *  \return new minimum, new disparity
+ */
+
+std::pair<float, int> update_minimum(float current_min, float value, int current_disp, int disp);
+
+/*!
+ *  \brief  Compute aggregated cost of one point along the direction (DROW, DCOL), for all disparities
+ *   The border test and the history reset are computed once for the point, then the whole
+ *   disparity vector is aggregated from the previous point.
+ *
+ *  \tparam DROW row coordinate of the direction: the previous point is on row - DROW
+ *  \tparam DCOL col coordinate of the direction: the previous point is on col - DCOL
+ *  \tparam RESET history reset, the reset masks are only read if the history can be reset
+ *  \tparam PENALTIES penalty mode, constant penalties are read without the position of the point
+ *  \tparam ADAPTIVE_P2 P2 divided by the intensity gradient of the guide image from the previous point, at least P1
+ *  \param pixel_costs contiguous costs of the point
+ *  \param inputs penalties, segmentation map, guide image and reset masks
  *  \param row row position
  *  \param col col position
- *  \param disp disp position
- * \param invalid_value value representing invalid cost
  *  \param nb_rows row number of cost volume
  *  \param nb_cols column number of cost volume
  *  \param nb_disps disparity number of cost volume
- *  \param P1 penalty P1 from sgm equation
- *  \param P2 penalty P2 from sgm equation
- *  \param direction array of struct containing coordinates of previous point
- *  \param buff7 buffer containing previous aggregated cost (previous line)
- *  \param min_disp7 value of minimum cost at the previous pixel
- *  \param current_class current class
- *  \param buff_class7 buffer containing previous class (previous point
- *  \param reset7 value of coefficient to multiply history
- *  \return cost aggregated point
+ *  \param invalid_value value representing invalid cost
+ *  \param dir index of the direction, in [0, 8)
+ *  \param simd SIMD kernels selected once for nb_disps
+ *  \param lines two lines of aggregated costs of the direction and their minimum: the previous point is read
+ *   and the point is written in them
+ *  \param min_lr output minimum aggregated cost of the point
+ *  \return aggregated costs of the point, nb_disps values in lines
  */
 
-template<typename T>
-T aggregatedCostFromBottomRight7(T pixelCost, int row, int col, int disp, T invalid_value,
-    int nb_rows, int nb_cols, int nb_disps, T P1, T P2, Direction direction,T * buff7, T * min_disp7,
-    float current_class, float * buff_class7, float & reset7, bool edge_classification);
+template<int DROW, int DCOL, ResetMode RESET, PenaltyMode PENALTIES, bool ADAPTIVE_P2, typename Tin, typename Tacc>
+Tacc * aggregatedCostFrom(const Tin * pixel_costs, const SgmInputs<Tin> & inputs, long long row, long long col, long long nb_rows, long long nb_cols, unsigned int nb_disps, Tin invalid_value,
+    int dir, const SimdKernels<Tin, Tacc> & simd, const LineBuffers<Tacc> & lines, Tacc & min_lr);
+
+/**
+* Signature of the aggregation of one point along a direction, costs of type Tin being aggregated in type Tacc
+*/
+template<typename Tin, typename Tacc = Tin>
+using DirectionKernel = Tacc * (*)(const Tin *, const SgmInputs<Tin> &, long long, long long, long long, long long,
+    unsigned int, Tin, int, const SimdKernels<Tin, Tacc> &, const LineBuffers<Tacc> &, Tacc &);
+
+/*!
+ *  \brief  Get the aggregation of one point along a direction
+ *
+ *  \param direction coordinates of previous point, each one in {-1, 0, 1}
+ *  \param reset history reset
+ *  \param penalties penalty mode
+ *  \param adaptive_p2 P2 adapted to the intensity gradient of the guide image
+ *  \return aggregatedCostFrom instantiated for the direction, the reset mode and the penalty modes
+ */
+
+template<typename Tin, typename Tacc = Tin>
+DirectionKernel<Tin, Tacc> directionKernel(Direction direction, ResetMode reset, PenaltyMode penalties = PENALTIES_MAP,
+    bool adaptive_p2 = false);
+
+/*!
+ *  \brief  Check that directions are steps to a neighbouring point
+ *   Throw std::invalid_argument if a coordinate is not in {-1, 0, 1} or if the step is null
+ *
+ *  \param direction array of struct containing coordinates of previous point, for the 8 directions
+ */
+
+void checkDirections(const Direction * direction);
+
+/*!
+ *  \brief  Check that the segmentation labels index the penalty tables
+ *   Throw std::invalid_argument if there is no segmentation map, or if a label is not an integer in [0, nb_classes)
+ *
+ *  \param segmentation segmentation map, labels of the classes
+ *  \param nb_rows row number of the segmentation map
+ *  \param nb_cols column number of the segmentation map
+ *  \param nb_classes number of classes of the penalty tables
+ *  \param num_threads number of threads
+ */
+
+void checkPenaltyClasses(const StridedArray<float> & segmentation, unsigned long int nb_rows,
+    unsigned long int nb_cols, unsigned int nb_classes, int num_threads);
 
 /*!
  *  \brief  Apply penalties
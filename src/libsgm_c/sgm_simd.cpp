@@ -0,0 +1,1034 @@
+/*
+ * Copyright (c) 2026 Centre National d'Etudes Spatiales (CNES).
+ *
+ * This file is part of LIBSGM
+ *
+ *     https://github.com/CNES/Pandora_libsgm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include "sgm_simd.hpp"
+
+#ifdef LIBSGM_X86_SIMD
+// Undefined vectors of the AVX-512 intrinsics are reported as uninitialized by some GCC versions
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include <immintrin.h>
+#endif
+
+SimdLevel detectSimdLevel()
+{
+#ifdef LIBSGM_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl"))
+  {
+    return SIMD_AVX512;
+  }
+  if (__builtin_cpu_supports("avx2"))
+  {
+    return SIMD_AVX2;
+  }
+  if (__builtin_cpu_supports("sse4.1"))
+  {
+    return SIMD_SSE41;
+  }
+#endif
+  return SIMD_SCALAR;
+}
+
+bool isSimdLevelSupported(SimdLevel level)
+{
+  static const SimdLevel best_level = detectSimdLevel();
+  return level <= best_level;
+}
+
+SimdLevel parseSimdLevel(const std::string &name)
+{
+  if (name == "scalar")
+  {
+    return SIMD_SCALAR;
+  }
+  if (name == "sse4.1")
+  {
+    return SIMD_SSE41;
+  }
+  if (name == "avx2")
+  {
+    return SIMD_AVX2;
+  }
+  if (name == "avx512")
+  {
+    return SIMD_AVX512;
+  }
+  throw std::invalid_argument("unknown instruction set " + name + ", expected scalar, sse4.1, avx2 or avx512");
+}
+
+std::string simdLevelName(SimdLevel level)
+{
+  switch (level)
+  {
+  case SIMD_SSE41:
+    return "sse4.1";
+  case SIMD_AVX2:
+    return "avx2";
+  case SIMD_AVX512:
+    return "avx512";
+  default:
+    return "scalar";
+  }
+}
+
+#ifdef LIBSGM_X86_SIMD
+
+#define LIBSGM_SSE41 __attribute__((target("sse4.1")))
+#define LIBSGM_AVX2 __attribute__((target("avx2")))
+#define LIBSGM_AVX512 __attribute__((target("avx512f,avx512bw,avx512vl")))
+
+// Loops over the disparities are unrolled, completely for the specialised kernels of small ranges
+#if defined(__clang__)
+#define LIBSGM_UNROLL _Pragma("unroll 16")
+#elif defined(__GNUC__) && __GNUC__ >= 8
+#define LIBSGM_UNROLL _Pragma("GCC unroll 16")
+#else
+#define LIBSGM_UNROLL
+#endif
+
+namespace
+{
+
+// Lane i receives a[i-1], lane 0 receives the maximum value
+LIBSGM_SSE41 inline __m128i shiftUpMaxEpu8(__m128i a)
+{
+  return _mm_alignr_epi8(a, _mm_set1_epi8(-1), 15);
+}
+
+// Lane i receives a[i+1], last lane receives the maximum value
+LIBSGM_SSE41 inline __m128i shiftDownMaxEpu8(__m128i a)
+{
+  return _mm_alignr_epi8(_mm_set1_epi8(-1), a, 1);
+}
+
+LIBSGM_SSE41 inline uint8_t horizontalMinEpu8(__m128i a)
+{
+  // Minimum of byte pairs in the low byte of each 16 bits word
+  a = _mm_min_epu8(a, _mm_srli_epi16(a, 8));
+  a = _mm_and_si128(a, _mm_set1_epi16(0x00FF));
+  return static_cast<uint8_t>(_mm_cvtsi128_si32(_mm_minpos_epu16(a)));
+}
+
+LIBSGM_SSE41 inline __m128i shiftUpMaxEpu16(__m128i a)
+{
+  return _mm_alignr_epi8(a, _mm_set1_epi16(-1), 14);
+}
+
+LIBSGM_SSE41 inline __m128i shiftDownMaxEpu16(__m128i a)
+{
+  return _mm_alignr_epi8(_mm_set1_epi16(-1), a, 2);
+}
+
+LIBSGM_SSE41 inline uint16_t horizontalMinEpu16(__m128i a)
+{
+  return static_cast<uint16_t>(_mm_cvtsi128_si32(_mm_minpos_epu16(a)));
+}
+
+LIBSGM_SSE41 inline __m128 shiftUpMaxPs(__m128 a)
+{
+  const __m128i max = _mm_castps_si128(_mm_set1_ps(std::numeric_limits<float>::max()));
+  return _mm_castsi128_ps(_mm_alignr_epi8(_mm_castps_si128(a), max, 12));
+}
+
+LIBSGM_SSE41 inline __m128 shiftDownMaxPs(__m128 a)
+{
+  const __m128i max = _mm_castps_si128(_mm_set1_ps(std::numeric_limits<float>::max()));
+  return _mm_castsi128_ps(_mm_alignr_epi8(max, _mm_castps_si128(a), 4));
+}
+
+LIBSGM_SSE41 inline float horizontalMinPs(__m128 a)
+{
+  a = _mm_min_ps(a, _mm_movehl_ps(a, a));
+  a = _mm_min_ps(a, _mm_shuffle_ps(a, a, 0x1));
+  return _mm_cvtss_f32(a);
+}
+
+LIBSGM_AVX2 inline __m256i shiftUpMaxEpu8(__m256i a)
+{
+  const __m256i low_to_high = _mm256_permute2x128_si256(a, a, 0x08);
+  const __m256i first = _mm256_setr_epi8(-1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                         0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  return _mm256_or_si256(_mm256_alignr_epi8(a, low_to_high, 15), first);
+}
+
+LIBSGM_AVX2 inline __m256i shiftDownMaxEpu8(__m256i a)
+{
+  const __m256i high_to_low = _mm256_permute2x128_si256(a, a, 0x81);
+  const __m256i last = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, -1);
+  return _mm256_or_si256(_mm256_alignr_epi8(high_to_low, a, 1), last);
+}
+
+LIBSGM_AVX2 inline __m256i shiftUpMaxEpu16(__m256i a)
+{
+  const __m256i low_to_high = _mm256_permute2x128_si256(a, a, 0x08);
+  const __m256i first = _mm256_setr_epi16(-1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  return _mm256_or_si256(_mm256_alignr_epi8(a, low_to_high, 14), first);
+}
+
+LIBSGM_AVX2 inline __m256i shiftDownMaxEpu16(__m256i a)
+{
+  const __m256i high_to_low = _mm256_permute2x128_si256(a, a, 0x81);
+  const __m256i last = _mm256_setr_epi16(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, -1);
+  return _mm256_or_si256(_mm256_alignr_epi8(high_to_low, a, 2), last);
+}
+
+LIBSGM_AVX2 inline uint16_t horizontalMinEpu16(__m256i a)
+{
+  return horizontalMinEpu16(_mm_min_epu16(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1)));
+}
+
+LIBSGM_AVX2 inline uint8_t horizontalMinEpu8(__m256i a)
+{
+  return horizontalMinEpu8(_mm_min_epu8(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1)));
+}
+
+LIBSGM_AVX512 inline uint8_t horizontalMinEpu8(__m512i a)
+{
+  // Minimum of the four 128 bits lanes in each lane
+  a = _mm512_min_epu8(a, _mm512_shuffle_i64x2(a, a, 0x4E));
+  a = _mm512_min_epu8(a, _mm512_shuffle_i64x2(a, a, 0xB1));
+  return horizontalMinEpu8(_mm512_castsi512_si128(a));
+}
+
+LIBSGM_AVX512 inline uint16_t horizontalMinEpu16(__m512i a)
+{
+  a = _mm512_min_epu16(a, _mm512_shuffle_i64x2(a, a, 0x4E));
+  a = _mm512_min_epu16(a, _mm512_shuffle_i64x2(a, a, 0xB1));
+  return horizontalMinEpu16(_mm512_castsi512_si128(a));
+}
+
+LIBSGM_AVX2 inline __m256 shiftUpMaxPs(__m256 a)
+{
+  const __m256 shifted = _mm256_permutevar8x32_ps(a, _mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6));
+  return _mm256_blend_ps(shifted, _mm256_set1_ps(std::numeric_limits<float>::max()), 0x01);
+}
+
+LIBSGM_AVX2 inline __m256 shiftDownMaxPs(__m256 a)
+{
+  const __m256 shifted = _mm256_permutevar8x32_ps(a, _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 7));
+  return _mm256_blend_ps(shifted, _mm256_set1_ps(std::numeric_limits<float>::max()), 0x80);
+}
+
+LIBSGM_AVX2 inline float horizontalMinPs(__m256 a)
+{
+  return horizontalMinPs(_mm_min_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1)));
+}
+
+/*
+ * Blocks of disparities for each instruction set: the aggregated costs of the block starting at disp,
+ * previous costs at disparity-1 and disparity+1 being the maximum outside of the disparity range
+ */
+
+LIBSGM_SSE41 inline __m128i aggregateBlock(const uint8_t *pixel_costs, const uint8_t *previous_lr, unsigned int disp,
+                                           unsigned int nb_disps, __m128i min_disp, __m128i p1, __m128i p2_min,
+                                           __m128i invalid)
+{
+  const __m128i costs = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixel_costs + disp));
+  const __m128i previous = _mm_loadu_si128(reinterpret_cast<const __m128i *>(previous_lr + disp));
+  const __m128i previous_low = (disp > 0) ? _mm_loadu_si128(reinterpret_cast<const __m128i *>(previous_lr + disp - 1))
+                                          : shiftUpMaxEpu8(previous);
+  const __m128i previous_high = (disp + 16 < nb_disps)
+                                  ? _mm_loadu_si128(reinterpret_cast<const __m128i *>(previous_lr + disp + 1))
+                                  : shiftDownMaxEpu8(previous);
+
+  __m128i path_min = _mm_min_epu8(previous, p2_min);
+  path_min = _mm_min_epu8(path_min, _mm_adds_epu8(previous_low, p1));
+  path_min = _mm_min_epu8(path_min, _mm_adds_epu8(previous_high, p1));
+  const __m128i cost_aggr = _mm_adds_epu8(costs, _mm_subs_epu8(path_min, min_disp));
+  // Invalid costs are kept
+  return _mm_blendv_epi8(cost_aggr, costs, _mm_cmpeq_epi8(costs, invalid));
+}
+
+// uint8 costs aggregated in uint16 lanes: 8 costs are loaded and widened
+LIBSGM_SSE41 inline __m128i aggregateBlock(const uint8_t *pixel_costs, const uint16_t *previous_lr, unsigned int disp,
+                                           unsigned int nb_disps, __m128i min_disp, __m128i p1, __m128i p2_min,
+                                           __m128i invalid)
+{
+  const __m128i costs = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(pixel_costs + disp)));
+  const __m128i previous = _mm_loadu_si128(reinterpret_cast<const __m128i *>(previous_lr + disp));
+  const __m128i previous_low = (disp > 0) ? _mm_loadu_si128(reinterpret_cast<const __m128i *>(previous_lr + disp - 1))
+                                          : shiftUpMaxEpu16(previous);
+  const __m128i previous_high = (disp + 8 < nb_disps)
+                                  ? _mm_loadu_si128(reinterpret_cast<const __m128i *>(previous_lr + disp + 1))
+                                  : shiftDownMaxEpu16(previous);
+
+  __m128i path_min = _mm_min_epu16(previous, p2_min);
+  path_min = _mm_min_epu16(path_min, _mm_adds_epu16(previous_low, p1));
+  path_min = _mm_min_epu16(path_min, _mm_adds_epu16(previous_high, p1));
+  const __m128i cost_aggr = _mm_adds_epu16(costs, _mm_subs_epu16(path_min, min_disp));
+  return _mm_blendv_epi8(cost_aggr, costs, _mm_cmpeq_epi16(costs, invalid));
+}
+
+LIBSGM_SSE41 inline __m128 aggregateBlock(const float *pixel_costs, const float *previous_lr, unsigned int disp,
+                                          unsigned int nb_disps, __m128 min_disp, __m128 p1, __m128 p2_min,
+                                          __m128 invalid)
+{
+  const __m128 costs = _mm_loadu_ps(pixel_costs + disp);
+  const __m128 previous = _mm_loadu_ps(previous_lr + disp);
+  const __m128 previous_low = (disp > 0) ? _mm_loadu_ps(previous_lr + disp - 1) : shiftUpMaxPs(previous);
+  const __m128 previous_high = (disp + 4 < nb_disps) ? _mm_loadu_ps(previous_lr + disp + 1) : shiftDownMaxPs(previous);
+
+  __m128 path_min = _mm_min_ps(previous, p2_min);
+  path_min = _mm_min_ps(path_min, _mm_add_ps(previous_low, p1));
+  path_min = _mm_min_ps(path_min, _mm_add_ps(previous_high, p1));
+  const __m128 cost_aggr = _mm_add_ps(costs, _mm_sub_ps(path_min, min_disp));
+  return _mm_blendv_ps(cost_aggr, costs, _mm_cmpeq_ps(costs, invalid));
+}
+
+LIBSGM_AVX2 inline __m256i aggregateBlock(const uint8_t *pixel_costs, const uint8_t *previous_lr, unsigned int disp,
+                                          unsigned int nb_disps, __m256i min_disp, __m256i p1, __m256i p2_min,
+                                          __m256i invalid)
+{
+  const __m256i costs = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pixel_costs + disp));
+  const __m256i previous = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(previous_lr + disp));
+  const __m256i previous_low = (disp > 0)
+                                 ? _mm256_loadu_si256(reinterpret_cast<const __m256i *>(previous_lr + disp - 1))
+                                 : shiftUpMaxEpu8(previous);
+  const __m256i previous_high = (disp + 32 < nb_disps)
+                                  ? _mm256_loadu_si256(reinterpret_cast<const __m256i *>(previous_lr + disp + 1))
+                                  : shiftDownMaxEpu8(previous);
+
+  __m256i path_min = _mm256_min_epu8(previous, p2_min);
+  path_min = _mm256_min_epu8(path_min, _mm256_adds_epu8(previous_low, p1));
+  path_min = _mm256_min_epu8(path_min, _mm256_adds_epu8(previous_high, p1));
+  const __m256i cost_aggr = _mm256_adds_epu8(costs, _mm256_subs_epu8(path_min, min_disp));
+  return _mm256_blendv_epi8(cost_aggr, costs, _mm256_cmpeq_epi8(costs, invalid));
+}
+
+LIBSGM_AVX2 inline __m256i aggregateBlock(const uint8_t *pixel_costs, const uint16_t *previous_lr, unsigned int disp,
+                                          unsigned int nb_disps, __m256i min_disp, __m256i p1, __m256i p2_min,
+                                          __m256i invalid)
+{
+  const __m256i costs = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pixel_costs + disp)));
+  const __m256i previous = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(previous_lr + disp));
+  const __m256i previous_low = (disp > 0)
+                                 ? _mm256_loadu_si256(reinterpret_cast<const __m256i *>(previous_lr + disp - 1))
+                                 : shiftUpMaxEpu16(previous);
+  const __m256i previous_high = (disp + 16 < nb_disps)
+                                  ? _mm256_loadu_si256(reinterpret_cast<const __m256i *>(previous_lr + disp + 1))
+                                  : shiftDownMaxEpu16(previous);
+
+  __m256i path_min = _mm256_min_epu16(previous, p2_min);
+  path_min = _mm256_min_epu16(path_min, _mm256_adds_epu16(previous_low, p1));
+  path_min = _mm256_min_epu16(path_min, _mm256_adds_epu16(previous_high, p1));
+  const __m256i cost_aggr = _mm256_adds_epu16(costs, _mm256_subs_epu16(path_min, min_disp));
+  return _mm256_blendv_epi8(cost_aggr, costs, _mm256_cmpeq_epi16(costs, invalid));
+}
+
+LIBSGM_AVX2 inline __m256 aggregateBlock(const float *pixel_costs, const float *previous_lr, unsigned int disp,
+                                         unsigned int nb_disps, __m256 min_disp, __m256 p1, __m256 p2_min,
+                                         __m256 invalid)
+{
+  const __m256 costs = _mm256_loadu_ps(pixel_costs + disp);
+  const __m256 previous = _mm256_loadu_ps(previous_lr + disp);
+  const __m256 previous_low = (disp > 0) ? _mm256_loadu_ps(previous_lr + disp - 1) : shiftUpMaxPs(previous);
+  const __m256 previous_high = (disp + 8 < nb_disps) ? _mm256_loadu_ps(previous_lr + disp + 1)
+                                                     : shiftDownMaxPs(previous);
+
+  __m256 path_min = _mm256_min_ps(previous, p2_min);
+  path_min = _mm256_min_ps(path_min, _mm256_add_ps(previous_low, p1));
+  path_min = _mm256_min_ps(path_min, _mm256_add_ps(previous_high, p1));
+  const __m256 cost_aggr = _mm256_add_ps(costs, _mm256_sub_ps(path_min, min_disp));
+  return _mm256_blendv_ps(cost_aggr, costs, _mm256_cmp_ps(costs, invalid, _CMP_EQ_OQ));
+}
+
+// Mask of the disparities of a block starting at disp lower than end
+inline uint64_t laneMask64(unsigned int disp, unsigned int end)
+{
+  return (end >= disp + 64) ? ~uint64_t(0) : (end > disp) ? (uint64_t(1) << (end - disp)) - 1 : 0;
+}
+
+/*
+ * Aggregation of all disparities of a point for each instruction set, D being the number of disparities
+ * of a specialised kernel or 0 for the generic one
+ */
+
+template <unsigned int D>
+LIBSGM_SSE41 inline uint8_t aggregateDisparitiesSse41(const uint8_t *pixel_costs, const uint8_t *previous_lr,
+                                                      uint8_t *lr, unsigned int disparities, uint8_t P1, uint8_t P2,
+                                                      uint8_t invalid_value, uint8_t previous_min)
+{
+  // Number of disparities, a constant for the specialised kernels
+  const unsigned int nb_disps = (D != 0) ? D : disparities;
+  // Last block overlaps the previous one when nb_disps is not a multiple of the lanes number
+  const unsigned int last = nb_disps - 16;
+
+  const __m128i min_disp = _mm_set1_epi8(static_cast<char>(previous_min));
+  const __m128i p1 = _mm_set1_epi8(static_cast<char>(P1));
+  const __m128i p2_min = _mm_adds_epu8(min_disp, _mm_set1_epi8(static_cast<char>(P2)));
+  const __m128i invalid = _mm_set1_epi8(static_cast<char>(invalid_value));
+
+  // Last block is computed before any store, so that costs are read before being overwritten
+  const __m128i last_block = aggregateBlock(pixel_costs, previous_lr, last, nb_disps, min_disp, p1, p2_min, invalid);
+  // Running minimum of the aggregated costs
+  __m128i min_vector = last_block;
+  LIBSGM_UNROLL
+  for (unsigned int disp = 0; disp < last; disp += 16)
+  {
+    const __m128i block = aggregateBlock(pixel_costs, previous_lr, disp, nb_disps, min_disp, p1, p2_min, invalid);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lr + disp), block);
+    min_vector = _mm_min_epu8(min_vector, block);
+  }
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(lr + last), last_block);
+  return horizontalMinEpu8(min_vector);
+}
+
+template <unsigned int D>
+LIBSGM_SSE41 inline uint16_t aggregateDisparitiesSse41(const uint8_t *pixel_costs, const uint16_t *previous_lr,
+                                                       uint16_t *lr, unsigned int disparities, uint16_t P1, uint16_t P2,
+                                                       uint8_t invalid_value, uint16_t previous_min)
+{
+  // Number of disparities, a constant for the specialised kernels
+  const unsigned int nb_disps = (D != 0) ? D : disparities;
+  const unsigned int last = nb_disps - 8;
+
+  const __m128i min_disp = _mm_set1_epi16(static_cast<short>(previous_min));
+  const __m128i p1 = _mm_set1_epi16(static_cast<short>(P1));
+  const __m128i p2_min = _mm_adds_epu16(min_disp, _mm_set1_epi16(static_cast<short>(P2)));
+  const __m128i invalid = _mm_set1_epi16(invalid_value);
+
+  const __m128i last_block = aggregateBlock(pixel_costs, previous_lr, last, nb_disps, min_disp, p1, p2_min, invalid);
+  __m128i min_vector = last_block;
+  LIBSGM_UNROLL
+  for (unsigned int disp = 0; disp < last; disp += 8)
+  {
+    const __m128i block = aggregateBlock(pixel_costs, previous_lr, disp, nb_disps, min_disp, p1, p2_min, invalid);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lr + disp), block);
+    min_vector = _mm_min_epu16(min_vector, block);
+  }
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(lr + last), last_block);
+  return horizontalMinEpu16(min_vector);
+}
+
+template <unsigned int D>
+LIBSGM_SSE41 inline float aggregateDisparitiesSse41(const float *pixel_costs, const float *previous_lr, float *lr,
+                                                    unsigned int disparities, float P1, float P2, float invalid_value,
+                                                    float previous_min)
+{
+  // Number of disparities, a constant for the specialised kernels
+  const unsigned int nb_disps = (D != 0) ? D : disparities;
+  const unsigned int last = nb_disps - 4;
+
+  const __m128 min_disp = _mm_set1_ps(previous_min);
+  const __m128 p1 = _mm_set1_ps(P1);
+  const __m128 p2_min = _mm_set1_ps(previous_min + P2);
+  const __m128 invalid = _mm_set1_ps(invalid_value);
+
+  const __m128 last_block = aggregateBlock(pixel_costs, previous_lr, last, nb_disps, min_disp, p1, p2_min, invalid);
+  __m128 min_vector = last_block;
+  LIBSGM_UNROLL
+  for (unsigned int disp = 0; disp < last; disp += 4)
+  {
+    const __m128 block = aggregateBlock(pixel_costs, previous_lr, disp, nb_disps, min_disp, p1, p2_min, invalid);
+    _mm_storeu_ps(lr + disp, block);
+    min_vector = _mm_min_ps(min_vector, block);
+  }
+  _mm_storeu_ps(lr + last, last_block);
+  return horizontalMinPs(min_vector);
+}
+
+template <unsigned int D>
+LIBSGM_AVX2 inline uint8_t aggregateDisparitiesAvx2(const uint8_t *pixel_costs, const uint8_t *previous_lr, uint8_t *lr,
+                                                    unsigned int disparities, uint8_t P1, uint8_t P2,
+                                                    uint8_t invalid_value, uint8_t previous_min)
+{
+  // Number of disparities, a constant for the specialised kernels
+  const unsigned int nb_disps = (D != 0) ? D : disparities;
+  const unsigned int last = nb_disps - 32;
+
+  const __m256i min_disp = _mm256_set1_epi8(static_cast<char>(previous_min));
+  const __m256i p1 = _mm256_set1_epi8(static_cast<char>(P1));
+  const __m256i p2_min = _mm256_adds_epu8(min_disp, _mm256_set1_epi8(static_cast<char>(P2)));
+  const __m256i invalid = _mm256_set1_epi8(static_cast<char>(invalid_value));
+
+  const __m256i last_block = aggregateBlock(pixel_costs, previous_lr, last, nb_disps, min_disp, p1, p2_min, invalid);
+  __m256i min_vector = last_block;
+  LIBSGM_UNROLL
+  for (unsigned int disp = 0; disp < last; disp += 32)
+  {
+    const __m256i block = aggregateBlock(pixel_costs, previous_lr, disp, nb_disps, min_disp, p1, p2_min, invalid);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lr + disp), block);
+    min_vector = _mm256_min_epu8(min_vector, block);
+  }
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(lr + last), last_block);
+  return horizontalMinEpu8(min_vector);
+}
+
+template <unsigned int D>
+LIBSGM_AVX2 inline uint16_t aggregateDisparitiesAvx2(const uint8_t *pixel_costs, const uint16_t *previous_lr,
+                                                     uint16_t *lr, unsigned int disparities, uint16_t P1, uint16_t P2,
+                                                     uint8_t invalid_value, uint16_t previous_min)
+{
+  // Number of disparities, a constant for the specialised kernels
+  const unsigned int nb_disps = (D != 0) ? D : disparities;
+  const unsigned int last = nb_disps - 16;
+
+  const __m256i min_disp = _mm256_set1_epi16(static_cast<short>(previous_min));
+  const __m256i p1 = _mm256_set1_epi16(static_cast<short>(P1));
+  const __m256i p2_min = _mm256_adds_epu16(min_disp, _mm256_set1_epi16(static_cast<short>(P2)));
+  const __m256i invalid = _mm256_set1_epi16(invalid_value);
+
+  const __m256i last_block = aggregateBlock(pixel_costs, previous_lr, last, nb_disps, min_disp, p1, p2_min, invalid);
+  __m256i min_vector = last_block;
+  LIBSGM_UNROLL
+  for (unsigned int disp = 0; disp < last; disp += 16)
+  {
+    const __m256i block = aggregateBlock(pixel_costs, previous_lr, disp, nb_disps, min_disp, p1, p2_min, invalid);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lr + disp), block);
+    min_vector = _mm256_min_epu16(min_vector, block);
+  }
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(lr + last), last_block);
+  return horizontalMinEpu16(min_vector);
+}
+
+template <unsigned int D>
+LIBSGM_AVX2 inline float aggregateDisparitiesAvx2(const float *pixel_costs, const float *previous_lr, float *lr,
+                                                  unsigned int disparities, float P1, float P2, float invalid_value,
+                                                  float previous_min)
+{
+  // Number of disparities, a constant for the specialised kernels
+  const unsigned int nb_disps = (D != 0) ? D : disparities;
+  const unsigned int last = nb_disps - 8;
+
+  const __m256 min_disp = _mm256_set1_ps(previous_min);
+  const __m256 p1 = _mm256_set1_ps(P1);
+  const __m256 p2_min = _mm256_set1_ps(previous_min + P2);
+  const __m256 invalid = _mm256_set1_ps(invalid_value);
+
+  const __m256 last_block = aggregateBlock(pixel_costs, previous_lr, last, nb_disps, min_disp, p1, p2_min, invalid);
+  __m256 min_vector = last_block;
+  LIBSGM_UNROLL
+  for (unsigned int disp = 0; disp < last; disp += 8)
+  {
+    const __m256 block = aggregateBlock(pixel_costs, previous_lr, disp, nb_disps, min_disp, p1, p2_min, invalid);
+    _mm256_storeu_ps(lr + disp, block);
+    min_vector = _mm256_min_ps(min_vector, block);
+  }
+  _mm256_storeu_ps(lr + last, last_block);
+  return horizontalMinPs(min_vector);
+}
+
+template <unsigned int D>
+LIBSGM_AVX512 inline uint8_t aggregateDisparitiesAvx512(const uint8_t *pixel_costs, const uint8_t *previous_lr,
+                                                        uint8_t *lr, unsigned int disparities, uint8_t P1, uint8_t P2,
+                                                        uint8_t invalid_value, uint8_t previous_min)
+{
+  // Number of disparities, a constant for the specialised kernels
+  const unsigned int nb_disps = (D != 0) ? D : disparities;
+  const __m512i max = _mm512_set1_epi8(-1);
+  const __m512i min_disp = _mm512_set1_epi8(static_cast<char>(previous_min));
+  const __m512i p1 = _mm512_set1_epi8(static_cast<char>(P1));
+  const __m512i p2_min = _mm512_adds_epu8(min_disp, _mm512_set1_epi8(static_cast<char>(P2)));
+  const __m512i invalid = _mm512_set1_epi8(static_cast<char>(invalid_value));
+
+  __m512i min_vector = max;
+  LIBSGM_UNROLL
+  for (unsigned int disp = 0; disp < nb_disps; disp += 64)
+  {
+    const __mmask64 mask = laneMask64(disp, nb_disps);
+    // Disparity-1 does not exist for the first lane, disparity+1 for the last one: the maximum is loaded instead,
+    // masked lanes are not read
+    const __mmask64 mask_low = (disp == 0) ? mask & ~__mmask64(1) : mask;
+    const __mmask64 mask_high = laneMask64(disp, nb_disps - 1);
+
+    const __m512i costs = _mm512_maskz_loadu_epi8(mask, pixel_costs + disp);
+    const __m512i previous = _mm512_mask_loadu_epi8(max, mask, previous_lr + disp);
+    const __m512i previous_low = _mm512_mask_loadu_epi8(max, mask_low, previous_lr + disp - 1);
+    const __m512i previous_high = _mm512_mask_loadu_epi8(max, mask_high, previous_lr + disp + 1);
+
+    __m512i path_min = _mm512_min_epu8(previous, p2_min);
+    path_min = _mm512_min_epu8(path_min, _mm512_adds_epu8(previous_low, p1));
+    path_min = _mm512_min_epu8(path_min, _mm512_adds_epu8(previous_high, p1));
+    const __m512i cost_aggr = _mm512_adds_epu8(costs, _mm512_subs_epu8(path_min, min_disp));
+    // Invalid costs are kept
+    const __m512i result = _mm512_mask_blend_epi8(_mm512_cmpeq_epu8_mask(costs, invalid), cost_aggr, costs);
+    _mm512_mask_storeu_epi8(lr + disp, mask, result);
+    min_vector = _mm512_mask_min_epu8(min_vector, mask, min_vector, result);
+  }
+  return horizontalMinEpu8(min_vector);
+}
+
+template <unsigned int D>
+LIBSGM_AVX512 inline uint16_t aggregateDisparitiesAvx512(const uint8_t *pixel_costs, const uint16_t *previous_lr,
+                                                         uint16_t *lr, unsigned int disparities, uint16_t P1,
+                                                         uint16_t P2, uint8_t invalid_value, uint16_t previous_min)
+{
+  // Number of disparities, a constant for the specialised kernels
+  const unsigned int nb_disps = (D != 0) ? D : disparities;
+  const __m512i max = _mm512_set1_epi16(-1);
+  const __m512i min_disp = _mm512_set1_epi16(static_cast<short>(previous_min));
+  const __m512i p1 = _mm512_set1_epi16(static_cast<short>(P1));
+  const __m512i p2_min = _mm512_adds_epu16(min_disp, _mm512_set1_epi16(static_cast<short>(P2)));
+  const __m512i invalid = _mm512_set1_epi16(invalid_value);
+
+  __m512i min_vector = max;
+  LIBSGM_UNROLL
+  for (unsigned int disp = 0; disp < nb_disps; disp += 32)
+  {
+    const __mmask32 mask = static_cast<__mmask32>(laneMask64(disp, nb_disps));
+    const __mmask32 mask_low = (disp == 0) ? mask & ~__mmask32(1) : mask;
+    const __mmask32 mask_high = static_cast<__mmask32>(laneMask64(disp, nb_disps - 1));
+
+    // 32 costs are loaded and widened
+    const __m512i costs = _mm512_cvtepu8_epi16(_mm256_maskz_loadu_epi8(mask, pixel_costs + disp));
+    const __m512i previous = _mm512_mask_loadu_epi16(max, mask, previous_lr + disp);
+    const __m512i previous_low = _mm512_mask_loadu_epi16(max, mask_low, previous_lr + disp - 1);
+    const __m512i previous_high = _mm512_mask_loadu_epi16(max, mask_high, previous_lr + disp + 1);
+
+    __m512i path_min = _mm512_min_epu16(previous, p2_min);
+    path_min = _mm512_min_epu16(path_min, _mm512_adds_epu16(previous_low, p1));
+    path_min = _mm512_min_epu16(path_min, _mm512_adds_epu16(previous_high, p1));
+    const __m512i cost_aggr = _mm512_adds_epu16(costs, _mm512_subs_epu16(path_min, min_disp));
+    const __m512i result = _mm512_mask_blend_epi16(_mm512_cmpeq_epu16_mask(costs, invalid), cost_aggr, costs);
+    _mm512_mask_storeu_epi16(lr + disp, mask, result);
+    min_vector = _mm512_mask_min_epu16(min_vector, mask, min_vector, result);
+  }
+  return horizontalMinEpu16(min_vector);
+}
+
+template <unsigned int D>
+LIBSGM_AVX512 inline float aggregateDisparitiesAvx512(const float *pixel_costs, const float *previous_lr, float *lr,
+                                                      unsigned int disparities, float P1, float P2, float invalid_value,
+                                                      float previous_min)
+{
+  // Number of disparities, a constant for the specialised kernels
+  const unsigned int nb_disps = (D != 0) ? D : disparities;
+  const __m512 max = _mm512_set1_ps(std::numeric_limits<float>::max());
+  const __m512 min_disp = _mm512_set1_ps(previous_min);
+  const __m512 p1 = _mm512_set1_ps(P1);
+  const __m512 p2_min = _mm512_set1_ps(previous_min + P2);
+  const __m512 invalid = _mm512_set1_ps(invalid_value);
+
+  __m512 min_vector = _mm512_set1_ps(std::numeric_limits<float>::infinity());
+  LIBSGM_UNROLL
+  for (unsigned int disp = 0; disp < nb_disps; disp += 16)
+  {
+    const __mmask16 mask = static_cast<__mmask16>(laneMask64(disp, nb_disps));
+    const __mmask16 mask_low = (disp == 0) ? mask & ~__mmask16(1) : mask;
+    const __mmask16 mask_high = static_cast<__mmask16>(laneMask64(disp, nb_disps - 1));
+
+    const __m512 costs = _mm512_maskz_loadu_ps(mask, pixel_costs + disp);
+    const __m512 previous = _mm512_mask_loadu_ps(max, mask, previous_lr + disp);
+    const __m512 previous_low = _mm512_mask_loadu_ps(max, mask_low, previous_lr + disp - 1);
+    const __m512 previous_high = _mm512_mask_loadu_ps(max, mask_high, previous_lr + disp + 1);
+
+    __m512 path_min = _mm512_min_ps(previous, p2_min);
+    path_min = _mm512_min_ps(path_min, _mm512_add_ps(previous_low, p1));
+    path_min = _mm512_min_ps(path_min, _mm512_add_ps(previous_high, p1));
+    const __m512 cost_aggr = _mm512_add_ps(costs, _mm512_sub_ps(path_min, min_disp));
+    const __m512 result = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(costs, invalid, _CMP_EQ_OQ), cost_aggr, costs);
+    _mm512_mask_storeu_ps(lr + disp, mask, result);
+    min_vector = _mm512_mask_min_ps(min_vector, mask, min_vector, result);
+  }
+  return _mm512_reduce_min_ps(min_vector);
+}
+
+} // namespace
+
+LIBSGM_SSE41 uint8_t aggregatePixelSse41(const uint8_t *pixel_costs, const uint8_t *previous_lr, uint8_t *lr,
+                                         unsigned int nb_disps, uint8_t P1, uint8_t P2, uint8_t invalid_value,
+                                         uint8_t previous_min)
+{
+  return aggregateDisparitiesSse41<0>(pixel_costs, previous_lr, lr, nb_disps, P1, P2, invalid_value, previous_min);
+}
+
+LIBSGM_SSE41 uint16_t aggregatePixelSse41(const uint8_t *pixel_costs, const uint16_t *previous_lr, uint16_t *lr,
+                                          unsigned int nb_disps, uint16_t P1, uint16_t P2, uint8_t invalid_value,
+                                          uint16_t previous_min)
+{
+  return aggregateDisparitiesSse41<0>(pixel_costs, previous_lr, lr, nb_disps, P1, P2, invalid_value, previous_min);
+}
+
+LIBSGM_SSE41 float aggregatePixelSse41(const float *pixel_costs, const float *previous_lr, float *lr,
+                                       unsigned int nb_disps, float P1, float P2, float invalid_value,
+                                       float previous_min)
+{
+  return aggregateDisparitiesSse41<0>(pixel_costs, previous_lr, lr, nb_disps, P1, P2, invalid_value, previous_min);
+}
+
+LIBSGM_AVX2 uint8_t aggregatePixelAvx2(const uint8_t *pixel_costs, const uint8_t *previous_lr, uint8_t *lr,
+                                       unsigned int nb_disps, uint8_t P1, uint8_t P2, uint8_t invalid_value,
+                                       uint8_t previous_min)
+{
+  return aggregateDisparitiesAvx2<0>(pixel_costs, previous_lr, lr, nb_disps, P1, P2, invalid_value, previous_min);
+}
+
+LIBSGM_AVX2 uint16_t aggregatePixelAvx2(const uint8_t *pixel_costs, const uint16_t *previous_lr, uint16_t *lr,
+                                        unsigned int nb_disps, uint16_t P1, uint16_t P2, uint8_t invalid_value,
+                                        uint16_t previous_min)
+{
+  return aggregateDisparitiesAvx2<0>(pixel_costs, previous_lr, lr, nb_disps, P1, P2, invalid_value, previous_min);
+}
+
+LIBSGM_AVX2 float aggregatePixelAvx2(const float *pixel_costs, const float *previous_lr, float *lr,
+                                     unsigned int nb_disps, float P1, float P2, float invalid_value, float previous_min)
+{
+  return aggregateDisparitiesAvx2<0>(pixel_costs, previous_lr, lr, nb_disps, P1, P2, invalid_value, previous_min);
+}
+
+LIBSGM_AVX512 uint8_t aggregatePixelAvx512(const uint8_t *pixel_costs, const uint8_t *previous_lr, uint8_t *lr,
+                                           unsigned int nb_disps, uint8_t P1, uint8_t P2, uint8_t invalid_value,
+                                           uint8_t previous_min)
+{
+  return aggregateDisparitiesAvx512<0>(pixel_costs, previous_lr, lr, nb_disps, P1, P2, invalid_value, previous_min);
+}
+
+LIBSGM_AVX512 uint16_t aggregatePixelAvx512(const uint8_t *pixel_costs, const uint16_t *previous_lr, uint16_t *lr,
+                                            unsigned int nb_disps, uint16_t P1, uint16_t P2, uint8_t invalid_value,
+                                            uint16_t previous_min)
+{
+  return aggregateDisparitiesAvx512<0>(pixel_costs, previous_lr, lr, nb_disps, P1, P2, invalid_value, previous_min);
+}
+
+LIBSGM_AVX512 float aggregatePixelAvx512(const float *pixel_costs, const float *previous_lr, float *lr,
+                                         unsigned int nb_disps, float P1, float P2, float invalid_value,
+                                         float previous_min)
+{
+  return aggregateDisparitiesAvx512<0>(pixel_costs, previous_lr, lr, nb_disps, P1, P2, invalid_value, previous_min);
+}
+
+/*
+ * Last position of a value, searched backwards one block at a time: the first block found
+ * holds the last position, given by the highest bit of the comparison mask
+ */
+
+LIBSGM_SSE41 int lastIndexOfSse41(const uint8_t *values, unsigned int nb_values, uint8_t value)
+{
+  const __m128i searched = _mm_set1_epi8(static_cast<char>(value));
+  for (long long start = static_cast<long long>(nb_values) - 16;; start -= 16)
+  {
+    start = std::max(start, 0LL);
+    const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(values + start));
+    const unsigned int found = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, searched)));
+    if (found != 0)
+    {
+      return static_cast<int>(start) + 31 - __builtin_clz(found);
+    }
+    if (start == 0)
+    {
+      return -1;
+    }
+  }
+}
+
+// Two mask bits for each uint16 value
+LIBSGM_SSE41 int lastIndexOfSse41(const uint16_t *values, unsigned int nb_values, uint16_t value)
+{
+  const __m128i searched = _mm_set1_epi16(static_cast<short>(value));
+  for (long long start = static_cast<long long>(nb_values) - 8;; start -= 8)
+  {
+    start = std::max(start, 0LL);
+    const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(values + start));
+    const unsigned int found = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi16(block, searched)));
+    if (found != 0)
+    {
+      return static_cast<int>(start) + (31 - __builtin_clz(found)) / 2;
+    }
+    if (start == 0)
+    {
+      return -1;
+    }
+  }
+}
+
+LIBSGM_SSE41 int lastIndexOfSse41(const float *values, unsigned int nb_values, float value)
+{
+  const __m128 searched = _mm_set1_ps(value);
+  for (long long start = static_cast<long long>(nb_values) - 4;; start -= 4)
+  {
+    start = std::max(start, 0LL);
+    const unsigned int found = static_cast<unsigned int>(_mm_movemask_ps(_mm_cmpeq_ps(_mm_loadu_ps(values + start),
+                                                                                      searched)));
+    if (found != 0)
+    {
+      return static_cast<int>(start) + 31 - __builtin_clz(found);
+    }
+    if (start == 0)
+    {
+      return -1;
+    }
+  }
+}
+
+LIBSGM_AVX2 int lastIndexOfAvx2(const uint8_t *values, unsigned int nb_values, uint8_t value)
+{
+  const __m256i searched = _mm256_set1_epi8(static_cast<char>(value));
+  for (long long start = static_cast<long long>(nb_values) - 32;; start -= 32)
+  {
+    start = std::max(start, 0LL);
+    const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + start));
+    const unsigned int found = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, searched)));
+    if (found != 0)
+    {
+      return static_cast<int>(start) + 31 - __builtin_clz(found);
+    }
+    if (start == 0)
+    {
+      return -1;
+    }
+  }
+}
+
+LIBSGM_AVX2 int lastIndexOfAvx2(const uint16_t *values, unsigned int nb_values, uint16_t value)
+{
+  const __m256i searched = _mm256_set1_epi16(static_cast<short>(value));
+  for (long long start = static_cast<long long>(nb_values) - 16;; start -= 16)
+  {
+    start = std::max(start, 0LL);
+    const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + start));
+    const unsigned int found = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi16(block, searched)));
+    if (found != 0)
+    {
+      return static_cast<int>(start) + (31 - __builtin_clz(found)) / 2;
+    }
+    if (start == 0)
+    {
+      return -1;
+    }
+  }
+}
+
+LIBSGM_AVX2 int lastIndexOfAvx2(const float *values, unsigned int nb_values, float value)
+{
+  const __m256 searched = _mm256_set1_ps(value);
+  for (long long start = static_cast<long long>(nb_values) - 8;; start -= 8)
+  {
+    start = std::max(start, 0LL);
+    const __m256 block = _mm256_loadu_ps(values + start);
+    const unsigned int found = static_cast<unsigned int>(_mm256_movemask_ps(_mm256_cmp_ps(block, searched,
+                                                                                          _CMP_EQ_OQ)));
+    if (found != 0)
+    {
+      return static_cast<int>(start) + 31 - __builtin_clz(found);
+    }
+    if (start == 0)
+    {
+      return -1;
+    }
+  }
+}
+
+LIBSGM_AVX512 int lastIndexOfAvx512(const uint8_t *values, unsigned int nb_values, uint8_t value)
+{
+  const __m512i searched = _mm512_set1_epi8(static_cast<char>(value));
+  // Blocks are aligned on the first value, the last one is masked
+  for (long long start = (static_cast<long long>(nb_values) - 1) / 64 * 64; start >= 0; start -= 64)
+  {
+    const __mmask64 mask = laneMask64(static_cast<unsigned int>(start), nb_values);
+    const uint64_t found = _mm512_mask_cmpeq_epu8_mask(mask, _mm512_maskz_loadu_epi8(mask, values + start), searched);
+    if (found != 0)
+    {
+      return static_cast<int>(start) + 63 - __builtin_clzll(found);
+    }
+  }
+  return -1;
+}
+
+LIBSGM_AVX512 int lastIndexOfAvx512(const uint16_t *values, unsigned int nb_values, uint16_t value)
+{
+  const __m512i searched = _mm512_set1_epi16(static_cast<short>(value));
+  for (long long start = (static_cast<long long>(nb_values) - 1) / 32 * 32; start >= 0; start -= 32)
+  {
+    const __mmask32 mask = static_cast<__mmask32>(laneMask64(static_cast<unsigned int>(start), nb_values));
+    const unsigned int found = _mm512_mask_cmpeq_epu16_mask(mask, _mm512_maskz_loadu_epi16(mask, values + start),
+                                                            searched);
+    if (found != 0)
+    {
+      return static_cast<int>(start) + 31 - __builtin_clz(found);
+    }
+  }
+  return -1;
+}
+
+LIBSGM_AVX512 int lastIndexOfAvx512(const float *values, unsigned int nb_values, float value)
+{
+  const __m512 searched = _mm512_set1_ps(value);
+  for (long long start = (static_cast<long long>(nb_values) - 1) / 16 * 16; start >= 0; start -= 16)
+  {
+    const __mmask16 mask = static_cast<__mmask16>(laneMask64(static_cast<unsigned int>(start), nb_values));
+    const unsigned int found = _mm512_mask_cmp_ps_mask(mask, _mm512_maskz_loadu_ps(mask, values + start), searched,
+                                                       _CMP_EQ_OQ);
+    if (found != 0)
+    {
+      return static_cast<int>(start) + 31 - __builtin_clz(found);
+    }
+  }
+  return -1;
+}
+
+#endif
+
+namespace
+{
+
+// Number of disparities of the specialised kernels
+const unsigned int fixed_disps[nb_fixed_disps] = {32, 64, 96, 128, 192, 256};
+
+/**
+* Kernels of an instruction set for a type of costs and of aggregated costs
+*/
+template <typename Tin, typename Tacc>
+struct LevelKernels
+{
+  AggregatePixelKernel<Tin, Tacc> aggregate_pixel; /**< generic kernel, for at least min_disps disparities */
+  LastIndexKernel<Tacc> last_index; /**< search of the position of the minimum */
+  unsigned int min_disps; /**< minimum number of disparities, or of searched values */
+  AggregatePixelKernel<Tin, Tacc> fixed[nb_fixed_disps]; /**< specialised kernels, for each of fixed_disps */
+};
+
+#ifdef LIBSGM_X86_SIMD
+
+template <typename Tin, typename Tacc>
+LevelKernels<Tin, Tacc> sse41Kernels(unsigned int min_disps)
+{
+  return {&aggregateDisparitiesSse41<0>, &lastIndexOfSse41, min_disps,
+          {&aggregateDisparitiesSse41<32>, &aggregateDisparitiesSse41<64>, &aggregateDisparitiesSse41<96>,
+           &aggregateDisparitiesSse41<128>, &aggregateDisparitiesSse41<192>, &aggregateDisparitiesSse41<256>}};
+}
+
+template <typename Tin, typename Tacc>
+LevelKernels<Tin, Tacc> avx2Kernels(unsigned int min_disps)
+{
+  return {&aggregateDisparitiesAvx2<0>, &lastIndexOfAvx2, min_disps,
+          {&aggregateDisparitiesAvx2<32>, &aggregateDisparitiesAvx2<64>, &aggregateDisparitiesAvx2<96>,
+           &aggregateDisparitiesAvx2<128>, &aggregateDisparitiesAvx2<192>, &aggregateDisparitiesAvx2<256>}};
+}
+
+template <typename Tin, typename Tacc>
+LevelKernels<Tin, Tacc> avx512Kernels(unsigned int min_disps)
+{
+  return {&aggregateDisparitiesAvx512<0>, &lastIndexOfAvx512, min_disps,
+          {&aggregateDisparitiesAvx512<32>, &aggregateDisparitiesAvx512<64>, &aggregateDisparitiesAvx512<96>,
+           &aggregateDisparitiesAvx512<128>, &aggregateDisparitiesAvx512<192>, &aggregateDisparitiesAvx512<256>}};
+}
+
+#endif
+
+/**
+* Kernels of an instruction set, for each type of costs
+*/
+struct KernelTable
+{
+  SimdLevel level;
+  LevelKernels<uint8_t, uint8_t> uint8_kernels;
+  LevelKernels<uint8_t, uint16_t> uint16_kernels;
+  LevelKernels<float, float> float_kernels;
+};
+
+KernelTable makeKernelTable(SimdLevel level)
+{
+  switch (level)
+  {
+#ifdef LIBSGM_X86_SIMD
+  case SIMD_SSE41:
+    return {level, sse41Kernels<uint8_t, uint8_t>(16), sse41Kernels<uint8_t, uint16_t>(8),
+            sse41Kernels<float, float>(4)};
+  case SIMD_AVX2:
+    return {level, avx2Kernels<uint8_t, uint8_t>(32), avx2Kernels<uint8_t, uint16_t>(16),
+            avx2Kernels<float, float>(8)};
+  case SIMD_AVX512:
+    return {level, avx512Kernels<uint8_t, uint8_t>(1), avx512Kernels<uint8_t, uint16_t>(1),
+            avx512Kernels<float, float>(1)};
+#endif
+  default:
+    return {SIMD_SCALAR, {}, {}, {}};
+  }
+}
+
+// Kernels for a number of disparities: the specialised one if any, else the generic one if there are enough lanes
+template <typename Tin, typename Tacc>
+SimdKernels<Tin, Tacc> selectKernels(const LevelKernels<Tin, Tacc> &kernels, unsigned int nb_disps)
+{
+  if (kernels.aggregate_pixel == nullptr || nb_disps < kernels.min_disps)
+  {
+    return {nullptr, nullptr};
+  }
+  for (unsigned int i = 0; i < nb_fixed_disps; i++)
+  {
+    if (nb_disps == fixed_disps[i])
+    {
+      return {kernels.fixed[i], kernels.last_index};
+    }
+  }
+  return {kernels.aggregate_pixel, kernels.last_index};
+}
+
+SimdLevel defaultSimdLevel()
+{
+  const char *name = std::getenv("LIBSGM_SIMD");
+  if (name == nullptr || *name == '\0')
+  {
+    return detectSimdLevel();
+  }
+  const SimdLevel level = parseSimdLevel(name);
+  if (!isSimdLevelSupported(level))
+  {
+    throw std::invalid_argument("LIBSGM_SIMD=" + std::string(name) + " is not supported by the processor");
+  }
+  return level;
+}
+
+KernelTable &kernelTable()
+{
+  static KernelTable table = makeKernelTable(defaultSimdLevel());
+  return table;
+}
+
+} // namespace
+
+SimdLevel getSimdLevel()
+{
+  return kernelTable().level;
+}
+
+void setSimdLevel(SimdLevel level)
+{
+  if (!isSimdLevelSupported(level))
+  {
+    throw std::invalid_argument(simdLevelName(level) + " is not supported by the processor");
+  }
+  kernelTable() = makeKernelTable(level);
+}
+
+template <>
+SimdKernels<uint8_t, uint8_t> simdKernels<uint8_t, uint8_t>(unsigned int nb_disps)
+{
+  return selectKernels(kernelTable().uint8_kernels, nb_disps);
+}
+
+template <>
+SimdKernels<uint8_t, uint16_t> simdKernels<uint8_t, uint16_t>(unsigned int nb_disps)
+{
+  return selectKernels(kernelTable().uint16_kernels, nb_disps);
+}
+
+template <>
+SimdKernels<float, float> simdKernels<float, float>(unsigned int nb_disps)
+{
+  return selectKernels(kernelTable().float_kernels, nb_disps);
+}
@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2026 Centre National d'Etudes Spatiales (CNES).
+ *
+ * This file is part of LIBSGM
+ *
+ *     https://github.com/CNES/Pandora_libsgm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SGM_SIMD_HPP
+#define SGM_SIMD_HPP
+
+#include <stdint.h>
+#include <string>
+
+/*
+ * SIMD kernels are built with target attributes, whatever the compilation flags,
+ * and are only called if the processor supports them.
+ */
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define LIBSGM_X86_SIMD
+#endif
+
+/**
+* Instruction sets of the aggregation kernels, from the scalar reference to the widest one
+*/
+enum SimdLevel{
+    SIMD_SCALAR = 0, /**< scalar reference code */
+    SIMD_SSE41 = 1, /**< SSE4.1, 16 uint8 or 4 float lanes */
+    SIMD_AVX2 = 2, /**< AVX2, 32 uint8 or 8 float lanes */
+    SIMD_AVX512 = 3 /**< AVX-512BW/VL, 64 uint8 or 16 float lanes with masked tails */
+};
+
+/**
+* Signature of a kernel computing the aggregated costs of one point for all disparities, returning their minimum.
+* Costs of type Tin are aggregated in lanes of type Tacc.
+*/
+template<typename Tin, typename Tacc = Tin>
+using AggregatePixelKernel = Tacc (*)(const Tin *, const Tacc *, Tacc *, unsigned int, Tacc, Tacc, Tin, Tacc);
+
+/**
+* Signature of a kernel searching the last position of a value, -1 if not found
+*/
+template<typename T>
+using LastIndexKernel = int (*)(const T *, unsigned int, T);
+
+/*!
+ *  \brief  Find the widest instruction set supported by the processor, with cpuid
+ *
+ *  \return Best supported level
+ */
+
+SimdLevel detectSimdLevel();
+
+/*!
+ *  \brief  Check if the processor supports an instruction set
+ *
+ *  \param level instruction set
+ *  \return True if kernels of this level can be used
+ */
+
+bool isSimdLevelSupported(SimdLevel level);
+
+/*!
+ *  \brief  Convert the name of an instruction set: scalar, sse4.1, avx2 or avx512
+ *
+ *  \param name name of the instruction set
+ *  \return Instruction set
+ *  \throws std::invalid_argument for an unknown name
+ */
+
+SimdLevel parseSimdLevel(const std::string & name);
+
+/*!
+ *  \brief  Name of an instruction set
+ *
+ *  \param level instruction set
+ *  \return Name of the instruction set, as understood by parseSimdLevel
+ */
+
+std::string simdLevelName(SimdLevel level);
+
+/*!
+ *  \brief  Get the instruction set of the kernels used by the aggregation.
+ *   At first call, it is chosen from the LIBSGM_SIMD environment variable if set, or else detected with cpuid.
+ *
+ *  \return Instruction set used by the aggregation
+ *  \throws std::invalid_argument if LIBSGM_SIMD is invalid or not supported by the processor
+ */
+
+SimdLevel getSimdLevel();
+
+/*!
+ *  \brief  Select the instruction set of the kernels used by the aggregation.
+ *   It must not be called while an aggregation is running.
+ *
+ *  \param level instruction set
+ *  \throws std::invalid_argument if the processor does not support it
+ */
+
+void setSimdLevel(SimdLevel level);
+
+#ifdef LIBSGM_X86_SIMD
+
+/*!
+ *  \brief  Compute aggregated cost of one point for all disparities with SSE4.1 instructions
+ *   Lr(p, d) = C(p, d) + min(Lr(p-r, d), Lr(p-r, d-1) + P1, Lr(p-r, d+1) + P1, min Lr(p-r) + P2) - min Lr(p-r)
+ *   A whole vector of disparities is computed at once from shifted loads of the previous aggregated costs,
+ *   the last vector overlaps the previous one. Integer lanes are saturating, uint8 costs are widened
+ *   to uint16 lanes by the uint16 kernel.
+ *   nb_disps must be at least the number of lanes (16 uint8, 8 uint16 or 4 float).
+ *
+ *  \param pixel_costs costs of the point, nb_disps values
+ *  \param previous_lr aggregated costs of the previous point
+ *  \param lr output aggregated costs of the point, nb_disps values
+ *  \param nb_disps disparity number of cost volume
+ *  \param P1 penalty P1 from sgm equation
+ *  \param P2 penalty P2 from sgm equation
+ *  \param invalid_value value representing invalid cost
+ *  \param previous_min minimum aggregated cost of the previous point
+ *  \return minimum aggregated cost of the point
+ */
+
+uint8_t aggregatePixelSse41(const uint8_t * pixel_costs, const uint8_t * previous_lr, uint8_t * lr, unsigned int nb_disps,
+    uint8_t P1, uint8_t P2, uint8_t invalid_value, uint8_t previous_min);
+
+uint16_t aggregatePixelSse41(const uint8_t * pixel_costs, const uint16_t * previous_lr, uint16_t * lr,
+    unsigned int nb_disps, uint16_t P1, uint16_t P2, uint8_t invalid_value, uint16_t previous_min);
+
+float aggregatePixelSse41(const float * pixel_costs, const float * previous_lr, float * lr, unsigned int nb_disps,
+    float P1, float P2, float invalid_value, float previous_min);
+
+/*!
+ *  \brief  Compute aggregated cost of one point for all disparities with AVX2 instructions
+ *   Same as aggregatePixelSse41, nb_disps must be at least the number of lanes (32 uint8, 16 uint16 or 8 float).
+ *
+ *  \param pixel_costs costs of the point, nb_disps values
+ *  \param previous_lr aggregated costs of the previous point
+ *  \param lr output aggregated costs of the point, nb_disps values
+ *  \param nb_disps disparity number of cost volume
+ *  \param P1 penalty P1 from sgm equation
+ *  \param P2 penalty P2 from sgm equation
+ *  \param invalid_value value representing invalid cost
+ *  \param previous_min minimum aggregated cost of the previous point
+ *  \return minimum aggregated cost of the point
+ */
+
+uint8_t aggregatePixelAvx2(const uint8_t * pixel_costs, const uint8_t * previous_lr, uint8_t * lr, unsigned int nb_disps,
+    uint8_t P1, uint8_t P2, uint8_t invalid_value, uint8_t previous_min);
+
+uint16_t aggregatePixelAvx2(const uint8_t * pixel_costs, const uint16_t * previous_lr, uint16_t * lr,
+    unsigned int nb_disps, uint16_t P1, uint16_t P2, uint8_t invalid_value, uint16_t previous_min);
+
+float aggregatePixelAvx2(const float * pixel_costs, const float * previous_lr, float * lr, unsigned int nb_disps,
+    float P1, float P2, float invalid_value, float previous_min);
+
+/*!
+ *  \brief  Compute aggregated cost of one point for all disparities with AVX-512BW/VL instructions
+ *   Same as aggregatePixelSse41, the last vector is masked so any nb_disps is supported.
+ *
+ *  \param pixel_costs costs of the point, nb_disps values
+ *  \param previous_lr aggregated costs of the previous point
+ *  \param lr output aggregated costs of the point, nb_disps values
+ *  \param nb_disps disparity number of cost volume
+ *  \param P1 penalty P1 from sgm equation
+ *  \param P2 penalty P2 from sgm equation
+ *  \param invalid_value value representing invalid cost
+ *  \param previous_min minimum aggregated cost of the previous point
+ *  \return minimum aggregated cost of the point
+ */
+
+uint8_t aggregatePixelAvx512(const uint8_t * pixel_costs, const uint8_t * previous_lr, uint8_t * lr, unsigned int nb_disps,
+    uint8_t P1, uint8_t P2, uint8_t invalid_value, uint8_t previous_min);
+
+uint16_t aggregatePixelAvx512(const uint8_t * pixel_costs, const uint16_t * previous_lr, uint16_t * lr,
+    unsigned int nb_disps, uint16_t P1, uint16_t P2, uint8_t invalid_value, uint16_t previous_min);
+
+float aggregatePixelAvx512(const float * pixel_costs, const float * previous_lr, float * lr, unsigned int nb_disps,
+    float P1, float P2, float invalid_value, float previous_min);
+
+/*!
+ *  \brief  Search the last position of a value with SSE4.1, AVX2 or AVX-512BW/VL instructions
+ *   Values are compared one vector at a time, from the end. SSE4.1 and AVX2 kernels need at least
+ *   as many values as lanes.
+ *
+ *  \param values values to search
+ *  \param nb_values number of values
+ *  \param value searched value
+ *  \return last position of the value, -1 if not found
+ */
+
+int lastIndexOfSse41(const uint8_t * values, unsigned int nb_values, uint8_t value);
+
+int lastIndexOfSse41(const uint16_t * values, unsigned int nb_values, uint16_t value);
+
+int lastIndexOfSse41(const float * values, unsigned int nb_values, float value);
+
+int lastIndexOfAvx2(const uint8_t * values, unsigned int nb_values, uint8_t value);
+
+int lastIndexOfAvx2(const uint16_t * values, unsigned int nb_values, uint16_t value);
+
+int lastIndexOfAvx2(const float * values, unsigned int nb_values, float value);
+
+int lastIndexOfAvx512(const uint8_t * values, unsigned int nb_values, uint8_t value);
+
+int lastIndexOfAvx512(const uint16_t * values, unsigned int nb_values, uint16_t value);
+
+int lastIndexOfAvx512(const float * values, unsigned int nb_values, float value);
+
+#endif
+
+/**
+* Number of disparities with a specialised kernel: 32, 64, 96, 128, 192 and 256
+*/
+const unsigned int nb_fixed_disps = 6;
+
+/**
+* Kernels of the selected instruction set for a number of disparities, null if the scalar code must be used
+*/
+template<typename Tin, typename Tacc = Tin>
+struct SimdKernels{
+    AggregatePixelKernel<Tin, Tacc> aggregate_pixel; /**< aggregated costs of one point */
+    LastIndexKernel<Tacc> last_index; /**< last position of a value among the aggregated costs of one point */
+};
+
+/*!
+ *  \brief  Select the kernels of the instruction set for a number of disparities, once for an aggregation.
+ *   Common numbers of disparities have kernels specialised at compile time, with unrolled loops;
+ *   the generic kernel is used for the others.
+ *
+ *  \param nb_disps disparity number of cost volume
+ *  \return kernels, null if no SIMD kernel is selected for this type and disparity number
+ */
+
+template<typename Tin, typename Tacc>
+SimdKernels<Tin, Tacc> simdKernels(unsigned int)
+{
+    return {nullptr, nullptr};
+}
+
+template<>
+SimdKernels<uint8_t, uint8_t> simdKernels<uint8_t, uint8_t>(unsigned int nb_disps);
+
+template<>
+SimdKernels<uint8_t, uint16_t> simdKernels<uint8_t, uint16_t>(unsigned int nb_disps);
+
+template<>
+SimdKernels<float, float> simdKernels<float, float>(unsigned int nb_disps);
+
+#endif
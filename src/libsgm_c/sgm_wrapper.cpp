@@ -24,38 +24,242 @@
 
 namespace py = pybind11;
 
-template<typename T, typename Tout>
-py::dict pySgmApi(py::array_t<T, py::array::c_style> cv_in,
-                 py::array_t<T, py::array::c_style> p1_in,
-                 py::array_t<T, py::array::c_style> p2_in,
-                 py::array_t<int, py::array::c_style> directions,
-                 float invalid_value,
-                 py::array_t<float, py::array::c_style> segmentation,
-                 bool cost_paths,
-                 bool overcounting,
-                 bool edge_classification)
+Concurrency parseConcurrency(const std::string & concurrency)
+{
+    if (concurrency == "none") {
+        return CONCURRENCY_NONE;
+    }
+    if (concurrency == "passes") {
+        return CONCURRENCY_PASSES;
+    }
+    if (concurrency == "directions") {
+        return CONCURRENCY_DIRECTIONS;
+    }
+    throw std::invalid_argument("concurrency must be 'none', 'passes' or 'directions'.");
+}
+
+DisparityMode parseDisparityMode(const std::string & disparity)
+{
+    if (disparity == "none") {
+        return DISPARITY_NONE;
+    }
+    if (disparity == "wta") {
+        return DISPARITY_WTA;
+    }
+    if (disparity == "parabola") {
+        return DISPARITY_PARABOLA;
+    }
+    if (disparity == "v_shape") {
+        return DISPARITY_V_SHAPE;
+    }
+    throw std::invalid_argument("disparity must be 'none', 'wta', 'parabola' or 'v_shape'.");
+}
+
+ConfidenceOptions parseConfidence(const std::vector<std::string> & confidence, float eta_max, float eta_step)
+{
+    ConfidenceOptions options = {false, false, false, false, eta_max, eta_step};
+    for (const std::string & measure : confidence) {
+        if (measure == "ambiguity") {
+            options.ambiguity = true;
+        } else if (measure == "risk") {
+            options.risk = true;
+        } else if (measure == "ratio") {
+            options.ratio = true;
+        } else if (measure == "path_agreement") {
+            options.path_agreement = true;
+        } else {
+            throw std::invalid_argument("confidence measures must be 'ambiguity', 'risk', 'ratio' or 'path_agreement'.");
+        }
+    }
+    return options;
+}
+
+/*!
+ *  \brief  Give a buffer allocated with new[] to NumPy, without copy
+ *   The capsule frees the buffer with delete[] when the array is garbage collected.
+ *
+ *  \param buffer buffer, owned by the array after the call
+ *  \param shape shape of the array
+ *  \return array viewing the buffer
+ */
+template<typename T>
+py::array_t<T> ownedArray(T * buffer, const std::vector<size_t> & shape)
+{
+    py::capsule owner(buffer, [](void * data) { delete[] static_cast<T*>(data); });
+    return py::array_t<T>(shape, buffer, owner);
+}
+
+/*!
+ *  \brief  Get the buffer of an output array given by the caller
+ *   The array is written in place: it must be writeable, C-contiguous, of the output type and shape.
+ *
+ *  \param out output array, or None
+ *  \param shape expected shape
+ *  \param name name of the argument, for error messages
+ *  \return buffer of the array, nullptr for None
+ */
+template<typename T>
+T * outputArrayBuffer(const py::object & out, const std::vector<py::ssize_t> & shape, const std::string & name)
+{
+    if (out.is_none()) {
+        return nullptr;
+    }
+    if (!py::isinstance<py::array_t<T, py::array::c_style>>(out)) {
+        throw std::invalid_argument(name + " must be a C-contiguous array of the output type.");
+    }
+    auto array = py::reinterpret_borrow<py::array_t<T, py::array::c_style>>(out);
+    if (array.ndim() != static_cast<py::ssize_t>(shape.size()) || !std::equal(shape.begin(), shape.end(), array.shape())) {
+        throw std::invalid_argument(name + " dimensions must match the output dimensions.");
+    }
+    if (!array.writeable()) {
+        throw std::invalid_argument(name + " must be writeable.");
+    }
+    return array.mutable_data();
+}
+
+/*!
+ *  \brief  View an input array through its strides, without copy
+ *   Strides of NumPy in bytes are converted in number of elements. As in NumPy broadcasting, the array is aligned on
+ *   the last axes of the shape, and missing axes or axes of size 1 are repeated with a null stride: a penalty array
+ *   of shape (8,), (1, 1, 8) or a scalar gives the same values to all points.
+ *
+ *  \param array input array, of at most as many dimensions as the shape
+ *  \param shape (rows, cols) or (rows, cols, depth) shape the array is broadcast to
+ *  \param name name of the argument, for error messages
+ *  \return data and strides of the array, the depth stride of a (rows, cols) shape is 0
+ */
+template<typename T>
+StridedArray<T> stridedArray(const py::array_t<T> & array, const std::vector<py::ssize_t> & shape,
+                             const std::string & name)
+{
+    const py::ssize_t offset = static_cast<py::ssize_t>(shape.size()) - array.ndim();
+    if (offset < 0) {
+        throw std::invalid_argument(name + " has too many dimensions.");
+    }
+    long long strides[3] = {0, 0, 0};
+    for (py::ssize_t axis = 0; axis < array.ndim(); axis++) {
+        if (array.shape(axis) != shape[axis + offset]) {
+            if (array.shape(axis) != 1) {
+                throw std::invalid_argument(name + " dimensions must match or be broadcastable to the dimensions of cv_in.");
+            }
+            continue;
+        }
+        if (array.strides(axis) % static_cast<py::ssize_t>(sizeof(T)) != 0) {
+            throw std::invalid_argument(name + " strides must be multiples of its item size.");
+        }
+        strides[axis + offset] = array.strides(axis) / static_cast<py::ssize_t>(sizeof(T));
+    }
+    return {array.data(), {strides[0], strides[1], strides[2]}};
+}
+
+/*!
+ *  \brief  Get the penalty tables of the segmentation classes
+ *
+ *  \param p1_classes p1 penalties of each class and direction, or None
+ *  \param p2_classes p2 penalties of each class and direction, or None
+ *  \param p1 output C-contiguous p1 tables of type T, kept alive by the caller during the aggregation
+ *  \param p2 output C-contiguous p2 tables of type T, kept alive by the caller during the aggregation
+ *  \return tables of the classes, p1 and p2 are nullptr without tables
+ */
+template<typename T>
+PenaltyTables<T> penaltyTables(const py::object & p1_classes, const py::object & p2_classes,
+                               py::array_t<T, py::array::c_style | py::array::forcecast> & p1,
+                               py::array_t<T, py::array::c_style | py::array::forcecast> & p2)
+{
+    if (p1_classes.is_none() && p2_classes.is_none()) {
+        return {nullptr, nullptr, 0};
+    }
+    if (p1_classes.is_none() || p2_classes.is_none()) {
+        throw std::invalid_argument("p1_classes and p2_classes must be given together.");
+    }
+    p1 = py::cast<py::array_t<T, py::array::c_style | py::array::forcecast>>(p1_classes);
+    p2 = py::cast<py::array_t<T, py::array::c_style | py::array::forcecast>>(p2_classes);
+    if (p1.ndim() != 2 || p1.shape(1) != 8 || p2.ndim() != 2 || p2.shape(0) != p1.shape(0) || p2.shape(1) != 8) {
+        throw std::invalid_argument("p1_classes and p2_classes must be arrays of shape (classes, 8).");
+    }
+    return {p1.data(), p2.data(), static_cast<unsigned int>(p1.shape(0))};
+}
+
+/*!
+ *  \brief  Pack the history resets of an integer or boolean segmentation map, without converting it to float
+ *
+ *  \param segmentation segmentation map
+ *  \param direction coordinates of the previous point, for the 8 directions
+ *  \param shape (rows, cols) shape of the map
+ *  \param edge_classification use segmentation as an edge classification
+ *  \param num_threads number of threads
+ *  \param reset_masks output masks, resized to rows x cols
+ *  \return false if the labels are not of type Tseg
+ */
+template<typename Tseg>
+bool packResetMasks(const py::array & segmentation, const Direction * direction, const std::vector<py::ssize_t> & shape,
+                    bool edge_classification, int num_threads, std::vector<uint8_t> & reset_masks)
+{
+    if (!py::isinstance<py::array_t<Tseg>>(segmentation)) {
+        return false;
+    }
+    auto labels = py::reinterpret_borrow<py::array_t<Tseg>>(segmentation);
+    reset_masks.resize(shape[0] * shape[1]);
+    resetMasks(stridedArray(labels, shape, "segmentation"), direction, shape[0], shape[1], edge_classification,
+               reset_masks.data(), getNumThreads(num_threads));
+    return true;
+}
+
+/**
+* Inputs of the aggregation read from Python, with the converted arrays they point to
+*/
+template<typename T>
+struct PyInputs {
+    SgmInputs<T> inputs; /**< inputs given to the aggregation */
+    unsigned long int nb_rows; /**< row number of cost volume */
+    unsigned long int nb_cols; /**< column number of cost volume */
+    unsigned int nb_disps; /**< disparity number of the dense cost volume */
+    int* directions; /**< directions to use */
+    py::array_t<T> p1_array, p2_array; /**< converted penalties */
+    py::array_t<T, py::array::c_style | py::array::forcecast> p1_tables, p2_tables; /**< converted class tables */
+    std::vector<uint8_t> reset_masks; /**< history resets of an integer or boolean segmentation */
+    py::array_t<float> segmentation_float, guide_array; /**< converted segmentation and guide */
+    py::array_t<uint8_t, py::array::c_style | py::array::forcecast> validity_array; /**< converted validity */
+    py::array_t<int32_t> disp_min_array, disp_max_array; /**< converted disparity grids */
+    py::array_t<int64_t, py::array::c_style | py::array::forcecast> offsets_array; /**< converted offsets */
+};
+
+/*!
+ *  \brief  Read the inputs of the aggregation, shared by sgm_api and esgm_api (see their docstrings)
+ *   The converted arrays are kept in py_inputs, which must outlive the aggregation.
+ *
+ *  \param py_inputs output inputs and converted arrays
+ */
+template<typename T>
+void pyInputs(PyInputs<T> & py_inputs,
+              py::array_t<T> cv_in,
+              py::object p1_in,
+              py::object p2_in,
+              py::array_t<int, py::array::c_style> directions,
+              py::array segmentation,
+              bool edge_classification,
+              int num_threads,
+              py::object p1_classes,
+              py::object p2_classes,
+              py::object guide,
+              py::object validity,
+              py::object disp_min,
+              py::object disp_max,
+              py::object offsets)
 {
 
     auto cv_in_shape = cv_in.shape();
-    auto p1_in_shape = p1_in.shape();
-    auto p2_in_shape = p2_in.shape();
     auto segmentation_shape = segmentation.shape();
     auto directions_shape = directions.shape();
-
-    unsigned long int nb_rows = cv_in_shape[0];
-    unsigned long int nb_cols = cv_in_shape[1];
-    unsigned int nb_disps = cv_in_shape[2];
-    unsigned int nb_directions = 8;
+    // A ragged cost volume packs the costs of the disparity intervals in a 1D array
+    const bool ragged = !offsets.is_none();
 
     //Check dimensions
-    if (cv_in.ndim() != 3) {
+    if (!ragged && cv_in.ndim() != 3) {
         throw std::invalid_argument("cv_in must be a 3D array.");
     }
-    if (p1_in.ndim() != 3) {
-        throw std::invalid_argument("p1_in must be a 3D array.");
-    }
-    if (p2_in.ndim() != 3) {
-        throw std::invalid_argument("p2_in must be a 3D array.");
+    if (ragged && (cv_in.ndim() != 1 || disp_min.is_none() || disp_max.is_none())) {
+        throw std::invalid_argument("a ragged cv_in must be a 1D array, with offsets, disp_min and disp_max.");
     }
     if (directions.ndim() != 2) {
         throw std::invalid_argument("direction must be a 2D array.");
@@ -64,58 +268,360 @@ py::dict pySgmApi(py::array_t<T, py::array::c_style> cv_in,
         throw std::invalid_argument("segmentation must be a 2D array.");
     }
 
+    unsigned long int nb_rows = ragged ? segmentation_shape[0] : cv_in_shape[0];
+    unsigned long int nb_cols = ragged ? segmentation_shape[1] : cv_in_shape[1];
+    // The dense disparity axis of a ragged volume ends at the highest disparity of the intervals
+    unsigned int nb_disps = ragged ? std::max(py::cast<int>(py::module::import("numpy").attr("max")(disp_max)) + 1, 1)
+                                   : static_cast<unsigned int>(cv_in_shape[2]);
+    unsigned int nb_directions = 8;
 
-    if (p1_in_shape[0] != cv_in_shape[0] || p1_in_shape[1] != cv_in_shape[1]) {
-        throw std::invalid_argument("p1_in dimensions must match cv_in dimensions.");
-    }
-    if (p2_in_shape[0] != cv_in_shape[0] || p2_in_shape[1] != cv_in_shape[1]){
-        throw std::invalid_argument("p2_in dimensions must match cv_in dimensions.");
-    }
-    if (segmentation_shape[0] != cv_in_shape[0] || segmentation_shape[1] != cv_in_shape[1]) {
+    if (segmentation_shape[0] != static_cast<py::ssize_t>(nb_rows) ||
+        segmentation_shape[1] != static_cast<py::ssize_t>(nb_cols)) {
         throw std::invalid_argument("segmentation dimensions must match the height and width of cv_in.");
     }
     if (directions_shape[0] != nb_directions) {
         throw std::invalid_argument("SGM only support 8 dimensions");
     }
+    const py::ssize_t rows = static_cast<py::ssize_t>(nb_rows);
+    const py::ssize_t cols = static_cast<py::ssize_t>(nb_cols);
+    if (ragged) {
+        py_inputs.offsets_array = py::cast<py::array_t<int64_t, py::array::c_style | py::array::forcecast>>(offsets);
+        const auto & offsets_array = py_inputs.offsets_array;
+        if (offsets_array.ndim() != 1 || offsets_array.shape(0) != rows * cols + 1 ||
+            offsets_array.at(0) < 0 || offsets_array.at(rows * cols) > cv_in.shape(0)) {
+            throw std::invalid_argument("offsets must be a 1D array of rows * cols + 1 offsets in cv_in.");
+        }
+    }
+    py_inputs.nb_rows = nb_rows;
+    py_inputs.nb_cols = nb_cols;
+    py_inputs.nb_disps = nb_disps;
 
-    /* Request buffers descriptor from Python */
-    T* cv_in_buf = const_cast<T*>(cv_in.data());
-    T* p1_in_buf = const_cast<T*>(p1_in.data());
-    T* p2_in_buf = const_cast<T*>(p2_in.data());
-    int* directions_buf = const_cast<int*>(directions.data());
-    float* segmentation_buf = const_cast<float*>(segmentation.data());
+    /* Request buffers descriptor from Python: views such as slices or transpositions are read through their strides,
+       penalties of each direction or scalars are broadcast to all points */
+    const py::ssize_t depth = static_cast<py::ssize_t>(nb_disps);
+    const py::ssize_t nb_dir = static_cast<py::ssize_t>(nb_directions);
+    SgmInputs<T> & inputs = py_inputs.inputs;
+    inputs = {
+        ragged ? StridedArray<T>{cv_in.data(), {0, 0, 1}} : stridedArray(cv_in, {rows, cols, depth}, "cv_in"),
+        {nullptr, {0, 0, 0}},
+        {nullptr, {0, 0, 0}},
+        {nullptr, {0, 0, 0}},
+        {nullptr, nullptr, 0},
+        {nullptr, {0, 0, 0}},
+        nullptr,
+        nullptr,
+        {nullptr, {0, 0, 0}},
+        {nullptr, {0, 0, 0}},
+        nullptr
+    };
+    py_inputs.directions = const_cast<int*>(directions.data());
+    // Converted penalties are kept alive until the end of the aggregation
+    inputs.penalty_tables = penaltyTables<T>(p1_classes, p2_classes, py_inputs.p1_tables, py_inputs.p2_tables);
+    // Integer and boolean maps are packed in reset bits as they are, float labels are still needed by the classes
+    Direction direction[8];
+    assignDirections(py_inputs.directions, direction);
+    std::vector<uint8_t> & reset_masks = py_inputs.reset_masks;
+    const bool packed =
+        packResetMasks<bool>(segmentation, direction, {rows, cols}, edge_classification, num_threads, reset_masks) ||
+        packResetMasks<uint8_t>(segmentation, direction, {rows, cols}, edge_classification, num_threads, reset_masks) ||
+        packResetMasks<int32_t>(segmentation, direction, {rows, cols}, edge_classification, num_threads, reset_masks) ||
+        packResetMasks<int64_t>(segmentation, direction, {rows, cols}, edge_classification, num_threads, reset_masks);
+    if (packed) {
+        inputs.reset_masks = reset_masks.data();
+    }
+    if (!packed || inputs.penalty_tables.p1 != nullptr) {
+        py_inputs.segmentation_float = py::cast<py::array_t<float>>(segmentation);
+        inputs.segmentation = stridedArray(py_inputs.segmentation_float, {rows, cols}, "segmentation");
+    }
+    if (inputs.penalty_tables.p1 == nullptr) {
+        if (p1_in.is_none() || p2_in.is_none()) {
+            throw std::invalid_argument("p1_in and p2_in are required without p1_classes and p2_classes.");
+        }
+        py_inputs.p1_array = py::cast<py::array_t<T>>(p1_in);
+        py_inputs.p2_array = py::cast<py::array_t<T>>(p2_in);
+        inputs.p1_in = stridedArray(py_inputs.p1_array, {rows, cols, nb_dir}, "p1_in");
+        inputs.p2_in = stridedArray(py_inputs.p2_array, {rows, cols, nb_dir}, "p2_in");
+    }
+    // Guide image of the adaptive P2, one intensity per point
+    if (!guide.is_none()) {
+        py_inputs.guide_array = py::cast<py::array_t<float>>(guide);
+        if (py_inputs.guide_array.ndim() != 2) {
+            throw std::invalid_argument("guide must be a 2D array.");
+        }
+        inputs.guide = stridedArray(py_inputs.guide_array, {rows, cols}, "guide");
+    }
+    // Validity of the points, e.g. computed once for several aggregations of the cost volume
+    if (!validity.is_none()) {
+        auto & validity_array = py_inputs.validity_array;
+        validity_array = py::cast<py::array_t<uint8_t, py::array::c_style | py::array::forcecast>>(validity);
+        if (validity_array.ndim() != 2 || validity_array.shape(0) != rows || validity_array.shape(1) != cols) {
+            throw std::invalid_argument("validity must be a 2D array of the height and width of cv_in.");
+        }
+        inputs.validity = validity_array.data();
+    }
+    // Disparity grids, as indices along the disparity axis of cv_in
+    if (disp_min.is_none() != disp_max.is_none()) {
+        throw std::invalid_argument("disp_min and disp_max must be given together.");
+    }
+    if (!disp_min.is_none()) {
+        py_inputs.disp_min_array = py::cast<py::array_t<int32_t>>(disp_min);
+        py_inputs.disp_max_array = py::cast<py::array_t<int32_t>>(disp_max);
+        inputs.disp_min = stridedArray(py_inputs.disp_min_array, {rows, cols}, "disp_min");
+        inputs.disp_max = stridedArray(py_inputs.disp_max_array, {rows, cols}, "disp_max");
+    }
+    if (ragged) {
+        if (cv_in.strides(0) != static_cast<py::ssize_t>(sizeof(T))) {
+            throw std::invalid_argument("a ragged cv_in must be contiguous.");
+        }
+        inputs.offsets = py_inputs.offsets_array.data();
+    }
+}
+
+template<typename T, typename Tout>
+py::dict pySgmApi(py::array_t<T> cv_in,
+                 py::object p1_in,
+                 py::object p2_in,
+                 py::array_t<int, py::array::c_style> directions,
+                 float invalid_value,
+                 py::array segmentation,
+                 bool cost_paths,
+                 bool overcounting,
+                 bool edge_classification,
+                 int num_threads,
+                 const std::string & concurrency,
+                 unsigned int nb_partial_volumes,
+                 py::object out,
+                 py::object out_cv_min,
+                 bool accumulate,
+                 py::object p1_classes,
+                 py::object p2_classes,
+                 py::object guide,
+                 py::object validity,
+                 py::object disp_min,
+                 py::object disp_max,
+                 py::object offsets,
+                 const std::string & disparity,
+                 bool keep_cv,
+                 const std::vector<std::string> & confidence,
+                 float eta_max,
+                 float eta_step)
+{
+    Concurrency concurrency_mode = parseConcurrency(concurrency);
+    DisparityMode disparity_mode = parseDisparityMode(disparity);
+    ConfidenceOptions confidence_options = parseConfidence(confidence, eta_max, eta_step);
+    if (!cost_paths && !out_cv_min.is_none()) {
+        throw std::invalid_argument("out_cv_min requires cost_paths.");
+    }
+    PyInputs<T> py_inputs;
+    pyInputs<T>(py_inputs, cv_in, p1_in, p2_in, directions, segmentation, edge_classification, num_threads,
+                p1_classes, p2_classes, guide, validity, disp_min, disp_max, offsets);
+    const unsigned long int nb_rows = py_inputs.nb_rows;
+    const unsigned long int nb_cols = py_inputs.nb_cols;
+    const py::ssize_t rows = static_cast<py::ssize_t>(nb_rows);
+    const py::ssize_t cols = static_cast<py::ssize_t>(nb_cols);
+    std::vector<py::ssize_t> out_shape = {rows, cols, static_cast<py::ssize_t>(py_inputs.nb_disps)};
+    if (!offsets.is_none()) {
+        out_shape = {static_cast<py::ssize_t>(py_inputs.offsets_array.at(rows * cols))};
+    }
+    Tout* out_buf = outputArrayBuffer<Tout>(out, out_shape, "out");
+    int* out_cv_min_buf = outputArrayBuffer<int>(out_cv_min, {rows, cols, 8}, "out_cv_min");
+    // out is reset before the costs are read
+    if (out_buf != nullptr && py::module::import("numpy").attr("may_share_memory")(out, cv_in).cast<bool>()) {
+        throw std::invalid_argument("out must not overlap cv_in.");
+    }
 
     CostVolumes<Tout> cv_out = sgm<T, Tout>(
-        cv_in_buf,
-        p1_in_buf,
-        p2_in_buf,
-        directions_buf,
+        py_inputs.inputs,
+        py_inputs.directions,
         nb_rows,
         nb_cols,
-        nb_disps,
+        py_inputs.nb_disps,
         invalid_value,
-        segmentation_buf,
         cost_paths,
         overcounting,
-        edge_classification
+        edge_classification,
+        num_threads,
+        concurrency_mode,
+        nb_partial_volumes,
+        out_buf,
+        out_cv_min_buf,
+        accumulate,
+        disparity_mode,
+        keep_cv,
+        nullptr,
+        confidence_options
     );
 
+    // Output arrays of the caller are returned, volumes allocated by sgm are given to NumPy, which frees them
     py::dict result;
-    result["cv"] = py::array_t<Tout>(std::vector<size_t>{nb_rows, nb_cols, nb_disps}, cv_out.cost_volume);
-    if (cost_paths) {
-        result["cv_min"] = py::array_t<int>(std::vector<size_t>{nb_rows, nb_cols, 8}, cv_out.cost_volume_min);
+    if (out_buf != nullptr) {
+        result["cv"] = out;
+    } else if (!keep_cv) {
+        result["cv"] = py::none();
     } else {
+        result["cv"] = ownedArray(cv_out.cost_volume, std::vector<size_t>(out_shape.begin(), out_shape.end()));
+    }
+    if (out_cv_min_buf != nullptr) {
+        result["cv_min"] = out_cv_min;
+    } else if (cost_paths) {
+        result["cv_min"] = ownedArray(cv_out.cost_volume_min, std::vector<size_t>{nb_rows, nb_cols, 8});
+    } else {
+        delete[] cv_out.cost_volume_min;
         result["cv_min"] = py::array_t<int>();  // Return an empty array if cost_paths is false
     }
-    delete cv_out.cost_volume;
-    delete cv_out.cost_volume_min;
+    if (disparity_mode != DISPARITY_NONE) {
+        result["disp"] = ownedArray(cv_out.disparity_map, std::vector<size_t>{nb_rows, nb_cols});
+    }
+    const std::vector<size_t> map_shape = {nb_rows, nb_cols};
+    if (confidence_options.ambiguity) {
+        result["ambiguity"] = ownedArray(cv_out.confidence.ambiguity, map_shape);
+    }
+    if (confidence_options.risk) {
+        result["risk_min"] = ownedArray(cv_out.confidence.risk_min, map_shape);
+        result["risk_max"] = ownedArray(cv_out.confidence.risk_max, map_shape);
+    }
+    if (confidence_options.ratio) {
+        result["ratio"] = ownedArray(cv_out.confidence.ratio, map_shape);
+    }
+    if (confidence_options.path_agreement) {
+        result["path_agreement"] = ownedArray(cv_out.confidence.path_agreement, map_shape);
+    }
+    return result;
+}
+
+template<typename T, typename Tout>
+py::dict pyEsgmApi(py::array_t<T> cv_in,
+                   py::object p1_in,
+                   py::object p2_in,
+                   py::array_t<int, py::array::c_style> directions,
+                   float invalid_value,
+                   py::array segmentation,
+                   bool overcounting,
+                   bool edge_classification,
+                   int num_threads,
+                   py::object p1_classes,
+                   py::object p2_classes,
+                   py::object guide,
+                   py::object validity,
+                   py::object disp_min,
+                   py::object disp_max,
+                   py::object offsets)
+{
+    PyInputs<T> py_inputs;
+    pyInputs<T>(py_inputs, cv_in, p1_in, p2_in, directions, segmentation, edge_classification, num_threads,
+                p1_classes, p2_classes, guide, validity, disp_min, disp_max, offsets);
+    const unsigned long int nb_rows = py_inputs.nb_rows;
+    const unsigned long int nb_cols = py_inputs.nb_cols;
+
+    DisparityMap<Tout> map = esgm<T, Tout>(py_inputs.inputs, py_inputs.directions, nb_rows, nb_cols,
+                                           py_inputs.nb_disps, static_cast<T>(invalid_value), overcounting,
+                                           edge_classification, num_threads);
+    py::dict result;
+    result["disp"] = ownedArray(map.disparity, std::vector<size_t>{nb_rows, nb_cols});
+    result["costs"] = ownedArray(map.costs, std::vector<size_t>{nb_rows, nb_cols, 3});
+    return result;
+}
+
+/*!
+ *  \brief  View the disparity grids of a ragged cost volume, of shape (rows, cols)
+ *
+ *  \param disp_min first disparity index of each point
+ *  \param disp_max last disparity index of each point, included
+ *  \return strided grids
+ */
+std::pair<StridedArray<int32_t>, StridedArray<int32_t>> disparityGrids(const py::array_t<int32_t> & disp_min,
+                                                                      const py::array_t<int32_t> & disp_max)
+{
+    if (disp_min.ndim() != 2) {
+        throw std::invalid_argument("disp_min must be a 2D array.");
+    }
+    const std::vector<py::ssize_t> shape = {disp_min.shape(0), disp_min.shape(1)};
+    return std::make_pair(stridedArray(disp_min, shape, "disp_min"), stridedArray(disp_max, shape, "disp_max"));
+}
+
+py::array_t<int64_t> pyRaggedOffsets(py::array_t<int32_t> disp_min, py::array_t<int32_t> disp_max,
+                                     unsigned int nb_disps)
+{
+    const auto grids = disparityGrids(disp_min, disp_max);
+    const size_t nb_pixels = disp_min.shape(0) * disp_min.shape(1);
+    int64_t* offsets = new int64_t[nb_pixels + 1];
+    raggedOffsets(grids.first, grids.second, disp_min.shape(0), disp_min.shape(1), nb_disps, offsets);
+    return ownedArray(offsets, std::vector<size_t>{nb_pixels + 1});
+}
+
+template<typename T>
+py::dict pyToRagged(py::array_t<T> cv_in, py::array_t<int32_t> disp_min, py::array_t<int32_t> disp_max,
+                    int num_threads)
+{
+    if (cv_in.ndim() != 3) {
+        throw std::invalid_argument("cv_in must be a 3D array.");
+    }
+    const auto grids = disparityGrids(disp_min, disp_max);
+    const unsigned long int nb_rows = cv_in.shape(0);
+    const unsigned long int nb_cols = cv_in.shape(1);
+    const unsigned int nb_disps = cv_in.shape(2);
+    if (disp_min.shape(0) != cv_in.shape(0) || disp_min.shape(1) != cv_in.shape(1)) {
+        throw std::invalid_argument("disp_min dimensions must match the height and width of cv_in.");
+    }
+    py::array_t<int64_t> offsets = pyRaggedOffsets(disp_min, disp_max, nb_disps);
+    const int64_t nb_costs = offsets.at(nb_rows * nb_cols);
+    T* costs = new T[nb_costs];
+    toRagged(stridedArray(cv_in, {cv_in.shape(0), cv_in.shape(1), cv_in.shape(2)}, "cv_in"), grids.first,
+             grids.second, offsets.data(), nb_rows, nb_cols, nb_disps, costs, getNumThreads(num_threads));
+    py::dict result;
+    result["cv"] = ownedArray(costs, std::vector<size_t>{static_cast<size_t>(nb_costs)});
+    result["offsets"] = offsets;
     return result;
 }
 
+template<typename T>
+py::array_t<T> pyToDense(py::array_t<T, py::array::c_style> cv_in,
+                         py::array_t<int64_t, py::array::c_style | py::array::forcecast> offsets,
+                         py::array_t<int32_t> disp_min, py::array_t<int32_t> disp_max, unsigned int nb_disps,
+                         float invalid_value, int num_threads)
+{
+    const auto grids = disparityGrids(disp_min, disp_max);
+    const unsigned long int nb_rows = disp_min.shape(0);
+    const unsigned long int nb_cols = disp_min.shape(1);
+    if (cv_in.ndim() != 1 || offsets.ndim() != 1 || offsets.shape(0) != static_cast<py::ssize_t>(nb_rows * nb_cols + 1) ||
+        offsets.at(0) < 0 || offsets.at(nb_rows * nb_cols) > cv_in.shape(0)) {
+        throw std::invalid_argument("cv_in must be a 1D array, with rows * cols + 1 offsets in it.");
+    }
+    const SgmInputs<T> inputs = {{cv_in.data(), {0, 0, 1}}, {nullptr, {0, 0, 0}}, {nullptr, {0, 0, 0}},
+                                 {nullptr, {0, 0, 0}}, {nullptr, nullptr, 0}, {nullptr, {0, 0, 0}}, nullptr, nullptr,
+                                 grids.first, grids.second, offsets.data()};
+    checkRaggedVolume(inputs, nb_rows, nb_cols, nb_disps, getNumThreads(num_threads));
+    T* dense = new T[nb_rows * nb_cols * nb_disps];
+    toDense(cv_in.data(), grids.first, grids.second, offsets.data(), nb_rows, nb_cols, nb_disps,
+            static_cast<T>(invalid_value), dense, getNumThreads(num_threads));
+    return ownedArray(dense, std::vector<size_t>{nb_rows, nb_cols, nb_disps});
+}
+
 //wrap as Python module
 PYBIND11_MODULE(c_libsgm, m)
 {
   m.doc() = "Wrapper module of sgm.cpp, a c++ module for sgm";
+  // Kernels are chosen at import, from LIBSGM_SIMD or cpuid
+  getSimdLevel();
+  m.def("simd_level",
+        []() { return simdLevelName(getSimdLevel()); },
+        R"pbdoc(
+            Instruction set of the aggregation kernels
+
+            :return: 'scalar', 'sse4.1', 'avx2' or 'avx512'
+            :rtype: str
+        )pbdoc"
+  );
+  m.def("set_simd_level",
+        [](const std::string & name) { setSimdLevel(parseSimdLevel(name)); },
+        py::arg("name"),
+        R"pbdoc(
+            Force the instruction set of the aggregation kernels, must be supported by the processor
+
+            :param name: 'scalar', 'sse4.1', 'avx2' or 'avx512'
+            :type name: str
+        )pbdoc"
+  );
   m.def("sgm_api",
         &pySgmApi<uint8_t, uint16_t>,
         "Compute aggregated cost volume following Semi-Global algorithm by Hirschmuller",
@@ -128,28 +634,102 @@ PYBIND11_MODULE(c_libsgm, m)
         py::arg("cost_paths") = false,
         py::arg("overcounting") = false,
         py::arg("edge_classification") = false,
+        py::arg("num_threads") = 1,
+        py::arg("concurrency") = "none",
+        py::arg("nb_partial_volumes") = 7,
+        py::arg("out") = py::none(),
+        py::arg("out_cv_min") = py::none(),
+        py::arg("accumulate") = false,
+        py::arg("p1_classes") = py::none(),
+        py::arg("p2_classes") = py::none(),
+        py::arg("guide") = py::none(),
+        py::arg("validity") = py::none(),
+        py::arg("disp_min") = py::none(),
+        py::arg("disp_max") = py::none(),
+        py::arg("offsets") = py::none(),
+        py::arg("disparity") = "none",
+        py::arg("keep_cv") = true,
+        py::arg("confidence") = std::vector<std::string>(),
+        py::arg("eta_max") = 0.f,
+        py::arg("eta_step") = 1.f,
         R"pbdoc(
             Python SGM wrapper
 
-            :param cv_in: Input cost volume
-            :type cv_in: uint8_t numpy ndarray
-            :param p1_in: p1 matrix
-            :type p1_in: uint8_t numpy ndarray
-            :param p2_in: p2 matrix
-            :type p2_in: uint8_t numpy ndarray
+            :param cv_in: Input cost volume, any strides: slices and transpositions are read without copy
+            :type cv_in: uint8_t numpy ndarray, 3D or 1D with offsets
+            :param p1_in: p1 matrix of shape (rows, cols, 8), or broadcastable to it: (8,) and (1, 1, 8) for the
+                          penalties of each direction, a scalar for all directions
+            :type p1_in: uint8_t numpy ndarray, scalar, or None with p1_classes
+            :param p2_in: p2 matrix, broadcastable as p1_in
+            :type p2_in: uint8_t numpy ndarray, scalar, or None with p2_classes
             :param directions: directions to explore
             :type directions: uint8_t numpy ndarray
             :param invalid_value: invalid value to use
             :type invalid_value: uint8_t
             :param segmentation: segmentation matrix
-            :type segmentation: uint8_t numpy ndarray
+            :type segmentation: float32, int32, int64, uint8 or bool numpy ndarray, integer and boolean maps are
+                                packed in history reset bits without conversion
             :param cost_paths: activate cost paths
             :type cost_paths: bool
             :param overcounting: activate overcounting
             :type overcounting: bool
             :param edge_classification: use segmentation as an edge classification
             :type edge_classification: bool
-            :return: ("cv": optimize cost volume, "cv_min": cost paths)
+            :param num_threads: number of threads, 1 for sequential aggregation, 0 for all available threads
+            :type num_threads: int
+            :param concurrency: tasks aggregated at the same time: 'none', 'passes' or 'directions'
+            :type concurrency: str
+            :param nb_partial_volumes: maximum number of private partial cost volumes for concurrent tasks
+            :type nb_partial_volumes: int
+            :param out: output cost volume written in place, e.g. a memmap or a shared memory buffer, allocated if None.
+                        It must not overlap cv_in
+            :type out: uint16 C-contiguous numpy ndarray of shape (rows, cols, disparities)
+            :param out_cv_min: output cost paths written in place, with cost_paths, allocated if None
+            :type out_cv_min: int32 C-contiguous numpy ndarray of shape (rows, cols, 8)
+            :param accumulate: add the aggregated costs to the values of out instead of resetting it
+            :type accumulate: bool
+            :param p1_classes: p1 penalties of each segmentation class and direction, used instead of p1_in:
+                               the segmentation labels are the integer indices of the classes
+            :type p1_classes: numpy ndarray of shape (classes, 8)
+            :param p2_classes: p2 penalties of each segmentation class and direction, used instead of p2_in
+            :type p2_classes: numpy ndarray of shape (classes, 8)
+            :param guide: guide image, e.g. the left image: P2 of each path step is divided by the intensity
+                          gradient |I(p) - I(p-r)| (if above 1), and kept at least P1
+            :type guide: float32 numpy ndarray of shape (rows, cols)
+            :param validity: validity of each point, 0 without invalid cost in its disparity interval, 1 with some,
+                             2 with only invalid costs: the points with only invalid costs are skipped and the
+                             paths restart after them.
+                             Derived from cv_in if None and invalid_value is NaN
+            :type validity: uint8 numpy ndarray of shape (rows, cols)
+            :param disp_min: first disparity of each point, as an index along the disparity axis of cv_in: the
+                             recurrence only runs over [disp_min, disp_max], the other costs are invalid
+            :type disp_min: integer numpy ndarray of shape (rows, cols), or broadcastable to it
+            :param disp_max: last disparity of each point, included, as an index along the disparity axis of cv_in
+            :type disp_max: integer numpy ndarray of shape (rows, cols), or broadcastable to it
+            :param offsets: ragged cost volume: cv_in is then the 1D array of the costs of the disparity intervals,
+                            the costs of the point p = col + row * cols being cv_in[offsets[p]:offsets[p + 1]].
+                            The aggregated volume has the same offsets; the aggregation is sequential, without
+                            concurrency. See ragged_offsets(), to_ragged() and to_dense()
+            :type offsets: int64 numpy ndarray of shape (rows * cols + 1,)
+            :param disparity: disparity map computed by the second pass from the final aggregated costs of each
+                              point: 'none', 'wta', or 'parabola' and 'v_shape' for the WTA disparity with a
+                              sub-pixel offset. The disparity is an index along the disparity axis, NaN without
+                              valid cost
+            :type disparity: str
+            :param keep_cv: return the aggregated cost volume, else "cv" is None and only the maps are kept
+            :type keep_cv: bool
+            :param confidence: confidence maps computed by the second pass from the final aggregated costs of each
+                               point: 'ambiguity', 'risk' (risk_min and risk_max), 'ratio' (lowest over second lowest
+                               cost) and 'path_agreement' (number of directions whose minimum is within one disparity
+                               of the lowest cost, with cost_paths)
+            :type confidence: list of str
+            :param eta_max: highest cost difference to the lowest cost of ambiguity and risk, in aggregated costs
+            :type eta_max: float
+            :param eta_step: step of the cost differences of ambiguity and risk, positive
+            :type eta_step: float
+            :return: ("cv": optimize cost volume, "cv_min": cost paths, "disp": float32 disparity map of shape
+                     (rows, cols) if disparity is not 'none', and a map of shape (rows, cols) for each confidence
+                     measure, float32 or uint8 for "path_agreement"), out and out_cv_min if given
             :rtype: dict
         )pbdoc"
   );
@@ -165,29 +745,317 @@ PYBIND11_MODULE(c_libsgm, m)
         py::arg("cost_paths") = false,
         py::arg("overcounting") = false,
         py::arg("edge_classification") = false,
+        py::arg("num_threads") = 1,
+        py::arg("concurrency") = "none",
+        py::arg("nb_partial_volumes") = 7,
+        py::arg("out") = py::none(),
+        py::arg("out_cv_min") = py::none(),
+        py::arg("accumulate") = false,
+        py::arg("p1_classes") = py::none(),
+        py::arg("p2_classes") = py::none(),
+        py::arg("guide") = py::none(),
+        py::arg("validity") = py::none(),
+        py::arg("disp_min") = py::none(),
+        py::arg("disp_max") = py::none(),
+        py::arg("offsets") = py::none(),
+        py::arg("disparity") = "none",
+        py::arg("keep_cv") = true,
+        py::arg("confidence") = std::vector<std::string>(),
+        py::arg("eta_max") = 0.f,
+        py::arg("eta_step") = 1.f,
         R"pbdoc(
             Python SGM wrapper
 
-            :param cv_in: Input cost volume
-            :type cv_in: float32 numpy ndarray
-            :param p1_in: p1 matrix
-            :type p1_in: float32 numpy ndarray
-            :param p2_in: p2 matrix
-            :type p2_in: float32 numpy ndarray
+            :param cv_in: Input cost volume, any strides: slices and transpositions are read without copy
+            :type cv_in: float32 numpy ndarray, 3D or 1D with offsets
+            :param p1_in: p1 matrix of shape (rows, cols, 8), or broadcastable to it: (8,) and (1, 1, 8) for the
+                          penalties of each direction, a scalar for all directions
+            :type p1_in: float32 numpy ndarray, scalar, or None with p1_classes
+            :param p2_in: p2 matrix, broadcastable as p1_in
+            :type p2_in: float32 numpy ndarray, scalar, or None with p2_classes
             :param directions: directions to explore
             :type directions: uint8_t numpy ndarray
             :param invalid_value: invalid value to use
             :type invalid_value: float32
             :param segmentation: segmentation matrix
-            :type segmentation: uint8_t numpy ndarray
+            :type segmentation: float32, int32, int64, uint8 or bool numpy ndarray, integer and boolean maps are
+                                packed in history reset bits without conversion
             :param cost_paths: activate cost paths
             :type cost_paths: bool
             :param overcounting: activate overcounting
             :type overcounting: bool
             :param edge_classification: use segmentation as an edge classification
             :type edge_classification: bool
-            :return: ("cv": optimize cost volume, "cv_min": cost paths)
+            :param num_threads: number of threads, 1 for sequential aggregation, 0 for all available threads
+            :type num_threads: int
+            :param concurrency: tasks aggregated at the same time: 'none', 'passes' or 'directions'
+            :type concurrency: str
+            :param nb_partial_volumes: maximum number of private partial cost volumes for concurrent tasks
+            :type nb_partial_volumes: int
+            :param out: output cost volume written in place, e.g. a memmap or a shared memory buffer, allocated if None.
+                        It must not overlap cv_in
+            :type out: float32 C-contiguous numpy ndarray of shape (rows, cols, disparities)
+            :param out_cv_min: output cost paths written in place, with cost_paths, allocated if None
+            :type out_cv_min: int32 C-contiguous numpy ndarray of shape (rows, cols, 8)
+            :param accumulate: add the aggregated costs to the values of out instead of resetting it
+            :type accumulate: bool
+            :param p1_classes: p1 penalties of each segmentation class and direction, used instead of p1_in:
+                               the segmentation labels are the integer indices of the classes
+            :type p1_classes: numpy ndarray of shape (classes, 8)
+            :param p2_classes: p2 penalties of each segmentation class and direction, used instead of p2_in
+            :type p2_classes: numpy ndarray of shape (classes, 8)
+            :param guide: guide image, e.g. the left image: P2 of each path step is divided by the intensity
+                          gradient |I(p) - I(p-r)| (if above 1), and kept at least P1
+            :type guide: float32 numpy ndarray of shape (rows, cols)
+            :param validity: validity of each point, 0 without invalid cost in its disparity interval, 1 with some,
+                             2 with only invalid costs: the points with only invalid costs are skipped and the
+                             paths restart after them.
+                             Derived from cv_in if None and invalid_value is NaN
+            :type validity: uint8 numpy ndarray of shape (rows, cols)
+            :param disp_min: first disparity of each point, as an index along the disparity axis of cv_in: the
+                             recurrence only runs over [disp_min, disp_max], the other costs are invalid
+            :type disp_min: integer numpy ndarray of shape (rows, cols), or broadcastable to it
+            :param disp_max: last disparity of each point, included, as an index along the disparity axis of cv_in
+            :type disp_max: integer numpy ndarray of shape (rows, cols), or broadcastable to it
+            :param offsets: ragged cost volume: cv_in is then the 1D array of the costs of the disparity intervals,
+                            the costs of the point p = col + row * cols being cv_in[offsets[p]:offsets[p + 1]].
+                            The aggregated volume has the same offsets; the aggregation is sequential, without
+                            concurrency. See ragged_offsets(), to_ragged() and to_dense()
+            :type offsets: int64 numpy ndarray of shape (rows * cols + 1,)
+            :param disparity: disparity map computed by the second pass from the final aggregated costs of each
+                              point: 'none', 'wta', or 'parabola' and 'v_shape' for the WTA disparity with a
+                              sub-pixel offset. The disparity is an index along the disparity axis, NaN without
+                              valid cost
+            :type disparity: str
+            :param keep_cv: return the aggregated cost volume, else "cv" is None and only the maps are kept
+            :type keep_cv: bool
+            :param confidence: confidence maps computed by the second pass from the final aggregated costs of each
+                               point: 'ambiguity', 'risk' (risk_min and risk_max), 'ratio' (lowest over second lowest
+                               cost) and 'path_agreement' (number of directions whose minimum is within one disparity
+                               of the lowest cost, with cost_paths)
+            :type confidence: list of str
+            :param eta_max: highest cost difference to the lowest cost of ambiguity and risk, in aggregated costs
+            :type eta_max: float
+            :param eta_step: step of the cost differences of ambiguity and risk, positive
+            :type eta_step: float
+            :return: ("cv": optimize cost volume, "cv_min": cost paths, "disp": float32 disparity map of shape
+                     (rows, cols) if disparity is not 'none', and a map of shape (rows, cols) for each confidence
+                     measure, float32 or uint8 for "path_agreement"), out and out_cv_min if given
             :rtype: dict
         )pbdoc"
   );
+  m.def("esgm_api",
+        &pyEsgmApi<uint8_t, uint16_t>,
+        "Compute the disparity map of the Semi-Global algorithm without the aggregated cost volume (eSGM)",
+        py::arg("cv_in").noconvert(),
+        py::arg("p1_in"),
+        py::arg("p2_in"),
+        py::arg("directions"),
+        py::arg("invalid_value"),
+        py::arg("segmentation"),
+        py::arg("overcounting") = false,
+        py::arg("edge_classification") = false,
+        py::arg("num_threads") = 1,
+        py::arg("p1_classes") = py::none(),
+        py::arg("p2_classes") = py::none(),
+        py::arg("guide") = py::none(),
+        py::arg("validity") = py::none(),
+        py::arg("disp_min") = py::none(),
+        py::arg("disp_max") = py::none(),
+        py::arg("offsets") = py::none(),
+        R"pbdoc(
+            Memory efficient SGM: the passes keep the best disparity of each point and its aggregated costs, the
+            aggregated cost volume is never allocated. The inputs are the ones of sgm_api.
+
+            :param cv_in: Input cost volume, any strides
+            :type cv_in: uint8 numpy ndarray, 3D or 1D with offsets
+            :return: ("disp": best disparity of each point as an index along the disparity axis, -1 without valid
+                     cost, "costs": aggregated costs at the best disparity - 1, the best disparity and the best
+                     disparity + 1, invalid_value out of the disparity axis)
+            :rtype: dict of int32 numpy ndarray of shape (rows, cols) and uint16 numpy ndarray of shape
+                    (rows, cols, 3)
+        )pbdoc"
+  );
+  m.def("esgm_api",
+        &pyEsgmApi<float, float>,
+        "Compute the disparity map of the Semi-Global algorithm without the aggregated cost volume (eSGM)",
+        py::arg("cv_in").noconvert(),
+        py::arg("p1_in"),
+        py::arg("p2_in"),
+        py::arg("directions"),
+        py::arg("invalid_value"),
+        py::arg("segmentation"),
+        py::arg("overcounting") = false,
+        py::arg("edge_classification") = false,
+        py::arg("num_threads") = 1,
+        py::arg("p1_classes") = py::none(),
+        py::arg("p2_classes") = py::none(),
+        py::arg("guide") = py::none(),
+        py::arg("validity") = py::none(),
+        py::arg("disp_min") = py::none(),
+        py::arg("disp_max") = py::none(),
+        py::arg("offsets") = py::none(),
+        R"pbdoc(
+            Memory efficient SGM: the passes keep the best disparity of each point and its aggregated costs, the
+            aggregated cost volume is never allocated. The inputs are the ones of sgm_api.
+
+            :param cv_in: Input cost volume, any strides
+            :type cv_in: float32 numpy ndarray, 3D or 1D with offsets
+            :return: ("disp": best disparity of each point as an index along the disparity axis, -1 without valid
+                     cost, "costs": aggregated costs at the best disparity - 1, the best disparity and the best
+                     disparity + 1, invalid_value out of the disparity axis)
+            :rtype: dict of int32 numpy ndarray of shape (rows, cols) and float32 numpy ndarray of shape
+                    (rows, cols, 3)
+        )pbdoc"
+  );
+  m.def("ragged_offsets",
+        &pyRaggedOffsets,
+        py::arg("disp_min"),
+        py::arg("disp_max"),
+        py::arg("nb_disps"),
+        R"pbdoc(
+            Offsets of a ragged cost volume, from the lengths of the disparity intervals clamped to [0, nb_disps)
+
+            :param disp_min: first disparity of each point, as an index along the disparity axis
+            :type disp_min: integer numpy ndarray of shape (rows, cols)
+            :param disp_max: last disparity of each point, included
+            :type disp_max: integer numpy ndarray of shape (rows, cols), or broadcastable to it
+            :param nb_disps: disparity number of the dense cost volume
+            :type nb_disps: int
+            :return: offsets, the costs of the point p = col + row * cols being [offsets[p], offsets[p + 1])
+            :rtype: int64 numpy ndarray of shape (rows * cols + 1,)
+        )pbdoc"
+  );
+  m.def("to_ragged",
+        &pyToRagged<uint8_t>,
+        py::arg("cv_in").noconvert(),
+        py::arg("disp_min"),
+        py::arg("disp_max"),
+        py::arg("num_threads") = 1,
+        R"pbdoc(
+            Pack the costs of the disparity intervals of a dense cost volume
+
+            :param cv_in: dense cost volume, any strides
+            :type cv_in: uint8 numpy ndarray of shape (rows, cols, disparities)
+            :param disp_min: first disparity of each point, as an index along the disparity axis of cv_in
+            :type disp_min: integer numpy ndarray of shape (rows, cols)
+            :param disp_max: last disparity of each point, included
+            :type disp_max: integer numpy ndarray of shape (rows, cols), or broadcastable to it
+            :param num_threads: number of threads, 0 for all available threads
+            :type num_threads: int
+            :return: ("cv": packed costs, "offsets": offsets of the points), cv_in and offsets of sgm_api
+            :rtype: dict
+        )pbdoc"
+  );
+  m.def("to_dense",
+        &pyToDense<uint8_t>,
+        py::arg("cv_in").noconvert(),
+        py::arg("offsets"),
+        py::arg("disp_min"),
+        py::arg("disp_max"),
+        py::arg("nb_disps"),
+        py::arg("invalid_value"),
+        py::arg("num_threads") = 1,
+        R"pbdoc(
+            Unpack a ragged cost volume, e.g. the output of sgm_api, in a dense one
+
+            :param cv_in: packed costs
+            :type cv_in: uint8 C-contiguous numpy ndarray
+            :param offsets: offsets of the points
+            :type offsets: int64 numpy ndarray of shape (rows * cols + 1,)
+            :param disp_min: first disparity of each point
+            :type disp_min: integer numpy ndarray of shape (rows, cols)
+            :param disp_max: last disparity of each point, included
+            :type disp_max: integer numpy ndarray of shape (rows, cols), or broadcastable to it
+            :param nb_disps: disparity number of the dense cost volume
+            :type nb_disps: int
+            :param invalid_value: value of the costs out of the intervals
+            :type invalid_value: float
+            :param num_threads: number of threads, 0 for all available threads
+            :type num_threads: int
+            :return: dense cost volume
+            :rtype: uint8 numpy ndarray of shape (rows, cols, nb_disps)
+        )pbdoc"
+  );
+  m.def("to_dense",
+        &pyToDense<uint16_t>,
+        py::arg("cv_in").noconvert(),
+        py::arg("offsets"),
+        py::arg("disp_min"),
+        py::arg("disp_max"),
+        py::arg("nb_disps"),
+        py::arg("invalid_value"),
+        py::arg("num_threads") = 1,
+        R"pbdoc(
+            Unpack a ragged cost volume, e.g. the output of sgm_api, in a dense one
+
+            :param cv_in: packed costs
+            :type cv_in: uint16 C-contiguous numpy ndarray
+            :param offsets: offsets of the points
+            :type offsets: int64 numpy ndarray of shape (rows * cols + 1,)
+            :param disp_min: first disparity of each point
+            :type disp_min: integer numpy ndarray of shape (rows, cols)
+            :param disp_max: last disparity of each point, included
+            :type disp_max: integer numpy ndarray of shape (rows, cols), or broadcastable to it
+            :param nb_disps: disparity number of the dense cost volume
+            :type nb_disps: int
+            :param invalid_value: value of the costs out of the intervals
+            :type invalid_value: float
+            :param num_threads: number of threads, 0 for all available threads
+            :type num_threads: int
+            :return: dense cost volume
+            :rtype: uint16 numpy ndarray of shape (rows, cols, nb_disps)
+        )pbdoc"
+  );
+  m.def("to_ragged",
+        &pyToRagged<float>,
+        py::arg("cv_in").noconvert(),
+        py::arg("disp_min"),
+        py::arg("disp_max"),
+        py::arg("num_threads") = 1,
+        R"pbdoc(
+            Pack the costs of the disparity intervals of a dense cost volume
+
+            :param cv_in: dense cost volume, any strides
+            :type cv_in: float32 numpy ndarray of shape (rows, cols, disparities)
+            :param disp_min: first disparity of each point, as an index along the disparity axis of cv_in
+            :type disp_min: integer numpy ndarray of shape (rows, cols)
+            :param disp_max: last disparity of each point, included
+            :type disp_max: integer numpy ndarray of shape (rows, cols), or broadcastable to it
+            :param num_threads: number of threads, 0 for all available threads
+            :type num_threads: int
+            :return: ("cv": packed costs, "offsets": offsets of the points), cv_in and offsets of sgm_api
+            :rtype: dict
+        )pbdoc"
+  );
+  m.def("to_dense",
+        &pyToDense<float>,
+        py::arg("cv_in").noconvert(),
+        py::arg("offsets"),
+        py::arg("disp_min"),
+        py::arg("disp_max"),
+        py::arg("nb_disps"),
+        py::arg("invalid_value"),
+        py::arg("num_threads") = 1,
+        R"pbdoc(
+            Unpack a ragged cost volume, e.g. the output of sgm_api, in a dense one
+
+            :param cv_in: packed costs
+            :type cv_in: float32 C-contiguous numpy ndarray
+            :param offsets: offsets of the points
+            :type offsets: int64 numpy ndarray of shape (rows * cols + 1,)
+            :param disp_min: first disparity of each point
+            :type disp_min: integer numpy ndarray of shape (rows, cols)
+            :param disp_max: last disparity of each point, included
+            :type disp_max: integer numpy ndarray of shape (rows, cols), or broadcastable to it
+            :param nb_disps: disparity number of the dense cost volume
+            :type nb_disps: int
+            :param invalid_value: value of the costs out of the intervals
+            :type invalid_value: float
+            :param num_threads: number of threads, 0 for all available threads
+            :type num_threads: int
+            :return: dense cost volume
+            :rtype: float32 numpy ndarray of shape (rows, cols, nb_disps)
+        )pbdoc"
+  );
 }
\ No newline at end of file
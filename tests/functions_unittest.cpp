@@ -18,8 +18,11 @@
  * limitations under the License.
  */
 
+#include <cmath>
+#include <numeric>
 #include "gtest/gtest.h"
 #include "../../src/libsgm_c/sgm.hpp"
+#include "../../src/libsgm_c/sgm_simd.hpp"
 
 // Global Test of sgm function: aggregation value from 8 directions on a middle point of cost volume
 // with invalid middle point and without over-counting correction
@@ -223,2581 +226,183 @@ TEST(sgmTest, TestMiddleValueOvercounting)
   EXPECT_EQ(58, cvs.cost_volume[13]);
 }
 
-// Test function aggregatedCostFromTopLeft0
+// Test function aggregatedCostFrom, along the 8 directions of the two passes
 
-// Test aggregation on cost Volume border
-TEST(aggregatedCostFromTopLeft0Test, borderValue)
-{
-
-  uint8_t pixel_0;
-  uint8_t min_disp0;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  uint8_t invalid_value = 57;
-  Direction direction = {0, 1};
-  bool edge_classification = false;
-
-  int row = 0;
-  int col = 0;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff0 = new uint8_t[nb_disps]();
-
-  // class variables
-  float class0 = 1;
-  float buff_class0 = 1; // same class for no piecewise optimization
-  float reset0 = 1;      // doesn'nt matter, disp==0
-
-  uint8_t costAggr = aggregatedCostFromTopLeft0(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff0, &min_disp0, &pixel_0, class0, buff_class0, reset0, edge_classification);
-
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset0);
-}
-
-TEST(aggregatedCostFromTopLeft0Test, resetWithEdgeClassification)
-{
-  uint8_t pixel_0;
-  uint8_t min_disp0;
-
-  uint8_t pixelCost = 20;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  uint8_t invalid_value = 57;
-
-  Direction direction = {0, 1};
-  bool edge_classification = true;
-
-  int row = 2;
-  int col = 2;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-
-  uint8_t *buff0 = new uint8_t[nb_disps];
-  buff0[0] = 50;
-  buff0[1] = 10;
-  buff0[2] = 40;
-
-  // set segmentation to trigger a reset
-  float class0 = 0;
-  float buff_class0 = 1;
-  float reset0 = 1; // didn't reset previously
-
-  uint8_t costAggr = aggregatedCostFromTopLeft0(
-      pixelCost,
-      row, col, disp,
-      invalid_value,
-      nb_rows, nb_cols, nb_disps,
-      P1, P2,
-      direction,
-      buff0,
-      &min_disp0,
-      &pixel_0,
-      class0,
-      buff_class0,
-      reset0,
-      edge_classification);
-
-  // Because we trigger reset, agg cost should equal pixel cost
-  EXPECT_EQ(pixelCost, costAggr);
-  EXPECT_EQ(0, reset0);
-  delete[] buff0;
-}
-
-// Test aggregation on cost Volume border and reset history
-TEST(aggregatedCostFromTopLeft0Test, borderValueResetHistory)
-{
-
-  uint8_t pixel_0;
-  uint8_t min_disp0;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  uint8_t invalid_value = 57;
-  Direction direction = {0, 1};
-
-  bool edge_classification = false;
-
-  int row = 0;
-  int col = 0;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff0 = new uint8_t[nb_disps]();
-
-  // class variables
-  float class0 = 1;
-  float buff_class0 = 2; // different class for piecewise optimization
-  float reset0 = 1;      // doesn't matter, disp==0 and not a workable pixel
-
-  uint8_t costAggr = aggregatedCostFromTopLeft0(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff0, &min_disp0, &pixel_0, class0, buff_class0, reset0, edge_classification);
-
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset0); // was not changed
-}
-
-// Test minimum value of the previous point
-TEST(aggregatedCostFromTopLeft0Test, findMinDisp)
-{
-
-  uint8_t pixel_0;
-  uint8_t min_disp0;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {0, 1};
-  uint8_t invalid_value = 57;
-
-  bool edge_classification = false;
-
-  int row = 1;
-  int col = 1;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff0 = new uint8_t[nb_disps]();
-  buff0[0] = 14;
-  buff0[1] = 28;
-  buff0[2] = 20;
-
-  // class variables
-  float class0 = 1;
-  float buff_class0 = 1; // same class for no piecewise optimization
-  float reset0 = 1;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft0(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff0, &min_disp0, &pixel_0, class0, buff_class0, reset0, edge_classification);
-
-  // pixel_0 = min(14,28,20)
-  EXPECT_EQ(14, min_disp0);
-  // costAggr = 15 + min(14 , 28 + 8 , 14 + 32) - 14 = 15
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset0);
-}
-
-// Test aggregation value of a non-border point
-TEST(aggregatedCostFromTopLeft0Test, aggregation)
-{
-
-  uint8_t pixel_0 = 14;
-  uint8_t min_disp0 = 14;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {0, 1};
-  uint8_t invalid_value = 57;
-
-  bool edge_classification = false;
-
-  int row = 1;
-  int col = 1;
-  int disp = 1;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff0 = new uint8_t[nb_disps]();
-  buff0[0] = 36;
-  buff0[1] = 28;
-  buff0[2] = 20;
-
-  // class variables
-  float class0 = 1;
-  float buff_class0 = 1; // same class for no piecewise optimization
-  float reset0 = 1;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft0(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff0, &min_disp0, &pixel_0, class0, buff_class0, reset0, edge_classification);
-
-  // costAggr = 15 + min ( 14+8 , 28 , 20 + 8 , 14+32) - 14 = 15+22-14 = 23
-  EXPECT_EQ(23, costAggr);
-  EXPECT_EQ(1, reset0);
-}
-
-// Test aggregation value of a non-border point and reset history with reset already computed
-TEST(aggregatedCostFromTopLeft0Test, aggregationResetHistory_disp1)
-{
-
-  uint8_t pixel_0 = 14;
-  uint8_t min_disp0 = 14;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {0, 1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 1;
-  int col = 1;
-  int disp = 1;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff0 = new uint8_t[nb_disps]();
-  buff0[0] = 36;
-  buff0[1] = 28;
-  buff0[2] = 20;
-
-  // class variables
-  float class0 = 1;
-  float buff_class0 = 2; // different class for  piecewise optimization and reset history
-  float reset0 = 0;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft0(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff0, &min_disp0, &pixel_0, class0, buff_class0, reset0, edge_classification);
-
-  // costAggr = 15 +  0 * min ( 14+8 , 28 , 20 + 8 , 14+32) - 14 = 15+22-14 = 23
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(0, reset0);
-}
-
-// Test aggregation value of a non-border point and reset history with update of reset
-TEST(aggregatedCostFromTopLeft0Test, aggregationResetHistory_disp0)
-{
-
-  uint8_t pixel_0 = 14;
-  uint8_t min_disp0 = 14;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {0, 1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 1;
-  int col = 1;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff0 = new uint8_t[nb_disps]();
-  buff0[0] = 36;
-  buff0[1] = 28;
-  buff0[2] = 20;
-
-  // class variables
-  float class0 = 1;
-  float buff_class0 = 2; // different class for  piecewise optimization and reset history
-  float reset0 = 1;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft0(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff0, &min_disp0, &pixel_0, class0, buff_class0, reset0, edge_classification);
-
-  // costAggr = 15 +  0 * min ( 14+8 , 28 , 20 + 8 , 14+32) - 14 = 15+22-14 = 23
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(0, reset0);
-}
-
-// Test aggregation value after an invalid point
-TEST(aggregatedCostFromTopLeft0Test, aggregationAfterInvalidPoint)
-{
-
-  uint8_t pixel_0;
-  uint8_t min_disp0;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {0, 1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 1;
-  int col = 1;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff0 = new uint8_t[nb_disps]();
-  buff0[0] = 57;
-  buff0[1] = 57;
-  buff0[2] = 57;
-
-  // class variables
-  float class0 = 1;
-  float buff_class0 = 1; // same class for no piecewise optimization
-  float reset0 = 1;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft0(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff0, &min_disp0, &pixel_0, class0, buff_class0, reset0, edge_classification);
-
-  // pixel_0 = min(14,28,20)
-  EXPECT_EQ(57, min_disp0);
-  // costAggr = 15 + min(14 , 28 + 8 , 14 + 32) - 14 = 15
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset0);
-}
-
-// Test function aggregatedCostFromTopLeft1
-
-// Test aggregation on cost Volume border
-TEST(aggregatedCostFromTopLeft1Test, borderValue)
-{
-
-  uint8_t pixel_1;
-  uint8_t min_disp1;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {1, 0};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 0;
-  int col = 0;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff1 = new uint8_t[nb_cols * nb_disps]();
-
-  // class variables
-  float class1 = 1;
-  float buff_class1[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset1 = 1;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft1(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff1, &min_disp1, &pixel_1, class1, buff_class1, reset1, edge_classification);
-
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset1);
-}
-
-TEST(aggregatedCostFromTopLeft1Test, resetWithEdgeClassification)
-{
-  uint8_t pixel_1;
-  uint8_t min_disp1;
-
-  uint8_t pixelCost = 20;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  uint8_t invalid_value = 57;
-
-  Direction direction = {1, 0};
-  bool edge_classification = true;
-
-  int row = 2;
-  int col = 2;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-
-  uint8_t *buff1 = new uint8_t[nb_cols * nb_disps];
-  buff1[col * nb_disps + 0] = 50;
-  buff1[col * nb_disps + 1] = 10;
-  buff1[col * nb_disps + 2] = 40;
-
-  float class1 = 0;
-  // only the pixel up is an edge
-  // this also allows us to check that we use the right pixel's classif (because direction is up)
-  float buff_class1[5] = {0, 0, 1, 0, 0}; 
-  float reset1 = 1;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft1(
-      pixelCost,
-      row, col, disp,
-      invalid_value,
-      nb_rows, nb_cols, nb_disps,
-      P1, P2,
-      direction,
-      buff1,
-      &min_disp1,
-      &pixel_1,
-      class1,
-      buff_class1,
-      reset1,
-      edge_classification);
-
-  EXPECT_EQ(pixelCost, costAggr);
-  EXPECT_EQ(0, reset1);
-  delete[] buff1;
-}
-
-// Test aggregation on cost Volume border
-TEST(aggregatedCostFromTopLeft1Test, borderValueResetHistory)
-{
-
-  uint8_t pixel_1;
-  uint8_t min_disp1;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {1, 0};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 0;
-  int col = 0;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff1 = new uint8_t[nb_cols * nb_disps]();
-
-  // class variables
-  float class1 = 1;
-  float buff_class1[5] = {0, 1, 1, 1, 1}; // different class for no piecewise optimization
-  float reset1 = 1;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft1(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff1, &min_disp1, &pixel_1, class1, buff_class1, reset1, edge_classification);
-
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset1); // unchanged
-}
-
-// Test minimum value of the previous point
-TEST(aggregatedCostFromTopLeft1Test, findMinDisp)
-{
-
-  uint8_t pixel_1;
-  uint8_t min_disp1;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {1, 0};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 1;
-  int col = 1;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff1 = new uint8_t[nb_cols * nb_disps]();
-  buff1[3] = 17;
-  buff1[4] = 45;
-  buff1[5] = 32;
-
-  // class variables
-  float class1 = 1;
-  float buff_class1[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset1 = 1;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft1(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff1, &min_disp1, &pixel_1, class1, buff_class1, reset1, edge_classification);
-
-  EXPECT_EQ(17, min_disp1);
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset1);
-}
-
-// Test aggregation value of a non-border point
-TEST(aggregatedCostFromTopLeft1Test, aggregation)
-{
-
-  uint8_t pixel_1 = 30;
-  uint8_t min_disp1 = 28;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {1, 0};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 1;
-  int col = 1;
-  int disp = 1;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff1 = new uint8_t[nb_disps]();
-  buff1[3] = 52;
-  buff1[4] = 28;
-  buff1[5] = 32;
-
-  // class variables
-  float class1 = 1;
-  float buff_class1[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset1 = 1;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft1(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff1, &min_disp1, &pixel_1, class1, buff_class1, reset1, edge_classification);
-
-  // costAggr = 15 + min(30+8 , 28 , 32+8 , 28+32) -28
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset1);
-}
-
-// Test aggregation value of a non-border point and reset history, with reset already computed
-TEST(aggregatedCostFromTopLeft1Test, aggregationResetHistory_disp1)
-{
-
-  uint8_t pixel_1 = 30;
-  uint8_t min_disp1 = 26;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {1, 0};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 1;
-  int col = 1;
-  int disp = 1;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff1 = new uint8_t[nb_disps]();
-  buff1[3] = 52;
-  buff1[4] = 28;
-  buff1[5] = 32;
-
-  // class variables
-  float class1 = 1;
-  float buff_class1[5] = {1, 1, 1, 1, 1}; // unused
-  float reset1 = 0;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft1(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff1, &min_disp1, &pixel_1, class1, buff_class1, reset1, edge_classification);
-
-  // costAggr = 15 + min(30+8 , 28 , 32+8 , 28+32) -26
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(0, reset1);
-}
-
-// Test aggregation value of a non-border point and reset history, and update reset
-TEST(aggregatedCostFromTopLeft1Test, aggregationResetHistory_disp0)
-{
-
-  uint8_t pixel_1 = 30;
-  uint8_t min_disp1 = 26;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {1, 0};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 1;
-  int col = 1;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff1 = new uint8_t[nb_disps]();
-  buff1[3] = 52;
-  buff1[4] = 28;
-  buff1[5] = 32;
-
-  // class variables
-  float class1 = 1;
-  float buff_class1[5] = {1, 2, 1, 1, 1}; // different class for  piecewise optimization
-  float reset1 = 1;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft1(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff1, &min_disp1, &pixel_1, class1, buff_class1, reset1, edge_classification);
-
-  // costAggr = 15 + min(30+8 , 28 , 32+8 , 28+32) -26
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(0, reset1);
-}
-
-// Test aggregation value after an invalid point
-TEST(aggregatedCostFromTopLeft1Test, aggregationAfterInvalidPoint)
-{
-
-  uint8_t pixel_1;
-  uint8_t min_disp1;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {1, 0};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 1;
-  int col = 1;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff1 = new uint8_t[nb_cols * nb_disps]();
-  buff1[3] = 57;
-  buff1[4] = 57;
-  buff1[5] = 57;
-
-  // class variables
-  float class1 = 1;
-  float buff_class1[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset1 = 1;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft1(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff1, &min_disp1, &pixel_1, class1, buff_class1, reset1, edge_classification);
-
-  EXPECT_EQ(57, min_disp1);
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset1);
-}
-
-// Test function aggregatedCostFromTopLeft2
-
-// Test aggregation on cost Volume border
-TEST(aggregatedCostFromTopLeft2Test, borderValue)
-{
-
-  uint8_t pixel_2;
-  uint8_t min_disp2;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {1, 1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 0;
-  int col = 0;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff2 = new uint8_t[nb_cols * nb_disps]();
-  uint8_t *buff_disp_2 = new uint8_t[nb_disps]();
-
-  // class variables
-  float class2 = 1;
-  float buff_class2[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset2 = 1;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft2(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff2, buff_disp_2, &min_disp2, &pixel_2, class2, buff_class2, reset2, edge_classification);
-
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset2);
-}
-
-TEST(aggregatedCostFromTopLeft2Test, resetWithEdgeClassification)
-{
-  uint8_t pixel_2;
-  uint8_t min_disp2;
-
-  uint8_t pixelCost = 20;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  uint8_t invalid_value = 57;
-
-  Direction direction = {1, 1};
-  bool edge_classification = true;
-
-  int row = 2;
-  int col = 2;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-
-  uint8_t *buff2 = new uint8_t[nb_cols * nb_disps];
-  buff2[col * nb_disps + 0] = 50;
-  buff2[col * nb_disps + 1] = 10;
-  buff2[col * nb_disps + 2] = 40;
-  uint8_t *buff_disp_2 = new uint8_t[nb_disps];
-
-  float class2 = 0;
-  // only the pixel left-up is an edge
-  // this also allows us to check that we use the right pixel's classif (because direction is left-up)
-  float buff_class2[5] = {0, 1, 0, 0, 0}; 
-  float reset2 = 1;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft2(
-      pixelCost,
-      row, col, disp,
-      invalid_value,
-      nb_rows, nb_cols, nb_disps,
-      P1, P2,
-      direction,
-      buff2,
-      buff_disp_2,
-      &min_disp2,
-      &pixel_2,
-      class2,
-      buff_class2,
-      reset2,
-      edge_classification);
-
-  EXPECT_EQ(pixelCost, costAggr);
-  EXPECT_EQ(0, reset2);
-  delete[] buff2;
-  delete[] buff_disp_2;
-}
-
-// Test aggregation on cost Volume border
-TEST(aggregatedCostFromTopLeft2Test, borderValueResetHistory)
-{
-
-  uint8_t pixel_2;
-  uint8_t min_disp2;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {1, 1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 0;
-  int col = 0;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff2 = new uint8_t[nb_cols * nb_disps]();
-  uint8_t *buff_disp_2 = new uint8_t[nb_disps]();
-
-  // class variables
-  float class2 = 1;
-  float buff_class2[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset2 = 0;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft2(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff2, buff_disp_2, &min_disp2, &pixel_2, class2, buff_class2, reset2, edge_classification);
-
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(0, reset2); // unchanged
-}
-
-// Test minimum value of the previous point
-TEST(aggregatedCostFromTopLeft2Test, findMinDisp)
-{
-
-  uint8_t pixel_2;
-  uint8_t min_disp2;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {1, 1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 1;
-  int col = 1;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff2 = new uint8_t[nb_cols * nb_disps]();
-  uint8_t *buff_disp_2 = new uint8_t[nb_disps]();
-  buff_disp_2[0] = 52;
-  buff_disp_2[1] = 28;
-  buff_disp_2[2] = 32;
-
-  // class variables
-  float class2 = 1;
-  float buff_class2[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset2 = 1;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft2(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff2, buff_disp_2, &min_disp2, &pixel_2, class2, buff_class2, reset2, edge_classification);
-
-  EXPECT_EQ(28, min_disp2);
-  // costAggr = 15 + min(52 , 28+8,32+28) - 28
-  EXPECT_EQ(23, costAggr);
-  EXPECT_EQ(1, reset2);
-}
-
-// Test aggregation value of a non-border point
-TEST(aggregatedCostFromTopLeft2Test, aggregation)
-{
-
-  uint8_t pixel_2 = 30;
-  uint8_t min_disp2 = 28;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {1, 1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 1;
-  int col = 1;
-  int disp = 1;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff2 = new uint8_t[nb_cols * nb_disps]();
-  uint8_t *buff_disp_2 = new uint8_t[nb_disps]();
-
-  buff_disp_2[0] = 52;
-  buff_disp_2[1] = 28;
-  buff_disp_2[2] = 32;
-
-  // class variables
-  float class2 = 1;
-  float buff_class2[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset2 = 1;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft2(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff2, buff_disp_2, &min_disp2, &pixel_2, class2, buff_class2, reset2, edge_classification);
-
-  // costAggr = 15 + min(30+8 , 28 , 32+8 , 28+32) -28
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset2);
-}
-
-// Test aggregation value of a non-border point and reset history, reset already computed
-TEST(aggregatedCostFromTopLeft2Test, aggregationResetHistory_disp1)
-{
-
-  uint8_t pixel_2 = 30;
-  uint8_t min_disp2 = 26;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {1, 1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 1;
-  int col = 1;
-  int disp = 1;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff2 = new uint8_t[nb_cols * nb_disps]();
-  uint8_t *buff_disp_2 = new uint8_t[nb_disps]();
-
-  buff_disp_2[0] = 52;
-  buff_disp_2[1] = 28;
-  buff_disp_2[2] = 32;
-
-  // class variables
-  float class2 = 1;
-  float buff_class2[5] = {1, 1, 1, 1, 1}; // unused
-  float reset2 = 0;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft2(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff2, buff_disp_2, &min_disp2, &pixel_2, class2, buff_class2, reset2, edge_classification);
-
-  // costAggr = 15 + min(30+8 , 28 , 32+8 , 28+32) -26
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(0, reset2);
-}
-
-// Test aggregation value of a non-border point and reset history, update reset
-TEST(aggregatedCostFromTopLeft2Test, aggregationResetHistory_disp0)
-{
-
-  uint8_t pixel_2 = 30;
-  uint8_t min_disp2 = 26;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {1, 1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 1;
-  int col = 1;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff2 = new uint8_t[nb_cols * nb_disps]();
-  uint8_t *buff_disp_2 = new uint8_t[nb_disps]();
-
-  buff_disp_2[0] = 52;
-  buff_disp_2[1] = 28;
-  buff_disp_2[2] = 32;
-
-  // class variables
-  float class2 = 1;
-  float buff_class2[5] = {2, 1, 1, 1, 1}; // different for  piecewise optimization
-  float reset2 = 1;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft2(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff2, buff_disp_2, &min_disp2, &pixel_2, class2, buff_class2, reset2, edge_classification);
-
-  // costAggr = 15 + min(30+8 , 28 , 32+8 , 28+32) -26
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(0, reset2);
-}
-
-// Test aggregation value after an invalid point
-TEST(aggregatedCostFromTopLeft2Test, aggregationAfterInvalidPoint)
-{
-
-  uint8_t pixel_2;
-  uint8_t min_disp2;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {1, 1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 1;
-  int col = 1;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff2 = new uint8_t[nb_cols * nb_disps]();
-  uint8_t *buff_disp_2 = new uint8_t[nb_disps]();
-  buff_disp_2[0] = 57;
-  buff_disp_2[1] = 57;
-  buff_disp_2[2] = 57;
-
-  // class variables
-  float class2 = 1;
-  float buff_class2[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset2 = 1;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft2(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff2, buff_disp_2, &min_disp2, &pixel_2, class2, buff_class2, reset2, edge_classification);
-
-  EXPECT_EQ(57, min_disp2);
-  // costAggr = 15 + min(52 , 28+8,32+28) - 28
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset2);
-}
-
-// Test function aggregatedCostFromTopLeft3
-
-// Test aggregation on cost Volume border
-TEST(aggregatedCostFromTopLeft3Test, borderValue)
-{
-
-  uint8_t min_disp3;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {1, -1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 1;
-  int col = 4;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff3 = new uint8_t[nb_cols * nb_disps]();
-
-  // class variables
-  float class3 = 1;
-  float buff_class3[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset3 = 1;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft3(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff3, &min_disp3, class3, buff_class3, reset3, edge_classification);
-
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset3);
-}
-
-TEST(aggregatedCostFromTopLeft3Test, resetWithEdgeClassification)
-{
-  uint8_t min_disp3;
-
-  uint8_t pixelCost = 20;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  uint8_t invalid_value = 57;
-
-  Direction direction = {1, -1};
-  bool edge_classification = true;
-
-  int row = 2;
-  int col = 2;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-
-  uint8_t *buff3 = new uint8_t[nb_cols * nb_disps];
-
-  int prev_col = col + 1;
-
-  buff3[prev_col * nb_disps + 0] = 50;
-  buff3[prev_col * nb_disps + 1] = 10;
-  buff3[prev_col * nb_disps + 2] = 40;
-
-  float class3 = 0;
-
-  float buff_class3[5] = {0, 0, 0, 1, 0};
-
-  float reset3 = 1;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft3(
-      pixelCost,
-      row, col, disp,
-      invalid_value,
-      nb_rows, nb_cols, nb_disps,
-      P1, P2,
-      direction,
-      buff3,
-      &min_disp3,
-      class3,
-      buff_class3,
-      reset3,
-      edge_classification);
-
-  EXPECT_EQ(pixelCost, costAggr);
-  EXPECT_EQ(0, reset3);
-  delete[] buff3;
-}
-
-// Test aggregation on cost Volume border
-TEST(aggregatedCostFromTopLeft3Test, borderValueResetHistory)
-{
-
-  uint8_t min_disp3;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {1, -1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 1;
-  int col = 4;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff3 = new uint8_t[nb_cols * nb_disps]();
-
-  // class variables
-  float class3 = 1;
-  float buff_class3[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset3 = 0;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft3(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff3, &min_disp3, class3, buff_class3, reset3, edge_classification);
-
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(0, reset3); // unchanged
-}
-
-// Test minimum value of the previous point
-TEST(aggregatedCostFromTopLeft3Test, findMinDisp)
-{
-
-  uint8_t min_disp3;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {1, -1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 1;
-  int col = 3;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff3 = new uint8_t[nb_cols * nb_disps]();
-  buff3[12] = 14;
-  buff3[13] = 28;
-  buff3[14] = 20;
-
-  // class variables
-  float class3 = 1;
-  float buff_class3[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset3 = 1;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft3(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff3, &min_disp3, class3, buff_class3, reset3, edge_classification);
-
-  // pixel_0 = min(14,28,20)
-  EXPECT_EQ(14, min_disp3);
-  // costAggr = 15 + min(14 , 28 + 8 , 14 + 32) - 14 = 15
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset3);
-}
-
-// Test aggregation value of a non-border point
-TEST(aggregatedCostFromTopLeft3Test, aggregation)
-{
-
-  uint8_t min_disp3 = 14;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {1, -1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 1;
-  int col = 3;
-  int disp = 1;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff3 = new uint8_t[nb_cols * nb_disps]();
-  buff3[12] = 14;
-  buff3[13] = 28;
-  buff3[14] = 20;
-
-  // class variables
-  float class3 = 1;
-  float buff_class3[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset3 = 1;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft3(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff3, &min_disp3, class3, buff_class3, reset3, edge_classification);
-
-  // costAggr = 15 + min ( 14+8 , 28 , 20 + 8 , 14+32) - 14 = 15+22-14 = 23
-  EXPECT_EQ(23, costAggr);
-  EXPECT_EQ(1, reset3);
-}
-
-// Test aggregation value of a non-border point and reset history, reset already computed
-TEST(aggregatedCostFromTopLeft3Test, aggregationResetHistory_disp1)
-{
-
-  uint8_t min_disp3 = 14;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {1, -1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 1;
-  int col = 3;
-  int disp = 1;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff3 = new uint8_t[nb_cols * nb_disps]();
-  buff3[12] = 14;
-  buff3[13] = 28;
-  buff3[14] = 20;
-
-  // class variables
-  float class3 = 1;
-  float buff_class3[5] = {1, 1, 1, 1, 1}; // unused
-  float reset3 = 0;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft3(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff3, &min_disp3, class3, buff_class3, reset3, edge_classification);
-
-  // costAggr = 15 + min ( 14+8 , 28 , 20 + 8 , 14+32) - 14 = 15+22-14 = 23
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(0, reset3);
-}
-
-// Test aggregation value of a non-border point and reset history, updated reset
-TEST(aggregatedCostFromTopLeft3Test, aggregationResetHistory_disp0)
-{
-
-  uint8_t min_disp3 = 14;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {1, -1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 1;
-  int col = 3;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff3 = new uint8_t[nb_cols * nb_disps]();
-  buff3[12] = 14;
-  buff3[13] = 28;
-  buff3[14] = 20;
-
-  // class variables
-  float class3 = 1;
-  float buff_class3[5] = {1, 1, 1, 1, 2}; // same class for no piecewise optimization
-  float reset3 = 1;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft3(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff3, &min_disp3, class3, buff_class3, reset3, edge_classification);
-
-  // costAggr = 15 + min ( 14+8 , 28 , 20 + 8 , 14+32) - 14 = 15+22-14 = 23
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(0, reset3);
-}
-
-// Test aggregation value after an invalid point
-TEST(aggregatedCostFromTopLeft3Test, aggregationAfterInvalidPoint)
-{
-
-  uint8_t min_disp3;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {1, -1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 1;
-  int col = 3;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff3 = new uint8_t[nb_cols * nb_disps]();
-  buff3[12] = 57;
-  buff3[13] = 57;
-  buff3[14] = 57;
-
-  // class variables
-  float class3 = 1;
-  float buff_class3[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset3 = 1;
-
-  uint8_t costAggr = aggregatedCostFromTopLeft3(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                P1, P2, direction, buff3, &min_disp3, class3, buff_class3, reset3, edge_classification);
-
-  EXPECT_EQ(57, min_disp3);
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset3);
-}
-
-// Test function aggregatedCostFromBottomRight4
-
-// Test aggregation on cost Volume border
-TEST(aggregatedCostFromBottomRight4Test, borderValue)
-{
-
-  uint8_t pixel_4;
-  uint8_t min_disp4;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {0, -1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 4;
-  int col = 4;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff4 = new uint8_t[nb_disps]();
-
-  // class variables
-  float class4 = 1;
-  float buff_class4 = 1; // same class for no piecewise optimization
-  float reset4 = 1;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight4(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff4, &min_disp4, &pixel_4, class4, buff_class4, reset4, edge_classification);
-
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset4);
-}
-
-// Test aggregation on cost Volume border
-TEST(aggregatedCostFromBottomRight4Test, borderValueResetHistory)
-{
-
-  uint8_t pixel_4;
-  uint8_t min_disp4;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {0, -1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 4;
-  int col = 4;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff4 = new uint8_t[nb_disps]();
-
-  // class variables
-  float class4 = 1;
-  float buff_class4 = 2; // different class for  piecewise optimization
-  float reset4 = 1;      // doesnt matter, disp ==0
-
-  uint8_t costAggr = aggregatedCostFromBottomRight4(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff4, &min_disp4, &pixel_4, class4, buff_class4, reset4, edge_classification);
-
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset4); // was not changed
-}
-
-TEST(aggregatedCostFromBottomRight4Test, resetWithEdgeClassification)
-{
-  uint8_t pixel_4;
-  uint8_t min_disp4;
-
-  uint8_t pixelCost = 20;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  uint8_t invalid_value = 57;
-
-  Direction direction = {0, -1};
-  bool edge_classification = true;
-
-  int row = 2;
-  int col = 2;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-
-  uint8_t *buff4 = new uint8_t[nb_disps];
-
-  buff4[0] = 50;
-  buff4[1] = 10;
-  buff4[2] = 40;
-
-  float class4 = 0;
-  float buff_class4 = 1;
-  float reset4 = 1;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight4(
-      pixelCost, row, col, disp,
-      invalid_value,
-      nb_rows, nb_cols, nb_disps,
-      P1, P2,
-      direction,
-      buff4,
-      &min_disp4,
-      &pixel_4,
-      class4,
-      buff_class4,
-      reset4,
-      edge_classification);
-
-  EXPECT_EQ(pixelCost, costAggr);
-  EXPECT_EQ(0, reset4);
-
-  delete[] buff4;
-}
-
-// Test minimum value of the previous point
-TEST(aggregatedCostFromBottomRight4Test, findMinDisp)
-{
-
-  uint8_t pixel_4;
-  uint8_t min_disp4;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {0, -1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 3;
-  int col = 3;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff4 = new uint8_t[nb_disps]();
-  buff4[0] = 14;
-  buff4[1] = 28;
-  buff4[2] = 20;
-
-  // class variables
-  float class4 = 1;
-  float buff_class4 = 1; // same class for no piecewise optimization
-  float reset4 = 1;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight4(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff4, &min_disp4, &pixel_4, class4, buff_class4, reset4, edge_classification);
-
-  // pixel_0 = min(14,28,20)
-  EXPECT_EQ(14, min_disp4);
-  // costAggr = 15 + min(14 , 28 + 8 , 14 + 32) - 14 = 15
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset4);
-}
-
-// Test aggregation value of a non-border point
-TEST(aggregatedCostFromBottomRight4Test, aggregation)
-{
-
-  uint8_t pixel_4 = 14;
-  uint8_t min_disp4 = 14;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {0, -1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 3;
-  int col = 3;
-  int disp = 1;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff4 = new uint8_t[nb_disps]();
-  buff4[0] = 36;
-  buff4[1] = 28;
-  buff4[2] = 20;
-
-  // class variables
-  float class4 = 1;
-  float buff_class4 = 1; // same class for no piecewise optimization
-  float reset4 = 1;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight4(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff4, &min_disp4, &pixel_4, class4, buff_class4, reset4, edge_classification);
-
-  // costAggr = 15 + min ( 14+8 , 28 , 20 + 8 , 14+32) - 14 = 15+22-14 = 23
-  EXPECT_EQ(23, costAggr);
-  EXPECT_EQ(1, reset4);
-}
-
-// Test aggregation value of a non-border point, reset history, reset already computed
-TEST(aggregatedCostFromBottomRight4Test, aggregationResetHistory_disp1)
-{
-
-  uint8_t pixel_4 = 14;
-  uint8_t min_disp4 = 14;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {0, -1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 3;
-  int col = 3;
-  int disp = 1;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff4 = new uint8_t[nb_disps]();
-  buff4[0] = 36;
-  buff4[1] = 28;
-  buff4[2] = 20;
-
-  // class variables
-  float class4 = 1;
-  float buff_class4 = 2; // different class for no piecewise optimization, disp > 0, doesnt matter
-  float reset4 = 0;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight4(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff4, &min_disp4, &pixel_4, class4, buff_class4, reset4, edge_classification);
-
-  // costAggr = 15 + 0 * min ( 14+8 , 28 , 20 + 8 , 14+32) - 14 = 15+22-14 = 23
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(0, reset4);
-}
-
-// Test aggregation value of a non-border point, reset history, update reset
-TEST(aggregatedCostFromBottomRight4Test, aggregationResetHistory_disp0)
-{
-
-  uint8_t pixel_4 = 14;
-  uint8_t min_disp4 = 14;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {0, -1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 3;
-  int col = 3;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff4 = new uint8_t[nb_disps]();
-  buff4[0] = 36;
-  buff4[1] = 28;
-  buff4[2] = 20;
-
-  // class variables
-  float class4 = 1;
-  float buff_class4 = 2; // different class for no piecewise optimization
-  float reset4 = 1;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight4(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff4, &min_disp4, &pixel_4, class4, buff_class4, reset4, edge_classification);
-
-  // costAggr = 15 + 0 * min ( 14+8 , 28 , 20 + 8 , 14+32) - 14 = 15+22-14 = 23
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(0, reset4);
-}
-
-// Test aggregation value after an invalid point
-TEST(aggregatedCostFromBottomRight4Test, aggregationAfterInvalidPoint)
-{
-
-  uint8_t pixel_4;
-  uint8_t min_disp4;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {0, -1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 3;
-  int col = 3;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff4 = new uint8_t[nb_disps]();
-  buff4[0] = 57;
-  buff4[1] = 57;
-  buff4[2] = 57;
-
-  // class variables
-  float class4 = 1;
-  float buff_class4 = 1; // same class for no piecewise optimization
-  float reset4 = 1;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight4(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff4, &min_disp4, &pixel_4, class4, buff_class4, reset4, edge_classification);
-
-  EXPECT_EQ(57, min_disp4);
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset4);
-}
-
-// Test fucntion aggregatedCostFromBottomRight5
-
-// Test aggregation on cost Volume border
-TEST(aggregatedCostFromBottomRight5Test, borderValue)
-{
-
-  uint8_t pixel_5;
-  uint8_t min_disp5;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {-1, 0};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 4;
-  int col = 4;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff5 = new uint8_t[nb_cols * nb_disps]();
-
-  // class variables
-  float class5 = 1;
-  float buff_class5[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset5 = 1;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight5(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff5, &min_disp5, &pixel_5, class5, buff_class5, reset5, edge_classification);
-
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset5);
-}
-
-TEST(aggregatedCostFromBottomRight5Test, resetWithEdgeClassification)
-{
-  uint8_t pixel_5;
-  uint8_t min_disp5;
-
-  uint8_t pixelCost = 20;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  uint8_t invalid_value = 57;
-
-  Direction direction = {-1, 0};
-  bool edge_classification = true;
-
-  int row = 2;
-  int col = 2;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-
-  uint8_t *buff5 = new uint8_t[nb_cols * nb_disps];
-
-  int prev_col = col;
-
-  buff5[prev_col * nb_disps + 0] = 50;
-  buff5[prev_col * nb_disps + 1] = 10;
-  buff5[prev_col * nb_disps + 2] = 40;
-
-  float class5 = 0;
-  float buff_class5[5] = {0, 0, 1, 0, 0};
-  float reset5 = 1;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight5(
-      pixelCost, row, col, disp,
-      invalid_value,
-      nb_rows, nb_cols, nb_disps,
-      P1, P2,
-      direction,
-      buff5,
-      &min_disp5,
-      &pixel_5,
-      class5,
-      buff_class5,
-      reset5,
-      edge_classification);
-
-  EXPECT_EQ(pixelCost, costAggr);
-  EXPECT_EQ(0, reset5);
-
-  delete[] buff5;
-}
-
-// Test aggregation on cost Volume border
-TEST(aggregatedCostFromBottomRight5Test, borderValueResetHistory)
-{
-
-  uint8_t pixel_5;
-  uint8_t min_disp5;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {-1, 0};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 4;
-  int col = 4;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff5 = new uint8_t[nb_cols * nb_disps]();
-
-  // class variables
-  float class5 = 1;
-  float buff_class5[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset5 = 0;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight5(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff5, &min_disp5, &pixel_5, class5, buff_class5, reset5, edge_classification);
-
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(0, reset5); // unchanged
-}
-
-// Test minimum value of the previous point
-TEST(aggregatedCostFromBottomRight5Test, findMinDisp)
-{
-
-  uint8_t pixel_5;
-  uint8_t min_disp5;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {-1, 0};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 3;
-  int col = 3;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff5 = new uint8_t[nb_cols * nb_disps]();
-  buff5[9] = 17;
-  buff5[10] = 45;
-  buff5[11] = 32;
-
-  // class variables
-  float class5 = 1;
-  float buff_class5[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset5 = 1;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight5(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff5, &min_disp5, &pixel_5, class5, buff_class5, reset5, edge_classification);
-
-  EXPECT_EQ(17, min_disp5);
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset5);
-}
-
-// Test aggregation value of a non-border point
-TEST(aggregatedCostFromBottomRight5Test, aggregation)
-{
-
-  uint8_t pixel_5 = 30;
-  uint8_t min_disp5 = 28;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {-1, 0};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 3;
-  int col = 3;
-  int disp = 1;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff5 = new uint8_t[nb_disps]();
-  buff5[9] = 52;
-  buff5[10] = 28;
-  buff5[11] = 32;
-
-  // class variables
-  float class5 = 1;
-  float buff_class5[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset5 = 1;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight5(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff5, &min_disp5, &pixel_5, class5, buff_class5, reset5, edge_classification);
-  // costAggr = 15 + min(30+8 , 28 , 32+8 , 28+32) -28
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset5);
-}
-
-// Test aggregation value of a non-border point, reset histroy,reset already computed
-TEST(aggregatedCostFromBottomRight5Test, aggregationResetHistory_disp1)
-{
-
-  uint8_t pixel_5 = 30;
-  uint8_t min_disp5 = 26;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {-1, 0};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 3;
-  int col = 3;
-  int disp = 1;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff5 = new uint8_t[nb_disps]();
-  buff5[9] = 52;
-  buff5[10] = 28;
-  buff5[11] = 32;
-
-  // class variables
-  float class5 = 1;
-  float buff_class5[5] = {1, 1, 1, 1, 1}; // unused
-  float reset5 = 0;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight5(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff5, &min_disp5, &pixel_5, class5, buff_class5, reset5, edge_classification);
-  // costAggr = 15 + min(30+8 , 28 , 32+8 , 28+32) -26
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(0, reset5);
-}
-
-// Test aggregation value of a non-border point, reset history, update reset
-TEST(aggregatedCostFromBottomRight5Test, aggregationResetHistory_disp0)
-{
-
-  uint8_t pixel_5 = 30;
-  uint8_t min_disp5 = 26;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {-1, 0};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 3;
-  int col = 3;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff5 = new uint8_t[nb_disps]();
-  buff5[9] = 52;
-  buff5[10] = 28;
-  buff5[11] = 32;
-
-  // class variables
-  float class5 = 1;
-  float buff_class5[5] = {1, 1, 1, 2, 1}; // different class
-  float reset5 = 1;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight5(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff5, &min_disp5, &pixel_5, class5, buff_class5, reset5, edge_classification);
-  // costAggr = 15 + min(30+8 , 28 , 32+8 , 28+32) -26
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(0, reset5);
-}
-
-// Test aggregation value after an invalid point
-TEST(aggregatedCostFromBottomRight5Test, aggregationAfterInvalidPoint)
-{
-
-  uint8_t pixel_5;
-  uint8_t min_disp5;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {-1, 0};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 3;
-  int col = 3;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff5 = new uint8_t[nb_cols * nb_disps]();
-  buff5[9] = 57;
-  buff5[10] = 57;
-  buff5[11] = 57;
-
-  // class variables
-  float class5 = 1;
-  float buff_class5[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset5 = 1;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight5(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff5, &min_disp5, &pixel_5, class5, buff_class5, reset5, edge_classification);
-
-  EXPECT_EQ(57, min_disp5);
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset5);
-}
-
-// Test function aggregatedCostFromBottomRight6
-
-// Test aggregation on cost Volume border
-TEST(aggregatedCostFromBottomRight6Test, borderValue)
-{
-
-  uint8_t pixel_6;
-  uint8_t min_disp6;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {-1, -1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 4;
-  int col = 4;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff6 = new uint8_t[nb_cols * nb_disps]();
-  uint8_t *buff_disp_6 = new uint8_t[nb_disps]();
-
-  // class variables
-  float class6 = 1;
-  float buff_class6[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset6 = 1;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight6(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff6, buff_disp_6, &min_disp6, &pixel_6, class6, buff_class6, reset6, edge_classification);
-
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset6);
-}
-
-TEST(aggregatedCostFromBottomRight6Test, resetWithEdgeClassification)
-{
-  uint8_t pixel_6;
-  uint8_t min_disp6;
-
-  uint8_t pixelCost = 20;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  uint8_t invalid_value = 57;
-
-  Direction direction = {-1, -1};
-  bool edge_classification = true;
-
-  int row = 2;
-  int col = 2;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-
-  uint8_t *buff6 = new uint8_t[nb_cols * nb_disps];
-  uint8_t *buff_disp_6 = new uint8_t[nb_disps];
-
-  int prev_col = col + 1;
-
-  buff6[prev_col * nb_disps + 0] = 50;
-  buff6[prev_col * nb_disps + 1] = 10;
-  buff6[prev_col * nb_disps + 2] = 40;
-
-  float class6 = 0;
-  float buff_class6[5] = {0, 0, 0, 1, 0};
-  float reset6 = 1;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight6(
-      pixelCost, row, col, disp,
-      invalid_value,
-      nb_rows, nb_cols, nb_disps,
-      P1, P2,
-      direction,
-      buff6,
-      buff_disp_6,
-      &min_disp6,
-      &pixel_6,
-      class6,
-      buff_class6,
-      reset6,
-      edge_classification);
-
-  EXPECT_EQ(pixelCost, costAggr);
-  EXPECT_EQ(0, reset6);
-
-  delete[] buff6;
-  delete[] buff_disp_6;
-}
-
-// Test aggregation on cost Volume border
-TEST(aggregatedCostFromBottomRight6Test, borderValueResetHistory)
-{
-
-  uint8_t pixel_6;
-  uint8_t min_disp6;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {-1, -1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 4;
-  int col = 4;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff6 = new uint8_t[nb_cols * nb_disps]();
-  uint8_t *buff_disp_6 = new uint8_t[nb_disps]();
-
-  // class variables
-  float class6 = 1;
-  float buff_class6[5] = {1, 1, 1, 1, 1}; // unused
-  float reset6 = 0;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight6(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff6, buff_disp_6, &min_disp6, &pixel_6, class6, buff_class6, reset6, edge_classification);
-
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(0, reset6); // unchanged
-}
-
-// Test minimum value of the previous point
-TEST(aggregatedCostFromBottomRight6Test, findMinDisp)
-{
-
-  uint8_t pixel_6;
-  uint8_t min_disp6;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {-1, -1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 3;
-  int col = 3;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff6 = new uint8_t[nb_cols * nb_disps]();
-  uint8_t *buff_disp_6 = new uint8_t[nb_disps]();
-  buff_disp_6[0] = 52;
-  buff_disp_6[1] = 28;
-  buff_disp_6[2] = 32;
-
-  // class variables
-  float class6 = 1;
-  float buff_class6[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset6 = 1;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight6(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff6, buff_disp_6, &min_disp6, &pixel_6, class6, buff_class6, reset6, edge_classification);
-
-  EXPECT_EQ(28, min_disp6);
-  // costAggr = 15 + min(52 , 28+8,32+28) - 28
-  EXPECT_EQ(23, costAggr);
-  EXPECT_EQ(1, reset6);
-}
-
-// Test aggregation value of a non-border point
-TEST(aggregatedCostFromBottomRight6Test, aggregation)
-{
-
-  uint8_t pixel_6 = 30;
-  uint8_t min_disp6 = 28;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {-1, -1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 3;
-  int col = 3;
-  int disp = 1;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff6 = new uint8_t[nb_cols * nb_disps]();
-  uint8_t *buff_disp_6 = new uint8_t[nb_disps]();
-
-  buff_disp_6[0] = 52;
-  buff_disp_6[1] = 28;
-  buff_disp_6[2] = 32;
-
-  // class variables
-  float class6 = 1;
-  float buff_class6[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset6 = 1;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight6(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff6, buff_disp_6, &min_disp6, &pixel_6, class6, buff_class6, reset6, edge_classification);
-
-  // costAggr = 15 + min(30+8 , 28 , 32+8 , 28+32) -28
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset6);
-}
-
-// Test aggregation value of a non-border point, reset history, with reset already computed
-TEST(aggregatedCostFromBottomRight6Test, aggregationResetHistory_disp1)
-{
-
-  uint8_t pixel_6 = 30;
-  uint8_t min_disp6 = 28;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {-1, -1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 3;
-  int col = 3;
-  int disp = 1;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff6 = new uint8_t[nb_cols * nb_disps]();
-  uint8_t *buff_disp_6 = new uint8_t[nb_disps]();
-
-  buff_disp_6[0] = 52;
-  buff_disp_6[1] = 28;
-  buff_disp_6[2] = 32;
-
-  // class variables
-  float class6 = 1;
-  float buff_class6[5] = {1, 1, 1, 1, 1}; // unused
-  float reset6 = 0;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight6(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff6, buff_disp_6, &min_disp6, &pixel_6, class6, buff_class6, reset6, edge_classification);
-
-  // costAggr = 15 + min(30+8 , 28 , 32+8 , 28+32) -28
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(0, reset6);
-}
-
-// Test aggregation value of a non-border point, reset history, update reset
-TEST(aggregatedCostFromBottomRight6Test, aggregationResetHistory_disp0)
-{
-
-  uint8_t pixel_6 = 30;
-  uint8_t min_disp6 = 28;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {-1, -1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 3;
-  int col = 3;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff6 = new uint8_t[nb_cols * nb_disps]();
-  uint8_t *buff_disp_6 = new uint8_t[nb_disps]();
-
-  buff_disp_6[0] = 52;
-  buff_disp_6[1] = 28;
-  buff_disp_6[2] = 32;
-
-  // class variables
-  float class6 = 1;
-  float buff_class6[5] = {1, 1, 1, 1, 2}; // same class for no piecewise optimization ( diagonal from left, but array is  reversed)
-  float reset6 = 1;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight6(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff6, buff_disp_6, &min_disp6, &pixel_6, class6, buff_class6, reset6, edge_classification);
-
-  // costAggr = 15 + min(30+8 , 28 , 32+8 , 28+32) -28
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(0, reset6);
-}
-
-// Test aggregation value after an invalid point
-TEST(aggregatedCostFromBottomRight6Test, aggregationAfterInvalidPoint)
-{
-
-  uint8_t pixel_6;
-  uint8_t min_disp6;
+const Direction pass_directions[8] = {{0, 1}, {1, 0}, {1, 1}, {1, -1}, {0, -1}, {-1, 0}, {-1, -1}, {-1, 1}};
 
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {-1, -1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 3;
-  int col = 3;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff6 = new uint8_t[nb_cols * nb_disps]();
-  uint8_t *buff_disp_6 = new uint8_t[nb_disps]();
-  buff_disp_6[0] = 57;
-  buff_disp_6[1] = 57;
-  buff_disp_6[2] = 57;
-
-  // class variables
-  float class6 = 1;
-  float buff_class6[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset6 = 1;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight6(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff6, buff_disp_6, &min_disp6, &pixel_6, class6, buff_class6, reset6, edge_classification);
-
-  EXPECT_EQ(57, min_disp6);
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset6);
-}
-
-// Test function aggregatedCostFromBottomRight7
-
-// Test aggregation on cost Volume border
-TEST(aggregatedCostFromBottomRight7Test, borderValue)
-{
-
-  uint8_t min_disp7;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {-1, 1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 4;
-  int col = 0;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff7 = new uint8_t[nb_cols * nb_disps]();
-
-  // class variables
-  float class7 = 1;
-  float buff_class7[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset7 = 1;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight7(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff7, &min_disp7, class7, buff_class7, reset7, edge_classification);
-
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset7);
+/*
+ * Aggregate the point (row, col) of a 5 x 5 x 3 cost volume along a direction, with P1 = 8, P2 = 32 and
+ * invalid_value = 57. The previous point, if any, has the aggregated costs previous_lr and the class previous_class.
+ * Without reset, the segmentation map is not given.
+ */
+std::vector<uint8_t> aggregateAlong(int dir, long long row, long long col, const std::vector<uint8_t> &previous_lr,
+                                    float current_class, float previous_class, ResetMode reset,
+                                    uint8_t pixel_cost = 15)
+{
+  const long long nb_rows = 5;
+  const long long nb_cols = 5;
+  const unsigned int nb_disps = 3;
+  const Direction direction = pass_directions[dir];
+
+  std::vector<uint8_t> cv_in(nb_rows * nb_cols * nb_disps, pixel_cost);
+  std::vector<uint8_t> p1(nb_rows * nb_cols * 8, 8);
+  std::vector<uint8_t> p2(nb_rows * nb_cols * 8, 32);
+  std::vector<float> segmentation(nb_rows * nb_cols, previous_class);
+  segmentation[col + row * nb_cols] = current_class;
+
+  // Two lines of aggregated costs indexed by row parity, containing the previous point
+  std::vector<uint8_t> lines(2 * nb_cols * nb_disps, 0);
+  std::vector<uint8_t> line_mins(2 * nb_cols, 0);
+  const long long previous_row = row - direction.drow;
+  const long long previous_col = col - direction.dcol;
+  if (previous_row >= 0 && previous_row < nb_rows && previous_col >= 0 && previous_col < nb_cols)
+  {
+    std::copy(previous_lr.begin(), previous_lr.end(),
+              lines.begin() + ((previous_row & 1) * nb_cols + previous_col) * nb_disps);
+    line_mins[(previous_row & 1) * nb_cols + previous_col] = *std::min_element(previous_lr.begin(), previous_lr.end());
+  }
+
+  uint8_t min_lr;
+  const float *segmentation_map = (reset == RESET_NONE) ? nullptr : segmentation.data();
+  SgmInputs<uint8_t> inputs =
+      contiguousInputs<uint8_t>(cv_in.data(), p1.data(), p2.data(), segmentation_map, nb_cols, nb_disps);
+  // History resets are read in the masks packed from the segmentation
+  std::vector<uint8_t> reset_masks(nb_rows * nb_cols, 0);
+  if (reset != RESET_NONE)
+  {
+    resetMasks(inputs.segmentation, pass_directions, nb_rows, nb_cols, reset == RESET_EDGES, reset_masks.data(), 1);
+    inputs.reset_masks = reset_masks.data();
+  }
+  const uint8_t *lr = directionKernel<uint8_t>(direction, reset)(&cv_in[(col + row * nb_cols) * nb_disps], inputs,
+                                                                 row, col, nb_rows, nb_cols, nb_disps, 57, dir,
+                                                                 simdKernels<uint8_t, uint8_t>(nb_disps),
+                                                                 {lines.data(), line_mins.data()}, min_lr);
+  // Minimum is tracked along the aggregation, and stored for the next point
+  EXPECT_EQ(*std::min_element(lr, lr + nb_disps), min_lr);
+  EXPECT_EQ(min_lr, line_mins[(row & 1) * nb_cols + col]);
+  return std::vector<uint8_t>(lr, lr + nb_disps);
+}
+
+// Test aggregation on cost Volume border: no previous point
+TEST(aggregatedCostFromTest, borderValue)
+{
+  for (int dir = 0; dir < 8; dir++)
+  {
+    const long long row = (pass_directions[dir].drow > 0) ? 0 : (pass_directions[dir].drow < 0) ? 4 : 2;
+    const long long col = (pass_directions[dir].dcol > 0) ? 0 : (pass_directions[dir].dcol < 0) ? 4 : 2;
+    // same class for no piecewise optimization
+    EXPECT_EQ(std::vector<uint8_t>({15, 15, 15}), aggregateAlong(dir, row, col, {50, 10, 40}, 1, 1, RESET_CLASSES))
+        << "direction " << dir;
+  }
 }
 
-TEST(aggregatedCostFromBottomRight7Test, resetWithEdgeClassification)
+// Test aggregation on cost Volume border and reset history
+TEST(aggregatedCostFromTest, borderValueResetHistory)
 {
-  uint8_t min_disp7;
-
-  uint8_t pixelCost = 20;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  uint8_t invalid_value = 57;
-
-  Direction direction = {-1, 1};
-  bool edge_classification = true;
-
-  int row = 2;
-  int col = 2;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-
-  uint8_t *buff7 = new uint8_t[nb_cols * nb_disps];
-
-  int prev_col = col - 1;
-
-  buff7[prev_col * nb_disps + 0] = 50;
-  buff7[prev_col * nb_disps + 1] = 10;
-  buff7[prev_col * nb_disps + 2] = 40;
-
-  float class7 = 0;
-  float buff_class7[5] = {0, 1, 0, 0, 0};
-  float reset7 = 1;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight7(
-      pixelCost, row, col, disp,
-      invalid_value,
-      nb_rows, nb_cols, nb_disps,
-      P1, P2,
-      direction,
-      buff7,
-      &min_disp7,
-      class7,
-      buff_class7,
-      reset7,
-      edge_classification);
-
-  EXPECT_EQ(pixelCost, costAggr);
-  EXPECT_EQ(0, reset7);
-
-  delete[] buff7;
+  for (int dir = 0; dir < 8; dir++)
+  {
+    const long long row = (pass_directions[dir].drow > 0) ? 0 : (pass_directions[dir].drow < 0) ? 4 : 2;
+    const long long col = (pass_directions[dir].dcol > 0) ? 0 : (pass_directions[dir].dcol < 0) ? 4 : 2;
+    // different class for piecewise optimization
+    EXPECT_EQ(std::vector<uint8_t>({15, 15, 15}), aggregateAlong(dir, row, col, {50, 10, 40}, 1, 2, RESET_CLASSES))
+        << "direction " << dir;
+  }
 }
 
-// Test aggregation on cost Volume border
-TEST(aggregatedCostFromBottomRight7Test, borderValueResetHistory)
+TEST(aggregatedCostFromTest, resetWithEdgeClassification)
 {
-
-  uint8_t min_disp7;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {-1, 1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 4;
-  int col = 0;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff7 = new uint8_t[nb_cols * nb_disps]();
-
-  // class variables
-  float class7 = 1;
-  float buff_class7[5] = {1, 1, 1, 1, 1}; // unused
-  float reset7 = 0;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight7(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff7, &min_disp7, class7, buff_class7, reset7, edge_classification);
-
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(0, reset7); // unchanged
+  for (int dir = 0; dir < 8; dir++)
+  {
+    // previous point is an edge: reset, aggregated cost equals pixel cost
+    EXPECT_EQ(std::vector<uint8_t>({20, 20, 20}), aggregateAlong(dir, 2, 2, {50, 10, 40}, 0, 1, RESET_EDGES, 20))
+        << "direction " << dir;
+    // previous point is not an edge: costAggr = 20 + min(10 + 8, 50, 40 + 8, 10 + 32) - 10 = 28, 20, 28
+    EXPECT_EQ(std::vector<uint8_t>({28, 20, 28}), aggregateAlong(dir, 2, 2, {50, 10, 40}, 1, 0, RESET_EDGES, 20))
+        << "direction " << dir;
+  }
 }
 
 // Test minimum value of the previous point
-TEST(aggregatedCostFromBottomRight7Test, findMinDisp)
+TEST(aggregatedCostFromTest, findMinDisp)
 {
-
-  uint8_t min_disp7;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {-1, 1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 3;
-  int col = 1;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff7 = new uint8_t[nb_cols * nb_disps]();
-  buff7[0] = 14;
-  buff7[1] = 28;
-  buff7[2] = 20;
-
-  // class variables
-  float class7 = 1;
-  float buff_class7[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset7 = 1;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight7(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff7, &min_disp7, class7, buff_class7, reset7, edge_classification);
-  // pixel_0 = min(14,28,20)
-  EXPECT_EQ(14, min_disp7);
-  // costAggr = 15 + min(14 , 28 + 8 , 14 + 32) - 14 = 15
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset7);
+  for (int dir = 0; dir < 8; dir++)
+  {
+    // min_disp = min(14, 28, 20) = 14
+    // costAggr = 15 + min(14, 28 + 8, 14 + 32) - 14 = 15
+    // costAggr = 15 + min(14 + 8, 28, 20 + 8, 14 + 32) - 14 = 23
+    // costAggr = 15 + min(28 + 8, 20, 14 + 32) - 14 = 21
+    EXPECT_EQ(std::vector<uint8_t>({15, 23, 21}), aggregateAlong(dir, 2, 2, {14, 28, 20}, 1, 1, RESET_CLASSES))
+        << "direction " << dir;
+  }
 }
 
 // Test aggregation value of a non-border point
-TEST(aggregatedCostFromBottomRight7Test, aggregation)
+TEST(aggregatedCostFromTest, aggregation)
 {
-
-  uint8_t min_disp7 = 14;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {-1, 1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 3;
-  int col = 1;
-  int disp = 1;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff7 = new uint8_t[nb_cols * nb_disps]();
-  buff7[0] = 14;
-  buff7[1] = 28;
-  buff7[2] = 20;
-
-  // class variables
-  float class7 = 1;
-  float buff_class7[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset7 = 1;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight7(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff7, &min_disp7, class7, buff_class7, reset7, edge_classification);
-
-  // costAggr = 15 + min ( 14+8 , 28 , 20 + 8 , 14+32) - 14 = 15+22-14 = 23
-  EXPECT_EQ(23, costAggr);
-  EXPECT_EQ(1, reset7);
+  for (int dir = 0; dir < 8; dir++)
+  {
+    // costAggr = 15 + min(36, 28 + 8, 20 + 32) - 20 = 31
+    // costAggr = 15 + min(36 + 8, 28, 20 + 8, 20 + 32) - 20 = 23
+    // costAggr = 15 + min(28 + 8, 20, 20 + 32) - 20 = 15
+    EXPECT_EQ(std::vector<uint8_t>({31, 23, 15}), aggregateAlong(dir, 1, 3, {36, 28, 20}, 1, 1, RESET_CLASSES))
+        << "direction " << dir;
+  }
 }
 
-// Test aggregation value of a non-border point, reset history, reset already computed
-TEST(aggregatedCostFromBottomRight7Test, aggregationResetHistory_disp1)
+// Without reset, the classes are not read and history is kept
+TEST(aggregatedCostFromTest, aggregationWithoutSegmentation)
 {
-
-  uint8_t min_disp7 = 14;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {-1, 1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 3;
-  int col = 1;
-  int disp = 1;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff7 = new uint8_t[nb_cols * nb_disps]();
-  buff7[0] = 14;
-  buff7[1] = 28;
-  buff7[2] = 20;
-
-  // class variables
-  float class7 = 1;
-  float buff_class7[5] = {1, 1, 1, 1, 1}; // unused
-  float reset7 = 0;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight7(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff7, &min_disp7, class7, buff_class7, reset7, edge_classification);
-
-  // costAggr = 15 +  0 * min ( 14+8 , 28 , 20 + 8 , 14+32) - 14 = 15
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(0, reset7);
+  for (int dir = 0; dir < 8; dir++)
+  {
+    EXPECT_EQ(std::vector<uint8_t>({31, 23, 15}), aggregateAlong(dir, 2, 2, {36, 28, 20}, 1, 2, RESET_NONE))
+        << "direction " << dir;
+  }
 }
 
-// Test aggregation value of a non-border point, reset history, update reset
-TEST(aggregatedCostFromBottomRight7Test, aggregationResetHistory_disp0)
+// Test aggregation value of a non-border point and reset history
+TEST(aggregatedCostFromTest, aggregationResetHistory)
 {
-
-  uint8_t min_disp7 = 14;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {-1, 1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 3;
-  int col = 1;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff7 = new uint8_t[nb_cols * nb_disps]();
-  buff7[0] = 14;
-  buff7[1] = 28;
-  buff7[2] = 20;
-
-  // class variables
-  float class7 = 1;
-  float buff_class7[5] = {2, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset7 = 1;
-
-  uint8_t costAggr = aggregatedCostFromBottomRight7(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff7, &min_disp7, class7, buff_class7, reset7, edge_classification);
-
-  // costAggr = 15 + 0 *  min ( 14+8 , 28 , 20 + 8 , 14+32) - 14 = 15
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(0, reset7);
+  for (int dir = 0; dir < 8; dir++)
+  {
+    // different class for piecewise optimization and reset history
+    EXPECT_EQ(std::vector<uint8_t>({15, 15, 15}), aggregateAlong(dir, 2, 2, {36, 28, 20}, 1, 2, RESET_CLASSES))
+        << "direction " << dir;
+  }
 }
 
 // Test aggregation value after an invalid point
-TEST(aggregatedCostFromBottomRight7Test, aggregationAfterInvalidPoint)
+TEST(aggregatedCostFromTest, aggregationAfterInvalidPoint)
 {
+  for (int dir = 0; dir < 8; dir++)
+  {
+    // min_disp = 57, costAggr = 15 + min(57, 57 + 8, 57 + 32) - 57 = 15
+    EXPECT_EQ(std::vector<uint8_t>({15, 15, 15}), aggregateAlong(dir, 2, 2, {57, 57, 57}, 1, 1, RESET_CLASSES))
+        << "direction " << dir;
+  }
+}
 
-  uint8_t min_disp7;
-
-  uint8_t pixelCost = 15;
-  uint8_t P1 = 8;
-  uint8_t P2 = 32;
-  Direction direction = {-1, 1};
-  uint8_t invalid_value = 57;
-  bool edge_classification = false;
-
-  int row = 3;
-  int col = 1;
-  int disp = 0;
-
-  int nb_rows = 5;
-  int nb_cols = 5;
-  int nb_disps = 3;
-  uint8_t *buff7 = new uint8_t[nb_cols * nb_disps]();
-  buff7[0] = 57;
-  buff7[1] = 57;
-  buff7[2] = 57;
-
-  // class variables
-  float class7 = 1;
-  float buff_class7[5] = {1, 1, 1, 1, 1}; // same class for no piecewise optimization
-  float reset7 = 1;
+// Test aggregation value of an invalid point
+TEST(aggregatedCostFromTest, invalidPoint)
+{
+  for (int dir = 0; dir < 8; dir++)
+  {
+    EXPECT_EQ(std::vector<uint8_t>({57, 57, 57}), aggregateAlong(dir, 2, 2, {36, 28, 20}, 1, 1, RESET_CLASSES, 57))
+        << "direction " << dir;
+  }
+}
 
-  uint8_t costAggr = aggregatedCostFromBottomRight7(pixelCost, row, col, disp, invalid_value, nb_rows, nb_cols, nb_disps,
-                                                    P1, P2, direction, buff7, &min_disp7, class7, buff_class7, reset7, edge_classification);
+TEST(aggregatedCostFromTest, invalidDirections)
+{
+  EXPECT_THROW(directionKernel<uint8_t>({0, 0}, RESET_CLASSES), std::invalid_argument);
+  EXPECT_THROW(directionKernel<float>({2, 1}, RESET_NONE), std::invalid_argument);
 
-  EXPECT_EQ(57, min_disp7);
-  EXPECT_EQ(15, costAggr);
-  EXPECT_EQ(1, reset7);
+  Direction directions[8];
+  std::copy(pass_directions, pass_directions + 8, directions);
+  EXPECT_NO_THROW(checkDirections(directions));
+  directions[3] = {0, 0};
+  EXPECT_THROW(checkDirections(directions), std::invalid_argument);
+  directions[3] = {-1, 2};
+  EXPECT_THROW(checkDirections(directions), std::invalid_argument);
 }
 
 // Global Test of sgm function, input float cost volume: aggregation value from 8 directions on a middle point of cost volume
@@ -3066,9 +671,2047 @@ TEST(sgmTestFloat, TestEdgesCostVolumeValue)
   EXPECT_EQ(-0.7f * 7.f - 0.2f, cvs.cost_volume[13]);
 }
 
+// Helpers for the tests comparing the aggregation engines on bigger cost volumes
+
+// Fill values with reproducible pseudo-random integers in [0, max_value)
+template <typename T>
+void fillRandom(T *values, unsigned long int nb_values, unsigned int max_value, unsigned int seed)
+{
+  for (unsigned long int i = 0; i < nb_values; i++)
+  {
+    seed = seed * 1103515245u + 12345u;
+    values[i] = static_cast<T>((seed >> 16) % max_value);
+  }
+}
+
+// Compare the multithreaded engine to the sequential two passes
+template <typename T, typename Tout>
+void compareToSequential(int num_threads, bool cost_paths, bool overcounting, bool edge_classification,
+                         Concurrency concurrency = CONCURRENCY_NONE, unsigned int nb_partial_volumes = 7,
+                         unsigned long int nb_row = 23, unsigned long int nb_col = 17)
+{
+  const unsigned int nb_disp = 11;
+  const unsigned long int nb_values = nb_row * nb_col * nb_disp;
+  const T invalid_value = 57;
+
+  T *cv_in = new T[nb_values];
+  T *p1 = new T[nb_row * nb_col * 8];
+  T *p2 = new T[nb_row * nb_col * 8];
+  float *segmentation = new float[nb_row * nb_col];
+  fillRandom(cv_in, nb_values, 60, 1);
+  fillRandom(p1, nb_row * nb_col * 8, 4, 2);
+  fillRandom(p2, nb_row * nb_col * 8, 20, 3);
+  fillRandom(segmentation, nb_row * nb_col, 3, 4);
+  for (unsigned long int i = 0; i < nb_row * nb_col * 8; i++)
+  {
+    p1[i] += 4;
+    p2[i] += 12;
+  }
+  int directions[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+
+  CostVolumes<Tout> sequential = sgm<T, Tout>(cv_in, p1, p2, directions, nb_row, nb_col, nb_disp, invalid_value, segmentation,
+                                              cost_paths, overcounting, edge_classification, 1);
+  CostVolumes<Tout> parallel = sgm<T, Tout>(cv_in, p1, p2, directions, nb_row, nb_col, nb_disp, invalid_value, segmentation,
+                                            cost_paths, overcounting, edge_classification, num_threads, concurrency,
+                                            nb_partial_volumes);
+
+  for (unsigned long int i = 0; i < nb_values; i++)
+  {
+    ASSERT_NEAR(sequential.cost_volume[i], parallel.cost_volume[i], 1e-3) << "at index " << i;
+  }
+  if (cost_paths)
+  {
+    for (unsigned long int i = 0; i < nb_row * nb_col * 8; i++)
+    {
+      ASSERT_EQ(sequential.cost_volume_min[i], parallel.cost_volume_min[i]) << "at index " << i;
+    }
+  }
+
+  delete[] sequential.cost_volume;
+  delete[] sequential.cost_volume_min;
+  delete[] parallel.cost_volume;
+  delete[] parallel.cost_volume_min;
+  delete[] cv_in;
+  delete[] p1;
+  delete[] p2;
+  delete[] segmentation;
+}
+
+// Multithreaded engine must give the same aggregation as the sequential two passes
+
+TEST(sgmMultithreadTest, sameAsSequential)
+{
+  compareToSequential<uint8_t, uint16_t>(4, false, false, false);
+  compareToSequential<float, float>(4, false, false, false);
+}
+
+TEST(sgmMultithreadTest, sameAsSequentialCostPathsOvercounting)
+{
+  compareToSequential<uint8_t, uint16_t>(3, true, true, false);
+  compareToSequential<float, float>(3, true, true, false);
+}
+
+TEST(sgmMultithreadTest, sameAsSequentialEdgeClassification)
+{
+  compareToSequential<uint8_t, uint16_t>(2, true, true, true);
+  compareToSequential<float, float>(2, true, true, true);
+}
+
+// All available threads
+TEST(sgmMultithreadTest, allThreads)
+{
+  compareToSequential<uint8_t, uint16_t>(0, true, false, false);
+  EXPECT_GE(getNumThreads(0), 1);
+  EXPECT_EQ(1, getNumThreads(1));
+}
+
+// Wavefronts on narrow, wide and single line cost volumes
+
+TEST(sgmMultithreadTest, wavefrontShapes)
+{
+  compareToSequential<uint8_t, uint16_t>(3, true, true, false, CONCURRENCY_NONE, 7, 40, 3);
+  compareToSequential<uint8_t, uint16_t>(3, true, true, false, CONCURRENCY_NONE, 7, 2, 41);
+  compareToSequential<float, float>(4, true, true, true, CONCURRENCY_NONE, 7, 1, 9);
+  compareToSequential<float, float>(4, true, false, false, CONCURRENCY_NONE, 7, 9, 1);
+}
+
+// Wavefronts keep the summation order of the sequential passes: same float values
+
+TEST(sgmMultithreadTest, wavefrontExactFloat)
+{
+  const unsigned long int nb_row = 13;
+  const unsigned long int nb_col = 19;
+  const unsigned int nb_disp = 7;
+  float cv_in[nb_row * nb_col * nb_disp];
+  float p1[nb_row * nb_col * 8];
+  float p2[nb_row * nb_col * 8];
+  float segmentation[nb_row * nb_col];
+  fillRandom(cv_in, nb_row * nb_col * nb_disp, 100, 5);
+  for (unsigned long int i = 0; i < nb_row * nb_col * nb_disp; i++)
+  {
+    cv_in[i] = cv_in[i] / 7.f - 3.f;
+  }
+  for (unsigned long int i = 0; i < nb_row * nb_col * 8; i++)
+  {
+    p1[i] = 0.3f;
+    p2[i] = 1.1f;
+  }
+  fillRandom(segmentation, nb_row * nb_col, 2, 6);
+  int directions[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+
+  CostVolumes<float> sequential = sgm<float, float>(cv_in, p1, p2, directions, nb_row, nb_col, nb_disp, 5.f, segmentation,
+                                                    false, true, false, 1);
+  CostVolumes<float> wavefront = sgm<float, float>(cv_in, p1, p2, directions, nb_row, nb_col, nb_disp, 5.f, segmentation,
+                                                   false, true, false, 5);
+  for (unsigned long int i = 0; i < nb_row * nb_col * nb_disp; i++)
+  {
+    ASSERT_EQ(sequential.cost_volume[i], wavefront.cost_volume[i]) << "at index " << i;
+  }
+  delete[] sequential.cost_volume;
+  delete[] sequential.cost_volume_min;
+  delete[] wavefront.cost_volume;
+  delete[] wavefront.cost_volume_min;
+}
+
+// Directions against the scan order of their pass cannot be aggregated on wavefronts
+
+TEST(sgmMultithreadTest, checkPassDirections)
+{
+  Direction direction[8];
+  int directions[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+  assignDirections(directions, direction);
+  EXPECT_NO_THROW(checkPassDirections(direction));
+
+  // right to left in the first pass
+  int reversed[2 * 8] = {0, -1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+  assignDirections(reversed, direction);
+  EXPECT_THROW(checkPassDirections(direction), std::invalid_argument);
+
+  // two rows above
+  int far[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -2, 0, -1, -1, -1, 1};
+  assignDirections(far, direction);
+  EXPECT_THROW(checkPassDirections(direction), std::invalid_argument);
+}
+
+// Concurrent passes or directions must give the same aggregation as the sequential two passes
+
+TEST(sgmConcurrencyTest, concurrentPasses)
+{
+  compareToSequential<uint8_t, uint16_t>(2, true, true, false, CONCURRENCY_PASSES);
+  compareToSequential<float, float>(4, true, true, true, CONCURRENCY_PASSES);
+}
+
+TEST(sgmConcurrencyTest, concurrentDirections)
+{
+  compareToSequential<uint8_t, uint16_t>(8, true, true, false, CONCURRENCY_DIRECTIONS);
+  compareToSequential<float, float>(16, true, false, true, CONCURRENCY_DIRECTIONS);
+}
+
+// Less partial volumes than tasks: tasks run in several rounds
+TEST(sgmConcurrencyTest, limitedPartialVolumes)
+{
+  compareToSequential<uint8_t, uint16_t>(8, true, true, false, CONCURRENCY_DIRECTIONS, 2);
+  compareToSequential<float, float>(8, false, true, false, CONCURRENCY_DIRECTIONS, 1);
+  // no partial volume: tasks one after the other in the final cost volume
+  compareToSequential<uint8_t, uint16_t>(4, true, true, true, CONCURRENCY_DIRECTIONS, 0);
+  compareToSequential<uint8_t, uint16_t>(1, false, true, false, CONCURRENCY_PASSES);
+}
+
+// Partial volumes are summed in the first one, and reset for the next tasks
+TEST(sgmConcurrencyTest, reducePartialVolumes)
+{
+  uint8_t cv_in[4] = {1, 2, 3, 4};
+  uint16_t first[4] = {10, 20, 30, 40};
+  uint16_t second[4] = {1, 1, 1, 1};
+  uint16_t third[4] = {5, 5, 5, 5};
+  uint16_t *partial_volumes[3] = {first, second, third};
+
+  reducePartialVolumes<uint8_t, uint16_t>({cv_in, contiguousStrides(1, 4)}, partial_volumes, 3, 1, 1, 4, 2, 2);
+
+  uint16_t expected[4] = {14, 22, 30, 38};
+  for (int i = 0; i < 4; i++)
+  {
+    EXPECT_EQ(expected[i], first[i]);
+    EXPECT_EQ(0, second[i]);
+    EXPECT_EQ(0, third[i]);
+  }
+}
+
+/*
+ * Scalar reference of the aggregated cost of one point, reset == 1
+ */
+template <typename Tin, typename T = Tin>
+void aggregatePixelReference(const Tin *pixel_costs, const T *previous_lr, T *lr, unsigned int nb_disps, T P1, T P2,
+                             Tin invalid_value)
+{
+  T min_disp = previous_lr[0];
+  for (unsigned int disp = 1; disp < nb_disps; disp++)
+  {
+    min_disp = std::min(min_disp, previous_lr[disp]);
+  }
+  for (unsigned int disp = 0; disp < nb_disps; disp++)
+  {
+    T path_min = std::min<T>(previous_lr[disp], min_disp + P2);
+    if (disp > 0)
+    {
+      path_min = std::min<T>(path_min, previous_lr[disp - 1] + P1);
+    }
+    if (disp < nb_disps - 1)
+    {
+      path_min = std::min<T>(path_min, previous_lr[disp + 1] + P1);
+    }
+    lr[disp] = (pixel_costs[disp] == invalid_value) ? pixel_costs[disp] : pixel_costs[disp] + (path_min - min_disp);
+  }
+}
+
+/*
+ * Compare a SIMD kernel to the scalar reference, values are small enough not to saturate the lanes
+ */
+template <typename Tin, typename T = Tin>
+void compareKernelToReference(AggregatePixelKernel<Tin, T> kernel, unsigned int min_disps, T P1, T P2,
+                              Tin invalid_value, unsigned int max_previous = 100)
+{
+  const unsigned int nb_disps_list[] = {1, 3, 4, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 70, 128, 200};
+  for (unsigned int nb_disps : nb_disps_list)
+  {
+    if (nb_disps < min_disps)
+    {
+      continue;
+    }
+    std::vector<Tin> costs(nb_disps);
+    std::vector<T> previous(nb_disps), expected(nb_disps), lr(nb_disps);
+    fillRandom(costs.data(), nb_disps, 60, nb_disps);
+    fillRandom(previous.data(), nb_disps, max_previous, nb_disps + 1);
+    costs[nb_disps / 2] = invalid_value;
+    aggregatePixelReference<Tin, T>(costs.data(), previous.data(), expected.data(), nb_disps, P1, P2, invalid_value);
+    const T min_lr = kernel(costs.data(), previous.data(), lr.data(), nb_disps, P1, P2, invalid_value,
+                            *std::min_element(previous.begin(), previous.end()));
+    for (unsigned int disp = 0; disp < nb_disps; disp++)
+    {
+      ASSERT_EQ(expected[disp], lr[disp]) << "nb_disps " << nb_disps << " at disparity " << disp;
+    }
+    ASSERT_EQ(*std::min_element(expected.begin(), expected.end()), min_lr) << "nb_disps " << nb_disps;
+  }
+}
+
+TEST(sgmSimdTest, sameAsScalarUint8)
+{
+  if (isSimdLevelSupported(SIMD_SSE41))
+  {
+    compareKernelToReference<uint8_t, uint8_t>(&aggregatePixelSse41, 16, 5, 40, 255);
+  }
+  if (isSimdLevelSupported(SIMD_AVX2))
+  {
+    compareKernelToReference<uint8_t, uint8_t>(&aggregatePixelAvx2, 32, 5, 40, 255);
+  }
+  if (isSimdLevelSupported(SIMD_AVX512))
+  {
+    compareKernelToReference<uint8_t, uint8_t>(&aggregatePixelAvx512, 1, 5, 40, 255);
+  }
+}
+
+// uint8 costs in uint16 lanes, aggregated costs above 255
+TEST(sgmSimdTest, sameAsScalarUint16)
+{
+  if (isSimdLevelSupported(SIMD_SSE41))
+  {
+    compareKernelToReference<uint8_t, uint16_t>(&aggregatePixelSse41, 8, 5, 200, 255, 600);
+  }
+  if (isSimdLevelSupported(SIMD_AVX2))
+  {
+    compareKernelToReference<uint8_t, uint16_t>(&aggregatePixelAvx2, 16, 5, 200, 255, 600);
+  }
+  if (isSimdLevelSupported(SIMD_AVX512))
+  {
+    compareKernelToReference<uint8_t, uint16_t>(&aggregatePixelAvx512, 1, 5, 200, 255, 600);
+  }
+}
+
+TEST(sgmSimdTest, sameAsScalarFloat)
+{
+  if (isSimdLevelSupported(SIMD_SSE41))
+  {
+    compareKernelToReference<float, float>(&aggregatePixelSse41, 4, 0.3f, 11.1f, -1.f);
+  }
+  if (isSimdLevelSupported(SIMD_AVX2))
+  {
+    compareKernelToReference<float, float>(&aggregatePixelAvx2, 8, 0.3f, 11.1f, -1.f);
+  }
+  if (isSimdLevelSupported(SIMD_AVX512))
+  {
+    compareKernelToReference<float, float>(&aggregatePixelAvx512, 1, 0.3f, 11.1f, -1.f);
+  }
+}
+
+TEST(sgmSimdTest, saturationUint8)
+{
+  const unsigned int nb_disps = 64;
+  const AggregatePixelKernel<uint8_t> kernels[] = {&aggregatePixelSse41, &aggregatePixelAvx2, &aggregatePixelAvx512};
+  for (int level = SIMD_SSE41; level <= SIMD_AVX512; level++)
+  {
+    if (!isSimdLevelSupported(static_cast<SimdLevel>(level)))
+    {
+      continue;
+    }
+    std::vector<uint8_t> costs(nb_disps, 250), previous(nb_disps, 20), lr(nb_disps);
+    previous[0] = 0;
+    kernels[level - SIMD_SSE41](costs.data(), previous.data(), lr.data(), nb_disps, 10, 30, 0, 0);
+    // Lr = 250 + 10 or 250 + 20 saturates, except at the minimum of the previous point
+    ASSERT_EQ(250, lr[0]);
+    for (unsigned int disp = 1; disp < nb_disps; disp++)
+    {
+      ASSERT_EQ(255, lr[disp]) << "level " << level << " at disparity " << disp;
+    }
+  }
+}
+
+/*
+ * Compare the kernels selected for the numbers of disparities with a specialised kernel to the scalar reference,
+ * at each supported level
+ */
+template <typename Tin, typename T = Tin>
+void compareFixedKernelsToReference(T P1, T P2, Tin invalid_value, unsigned int max_previous)
+{
+  const unsigned int fixed_disps[nb_fixed_disps] = {32, 64, 96, 128, 192, 256};
+  const SimdLevel level = getSimdLevel();
+  for (int simd = SIMD_SSE41; simd <= detectSimdLevel(); simd++)
+  {
+    setSimdLevel(static_cast<SimdLevel>(simd));
+    for (unsigned int nb_disps : fixed_disps)
+    {
+      const AggregatePixelKernel<Tin, T> kernel = simdKernels<Tin, T>(nb_disps).aggregate_pixel;
+      ASSERT_NE(nullptr, kernel) << "level " << simd << " nb_disps " << nb_disps;
+      std::vector<Tin> costs(nb_disps);
+      std::vector<T> previous(nb_disps), expected(nb_disps), lr(nb_disps);
+      fillRandom(costs.data(), nb_disps, 60, nb_disps);
+      fillRandom(previous.data(), nb_disps, max_previous, nb_disps + 1);
+      costs[nb_disps / 3] = invalid_value;
+      aggregatePixelReference<Tin, T>(costs.data(), previous.data(), expected.data(), nb_disps, P1, P2, invalid_value);
+      const T min_lr = kernel(costs.data(), previous.data(), lr.data(), nb_disps, P1, P2, invalid_value,
+                              *std::min_element(previous.begin(), previous.end()));
+      for (unsigned int disp = 0; disp < nb_disps; disp++)
+      {
+        ASSERT_EQ(expected[disp], lr[disp]) << "level " << simd << " nb_disps " << nb_disps << " at " << disp;
+      }
+      ASSERT_EQ(*std::min_element(expected.begin(), expected.end()), min_lr);
+    }
+  }
+  setSimdLevel(level);
+}
+
+TEST(sgmSimdTest, fixedDisparityKernels)
+{
+  compareFixedKernelsToReference<uint8_t, uint8_t>(5, 40, 255, 100);
+  compareFixedKernelsToReference<uint8_t, uint16_t>(5, 200, 255, 600);
+  compareFixedKernelsToReference<float, float>(0.3f, 11.1f, -1.f, 100);
+}
+
+TEST(sgmSimdTest, simdLevels)
+{
+  EXPECT_TRUE(isSimdLevelSupported(SIMD_SCALAR));
+  EXPECT_TRUE(isSimdLevelSupported(detectSimdLevel()));
+  EXPECT_EQ(SIMD_AVX2, parseSimdLevel("avx2"));
+  EXPECT_EQ(SIMD_SSE41, parseSimdLevel(simdLevelName(SIMD_SSE41)));
+  EXPECT_THROW(parseSimdLevel("neon"), std::invalid_argument);
+
+  const SimdLevel level = getSimdLevel();
+  setSimdLevel(SIMD_SCALAR);
+  EXPECT_EQ(SIMD_SCALAR, getSimdLevel());
+  // No kernel in scalar mode
+  EXPECT_EQ(nullptr, (simdKernels<float, float>(64).aggregate_pixel));
+  EXPECT_EQ(nullptr, (simdKernels<uint8_t, uint8_t>(64).last_index));
+  setSimdLevel(level);
+}
+
+TEST(sgmSimdTest, sameResultAllLevels)
+{
+  const unsigned long int nb_row = 9;
+  const unsigned long int nb_col = 11;
+  const unsigned int nb_disp = 37;
+  float cv_in[nb_row * nb_col * nb_disp];
+  float p1[nb_row * nb_col * 8];
+  float p2[nb_row * nb_col * 8];
+  float segmentation[nb_row * nb_col];
+  fillRandom(cv_in, nb_row * nb_col * nb_disp, 100, 9);
+  for (unsigned long int i = 0; i < nb_row * nb_col * 8; i++)
+  {
+    p1[i] = 3.f;
+    p2[i] = 17.f;
+  }
+  std::fill(segmentation, segmentation + nb_row * nb_col, 1.f);
+  int directions[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+
+  const SimdLevel level = getSimdLevel();
+  setSimdLevel(SIMD_SCALAR);
+  CostVolumes<float> scalar = sgm<float, float>(cv_in, p1, p2, directions, nb_row, nb_col, nb_disp, -1.f, segmentation,
+                                                true, true, false);
+  for (int simd = SIMD_SSE41; simd <= detectSimdLevel(); simd++)
+  {
+    setSimdLevel(static_cast<SimdLevel>(simd));
+    CostVolumes<float> vectorised = sgm<float, float>(cv_in, p1, p2, directions, nb_row, nb_col, nb_disp, -1.f,
+                                                      segmentation, true, true, false);
+    for (unsigned long int i = 0; i < nb_row * nb_col * nb_disp; i++)
+    {
+      ASSERT_EQ(scalar.cost_volume[i], vectorised.cost_volume[i]) << "level " << simd << " at index " << i;
+    }
+    for (unsigned long int i = 0; i < nb_row * nb_col * 8; i++)
+    {
+      ASSERT_EQ(scalar.cost_volume_min[i], vectorised.cost_volume_min[i]) << "level " << simd << " at index " << i;
+    }
+    delete[] vectorised.cost_volume;
+    delete[] vectorised.cost_volume_min;
+  }
+  setSimdLevel(level);
+  delete[] scalar.cost_volume;
+  delete[] scalar.cost_volume_min;
+}
+
+TEST(sgmSimdTest, aggregatePixelDispatch)
+{
+  const unsigned int nb_disps = 40;
+  std::vector<float> costs(nb_disps), previous(nb_disps), expected(nb_disps), lr(nb_disps);
+  fillRandom(costs.data(), nb_disps, 100, 3);
+  fillRandom(previous.data(), nb_disps, 100, 4);
+  aggregatePixelReference<float>(costs.data(), previous.data(), expected.data(), nb_disps, 2.f, 9.f, -1.f);
+  const float previous_min = *std::min_element(previous.begin(), previous.end());
+  const AggregatePixelKernel<float> kernel = simdKernels<float, float>(nb_disps).aggregate_pixel;
+  aggregatePixel<float>(costs.data(), previous.data(), lr.data(), nb_disps, 2.f, 9.f, -1.f, 1.f, previous_min, kernel);
+  for (unsigned int disp = 0; disp < nb_disps; disp++)
+  {
+    ASSERT_EQ(expected[disp], lr[disp]) << "at disparity " << disp;
+  }
+  // Reset history: the scalar path is used
+  const float min_lr = aggregatePixel<float>(costs.data(), previous.data(), lr.data(), nb_disps, 2.f, 9.f, -1.f, 0.f,
+                                             previous_min, kernel);
+  for (unsigned int disp = 0; disp < nb_disps; disp++)
+  {
+    ASSERT_EQ(costs[disp], lr[disp]) << "at disparity " << disp;
+  }
+  EXPECT_EQ(*std::min_element(costs.begin(), costs.end()), min_lr);
+}
+
+/*
+ * Compare a last position kernel to a backward search
+ */
+template <typename T>
+void compareLastIndexToReference(LastIndexKernel<T> kernel, unsigned int min_values)
+{
+  const unsigned int nb_values_list[] = {1, 3, 4, 5, 15, 16, 17, 32, 33, 64, 65, 100, 200};
+  for (unsigned int nb_values : nb_values_list)
+  {
+    if (nb_values < min_values)
+    {
+      continue;
+    }
+    std::vector<T> values(nb_values);
+    fillRandom(values.data(), nb_values, 5, nb_values);
+    for (unsigned int searched = 0; searched < 6; searched++)
+    {
+      int expected = static_cast<int>(nb_values) - 1;
+      while (expected >= 0 && values[expected] != static_cast<T>(searched))
+      {
+        expected--;
+      }
+      ASSERT_EQ(expected, kernel(values.data(), nb_values, static_cast<T>(searched)))
+          << "nb_values " << nb_values << " searched " << searched;
+    }
+  }
+}
+
+TEST(sgmSimdTest, lastIndexOf)
+{
+  if (isSimdLevelSupported(SIMD_SSE41))
+  {
+    compareLastIndexToReference<uint8_t>(&lastIndexOfSse41, 16);
+    compareLastIndexToReference<uint16_t>(&lastIndexOfSse41, 8);
+    compareLastIndexToReference<float>(&lastIndexOfSse41, 4);
+  }
+  if (isSimdLevelSupported(SIMD_AVX2))
+  {
+    compareLastIndexToReference<uint8_t>(&lastIndexOfAvx2, 32);
+    compareLastIndexToReference<uint16_t>(&lastIndexOfAvx2, 16);
+    compareLastIndexToReference<float>(&lastIndexOfAvx2, 8);
+  }
+  if (isSimdLevelSupported(SIMD_AVX512))
+  {
+    compareLastIndexToReference<uint8_t>(&lastIndexOfAvx512, 1);
+    compareLastIndexToReference<uint16_t>(&lastIndexOfAvx512, 1);
+    compareLastIndexToReference<float>(&lastIndexOfAvx512, 1);
+  }
+}
+
+// Test position of the minimum against update_minimum
+TEST(sgmSimdTest, lastMinimumPosition)
+{
+  const float inf = std::numeric_limits<float>::infinity();
+  const std::vector<std::vector<float>> costs_list = {
+      {3.f, 1.f, 2.f, 1.f, 5.f}, {1.f}, {2.f, 2.f, 2.f, 2.f, 2.f, 2.f, 2.f, 2.f, 2.f}, {inf, inf, inf, inf, inf},
+      {4.f, 3.f, 9.f, 0.5f, 7.f, 8.f, 0.5f, 6.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f, 8.f, 9.f, 10.f}};
+  for (const std::vector<float> &costs : costs_list)
+  {
+    float min_cost = std::numeric_limits<float>::max();
+    int pos = 0;
+    for (unsigned int disp = 0; disp < costs.size(); disp++)
+    {
+      std::tie(min_cost, pos) = update_minimum(min_cost, costs[disp], pos, disp);
+    }
+    const float min_lr = *std::min_element(costs.begin(), costs.end());
+    EXPECT_EQ(pos, lastMinimumPosition<float>(costs.data(), costs.size(), min_lr, nullptr));
+    EXPECT_EQ(pos, lastMinimumPosition(costs.data(), costs.size(), min_lr,
+                                       simdKernels<float, float>(costs.size()).last_index));
+  }
+}
+
+/*
+ * Accumulator type of the aggregated costs
+ */
+
+// Random uint8 cost volume and penalties, p1 = 20 and p2 = max_p2
+void fillUint8Volume(std::vector<uint8_t> &cv_in, std::vector<uint8_t> &p1, std::vector<uint8_t> &p2,
+                     unsigned long int nb_pixels, unsigned int nb_disp, unsigned int max_cost, uint8_t max_p2)
+{
+  cv_in.resize(nb_pixels * nb_disp);
+  fillRandom(cv_in.data(), cv_in.size(), max_cost, 11);
+  p1.assign(nb_pixels * 8, 20);
+  p2.assign(nb_pixels * 8, max_p2);
+}
+
+TEST(sgmAccumulatorTest, aggregatedCostBound)
+{
+  const uint8_t cv_in[6] = {3, 255, 17, 2, 255, 9};
+  uint8_t p2[16] = {};
+  p2[3] = 40;
+  p2[12] = 90;
+  // Two points of three disparities
+  const SgmInputs<uint8_t> inputs = contiguousInputs<uint8_t>(cv_in, p2, p2, nullptr, 2, 3);
+  // Invalid costs are not aggregated
+  EXPECT_EQ(17. + 90., aggregatedCostBound(inputs, 1, 2, 3, uint8_t(255), 1));
+  EXPECT_EQ(255. + 90., aggregatedCostBound(inputs, 1, 2, 3, uint8_t(0), 1));
+}
+
+// Aggregated costs above 255 are aggregated in uint16 lanes, as float costs would be
+TEST(sgmAccumulatorTest, wideAccumulatorSameAsFloat)
+{
+  const unsigned long int nb_row = 7;
+  const unsigned long int nb_col = 9;
+  const unsigned int nb_disp = 35;
+  std::vector<uint8_t> cv_in, p1, p2;
+  fillUint8Volume(cv_in, p1, p2, nb_row * nb_col, nb_disp, 250, 200);
+  std::vector<float> segmentation(nb_row * nb_col, 1.f);
+  std::vector<float> cv_float(cv_in.begin(), cv_in.end()), p1_float(p1.begin(), p1.end()),
+      p2_float(p2.begin(), p2.end());
+  int directions[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+
+  CostVolumes<uint16_t> cvs = sgm<uint8_t, uint16_t>(cv_in.data(), p1.data(), p2.data(), directions, nb_row, nb_col,
+                                                     nb_disp, 255, segmentation.data(), true, true, false);
+  CostVolumes<float> expected = sgm<float, float>(cv_float.data(), p1_float.data(), p2_float.data(), directions,
+                                                  nb_row, nb_col, nb_disp, 255.f, segmentation.data(), true, true,
+                                                  false);
+  for (unsigned long int i = 0; i < nb_row * nb_col * nb_disp; i++)
+  {
+    ASSERT_EQ(expected.cost_volume[i], cvs.cost_volume[i]) << "at index " << i;
+  }
+  for (unsigned long int i = 0; i < nb_row * nb_col * 8; i++)
+  {
+    ASSERT_EQ(expected.cost_volume_min[i], cvs.cost_volume_min[i]) << "at index " << i;
+  }
+  delete[] cvs.cost_volume;
+  delete[] cvs.cost_volume_min;
+  delete[] expected.cost_volume;
+  delete[] expected.cost_volume_min;
+}
+
+// Narrow lanes are chosen when aggregated costs fit in them, with the same result as wide ones
+TEST(sgmAccumulatorTest, narrowAccumulator)
+{
+  const unsigned long int nb_row = 6;
+  const unsigned long int nb_col = 8;
+  const unsigned int nb_disp = 40;
+  std::vector<uint8_t> cv_in, p1, p2;
+  fillUint8Volume(cv_in, p1, p2, nb_row * nb_col, nb_disp, 150, 100);
+  std::vector<float> segmentation(nb_row * nb_col, 1.f);
+  int directions[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+
+  CostVolumes<uint16_t> narrow = sgmWithAccumulator<uint8_t, uint8_t, uint16_t>(
+      contiguousInputs<uint8_t>(cv_in.data(), p1.data(), p2.data(), segmentation.data(), nb_col, nb_disp), directions,
+      nb_row, nb_col, nb_disp, 255, false, false, false);
+  CostVolumes<uint16_t> wide = sgmWithAccumulator<uint8_t, uint16_t, uint16_t>(
+      contiguousInputs<uint8_t>(cv_in.data(), p1.data(), p2.data(), segmentation.data(), nb_col, nb_disp), directions,
+      nb_row, nb_col, nb_disp, 255, false, false, false);
+  for (unsigned long int i = 0; i < nb_row * nb_col * nb_disp; i++)
+  {
+    ASSERT_EQ(wide.cost_volume[i], narrow.cost_volume[i]) << "at index " << i;
+  }
+  delete[] narrow.cost_volume;
+  delete[] narrow.cost_volume_min;
+  delete[] wide.cost_volume;
+  delete[] wide.cost_volume_min;
+}
+
+// A too narrow accumulator saturates, the scalar path as the SIMD lanes
+TEST(sgmAccumulatorTest, saturationAllLevels)
+{
+  const unsigned long int nb_row = 5;
+  const unsigned long int nb_col = 6;
+  const unsigned int nb_disp = 70;
+  std::vector<uint8_t> cv_in, p1, p2;
+  fillUint8Volume(cv_in, p1, p2, nb_row * nb_col, nb_disp, 250, 200);
+  std::vector<float> segmentation(nb_row * nb_col, 1.f);
+  int directions[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+
+  const SimdLevel level = getSimdLevel();
+  setSimdLevel(SIMD_SCALAR);
+  const SgmInputs<uint8_t> inputs =
+      contiguousInputs<uint8_t>(cv_in.data(), p1.data(), p2.data(), segmentation.data(), nb_col, nb_disp);
+  CostVolumes<uint16_t> scalar = sgmWithAccumulator<uint8_t, uint8_t, uint16_t>(
+      inputs, directions, nb_row, nb_col, nb_disp, 255, true, false, false);
+  for (int simd = SIMD_SSE41; simd <= detectSimdLevel(); simd++)
+  {
+    setSimdLevel(static_cast<SimdLevel>(simd));
+    CostVolumes<uint16_t> vectorised = sgmWithAccumulator<uint8_t, uint8_t, uint16_t>(
+        inputs, directions, nb_row, nb_col, nb_disp, 255, true, false, false);
+    for (unsigned long int i = 0; i < nb_row * nb_col * nb_disp; i++)
+    {
+      ASSERT_EQ(scalar.cost_volume[i], vectorised.cost_volume[i]) << "level " << simd << " at index " << i;
+    }
+    for (unsigned long int i = 0; i < nb_row * nb_col * 8; i++)
+    {
+      ASSERT_EQ(scalar.cost_volume_min[i], vectorised.cost_volume_min[i]) << "level " << simd << " at index " << i;
+    }
+    delete[] vectorised.cost_volume;
+    delete[] vectorised.cost_volume_min;
+  }
+  setSimdLevel(level);
+  delete[] scalar.cost_volume;
+  delete[] scalar.cost_volume_min;
+}
+
+/*
+ * Options dispatched at compile time
+ */
+
+TEST(sgmOptionsTest, resetMode)
+{
+  const float uniform[4] = {1.f, 1.f, 1.f, 1.f};
+  const float classes[4] = {1.f, 1.f, 2.f, 1.f};
+  const float no_edges[4] = {0.f, 0.f, -1.f, 0.f};
+  const Strides strides = contiguousStrides(2, 1);
+  EXPECT_EQ(RESET_NONE, resetMode({nullptr, strides}, 2, 2, false, 1));
+  EXPECT_EQ(RESET_NONE, resetMode({uniform, strides}, 2, 2, false, 1));
+  EXPECT_EQ(RESET_CLASSES, resetMode({classes, strides}, 2, 2, false, 1));
+  EXPECT_EQ(RESET_NONE, resetMode({no_edges, strides}, 2, 2, true, 1));
+  EXPECT_EQ(RESET_EDGES, resetMode({classes, strides}, 2, 2, true, 1));
+  // Every point is an edge
+  EXPECT_EQ(RESET_EDGES, resetMode({uniform, strides}, 2, 2, true, 1));
+  // Only the first column is read: the class of the first row is repeated
+  EXPECT_EQ(RESET_NONE, resetMode({classes, {0, 1, 1}}, 2, 2, false, 1));
+}
+
+// The instantiation without segmentation gives the same result as a uniform segmentation map
+TEST(sgmOptionsTest, sameAsUniformSegmentation)
+{
+  const unsigned long int nb_row = 8;
+  const unsigned long int nb_col = 9;
+  const unsigned int nb_disp = 13;
+  std::vector<float> cv_in(nb_row * nb_col * nb_disp);
+  fillRandom(cv_in.data(), cv_in.size(), 50, 12);
+  std::vector<float> p1(nb_row * nb_col * 8, 2.f), p2(nb_row * nb_col * 8, 11.f);
+  std::vector<float> segmentation(nb_row * nb_col, 3.f);
+  Direction directions[8];
+  std::copy(pass_directions, pass_directions + 8, directions);
+  const unsigned long int nb_values = nb_row * nb_col * nb_disp;
+
+  const Concurrency concurrencies[3] = {CONCURRENCY_NONE, CONCURRENCY_PASSES, CONCURRENCY_DIRECTIONS};
+  for (int options = 0; options < 4; options++)
+  {
+    const bool cost_paths = options & 2;
+    const bool overcounting = options & 1;
+    for (Concurrency concurrency : concurrencies)
+    {
+      std::vector<float> expected(nb_values, 0.f), result(nb_values, 0.f);
+      std::vector<int> expected_min(nb_row * nb_col * 8, 0), result_min(nb_row * nb_col * 8, 0);
+      CostVolumes<float> expected_cvs = {expected.data(), expected_min.data(), nullptr, {}};
+      CostVolumes<float> result_cvs = {result.data(), result_min.data(), nullptr, {}};
+      aggregationEngine<float, float, float>(cost_paths, overcounting, RESET_CLASSES)(
+          contiguousInputs<float>(cv_in.data(), p1.data(), p2.data(), segmentation.data(), nb_col, nb_disp),
+          directions, nb_row, nb_col, nb_disp, -1.f, expected_cvs, 2, concurrency, 7, DISPARITY_NONE,
+          ConfidenceOptions());
+      aggregationEngine<float, float, float>(cost_paths, overcounting, RESET_NONE)(
+          contiguousInputs<float>(cv_in.data(), p1.data(), p2.data(), nullptr, nb_col, nb_disp), directions, nb_row,
+          nb_col, nb_disp, -1.f, result_cvs, 2, concurrency, 7, DISPARITY_NONE, ConfidenceOptions());
+      EXPECT_EQ(expected, result) << "options " << options << " concurrency " << concurrency;
+      EXPECT_EQ(expected_min, result_min) << "options " << options << " concurrency " << concurrency;
+    }
+  }
+}
+
+/*
+ * Output buffers of the caller
+ */
+
+// Buffers of the caller are reset and written in place, with the same result as buffers allocated by sgm
+TEST(sgmOutputTest, callerBuffers)
+{
+  const unsigned long int nb_row = 6;
+  const unsigned long int nb_col = 7;
+  const unsigned int nb_disp = 19;
+  std::vector<uint8_t> cv_in, p1, p2;
+  fillUint8Volume(cv_in, p1, p2, nb_row * nb_col, nb_disp, 90, 40);
+  std::vector<float> segmentation(nb_row * nb_col, 1.f);
+  int directions[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+
+  CostVolumes<uint16_t> expected = sgm<uint8_t, uint16_t>(cv_in.data(), p1.data(), p2.data(), directions, nb_row,
+                                                          nb_col, nb_disp, 255, segmentation.data(), true, true, false);
+  std::vector<uint16_t> out(nb_row * nb_col * nb_disp, 1234);
+  std::vector<int> out_min(nb_row * nb_col * 8, -5);
+  CostVolumes<uint16_t> cvs = sgm<uint8_t, uint16_t>(cv_in.data(), p1.data(), p2.data(), directions, nb_row, nb_col,
+                                                     nb_disp, 255, segmentation.data(), true, true, false, 1,
+                                                     CONCURRENCY_NONE, 7, out.data(), out_min.data());
+  EXPECT_EQ(out.data(), cvs.cost_volume);
+  EXPECT_EQ(out_min.data(), cvs.cost_volume_min);
+  EXPECT_EQ(std::vector<uint16_t>(expected.cost_volume, expected.cost_volume + out.size()), out);
+  EXPECT_EQ(std::vector<int>(expected.cost_volume_min, expected.cost_volume_min + out_min.size()), out_min);
+  delete[] expected.cost_volume;
+  delete[] expected.cost_volume_min;
+
+  // Only the cost volume is given
+  CostVolumes<uint16_t> no_paths = sgm<uint8_t, uint16_t>(cv_in.data(), p1.data(), p2.data(), directions, nb_row,
+                                                          nb_col, nb_disp, 255, segmentation.data(), false, false,
+                                                          false, 1, CONCURRENCY_PASSES, 7, out.data());
+  EXPECT_EQ(out.data(), no_paths.cost_volume);
+  delete[] no_paths.cost_volume_min;
+}
+
+// Volumes of two calls are summed in the buffer of the caller
+TEST(sgmOutputTest, accumulate)
+{
+  const unsigned long int nb_row = 5;
+  const unsigned long int nb_col = 8;
+  const unsigned int nb_disp = 11;
+  const unsigned long int nb_values = nb_row * nb_col * nb_disp;
+  std::vector<float> first(nb_values), second(nb_values);
+  fillRandom(first.data(), nb_values, 40, 21);
+  fillRandom(second.data(), nb_values, 40, 22);
+  std::vector<float> p1(nb_row * nb_col * 8, 3.f), p2(nb_row * nb_col * 8, 14.f);
+  std::vector<float> segmentation(nb_row * nb_col, 1.f);
+  int directions[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+
+  const Concurrency concurrencies[3] = {CONCURRENCY_NONE, CONCURRENCY_PASSES, CONCURRENCY_DIRECTIONS};
+  for (Concurrency concurrency : concurrencies)
+  {
+    std::vector<float> first_out(nb_values), expected(nb_values), out(nb_values);
+    sgm<float, float>(first.data(), p1.data(), p2.data(), directions, nb_row, nb_col, nb_disp, -1.f,
+                      segmentation.data(), false, true, false, 2, concurrency, 7, first_out.data());
+    sgm<float, float>(second.data(), p1.data(), p2.data(), directions, nb_row, nb_col, nb_disp, -1.f,
+                      segmentation.data(), false, true, false, 2, concurrency, 7, expected.data());
+    for (unsigned long int i = 0; i < nb_values; i++)
+    {
+      expected[i] += first_out[i];
+    }
+
+    std::vector<int> out_min(nb_row * nb_col * 8);
+    sgm<float, float>(first.data(), p1.data(), p2.data(), directions, nb_row, nb_col, nb_disp, -1.f,
+                      segmentation.data(), true, true, false, 2, concurrency, 7, out.data(), out_min.data());
+    sgm<float, float>(second.data(), p1.data(), p2.data(), directions, nb_row, nb_col, nb_disp, -1.f,
+                      segmentation.data(), true, true, false, 2, concurrency, 7, out.data(), out_min.data(), true);
+    EXPECT_EQ(expected, out) << "concurrency " << concurrency;
+  }
+
+  EXPECT_THROW((sgm<float, float>(first.data(), p1.data(), p2.data(), directions, nb_row, nb_col, nb_disp, -1.f,
+                                  segmentation.data(), false, false, false, 1, CONCURRENCY_NONE, 7, nullptr, nullptr,
+                                  true)),
+               std::invalid_argument);
+}
+
+// The output volume is reset before the costs are read: it can not be the cost volume
+TEST(sgmOutputTest, outputIsCostVolume)
+{
+  const unsigned long int nb_row = 3;
+  const unsigned long int nb_col = 4;
+  const unsigned int nb_disp = 5;
+  std::vector<float> cv_in(nb_row * nb_col * nb_disp, 2.f);
+  std::vector<float> p1(nb_row * nb_col * 8, 4.f), p2(nb_row * nb_col * 8, 19.f);
+  int directions[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+
+  EXPECT_THROW((sgm<float, float>(cv_in.data(), p1.data(), p2.data(), directions, nb_row, nb_col, nb_disp, -1.f,
+                                  nullptr, false, false, false, 1, CONCURRENCY_NONE, 7, cv_in.data())),
+               std::invalid_argument);
+}
+
+/*
+ * Strided inputs
+ */
+
+// Strided views of larger arrays are aggregated as their contiguous copies
+TEST(sgmStridesTest, sameAsContiguousCopies)
+{
+  const unsigned long int nb_row = 6;
+  const unsigned long int nb_col = 7;
+  const unsigned int nb_disp = 11;
+  // Disparity-major volume with a margin of one point around the window: strides (nb_col + 2, 1, rows * cols)
+  const long long full_rows = nb_row + 2;
+  const long long full_cols = nb_col + 2;
+  std::vector<float> full_volume(full_rows * full_cols * nb_disp);
+  fillRandom(full_volume.data(), full_volume.size(), 70, 41);
+  const Strides volume_strides = {full_cols, 1, full_rows * full_cols};
+  const float *window = &full_volume[1 + full_cols];
+  // Same penalties for all points, classes from a column-major map
+  const float p1[8] = {2.f, 3.f, 4.f, 5.f, 2.f, 3.f, 4.f, 5.f};
+  const float p2[8] = {20.f, 21.f, 22.f, 23.f, 24.f, 25.f, 26.f, 27.f};
+  std::vector<float> classes(nb_row * nb_col, 1.f);
+  classes[3 * nb_row + 2] = 2.f;
+  const SgmInputs<float> inputs = {
+      {window, volume_strides}, {p1, {0, 0, 1}}, {p2, {0, 0, 1}}, {classes.data(), {1, nb_row, 1}}, {}, {}, nullptr, nullptr, {}, {}, nullptr};
+
+  // Contiguous copies
+  std::vector<float> cv_in(nb_row * nb_col * nb_disp), p1_in(nb_row * nb_col * 8), p2_in(nb_row * nb_col * 8);
+  std::vector<float> segmentation(nb_row * nb_col);
+  for (unsigned long int row = 0; row < nb_row; row++)
+  {
+    for (unsigned long int col = 0; col < nb_col; col++)
+    {
+      const unsigned long int pixel = col + row * nb_col;
+      for (unsigned int disp = 0; disp < nb_disp; disp++)
+      {
+        cv_in[pixel * nb_disp + disp] =
+            window[row * volume_strides.row + col * volume_strides.col + disp * volume_strides.depth];
+      }
+      std::copy(p1, p1 + 8, &p1_in[pixel * 8]);
+      std::copy(p2, p2 + 8, &p2_in[pixel * 8]);
+      segmentation[pixel] = classes[row + col * nb_row];
+    }
+  }
+  int directions[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+
+  const Concurrency concurrencies[3] = {CONCURRENCY_NONE, CONCURRENCY_PASSES, CONCURRENCY_DIRECTIONS};
+  for (Concurrency concurrency : concurrencies)
+  {
+    for (int num_threads = 1; num_threads <= 2; num_threads++)
+    {
+      CostVolumes<float> expected = sgm<float, float>(cv_in.data(), p1_in.data(), p2_in.data(), directions, nb_row,
+                                                      nb_col, nb_disp, -1.f, segmentation.data(), true, true, false,
+                                                      num_threads, concurrency);
+      CostVolumes<float> cvs = sgm<float, float>(inputs, directions, nb_row, nb_col, nb_disp, -1.f, true, true, false,
+                                                 num_threads, concurrency);
+      EXPECT_TRUE(std::equal(expected.cost_volume, expected.cost_volume + cv_in.size(), cvs.cost_volume))
+          << "concurrency " << concurrency << " threads " << num_threads;
+      EXPECT_TRUE(std::equal(expected.cost_volume_min, expected.cost_volume_min + nb_row * nb_col * 8,
+                             cvs.cost_volume_min))
+          << "concurrency " << concurrency << " threads " << num_threads;
+      delete[] expected.cost_volume;
+      delete[] expected.cost_volume_min;
+      delete[] cvs.cost_volume;
+      delete[] cvs.cost_volume_min;
+    }
+  }
+
+  // A strided cost volume can not be the output volume either
+  EXPECT_THROW((sgm<float, float>(inputs, directions, nb_row, nb_col, nb_disp, -1.f, false, false, false, 1,
+                                  CONCURRENCY_NONE, 7, const_cast<float *>(window))),
+               std::invalid_argument);
+}
+
+/*
+ * Broadcast penalties
+ */
+
+TEST(sgmPenaltiesTest, penaltyMode)
+{
+  const float p1[8] = {};
+  const float p2[8] = {};
+  const float cv_in[1] = {};
+  EXPECT_EQ(PENALTIES_MAP, penaltyMode(contiguousInputs<float>(cv_in, p1, p2, nullptr, 1, 1)));
+  EXPECT_EQ(PENALTIES_CONSTANT, penaltyMode<float>({{cv_in, {1, 1, 1}}, {p1, {0, 0, 1}}, {p2, {0, 0, 0}}, {}, {}, {}, nullptr, nullptr, {}, {}, nullptr}));
+  // P1 constant along the rows only
+  EXPECT_EQ(PENALTIES_MAP, penaltyMode<float>({{cv_in, {1, 1, 1}}, {p1, {0, 8, 1}}, {p2, {0, 0, 1}}, {}, {}, {}, nullptr, nullptr, {}, {}, nullptr}));
+  // Tables of the classes are used instead of the maps
+  EXPECT_EQ(PENALTIES_CLASSES, penaltyMode<float>({{cv_in, {1, 1, 1}}, {}, {}, {}, {p1, p2, 1}, {}, nullptr, nullptr, {}, {}, nullptr}));
+}
+
+/*
+ * Penalties of each direction, or a scalar, read through null strides as the full maps they are broadcast to
+ */
+template <typename T, typename Tout>
+void compareToPenaltyMaps(const T *p1, const T *p2, long long depth_stride)
+{
+  const unsigned long int nb_row = 7;
+  const unsigned long int nb_col = 8;
+  const unsigned int nb_disp = 33;
+  std::vector<T> cv_in(nb_row * nb_col * nb_disp);
+  fillRandom(cv_in.data(), cv_in.size(), 60, 43);
+  std::vector<T> p1_in(nb_row * nb_col * 8), p2_in(nb_row * nb_col * 8);
+  for (unsigned long int i = 0; i < p1_in.size(); i++)
+  {
+    p1_in[i] = p1[(i % 8) * depth_stride];
+    p2_in[i] = p2[(i % 8) * depth_stride];
+  }
+  std::vector<float> segmentation(nb_row * nb_col, 1.f);
+  segmentation[20] = 2.f;
+  int directions[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+  SgmInputs<T> inputs = contiguousInputs<T>(cv_in.data(), p1, p2, segmentation.data(), nb_col, nb_disp);
+  inputs.p1_in.strides = {0, 0, depth_stride};
+  inputs.p2_in.strides = {0, 0, depth_stride};
+
+  const Concurrency concurrencies[3] = {CONCURRENCY_NONE, CONCURRENCY_PASSES, CONCURRENCY_DIRECTIONS};
+  for (Concurrency concurrency : concurrencies)
+  {
+    CostVolumes<Tout> expected = sgm<T, Tout>(cv_in.data(), p1_in.data(), p2_in.data(), directions, nb_row, nb_col,
+                                              nb_disp, T(255), segmentation.data(), true, true, false, 2, concurrency);
+    CostVolumes<Tout> cvs =
+        sgm<T, Tout>(inputs, directions, nb_row, nb_col, nb_disp, T(255), true, true, false, 2, concurrency);
+    EXPECT_TRUE(std::equal(expected.cost_volume, expected.cost_volume + cv_in.size(), cvs.cost_volume))
+        << "concurrency " << concurrency;
+    EXPECT_TRUE(std::equal(expected.cost_volume_min, expected.cost_volume_min + nb_row * nb_col * 8,
+                           cvs.cost_volume_min))
+        << "concurrency " << concurrency;
+    delete[] expected.cost_volume;
+    delete[] expected.cost_volume_min;
+    delete[] cvs.cost_volume;
+    delete[] cvs.cost_volume_min;
+  }
+}
+
+TEST(sgmPenaltiesTest, sameAsPenaltyMaps)
+{
+  const uint8_t p1[8] = {3, 4, 5, 6, 3, 4, 5, 6};
+  const uint8_t p2[8] = {30, 31, 32, 33, 34, 35, 36, 37};
+  compareToPenaltyMaps<uint8_t, uint16_t>(p1, p2, 1);
+  compareToPenaltyMaps<uint8_t, uint16_t>(p1, p2, 0);
+  const float p1_float[8] = {2.f, 2.5f, 3.f, 3.5f, 4.f, 4.5f, 5.f, 5.5f};
+  const float p2_float[8] = {20.f, 21.f, 22.f, 23.f, 24.f, 25.f, 26.f, 27.f};
+  compareToPenaltyMaps<float, float>(p1_float, p2_float, 1);
+  compareToPenaltyMaps<float, float>(p1_float, p2_float, 0);
+}
+
+/*
+ * Penalties of the segmentation classes
+ */
+
+// Penalty tables of the classes give the same result as the maps they are expanded to
+TEST(sgmPenaltiesTest, sameAsClassTables)
+{
+  const unsigned long int nb_row = 7;
+  const unsigned long int nb_col = 9;
+  const unsigned int nb_disp = 21;
+  std::vector<uint8_t> cv_in(nb_row * nb_col * nb_disp);
+  fillRandom(cv_in.data(), cv_in.size(), 60, 47);
+  // Three classes, e.g. water, vegetation and urban areas
+  const uint8_t p1_classes[3 * 8] = {2, 2, 2, 2, 2, 2, 2, 2, 5, 6, 5, 6, 5, 6, 5, 6, 9, 9, 9, 9, 8, 8, 8, 8};
+  const uint8_t p2_classes[3 * 8] = {20, 20, 20, 20, 20, 20, 20, 20, 40, 41, 42, 43, 44, 45, 46, 47,
+                                     70, 70, 70, 70, 60, 60, 60, 60};
+  std::vector<float> segmentation(nb_row * nb_col);
+  std::vector<uint8_t> p1(nb_row * nb_col * 8), p2(nb_row * nb_col * 8);
+  for (unsigned long int pixel = 0; pixel < nb_row * nb_col; pixel++)
+  {
+    const int label = static_cast<int>((pixel / 5) % 3);
+    segmentation[pixel] = static_cast<float>(label);
+    std::copy(&p1_classes[label * 8], &p1_classes[label * 8 + 8], &p1[pixel * 8]);
+    std::copy(&p2_classes[label * 8], &p2_classes[label * 8 + 8], &p2[pixel * 8]);
+  }
+  int directions[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+  SgmInputs<uint8_t> inputs =
+      contiguousInputs<uint8_t>(cv_in.data(), nullptr, nullptr, segmentation.data(), nb_col, nb_disp);
+  inputs.penalty_tables = {p1_classes, p2_classes, 3};
+
+  for (int edge_classification = 0; edge_classification < 2; edge_classification++)
+  {
+    CostVolumes<uint16_t> expected =
+        sgm<uint8_t, uint16_t>(cv_in.data(), p1.data(), p2.data(), directions, nb_row, nb_col, nb_disp, 255,
+                               segmentation.data(), true, true, edge_classification, 2);
+    CostVolumes<uint16_t> cvs = sgm<uint8_t, uint16_t>(inputs, directions, nb_row, nb_col, nb_disp, 255, true, true,
+                                                       edge_classification, 2);
+    EXPECT_TRUE(std::equal(expected.cost_volume, expected.cost_volume + cv_in.size(), cvs.cost_volume))
+        << "edge classification " << edge_classification;
+    EXPECT_TRUE(std::equal(expected.cost_volume_min, expected.cost_volume_min + nb_row * nb_col * 8,
+                           cvs.cost_volume_min))
+        << "edge classification " << edge_classification;
+    delete[] expected.cost_volume;
+    delete[] expected.cost_volume_min;
+    delete[] cvs.cost_volume;
+    delete[] cvs.cost_volume_min;
+  }
+
+  // Labels out of the tables
+  segmentation[17] = 3.f;
+  EXPECT_THROW((sgm<uint8_t, uint16_t>(inputs, directions, nb_row, nb_col, nb_disp, 255, false, false, false)),
+               std::invalid_argument);
+  segmentation[17] = 1.5f;
+  EXPECT_THROW((sgm<uint8_t, uint16_t>(inputs, directions, nb_row, nb_col, nb_disp, 255, false, false, false)),
+               std::invalid_argument);
+  inputs.segmentation.data = nullptr;
+  EXPECT_THROW((sgm<uint8_t, uint16_t>(inputs, directions, nb_row, nb_col, nb_disp, 255, false, false, false)),
+               std::invalid_argument);
+}
+
+/*
+ * Intensity-adaptive P2
+ */
+
+// P2 adapted to the gradient of the guide image along the paths gives the same result as the precomputed P2 map
+template <typename T, typename Tout>
+void compareToAdaptiveP2Map()
+{
+  const unsigned long int nb_row = 6;
+  const unsigned long int nb_col = 9;
+  const unsigned int nb_disp = 17;
+  std::vector<T> cv_in(nb_row * nb_col * nb_disp);
+  fillRandom(cv_in.data(), cv_in.size(), 60, 53);
+  std::vector<float> guide(nb_row * nb_col);
+  fillRandom(guide.data(), guide.size(), 12, 59);
+  const T p1[8] = {4, 4, 5, 5, 4, 4, 5, 5};
+  const T p2[8] = {60, 61, 62, 63, 64, 65, 66, 67};
+  int directions[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+  std::vector<float> segmentation(nb_row * nb_col, 1.f);
+
+  // P2 / |I(p) - I(p-r)|, at least P1, for the points having a previous point
+  std::vector<T> p1_in(nb_row * nb_col * 8), p2_in(nb_row * nb_col * 8);
+  for (long long row = 0; row < static_cast<long long>(nb_row); row++)
+  {
+    for (long long col = 0; col < static_cast<long long>(nb_col); col++)
+    {
+      const unsigned long int pixel = col + row * nb_col;
+      for (int dir = 0; dir < 8; dir++)
+      {
+        const long long previous_row = row - directions[2 * dir];
+        const long long previous_col = col - directions[2 * dir + 1];
+        p1_in[pixel * 8 + dir] = p1[dir];
+        p2_in[pixel * 8 + dir] = p2[dir];
+        if (previous_row >= 0 && previous_row < static_cast<long long>(nb_row) && previous_col >= 0 &&
+            previous_col < static_cast<long long>(nb_col))
+        {
+          const float gradient = std::fabs(guide[pixel] - guide[previous_col + previous_row * nb_col]);
+          p2_in[pixel * 8 + dir] =
+              static_cast<T>(std::max(static_cast<float>(p1[dir]), static_cast<float>(p2[dir]) / std::max(gradient, 1.f)));
+        }
+      }
+    }
+  }
+  SgmInputs<T> inputs = contiguousInputs<T>(cv_in.data(), p1, p2, segmentation.data(), nb_col, nb_disp);
+  inputs.p1_in.strides = {0, 0, 1};
+  inputs.p2_in.strides = {0, 0, 1};
+  inputs.guide.data = guide.data();
+
+  const Concurrency concurrencies[3] = {CONCURRENCY_NONE, CONCURRENCY_PASSES, CONCURRENCY_DIRECTIONS};
+  for (Concurrency concurrency : concurrencies)
+  {
+    CostVolumes<Tout> expected = sgm<T, Tout>(cv_in.data(), p1_in.data(), p2_in.data(), directions, nb_row, nb_col,
+                                              nb_disp, T(255), segmentation.data(), true, true, false, 2, concurrency);
+    CostVolumes<Tout> cvs =
+        sgm<T, Tout>(inputs, directions, nb_row, nb_col, nb_disp, T(255), true, true, false, 2, concurrency);
+    EXPECT_TRUE(std::equal(expected.cost_volume, expected.cost_volume + cv_in.size(), cvs.cost_volume))
+        << "concurrency " << concurrency;
+    EXPECT_TRUE(std::equal(expected.cost_volume_min, expected.cost_volume_min + nb_row * nb_col * 8,
+                           cvs.cost_volume_min))
+        << "concurrency " << concurrency;
+    delete[] expected.cost_volume;
+    delete[] expected.cost_volume_min;
+    delete[] cvs.cost_volume;
+    delete[] cvs.cost_volume_min;
+  }
+}
+
+TEST(sgmPenaltiesTest, sameAsAdaptiveP2Map)
+{
+  compareToAdaptiveP2Map<uint8_t, uint16_t>();
+  compareToAdaptiveP2Map<float, float>();
+}
+
+/*
+ * Packed history resets
+ */
+
+// One bit per direction, set where the label changes from the previous point, or after an edge
+TEST(sgmResetMasksTest, resetBits)
+{
+  // 2 x 3 map
+  const int labels[6] = {1, 1, 2, 1, 0, 2};
+  const Strides strides = contiguousStrides(3, 1);
+  uint8_t masks[6];
+  resetMasks<int>({labels, strides}, pass_directions, 2, 3, false, masks, 1);
+  // Direction 0 (0, 1): previous point on the left; direction 1 (1, 0): previous point above;
+  // direction 2 (1, 1): top left; direction 3 (1, -1): top right; 4-7: opposite directions
+  const uint8_t expected[6] = {0x40, 0x70, 0x81, 0x10, 0x1f, 0x05};
+  for (int i = 0; i < 6; i++)
+  {
+    EXPECT_EQ(expected[i], masks[i]) << "at index " << i;
+  }
+  EXPECT_EQ(RESET_CLASSES, resetMode(masks, 6, 1));
+
+  // Edges reset the history of the next points
+  const bool edges[6] = {false, true, false, false, false, false};
+  resetMasks<bool>({edges, strides}, pass_directions, 2, 3, true, masks, 2);
+  const uint8_t expected_edges[6] = {0x10, 0x00, 0x01, 0x08, 0x02, 0x04};
+  for (int i = 0; i < 6; i++)
+  {
+    EXPECT_EQ(expected_edges[i], masks[i]) << "at index " << i;
+  }
+
+  const uint8_t uniform[6] = {3, 3, 3, 3, 3, 3};
+  resetMasks<uint8_t>({uniform, strides}, pass_directions, 2, 3, false, masks, 1);
+  EXPECT_EQ(RESET_NONE, resetMode(masks, 6, 1));
+}
+
+// Masks of an integer map give the same result as the float map
+TEST(sgmResetMasksTest, sameAsFloatSegmentation)
+{
+  const unsigned long int nb_row = 8;
+  const unsigned long int nb_col = 7;
+  const unsigned int nb_disp = 24;
+  std::vector<float> cv_in(nb_row * nb_col * nb_disp);
+  fillRandom(cv_in.data(), cv_in.size(), 50, 61);
+  std::vector<float> p1(nb_row * nb_col * 8, 3.f), p2(nb_row * nb_col * 8, 17.f);
+  std::vector<int32_t> labels(nb_row * nb_col);
+  fillRandom(labels.data(), labels.size(), 3, 67);
+  std::vector<float> segmentation(labels.begin(), labels.end());
+  int directions_in[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+  Direction directions[8];
+  assignDirections(directions_in, directions);
+
+  std::vector<uint8_t> reset_masks(nb_row * nb_col);
+  for (int edge_classification = 0; edge_classification < 2; edge_classification++)
+  {
+    resetMasks<int32_t>({labels.data(), contiguousStrides(nb_col, 1)}, directions, nb_row, nb_col,
+                        edge_classification, reset_masks.data(), 2);
+    SgmInputs<float> inputs = contiguousInputs<float>(cv_in.data(), p1.data(), p2.data(), nullptr, nb_col, nb_disp);
+    inputs.reset_masks = reset_masks.data();
+    CostVolumes<float> expected = sgm<float, float>(cv_in.data(), p1.data(), p2.data(), directions_in, nb_row,
+                                                    nb_col, nb_disp, -1.f, segmentation.data(), true, false,
+                                                    edge_classification, 2, CONCURRENCY_DIRECTIONS);
+    CostVolumes<float> cvs = sgm<float, float>(inputs, directions_in, nb_row, nb_col, nb_disp, -1.f, true, false,
+                                               edge_classification, 2, CONCURRENCY_DIRECTIONS);
+    EXPECT_TRUE(std::equal(expected.cost_volume, expected.cost_volume + cv_in.size(), cvs.cost_volume))
+        << "edge classification " << edge_classification;
+    EXPECT_TRUE(std::equal(expected.cost_volume_min, expected.cost_volume_min + nb_row * nb_col * 8,
+                           cvs.cost_volume_min))
+        << "edge classification " << edge_classification;
+    delete[] expected.cost_volume;
+    delete[] expected.cost_volume_min;
+    delete[] cvs.cost_volume;
+    delete[] cvs.cost_volume_min;
+  }
+}
+
+/*
+ * Validity of the points
+ */
+
+TEST(sgmValidityTest, pixelValidity)
+{
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  // Points with no, some and only invalid costs, 2 disparities
+  const float cv_in[6] = {1.f, 2.f, nan, 3.f, nan, nan};
+  uint8_t validity[3] = {};
+  SgmInputs<float> inputs = contiguousInputs<float>(cv_in, nullptr, nullptr, nullptr, 3, 2);
+  pixelValidity(inputs, 1, 3, 2, nan, validity, 1);
+  EXPECT_EQ(PIXEL_VALID, validity[0]);
+  EXPECT_EQ(PIXEL_PARTIAL, validity[1]);
+  EXPECT_EQ(PIXEL_INVALID, validity[2]);
+
+  // Only the costs of the intervals are read: the second point has only invalid costs, the last one none
+  const int32_t disp_min[3] = {0, 0, 1};
+  const int32_t disp_max[3] = {1, 0, 0};
+  inputs.disp_min = {disp_min, contiguousStrides(3, 1)};
+  inputs.disp_max = {disp_max, contiguousStrides(3, 1)};
+  pixelValidity(inputs, 1, 3, 2, nan, validity, 1);
+  EXPECT_EQ(PIXEL_VALID, validity[0]);
+  EXPECT_EQ(PIXEL_INVALID, validity[1]);
+  EXPECT_EQ(PIXEL_INVALID, validity[2]);
+
+  // Read through the strides of a transposed volume: the disparities are the rows
+  const uint8_t costs[6] = {255, 4, 255, 255, 5, 6};
+  SgmInputs<uint8_t> transposed = contiguousInputs<uint8_t>(costs, nullptr, nullptr, nullptr, 3, 2);
+  transposed.cv_in.strides = {0, 1, 3};
+  pixelValidity(transposed, 1, 3, 2, uint8_t(255), validity, 2);
+  EXPECT_EQ(PIXEL_INVALID, validity[0]);
+  EXPECT_EQ(PIXEL_VALID, validity[1]);
+  EXPECT_EQ(PIXEL_PARTIAL, validity[2]);
+}
+
+/*
+ * Cost volume of a block of invalid points, and of points with some invalid costs
+ */
+void fillInvalidCosts(std::vector<float> &cv_in, unsigned long int nb_col, unsigned int nb_disp, float invalid_value)
+{
+  for (unsigned long int row = 2; row < 5; row++)
+  {
+    for (unsigned long int col = 1; col < 5; col++)
+    {
+      std::fill(&cv_in[(row * nb_col + col) * nb_disp], &cv_in[(row * nb_col + col + 1) * nb_disp], invalid_value);
+    }
+  }
+  for (unsigned int disp = 0; disp < nb_disp; disp += 3)
+  {
+    cv_in[(6 * nb_col + 2) * nb_disp + disp] = invalid_value;
+  }
+}
+
+TEST(sgmValidityTest, sameWithValidity)
+{
+  const unsigned long int nb_row = 8;
+  const unsigned long int nb_col = 7;
+  const unsigned int nb_disp = 19;
+  std::vector<float> cv_in(nb_row * nb_col * nb_disp);
+  fillRandom(cv_in.data(), cv_in.size(), 50, 71);
+  fillInvalidCosts(cv_in, nb_col, nb_disp, 1000.f);
+  std::vector<float> p1(nb_row * nb_col * 8, 4.f), p2(nb_row * nb_col * 8, 21.f);
+  int directions_in[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+
+  std::vector<uint8_t> validity(nb_row * nb_col);
+  SgmInputs<float> inputs = contiguousInputs<float>(cv_in.data(), p1.data(), p2.data(), nullptr, nb_col, nb_disp);
+  pixelValidity(inputs, nb_row, nb_col, nb_disp, 1000.f, validity.data(), 2);
+  EXPECT_EQ(PIXEL_INVALID, validity[2 * nb_col + 1]);
+  EXPECT_EQ(PIXEL_PARTIAL, validity[6 * nb_col + 2]);
+  SgmInputs<float> valid_inputs = inputs;
+  valid_inputs.validity = validity.data();
+  // The paths after a point of equal costs restart as they do without validity
+  const Concurrency concurrencies[3] = {CONCURRENCY_NONE, CONCURRENCY_PASSES, CONCURRENCY_DIRECTIONS};
+  for (Concurrency concurrency : concurrencies)
+  {
+    CostVolumes<float> expected = sgm<float, float>(inputs, directions_in, nb_row, nb_col, nb_disp, 1000.f, true, true,
+                                                    false, 2, concurrency);
+    CostVolumes<float> cvs = sgm<float, float>(valid_inputs, directions_in, nb_row, nb_col, nb_disp, 1000.f, true,
+                                               true, false, 2, concurrency);
+    EXPECT_TRUE(std::equal(expected.cost_volume, expected.cost_volume + cv_in.size(), cvs.cost_volume))
+        << "concurrency " << concurrency;
+    EXPECT_TRUE(std::equal(expected.cost_volume_min, expected.cost_volume_min + nb_row * nb_col * 8,
+                           cvs.cost_volume_min))
+        << "concurrency " << concurrency;
+    delete[] expected.cost_volume;
+    delete[] expected.cost_volume_min;
+    delete[] cvs.cost_volume;
+    delete[] cvs.cost_volume_min;
+  }
+}
+
+TEST(sgmValidityTest, nanInvalidValue)
+{
+  const unsigned long int nb_row = 8;
+  const unsigned long int nb_col = 7;
+  const unsigned int nb_disp = 19;
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  std::vector<float> random_costs(nb_row * nb_col * nb_disp);
+  fillRandom(random_costs.data(), random_costs.size(), 50, 73);
+  std::vector<float> cv_in = random_costs, cv_nan = random_costs;
+  fillInvalidCosts(cv_in, nb_col, nb_disp, 1000.f);
+  fillInvalidCosts(cv_nan, nb_col, nb_disp, nan);
+  // Only the block of invalid points at first
+  const unsigned long int partial_point = 6 * nb_col + 2;
+  std::copy(&random_costs[partial_point * nb_disp], &random_costs[(partial_point + 1) * nb_disp],
+            &cv_in[partial_point * nb_disp]);
+  std::copy(&random_costs[partial_point * nb_disp], &random_costs[(partial_point + 1) * nb_disp],
+            &cv_nan[partial_point * nb_disp]);
+  std::vector<float> p1(nb_row * nb_col * 8, 4.f), p2(nb_row * nb_col * 8, 21.f);
+  int directions_in[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+
+  // The paths restart after the NaN points as after the points of equal invalid costs
+  CostVolumes<float> expected = sgm<float, float>(cv_in.data(), p1.data(), p2.data(), directions_in, nb_row, nb_col,
+                                                  nb_disp, 1000.f, nullptr, false, false, false, 2);
+  CostVolumes<float> cvs = sgm<float, float>(cv_nan.data(), p1.data(), p2.data(), directions_in, nb_row, nb_col,
+                                             nb_disp, nan, nullptr, false, false, false, 2);
+  for (unsigned long int index = 0; index < cv_in.size(); index++)
+  {
+    if (std::isnan(cv_nan[index]))
+    {
+      EXPECT_TRUE(std::isnan(cvs.cost_volume[index])) << "index " << index;
+    }
+    else
+    {
+      EXPECT_EQ(expected.cost_volume[index], cvs.cost_volume[index]) << "index " << index;
+    }
+  }
+  delete[] expected.cost_volume;
+  delete[] expected.cost_volume_min;
+  delete[] cvs.cost_volume;
+  delete[] cvs.cost_volume_min;
+
+  // NaN costs of a point are never selected as the minimum of the previous point
+  fillInvalidCosts(cv_nan, nb_col, nb_disp, nan);
+  cvs = sgm<float, float>(cv_nan.data(), p1.data(), p2.data(), directions_in, nb_row, nb_col, nb_disp, nan, nullptr,
+                          false, false, false, 2);
+  for (unsigned long int index = 0; index < cv_in.size(); index++)
+  {
+    EXPECT_EQ(std::isnan(cv_nan[index]), std::isnan(cvs.cost_volume[index])) << "index " << index;
+  }
+  delete[] cvs.cost_volume;
+  delete[] cvs.cost_volume_min;
+}
+
+/*
+ * Disparity grids
+ */
+
+TEST(sgmRangesTest, sameAsInvalidOutOfRange)
+{
+  const unsigned long int nb_row = 8;
+  const unsigned long int nb_col = 7;
+  const unsigned int nb_disp = 19;
+  const float invalid_value = 1e6f;
+  std::vector<float> cv_in(nb_row * nb_col * nb_disp);
+  fillRandom(cv_in.data(), cv_in.size(), 50, 79);
+  // Intervals clamped to the disparity axis, full in the first column, empty in one point
+  std::vector<int32_t> disp_min(nb_row * nb_col), disp_max(nb_row * nb_col);
+  for (unsigned long int row = 0; row < nb_row; row++)
+  {
+    for (unsigned long int col = 0; col < nb_col; col++)
+    {
+      disp_min[row * nb_col + col] = (col == 0) ? 0 : static_cast<int32_t>((row * 3 + col * 5) % 12) - 2;
+      disp_max[row * nb_col + col] = (col == 0) ? nb_disp - 1 : disp_min[row * nb_col + col] + (row + col) % 9 + 4;
+    }
+  }
+  disp_min[3 * nb_col + 3] = 5;
+  disp_max[3 * nb_col + 3] = 2;
+  // Costs out of the intervals are invalid
+  for (unsigned long int point = 0; point < nb_row * nb_col; point++)
+  {
+    for (int disp = 0; disp < static_cast<int>(nb_disp); disp++)
+    {
+      if (disp < disp_min[point] || disp > disp_max[point])
+      {
+        cv_in[point * nb_disp + disp] = invalid_value;
+      }
+    }
+  }
+  std::vector<float> p1(nb_row * nb_col * 8, 4.f), p2(nb_row * nb_col * 8, 21.f);
+  int directions_in[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+
+  SgmInputs<float> inputs = contiguousInputs<float>(cv_in.data(), p1.data(), p2.data(), nullptr, nb_col, nb_disp);
+  SgmInputs<float> range_inputs = inputs;
+  range_inputs.disp_min.data = disp_min.data();
+  range_inputs.disp_max.data = disp_max.data();
+  // Out of the intervals of the previous point, its invalid costs are never selected by the recurrence
+  const Concurrency concurrencies[3] = {CONCURRENCY_NONE, CONCURRENCY_PASSES, CONCURRENCY_DIRECTIONS};
+  for (Concurrency concurrency : concurrencies)
+  {
+    CostVolumes<float> expected = sgm<float, float>(inputs, directions_in, nb_row, nb_col, nb_disp, invalid_value,
+                                                    true, true, false, 2, concurrency);
+    CostVolumes<float> cvs = sgm<float, float>(range_inputs, directions_in, nb_row, nb_col, nb_disp, invalid_value,
+                                               true, true, false, 2, concurrency);
+    EXPECT_TRUE(std::equal(expected.cost_volume, expected.cost_volume + cv_in.size(), cvs.cost_volume))
+        << "concurrency " << concurrency;
+    EXPECT_TRUE(std::equal(expected.cost_volume_min, expected.cost_volume_min + nb_row * nb_col * 8,
+                           cvs.cost_volume_min))
+        << "concurrency " << concurrency;
+    delete[] expected.cost_volume;
+    delete[] expected.cost_volume_min;
+    delete[] cvs.cost_volume;
+    delete[] cvs.cost_volume_min;
+  }
+
+  range_inputs.disp_max.data = nullptr;
+  EXPECT_THROW((sgm<float, float>(range_inputs, directions_in, nb_row, nb_col, nb_disp, invalid_value, false, false,
+                                  false, 1, CONCURRENCY_NONE)),
+               std::invalid_argument);
+}
+
+// Out of the interval of the previous point, the minimum + P2 of the previous point must not saturate the narrow lanes
+TEST(sgmRangesTest, narrowSameAsWide)
+{
+  const unsigned long int nb_row = 4;
+  const unsigned long int nb_col = 8;
+  const unsigned int nb_disp = 12;
+  // Intervals not overlapping the ones of the previous column
+  std::vector<int32_t> disp_min(nb_row * nb_col), disp_max(nb_row * nb_col);
+  for (unsigned long int point = 0; point < nb_row * nb_col; point++)
+  {
+    disp_min[point] = (point % 2 == 0) ? 0 : 8;
+    disp_max[point] = disp_min[point] + 3;
+  }
+  std::vector<uint8_t> p1(nb_row * nb_col * 8, 20), p2(nb_row * nb_col * 8, 50);
+  int directions[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+  // Highest costs of 149, then of 199: max cost + 2 P2 fits in uint8, then does not
+  const unsigned int max_costs[2] = {149, 199};
+  for (unsigned int max_cost : max_costs)
+  {
+    std::vector<uint8_t> cv_in(nb_row * nb_col * nb_disp);
+    fillRandom(cv_in.data(), cv_in.size(), 10, 103);
+    for (uint8_t &cost : cv_in)
+    {
+      cost = static_cast<uint8_t>(cost + max_cost - 9);
+    }
+    SgmInputs<uint8_t> inputs = contiguousInputs<uint8_t>(cv_in.data(), p1.data(), p2.data(), nullptr, nb_col, nb_disp);
+    inputs.disp_min = {disp_min.data(), contiguousStrides(nb_col, 1)};
+    inputs.disp_max = {disp_max.data(), contiguousStrides(nb_col, 1)};
+    EXPECT_EQ(max_cost + 100., aggregatedCostBound(inputs, nb_row, nb_col, nb_disp, uint8_t(255), 1));
+
+    CostVolumes<uint16_t> wide = sgmWithAccumulator<uint8_t, uint16_t, uint16_t>(
+        inputs, directions, nb_row, nb_col, nb_disp, 255, false, false, false);
+    CostVolumes<uint16_t> cvs = sgm<uint8_t, uint16_t>(inputs, directions, nb_row, nb_col, nb_disp, 255, false, false,
+                                                       false);
+    EXPECT_TRUE(std::equal(wide.cost_volume, wide.cost_volume + cv_in.size(), cvs.cost_volume))
+        << "max cost " << max_cost;
+    if (max_cost + 100 <= 255)
+    {
+      CostVolumes<uint16_t> narrow = sgmWithAccumulator<uint8_t, uint8_t, uint16_t>(
+          inputs, directions, nb_row, nb_col, nb_disp, 255, false, false, false);
+      EXPECT_TRUE(std::equal(wide.cost_volume, wide.cost_volume + cv_in.size(), narrow.cost_volume))
+          << "max cost " << max_cost;
+      delete[] narrow.cost_volume;
+      delete[] narrow.cost_volume_min;
+    }
+    delete[] wide.cost_volume;
+    delete[] wide.cost_volume_min;
+    delete[] cvs.cost_volume;
+    delete[] cvs.cost_volume_min;
+  }
+}
+
+// Random costs, valid out of the intervals too, and points with only NaN costs in their interval
+void fillNanIntervals(std::vector<float> &cv_in, std::vector<int32_t> &disp_min, std::vector<int32_t> &disp_max,
+                      unsigned int nb_disp, const std::vector<unsigned long int> &nan_points)
+{
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  fillRandom(cv_in.data(), cv_in.size(), 50, 97);
+  for (unsigned long int point = 0; point < disp_min.size(); point++)
+  {
+    disp_min[point] = static_cast<int32_t>((point * 5) % 11);
+    disp_max[point] = disp_min[point] + static_cast<int32_t>(point % 6) + 2;
+  }
+  for (unsigned long int point : nan_points)
+  {
+    std::fill(&cv_in[point * nb_disp + disp_min[point]], &cv_in[point * nb_disp + disp_max[point] + 1], nan);
+  }
+}
+
+// Aggregated costs, NaN where they are expected NaN
+void expectSameCosts(const float *expected, const float *costs, unsigned long int nb_costs, const std::string &message)
+{
+  for (unsigned long int index = 0; index < nb_costs; index++)
+  {
+    if (std::isnan(expected[index]))
+    {
+      EXPECT_TRUE(std::isnan(costs[index])) << message << ", index " << index;
+    }
+    else
+    {
+      EXPECT_EQ(expected[index], costs[index]) << message << ", index " << index;
+    }
+  }
+}
+
+TEST(sgmRangesTest, nanInvalidValue)
+{
+  const unsigned long int nb_row = 8;
+  const unsigned long int nb_col = 7;
+  const unsigned int nb_disp = 19;
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  std::vector<float> cv_in(nb_row * nb_col * nb_disp);
+  std::vector<int32_t> disp_min(nb_row * nb_col), disp_max(nb_row * nb_col);
+  const std::vector<unsigned long int> nan_points = {9, 24, 25, 40};
+  fillNanIntervals(cv_in, disp_min, disp_max, nb_disp, nan_points);
+  std::vector<int32_t> empty_max = disp_max;
+  for (unsigned long int point : nan_points)
+  {
+    empty_max[point] = disp_min[point] - 1;
+  }
+  std::vector<float> p1(nb_row * nb_col * 8, 4.f), p2(nb_row * nb_col * 8, 21.f);
+  int directions_in[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+
+  SgmInputs<float> inputs = contiguousInputs<float>(cv_in.data(), p1.data(), p2.data(), nullptr, nb_col, nb_disp);
+  inputs.disp_min.data = disp_min.data();
+  inputs.disp_max.data = disp_max.data();
+  SgmInputs<float> empty_inputs = inputs;
+  empty_inputs.disp_max.data = empty_max.data();
+  // The paths restart after a point with only NaN costs in its interval, as after an empty interval, whatever its
+  // valid costs out of the interval
+  const Concurrency concurrencies[3] = {CONCURRENCY_NONE, CONCURRENCY_PASSES, CONCURRENCY_DIRECTIONS};
+  for (Concurrency concurrency : concurrencies)
+  {
+    CostVolumes<float> expected = sgm<float, float>(empty_inputs, directions_in, nb_row, nb_col, nb_disp, nan, false,
+                                                    true, false, 2, concurrency);
+    CostVolumes<float> cvs = sgm<float, float>(inputs, directions_in, nb_row, nb_col, nb_disp, nan, false, true, false,
+                                               2, concurrency);
+    expectSameCosts(expected.cost_volume, cvs.cost_volume, cv_in.size(),
+                    "concurrency " + std::to_string(concurrency));
+    delete[] expected.cost_volume;
+    delete[] expected.cost_volume_min;
+    delete[] cvs.cost_volume;
+    delete[] cvs.cost_volume_min;
+  }
+}
+
+/*
+ * Ragged cost volumes
+ */
+
+TEST(sgmRaggedTest, converters)
+{
+  const unsigned long int nb_row = 2;
+  const unsigned long int nb_col = 2;
+  const unsigned int nb_disp = 4;
+  std::vector<uint8_t> cv_in(nb_row * nb_col * nb_disp);
+  std::iota(cv_in.begin(), cv_in.end(), 1);
+  // Intervals clamped to the disparity axis, and an empty one
+  const int32_t disp_min[4] = {1, -2, 3, 2};
+  const int32_t disp_max[4] = {2, 0, 9, 1};
+  const StridedArray<int32_t> min_grid = {disp_min, contiguousStrides(nb_col, 1)};
+  const StridedArray<int32_t> max_grid = {disp_max, contiguousStrides(nb_col, 1)};
+  int64_t offsets[5] = {};
+  EXPECT_EQ(4, raggedOffsets(min_grid, max_grid, nb_row, nb_col, nb_disp, offsets));
+  const int64_t expected_offsets[5] = {0, 2, 3, 4, 4};
+  EXPECT_TRUE(std::equal(offsets, offsets + 5, expected_offsets));
+
+  std::vector<uint8_t> costs(4);
+  toRagged<uint8_t>({cv_in.data(), contiguousStrides(nb_col, nb_disp)}, min_grid, max_grid, offsets, nb_row, nb_col,
+                    nb_disp, costs.data(), 2);
+  EXPECT_EQ((std::vector<uint8_t>{2, 3, 5, 12}), costs);
+
+  std::vector<uint8_t> dense(cv_in.size());
+  toDense<uint8_t>(costs.data(), min_grid, max_grid, offsets, nb_row, nb_col, nb_disp, 255, dense.data(), 2);
+  EXPECT_EQ((std::vector<uint8_t>{255, 2, 3, 255, 5, 255, 255, 255, 255, 255, 255, 12, 255, 255, 255, 255}), dense);
+}
+
+TEST(sgmRaggedTest, sameAsDenseRanges)
+{
+  const unsigned long int nb_row = 8;
+  const unsigned long int nb_col = 7;
+  const unsigned int nb_disp = 19;
+  const float invalid_value = 1e6f;
+  std::vector<float> cv_in(nb_row * nb_col * nb_disp);
+  fillRandom(cv_in.data(), cv_in.size(), 50, 83);
+  std::vector<int32_t> disp_min(nb_row * nb_col), disp_max(nb_row * nb_col);
+  for (unsigned long int point = 0; point < nb_row * nb_col; point++)
+  {
+    disp_min[point] = static_cast<int32_t>((point * 7) % 13) - 1;
+    disp_max[point] = disp_min[point] + static_cast<int32_t>(point % 8) + 2;
+  }
+  disp_max[20] = disp_min[20] - 1;
+  const StridedArray<int32_t> min_grid = {disp_min.data(), contiguousStrides(nb_col, 1)};
+  const StridedArray<int32_t> max_grid = {disp_max.data(), contiguousStrides(nb_col, 1)};
+  std::vector<float> p1(nb_row * nb_col * 8, 4.f), p2(nb_row * nb_col * 8, 21.f);
+  int directions_in[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+
+  std::vector<int64_t> offsets(nb_row * nb_col + 1);
+  const int64_t nb_costs = raggedOffsets(min_grid, max_grid, nb_row, nb_col, nb_disp, offsets.data());
+  std::vector<float> costs(nb_costs);
+  toRagged<float>({cv_in.data(), contiguousStrides(nb_col, nb_disp)}, min_grid, max_grid, offsets.data(), nb_row,
+                  nb_col, nb_disp, costs.data(), 1);
+
+  SgmInputs<float> inputs = contiguousInputs<float>(cv_in.data(), p1.data(), p2.data(), nullptr, nb_col, nb_disp);
+  inputs.disp_min = min_grid;
+  inputs.disp_max = max_grid;
+  SgmInputs<float> ragged_inputs = inputs;
+  ragged_inputs.cv_in = {costs.data(), {0, 0, 1}};
+  ragged_inputs.offsets = offsets.data();
+  // The ragged volume gives the aggregated costs of the dense volume in the intervals
+  for (int num_threads = 1; num_threads < 3; num_threads++)
+  {
+    CostVolumes<float> expected = sgm<float, float>(inputs, directions_in, nb_row, nb_col, nb_disp, invalid_value,
+                                                    true, true, false, num_threads, CONCURRENCY_NONE);
+    CostVolumes<float> cvs = sgm<float, float>(ragged_inputs, directions_in, nb_row, nb_col, nb_disp, invalid_value,
+                                               true, true, false, num_threads, CONCURRENCY_NONE);
+    std::vector<float> expected_costs(nb_costs);
+    toRagged<float>({expected.cost_volume, contiguousStrides(nb_col, nb_disp)}, min_grid, max_grid, offsets.data(),
+                    nb_row, nb_col, nb_disp, expected_costs.data(), 1);
+    EXPECT_TRUE(std::equal(expected_costs.begin(), expected_costs.end(), cvs.cost_volume))
+        << "threads " << num_threads;
+    EXPECT_TRUE(std::equal(expected.cost_volume_min, expected.cost_volume_min + nb_row * nb_col * 8,
+                           cvs.cost_volume_min))
+        << "threads " << num_threads;
+    delete[] expected.cost_volume;
+    delete[] expected.cost_volume_min;
+    delete[] cvs.cost_volume;
+    delete[] cvs.cost_volume_min;
+  }
+
+  EXPECT_THROW((sgm<float, float>(ragged_inputs, directions_in, nb_row, nb_col, nb_disp, invalid_value, false, false,
+                                  false, 2, CONCURRENCY_PASSES)),
+               std::invalid_argument);
+  offsets[5] += 1;
+  EXPECT_THROW((sgm<float, float>(ragged_inputs, directions_in, nb_row, nb_col, nb_disp, invalid_value, false, false,
+                                  false, 1, CONCURRENCY_NONE)),
+               std::invalid_argument);
+}
+
+// With a NaN invalid value, the points with only NaN costs are found in the packed intervals
+TEST(sgmRaggedTest, nanInvalidValue)
+{
+  const unsigned long int nb_row = 8;
+  const unsigned long int nb_col = 7;
+  const unsigned int nb_disp = 19;
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  std::vector<float> cv_in(nb_row * nb_col * nb_disp);
+  std::vector<int32_t> disp_min(nb_row * nb_col), disp_max(nb_row * nb_col);
+  fillNanIntervals(cv_in, disp_min, disp_max, nb_disp, {9, 24, 25, 40});
+  const StridedArray<int32_t> min_grid = {disp_min.data(), contiguousStrides(nb_col, 1)};
+  const StridedArray<int32_t> max_grid = {disp_max.data(), contiguousStrides(nb_col, 1)};
+  std::vector<float> p1(nb_row * nb_col * 8, 4.f), p2(nb_row * nb_col * 8, 21.f);
+  int directions_in[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+
+  std::vector<int64_t> offsets(nb_row * nb_col + 1);
+  const int64_t nb_costs = raggedOffsets(min_grid, max_grid, nb_row, nb_col, nb_disp, offsets.data());
+  std::vector<float> costs(nb_costs);
+  toRagged<float>({cv_in.data(), contiguousStrides(nb_col, nb_disp)}, min_grid, max_grid, offsets.data(), nb_row,
+                  nb_col, nb_disp, costs.data(), 1);
+
+  SgmInputs<float> inputs = contiguousInputs<float>(cv_in.data(), p1.data(), p2.data(), nullptr, nb_col, nb_disp);
+  inputs.disp_min = min_grid;
+  inputs.disp_max = max_grid;
+  SgmInputs<float> ragged_inputs = inputs;
+  ragged_inputs.cv_in = {costs.data(), {0, 0, 1}};
+  ragged_inputs.offsets = offsets.data();
+  for (int num_threads = 1; num_threads < 3; num_threads++)
+  {
+    CostVolumes<float> expected = sgm<float, float>(inputs, directions_in, nb_row, nb_col, nb_disp, nan, false, true,
+                                                    false, num_threads, CONCURRENCY_NONE);
+    CostVolumes<float> cvs = sgm<float, float>(ragged_inputs, directions_in, nb_row, nb_col, nb_disp, nan, false, true,
+                                               false, num_threads, CONCURRENCY_NONE);
+    std::vector<float> expected_costs(nb_costs);
+    toRagged<float>({expected.cost_volume, contiguousStrides(nb_col, nb_disp)}, min_grid, max_grid, offsets.data(),
+                    nb_row, nb_col, nb_disp, expected_costs.data(), 1);
+    expectSameCosts(expected_costs.data(), cvs.cost_volume, nb_costs, "threads " + std::to_string(num_threads));
+    delete[] expected.cost_volume;
+    delete[] expected.cost_volume_min;
+    delete[] cvs.cost_volume;
+    delete[] cvs.cost_volume_min;
+  }
+}
+
+/*
+ * Memory efficient SGM
+ */
+
+// The costs of the disparity map are the ones of the aggregated cost volume, around the best disparity
+template <typename T, typename Tout>
+void compareToDenseVolume(T invalid_value, T max_cost)
+{
+  const unsigned long int nb_row = 9;
+  const unsigned long int nb_col = 8;
+  const unsigned int nb_disp = 21;
+  std::vector<T> cv_in(nb_row * nb_col * nb_disp);
+  fillRandom(cv_in.data(), cv_in.size(), max_cost, 89);
+  // A point with only invalid costs, and invalid first disparities in another one
+  std::fill(cv_in.begin() + 12 * nb_disp, cv_in.begin() + 13 * nb_disp, invalid_value);
+  std::fill(cv_in.begin() + 30 * nb_disp, cv_in.begin() + 30 * nb_disp + 6, invalid_value);
+  std::vector<T> p1(nb_row * nb_col * 8, 4), p2(nb_row * nb_col * 8, 21);
+  int directions_in[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+  const SgmInputs<T> inputs = contiguousInputs<T>(cv_in.data(), p1.data(), p2.data(), nullptr, nb_col, nb_disp);
+
+  CostVolumes<Tout> expected = sgm<T, Tout>(inputs, directions_in, nb_row, nb_col, nb_disp, invalid_value, false,
+                                            true, false);
+  for (int num_threads = 1; num_threads < 3; num_threads++)
+  {
+    DisparityMap<Tout> map = esgm<T, Tout>(inputs, directions_in, nb_row, nb_col, nb_disp, invalid_value, true, false,
+                                           num_threads);
+    for (unsigned long int point = 0; point < nb_row * nb_col; point++)
+    {
+      const int disp = map.disparity[point];
+      if (point == 12)
+      {
+        EXPECT_EQ(-1, disp);
+        continue;
+      }
+      ASSERT_GE(disp, 0) << "at point " << point;
+      ASSERT_LT(disp, static_cast<int>(nb_disp)) << "at point " << point;
+      EXPECT_NE(invalid_value, cv_in[point * nb_disp + disp]) << "at point " << point;
+      for (int k = 0; k < 3; k++)
+      {
+        const int neighbour = disp - 1 + k;
+        const Tout cost = (neighbour < 0 || neighbour >= static_cast<int>(nb_disp))
+                              ? static_cast<Tout>(invalid_value)
+                              : expected.cost_volume[point * nb_disp + neighbour];
+        EXPECT_EQ(cost, map.costs[3 * point + k]) << "at point " << point << ", threads " << num_threads;
+      }
+    }
+    delete[] map.disparity;
+    delete[] map.costs;
+  }
+  delete[] expected.cost_volume;
+  delete[] expected.cost_volume_min;
+}
+
+TEST(sgmEsgmTest, sameCostsAsDenseVolume)
+{
+  compareToDenseVolume<uint8_t, uint16_t>(255, 60);
+  compareToDenseVolume<float, float>(1e6f, 60.f);
+}
+
+// With a unique minimum along all the paths, the disparity map is the winner-takes-all of the cost volume
+TEST(sgmEsgmTest, sameAsWinnerTakesAll)
+{
+  const unsigned long int nb_row = 10;
+  const unsigned long int nb_col = 12;
+  const unsigned int nb_disp = 16;
+  std::vector<float> cv_in(nb_row * nb_col * nb_disp);
+  for (unsigned long int row = 0; row < nb_row; row++)
+  {
+    for (unsigned long int col = 0; col < nb_col; col++)
+    {
+      const int true_disp = static_cast<int>(3 + (row + col) / 3);
+      for (int disp = 0; disp < static_cast<int>(nb_disp); disp++)
+      {
+        cv_in[(row * nb_col + col) * nb_disp + disp] = 8.f * std::abs(disp - true_disp);
+      }
+    }
+  }
+  std::vector<float> p1(nb_row * nb_col * 8, 4.f), p2(nb_row * nb_col * 8, 21.f);
+  int directions_in[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+  const SgmInputs<float> inputs =
+      contiguousInputs<float>(cv_in.data(), p1.data(), p2.data(), nullptr, nb_col, nb_disp);
+
+  CostVolumes<float> expected = sgm<float, float>(inputs, directions_in, nb_row, nb_col, nb_disp, -1.f, false, false,
+                                                  false);
+  std::vector<int> disparity(nb_row * nb_col);
+  std::vector<float> costs(3 * nb_row * nb_col);
+  DisparityMap<float> map = esgm<float, float>(inputs, directions_in, nb_row, nb_col, nb_disp, -1.f, false, false, 1,
+                                               disparity.data(), costs.data());
+  EXPECT_EQ(disparity.data(), map.disparity);
+  EXPECT_EQ(costs.data(), map.costs);
+  for (unsigned long int point = 0; point < nb_row * nb_col; point++)
+  {
+    const float *point_costs = &expected.cost_volume[point * nb_disp];
+    EXPECT_EQ(std::min_element(point_costs, point_costs + nb_disp) - point_costs, disparity[point])
+        << "at point " << point;
+  }
+  delete[] expected.cost_volume;
+  delete[] expected.cost_volume_min;
+
+  int single_pass[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, 1, -1, 0, -1, -1, -1, 1};
+  EXPECT_THROW((esgm<float, float>(inputs, single_pass, nb_row, nb_col, nb_disp, -1.f, false, false)),
+               std::invalid_argument);
+}
+
+// With disparity grids, the best disparity and its costs are the ones of the interval of the point
+TEST(sgmEsgmTest, disparityGrids)
+{
+  int directions_in[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+  // Equal valid costs out of the interval are never selected, whatever the invalid value
+  std::vector<float> equal_costs(4 * 4, 5.f);
+  std::vector<float> equal_p1(4 * 8, 4.f), equal_p2(4 * 8, 21.f);
+  const std::vector<int32_t> equal_min(4, 2), equal_max(4, 3);
+  SgmInputs<float> equal_inputs =
+      contiguousInputs<float>(equal_costs.data(), equal_p1.data(), equal_p2.data(), nullptr, 4, 4);
+  equal_inputs.disp_min.data = equal_min.data();
+  equal_inputs.disp_max.data = equal_max.data();
+  const float invalid_values[2] = {-1.f, std::numeric_limits<float>::quiet_NaN()};
+  for (float invalid_value : invalid_values)
+  {
+    DisparityMap<float> map = esgm<float, float>(equal_inputs, directions_in, 1, 4, 4, invalid_value, false, false);
+    for (int point = 0; point < 4; point++)
+    {
+      EXPECT_EQ(2, map.disparity[point]) << "invalid value " << invalid_value;
+      EXPECT_TRUE(isInvalidCost(map.costs[3 * point], invalid_value)) << "invalid value " << invalid_value;
+      EXPECT_FALSE(isInvalidCost(map.costs[3 * point + 2], invalid_value)) << "invalid value " << invalid_value;
+    }
+    delete[] map.disparity;
+    delete[] map.costs;
+  }
+
+  // Random intervals and valid costs out of them, dense or ragged
+  const unsigned long int nb_row = 9;
+  const unsigned long int nb_col = 8;
+  const unsigned int nb_disp = 21;
+  const float invalid_value = 1e6f;
+  std::vector<float> cv_in(nb_row * nb_col * nb_disp);
+  fillRandom(cv_in.data(), cv_in.size(), 60, 101);
+  std::vector<int32_t> disp_min(nb_row * nb_col), disp_max(nb_row * nb_col);
+  for (unsigned long int point = 0; point < nb_row * nb_col; point++)
+  {
+    disp_min[point] = static_cast<int32_t>((point * 7) % 15) - 2;
+    disp_max[point] = disp_min[point] + static_cast<int32_t>(point % 9) + 1;
+  }
+  disp_max[30] = disp_min[30] - 1;
+  const StridedArray<int32_t> min_grid = {disp_min.data(), contiguousStrides(nb_col, 1)};
+  const StridedArray<int32_t> max_grid = {disp_max.data(), contiguousStrides(nb_col, 1)};
+  std::vector<float> p1(nb_row * nb_col * 8, 4.f), p2(nb_row * nb_col * 8, 21.f);
+  SgmInputs<float> inputs = contiguousInputs<float>(cv_in.data(), p1.data(), p2.data(), nullptr, nb_col, nb_disp);
+  inputs.disp_min = min_grid;
+  inputs.disp_max = max_grid;
+  std::vector<int64_t> offsets(nb_row * nb_col + 1);
+  std::vector<float> ragged_costs(raggedOffsets(min_grid, max_grid, nb_row, nb_col, nb_disp, offsets.data()));
+  toRagged<float>({cv_in.data(), contiguousStrides(nb_col, nb_disp)}, min_grid, max_grid, offsets.data(), nb_row,
+                  nb_col, nb_disp, ragged_costs.data(), 1);
+  SgmInputs<float> ragged_inputs = inputs;
+  ragged_inputs.cv_in = {ragged_costs.data(), {0, 0, 1}};
+  ragged_inputs.offsets = offsets.data();
+
+  CostVolumes<float> expected = sgm<float, float>(inputs, directions_in, nb_row, nb_col, nb_disp, invalid_value, false,
+                                                  true, false);
+  for (int num_threads = 1; num_threads < 3; num_threads++)
+  {
+    DisparityMap<float> map = esgm<float, float>(inputs, directions_in, nb_row, nb_col, nb_disp, invalid_value, true,
+                                                 false, num_threads);
+    DisparityMap<float> ragged_map = esgm<float, float>(ragged_inputs, directions_in, nb_row, nb_col, nb_disp,
+                                                        invalid_value, true, false, num_threads);
+    for (unsigned long int point = 0; point < nb_row * nb_col; point++)
+    {
+      const std::pair<int, int> range = disparityRange(inputs, point / nb_col, point % nb_col, nb_disp);
+      const int disp = map.disparity[point];
+      EXPECT_EQ(disp, ragged_map.disparity[point]) << "at point " << point << ", threads " << num_threads;
+      if (range.first > range.second)
+      {
+        EXPECT_EQ(-1, disp) << "at point " << point;
+        continue;
+      }
+      EXPECT_GE(disp, range.first) << "at point " << point;
+      EXPECT_LE(disp, range.second) << "at point " << point;
+      for (int k = 0; k < 3; k++)
+      {
+        const int neighbour = disp - 1 + k;
+        const float cost = (neighbour < range.first || neighbour > range.second)
+                               ? invalid_value
+                               : expected.cost_volume[point * nb_disp + neighbour];
+        EXPECT_EQ(cost, map.costs[3 * point + k]) << "at point " << point << ", threads " << num_threads;
+        EXPECT_EQ(cost, ragged_map.costs[3 * point + k]) << "at point " << point << ", threads " << num_threads;
+      }
+    }
+    delete[] map.disparity;
+    delete[] map.costs;
+    delete[] ragged_map.disparity;
+    delete[] ragged_map.costs;
+  }
+  delete[] expected.cost_volume;
+  delete[] expected.cost_volume_min;
+}
+
+/*
+ * Fused disparity map
+ */
+
+TEST(sgmDisparityTest, pointDisparity)
+{
+  const float pixel_costs[6] = {3.f, 1.f, -1.f, 2.f, 2.f, 7.f};
+  const float costs[6] = {9.f, 5.f, 0.f, 1.f, 3.f, 1.f};
+  // Invalid costs are not selected, ties give the lowest disparity
+  EXPECT_EQ(3.f, pointDisparity(costs, pixel_costs, 0, 5, -1.f, DISPARITY_WTA));
+  // An invalid neighbour, or the end of the interval, leaves the disparity as is
+  EXPECT_EQ(3.f, pointDisparity(costs, pixel_costs, 0, 5, -1.f, DISPARITY_PARABOLA));
+  EXPECT_EQ(5.f, pointDisparity(&costs[4], pixel_costs, 4, 5, -1.f, DISPARITY_V_SHAPE));
+  const uint8_t int_costs[5] = {4, 4, 4, 4, 4};
+  const uint16_t sums[5] = {8, 5, 1, 3, 6};
+  EXPECT_FLOAT_EQ(2.f + 2.f / 12.f, pointDisparity(sums, int_costs, 0, 4, uint8_t(255), DISPARITY_PARABOLA));
+  EXPECT_FLOAT_EQ(2.f + 2.f / 8.f, pointDisparity(sums, int_costs, 0, 4, uint8_t(255), DISPARITY_V_SHAPE));
+  EXPECT_TRUE(std::isnan(pointDisparity(sums, int_costs, 0, 4, uint8_t(4), DISPARITY_WTA)));
+}
+
+// The disparity map of the second pass is the one of the returned cost volume, with or without concurrency
+TEST(sgmDisparityTest, sameAsCostVolume)
+{
+  const unsigned long int nb_row = 8;
+  const unsigned long int nb_col = 9;
+  const unsigned int nb_disp = 17;
+  const float invalid_value = 1e6f;
+  std::vector<float> cv_in(nb_row * nb_col * nb_disp);
+  fillRandom(cv_in.data(), cv_in.size(), 50, 97);
+  fillInvalidCosts(cv_in, nb_col, nb_disp, invalid_value);
+  std::vector<int32_t> disp_min(nb_row * nb_col), disp_max(nb_row * nb_col);
+  for (unsigned long int point = 0; point < nb_row * nb_col; point++)
+  {
+    disp_min[point] = static_cast<int32_t>(point % 5) - 1;
+    disp_max[point] = disp_min[point] + 9;
+  }
+  std::vector<float> p1(nb_row * nb_col * 8, 4.f), p2(nb_row * nb_col * 8, 21.f);
+  int directions_in[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+  SgmInputs<float> inputs = contiguousInputs<float>(cv_in.data(), p1.data(), p2.data(), nullptr, nb_col, nb_disp);
+  inputs.disp_min = {disp_min.data(), contiguousStrides(nb_col, 1)};
+  inputs.disp_max = {disp_max.data(), contiguousStrides(nb_col, 1)};
+
+  const DisparityMode modes[3] = {DISPARITY_WTA, DISPARITY_PARABOLA, DISPARITY_V_SHAPE};
+  const Concurrency concurrencies[3] = {CONCURRENCY_NONE, CONCURRENCY_PASSES, CONCURRENCY_DIRECTIONS};
+  for (DisparityMode mode : modes)
+  {
+    for (Concurrency concurrency : concurrencies)
+    {
+      CostVolumes<float> cvs = sgm<float, float>(inputs, directions_in, nb_row, nb_col, nb_disp, invalid_value, false,
+                                                 true, false, 2, concurrency, 7, nullptr, nullptr, false, mode);
+      CostVolumes<float> map_only = sgm<float, float>(inputs, directions_in, nb_row, nb_col, nb_disp, invalid_value,
+                                                      false, true, false, 2, concurrency, 7, nullptr, nullptr, false,
+                                                      mode, false);
+      EXPECT_EQ(nullptr, map_only.cost_volume);
+      for (unsigned long int point = 0; point < nb_row * nb_col; point++)
+      {
+        const int first_disp = std::max(disp_min[point], 0);
+        const int last_disp = std::min(disp_max[point], static_cast<int32_t>(nb_disp) - 1);
+        const float expected = pointDisparity(&cvs.cost_volume[point * nb_disp + first_disp],
+                                              &cv_in[point * nb_disp], first_disp, last_disp, invalid_value, mode);
+        if (std::isnan(expected))
+        {
+          EXPECT_TRUE(std::isnan(cvs.disparity_map[point])) << "at point " << point;
+          EXPECT_TRUE(std::isnan(map_only.disparity_map[point])) << "at point " << point;
+          continue;
+        }
+        EXPECT_EQ(expected, cvs.disparity_map[point]) << "mode " << mode << " concurrency " << concurrency;
+        EXPECT_EQ(expected, map_only.disparity_map[point]) << "mode " << mode << " concurrency " << concurrency;
+        EXPECT_GE(cvs.disparity_map[point], first_disp - 0.5f);
+        EXPECT_LE(cvs.disparity_map[point], last_disp + 0.5f);
+      }
+      delete[] cvs.cost_volume;
+      delete[] cvs.cost_volume_min;
+      delete[] cvs.disparity_map;
+      delete[] map_only.cost_volume_min;
+      delete[] map_only.disparity_map;
+    }
+  }
+
+  // The argmin of the block of invalid costs is NaN
+  CostVolumes<float> wta = sgm<float, float>(inputs, directions_in, nb_row, nb_col, nb_disp, invalid_value, false,
+                                             false, false, 1, CONCURRENCY_NONE, 7, nullptr, nullptr, false,
+                                             DISPARITY_WTA, false);
+  EXPECT_TRUE(std::isnan(wta.disparity_map[3 * nb_col + 2]));
+  delete[] wta.cost_volume_min;
+  delete[] wta.disparity_map;
+
+  // Without disparity grids, the interval of each point is the whole disparity axis
+  inputs.disp_min.data = nullptr;
+  inputs.disp_max.data = nullptr;
+  CostVolumes<float> dense = sgm<float, float>(inputs, directions_in, nb_row, nb_col, nb_disp, invalid_value, false,
+                                               false, false, 1, CONCURRENCY_NONE, 7, nullptr, nullptr, false,
+                                               DISPARITY_WTA);
+  for (unsigned long int point = 0; point < nb_row * nb_col; point++)
+  {
+    const float expected = pointDisparity(&dense.cost_volume[point * nb_disp], &cv_in[point * nb_disp], 0,
+                                          nb_disp - 1, invalid_value, DISPARITY_WTA);
+    EXPECT_TRUE(expected == dense.disparity_map[point] ||
+                (std::isnan(expected) && std::isnan(dense.disparity_map[point])))
+        << "at point " << point;
+  }
+  delete[] dense.cost_volume;
+  delete[] dense.cost_volume_min;
+  delete[] dense.disparity_map;
+
+  EXPECT_THROW((sgm<float, float>(inputs, directions_in, nb_row, nb_col, nb_disp, invalid_value, false, false, false,
+                                  1, CONCURRENCY_NONE, 7, nullptr, nullptr, false, DISPARITY_NONE, false)),
+               std::invalid_argument);
+}
+
+/*
+ * Fused confidence maps
+ */
+
+TEST(sgmConfidenceTest, pointConfidence)
+{
+  const float pixel_costs[5] = {3.f, 1.f, 2.f, 2.f, 7.f};
+  const float costs[5] = {4.f, 1.f, 2.f, 6.f, 1.5f};
+  const int path_minimums[8] = {1, 2, 0, 4, 1, 1, 3, 1};
+  float ambiguity = 0.f, risk_min = 0.f, risk_max = 0.f, ratio = 0.f;
+  uint8_t path_agreement = 0;
+  ConfidenceMaps maps = {&ambiguity, &risk_min, &risk_max, &ratio, &path_agreement};
+  const ConfidenceOptions options = {true, true, true, true, 1.f, 0.5f};
+  // Disparities up to eta = 0, 0.5 and 1 above the lowest cost: {1}, {1, 4} and {1, 2, 4}
+  pointConfidence(costs, pixel_costs, 0, 4, -1.f, options, path_minimums, maps, 0);
+  EXPECT_FLOAT_EQ(2.f, ambiguity);
+  EXPECT_FLOAT_EQ(1.f / 3.f, risk_min);
+  EXPECT_FLOAT_EQ(2.f, risk_max);
+  EXPECT_FLOAT_EQ(1.f / 1.5f, ratio);
+  EXPECT_EQ(6, path_agreement);
+
+  // Without valid cost
+  pointConfidence(costs, pixel_costs, 0, 4, 2.f, options, path_minimums, maps, 0);
+  pointConfidence(costs, pixel_costs, 2, 3, 2.f, options, path_minimums, maps, 0);
+  EXPECT_TRUE(std::isnan(ambiguity));
+  EXPECT_TRUE(std::isnan(risk_min));
+  EXPECT_TRUE(std::isnan(risk_max));
+  EXPECT_TRUE(std::isnan(ratio));
+  EXPECT_EQ(0, path_agreement);
+}
+
+// The confidence maps of the second pass are the ones of the returned cost volume, with or without concurrency
+TEST(sgmConfidenceTest, sameAsCostVolume)
+{
+  const unsigned long int nb_row = 7;
+  const unsigned long int nb_col = 8;
+  const unsigned int nb_disp = 15;
+  const uint8_t invalid_value = 255;
+  std::vector<uint8_t> cv_in, p1, p2;
+  fillUint8Volume(cv_in, p1, p2, nb_row * nb_col, nb_disp, 60, 30);
+  std::fill(cv_in.begin() + 9 * nb_disp, cv_in.begin() + 10 * nb_disp, invalid_value);
+  int directions_in[2 * 8] = {0, 1, 1, 0, 1, 1, 1, -1, 0, -1, -1, 0, -1, -1, -1, 1};
+  const SgmInputs<uint8_t> inputs =
+      contiguousInputs<uint8_t>(cv_in.data(), p1.data(), p2.data(), nullptr, nb_col, nb_disp);
+  const ConfidenceOptions options = {true, true, true, true, 20.f, 4.f};
+  const unsigned long int nb_pixels = nb_row * nb_col;
+
+  const Concurrency concurrencies[3] = {CONCURRENCY_NONE, CONCURRENCY_PASSES, CONCURRENCY_DIRECTIONS};
+  for (Concurrency concurrency : concurrencies)
+  {
+    CostVolumes<uint16_t> cvs = sgm<uint8_t, uint16_t>(inputs, directions_in, nb_row, nb_col, nb_disp, invalid_value,
+                                                       true, true, false, 2, concurrency, 7, nullptr, nullptr, false,
+                                                       DISPARITY_NONE, true, nullptr, options);
+    EXPECT_EQ(nullptr, cvs.disparity_map);
+    std::vector<float> ambiguity(nb_pixels), risk_min(nb_pixels), risk_max(nb_pixels), ratio(nb_pixels);
+    std::vector<uint8_t> path_agreement(nb_pixels);
+    ConfidenceMaps expected = {ambiguity.data(), risk_min.data(), risk_max.data(), ratio.data(),
+                               path_agreement.data()};
+    for (unsigned long int point = 0; point < nb_pixels; point++)
+    {
+      pointConfidence(&cvs.cost_volume[point * nb_disp], &cv_in[point * nb_disp], 0, nb_disp - 1, invalid_value,
+                      options, &cvs.cost_volume_min[point * 8], expected, point);
+    }
+    for (unsigned long int point = 0; point < nb_pixels; point++)
+    {
+      if (point == 9)
+      {
+        EXPECT_TRUE(std::isnan(cvs.confidence.ambiguity[point]));
+        EXPECT_EQ(0, cvs.confidence.path_agreement[point]);
+        continue;
+      }
+      ASSERT_EQ(ambiguity[point], cvs.confidence.ambiguity[point]) << "concurrency " << concurrency;
+      ASSERT_EQ(risk_min[point], cvs.confidence.risk_min[point]) << "concurrency " << concurrency;
+      ASSERT_EQ(risk_max[point], cvs.confidence.risk_max[point]) << "concurrency " << concurrency;
+      ASSERT_EQ(ratio[point], cvs.confidence.ratio[point]) << "concurrency " << concurrency;
+      ASSERT_EQ(path_agreement[point], cvs.confidence.path_agreement[point]) << "concurrency " << concurrency;
+      EXPECT_GE(cvs.confidence.ambiguity[point], 1.f);
+      EXPECT_LE(cvs.confidence.risk_min[point], cvs.confidence.risk_max[point]);
+      EXPECT_LE(cvs.confidence.ratio[point], 1.f);
+      EXPECT_LE(cvs.confidence.path_agreement[point], 8);
+    }
+    delete[] cvs.cost_volume;
+    delete[] cvs.cost_volume_min;
+    delete[] cvs.confidence.ambiguity;
+    delete[] cvs.confidence.risk_min;
+    delete[] cvs.confidence.risk_max;
+    delete[] cvs.confidence.ratio;
+    delete[] cvs.confidence.path_agreement;
+  }
+
+  EXPECT_THROW((sgm<uint8_t, uint16_t>(inputs, directions_in, nb_row, nb_col, nb_disp, invalid_value, false, true,
+                                       false, 1, CONCURRENCY_NONE, 7, nullptr, nullptr, false, DISPARITY_NONE, true,
+                                       nullptr, options)),
+               std::invalid_argument);
+}
+
 int main(int argc, char **argv)
 {
 
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
-}
\ No newline at end of file
+}